@@ -0,0 +1,285 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+/*
+ * Copyright (C) Fadhil Riyanto <me@fadev.org>
+ */
+
+#include "aho_corasick.h"
+#include <stdlib.h>
+#include <string.h>
+
+int ac_init(struct ac *ac) {
+        memset(ac, 0, sizeof(struct ac));
+
+        ac->nodes_cap = 64;
+        ac->nodes = (struct ac_node *)calloc(ac->nodes_cap,
+                                             sizeof(struct ac_node));
+        if (ac->nodes == NULL)
+                return -1;
+
+        ac->nnodes = 1; /* root */
+        return 0;
+}
+
+static uint32_t __ac_node_new(struct ac *ac, uint8_t byte) {
+        if (ac->nnodes == ac->nodes_cap) {
+                uint32_t cap = ac->nodes_cap * 2;
+                struct ac_node *nodes = (struct ac_node *)realloc(
+                    ac->nodes, cap * sizeof(struct ac_node));
+                if (nodes == NULL)
+                        return 0;
+
+                ac->nodes = nodes;
+                ac->nodes_cap = cap;
+        }
+
+        memset(&ac->nodes[ac->nnodes], 0, sizeof(struct ac_node));
+        ac->nodes[ac->nnodes].byte = byte;
+        return ac->nnodes++;
+}
+
+int ac_add(struct ac *ac, const uint8_t *key, uint32_t len, uint32_t id) {
+        uint32_t node = 0;
+
+        if (len == 0)
+                return -1;
+
+        for (uint32_t i = 0; i < len; i++) {
+                uint32_t c = ac->nodes[node].child;
+
+                while (c && ac->nodes[c].byte != key[i]) {
+                        c = ac->nodes[c].sibling;
+                }
+
+                if (c == 0) {
+                        c = __ac_node_new(ac, key[i]);
+                        if (c == 0)
+                                return -1;
+
+                        ac->nodes[c].sibling = ac->nodes[node].child;
+                        ac->nodes[node].child = c;
+                }
+                node = c;
+        }
+
+        if (ac->nkeys == ac->keys_cap) {
+                uint32_t cap = ac->keys_cap ? ac->keys_cap * 2 : 64;
+                uint32_t *ids =
+                    (uint32_t *)realloc(ac->key_ids, cap * sizeof(uint32_t));
+                if (ids == NULL)
+                        return -1;
+                ac->key_ids = ids;
+
+                uint32_t *next =
+                    (uint32_t *)realloc(ac->key_next, cap * sizeof(uint32_t));
+                if (next == NULL)
+                        return -1;
+                ac->key_next = next;
+                ac->keys_cap = cap;
+        }
+
+        /* key index + 1, 0 ends the list */
+        ac->key_ids[ac->nkeys] = id;
+        ac->key_next[ac->nkeys] = ac->nodes[node].out;
+        ac->nodes[node].out = ac->nkeys + 1;
+        ac->nkeys++;
+        return 0;
+}
+
+/* goto of state s on byte c, 0 when s has no such edge */
+static inline uint32_t __ac_edge(const struct ac *ac, uint32_t s, uint8_t c) {
+        uint32_t lo = ac->edge_first[s];
+        uint32_t hi = ac->edge_first[s + 1];
+
+        while (lo < hi) {
+                uint32_t mid = lo + (hi - lo) / 2;
+
+                if (ac->edge_byte[mid] == c)
+                        return ac->edge_next[mid];
+                if (ac->edge_byte[mid] < c)
+                        lo = mid + 1;
+                else
+                        hi = mid;
+        }
+
+        return 0;
+}
+
+static void __ac_sort_children(struct ac *ac, uint32_t *c, uint32_t n) {
+        for (uint32_t i = 1; i < n; i++) {
+                uint32_t v = c[i];
+                uint32_t j = i;
+
+                for (; j > 0 && ac->nodes[c[j - 1]].byte > ac->nodes[v].byte;
+                     j--) {
+                        c[j] = c[j - 1];
+                }
+                c[j] = v;
+        }
+}
+
+int ac_compile(struct ac *ac) {
+        uint32_t n = ac->nnodes;
+        uint32_t children[256];
+        int ret = -1;
+
+        uint32_t *order = (uint32_t *)malloc(n * sizeof(uint32_t));
+        uint32_t *newid = (uint32_t *)malloc(n * sizeof(uint32_t));
+        uint32_t *parent = (uint32_t *)malloc(n * sizeof(uint32_t));
+
+        ac->nstates = n;
+        ac->ndense = n < AC_DENSE_MAX ? n : AC_DENSE_MAX;
+        ac->fail = (uint32_t *)calloc(n, sizeof(uint32_t));
+        ac->dict = (uint32_t *)calloc(n, sizeof(uint32_t));
+        ac->edge_first = (uint32_t *)calloc(n + 1, sizeof(uint32_t));
+        ac->edge_byte = (uint8_t *)malloc(n);
+        ac->edge_next = (uint32_t *)malloc(n * sizeof(uint32_t));
+        ac->out_first = (uint32_t *)calloc(n + 1, sizeof(uint32_t));
+        ac->out = (uint32_t *)malloc((ac->nkeys + 1) * sizeof(uint32_t));
+        ac->dense = (uint32_t *)malloc((size_t)ac->ndense * 256 *
+                                       sizeof(uint32_t));
+
+        if (!order || !newid || !parent || !ac->fail || !ac->dict ||
+            !ac->edge_first || !ac->edge_byte || !ac->edge_next ||
+            !ac->out_first || !ac->out || !ac->dense)
+                goto out;
+
+        /* breadth first numbering, shallow states first */
+        uint32_t head = 0;
+        uint32_t tail = 1;
+        uint32_t nedges = 0;
+        uint32_t nout = 0;
+
+        order[0] = 0;
+        newid[0] = 0;
+        while (head < tail) {
+                uint32_t s = head;
+                uint32_t u = order[head++];
+                uint32_t nc = 0;
+
+                for (uint32_t c = ac->nodes[u].child; c;
+                     c = ac->nodes[c].sibling) {
+                        children[nc++] = c;
+                }
+                __ac_sort_children(ac, children, nc);
+
+                ac->edge_first[s] = nedges;
+                for (uint32_t i = 0; i < nc; i++) {
+                        newid[children[i]] = tail;
+                        parent[tail] = s;
+                        order[tail++] = children[i];
+                        ac->edge_byte[nedges] = ac->nodes[children[i]].byte;
+                        ac->edge_next[nedges] = newid[children[i]];
+                        nedges++;
+                }
+
+                ac->out_first[s] = nout;
+                for (uint32_t k = ac->nodes[u].out; k;
+                     k = ac->key_next[k - 1]) {
+                        ac->out[nout++] = ac->key_ids[k - 1];
+                }
+        }
+        ac->edge_first[n] = nedges;
+        ac->out_first[n] = nout;
+
+        /* a parent always comes before its children */
+        for (uint32_t s = 1; s < n; s++) {
+                uint32_t p = parent[s];
+                uint8_t c = ac->nodes[order[s]].byte;
+                uint32_t f = ac->fail[p];
+
+                if (p == 0)
+                        continue;
+
+                for (;;) {
+                        uint32_t t = __ac_edge(ac, f, c);
+                        if (t) {
+                                ac->fail[s] = t;
+                                break;
+                        }
+                        if (f == 0)
+                                break;
+                        f = ac->fail[f];
+                }
+        }
+
+        for (uint32_t s = 1; s < n; s++) {
+                uint32_t f = ac->fail[s];
+
+                ac->dict[s] = ac->out_first[f] != ac->out_first[f + 1]
+                                  ? f
+                                  : ac->dict[f];
+        }
+
+        /* fail[s] < s, its row is already complete */
+        for (uint32_t s = 0; s < ac->ndense; s++) {
+                uint32_t *row = &ac->dense[(size_t)s * 256];
+
+                for (uint32_t c = 0; c < 256; c++) {
+                        uint32_t t = __ac_edge(ac, s, c);
+
+                        if (t == 0 && s != 0)
+                                t = ac->dense[(size_t)ac->fail[s] * 256 + c];
+                        row[c] = t;
+                }
+        }
+
+        free(ac->nodes);
+        free(ac->key_ids);
+        free(ac->key_next);
+        ac->nodes = NULL;
+        ac->key_ids = NULL;
+        ac->key_next = NULL;
+        ret = 0;
+
+out:
+        free(order);
+        free(newid);
+        free(parent);
+        return ret;
+}
+
+void ac_free(struct ac *ac) {
+        free(ac->nodes);
+        free(ac->key_ids);
+        free(ac->key_next);
+        free(ac->dense);
+        free(ac->fail);
+        free(ac->edge_first);
+        free(ac->edge_byte);
+        free(ac->edge_next);
+        free(ac->out_first);
+        free(ac->out);
+        free(ac->dict);
+        memset(ac, 0, sizeof(struct ac));
+}
+
+static inline uint32_t __ac_next(const struct ac *ac, uint32_t s, uint8_t c) {
+        while (s >= ac->ndense) {
+                uint32_t t = __ac_edge(ac, s, c);
+                if (t)
+                        return t;
+
+                s = ac->fail[s];
+        }
+
+        return ac->dense[(size_t)s * 256 + c];
+}
+
+void ac_scan(const struct ac *ac, const uint8_t *data, uint64_t start,
+             uint64_t end, ac_match_fn fn, void *ctx) {
+        uint32_t s = 0;
+
+        for (uint64_t i = start; i < end; i++) {
+                s = __ac_next(ac, s, data[i]);
+
+                uint32_t t = ac->out_first[s] != ac->out_first[s + 1]
+                                 ? s
+                                 : ac->dict[s];
+                for (; t; t = ac->dict[t]) {
+                        for (uint32_t k = ac->out_first[t];
+                             k < ac->out_first[t + 1]; k++) {
+                                fn(ctx, ac->out[k], i + 1);
+                        }
+                }
+        }
+}
@@ -0,0 +1,64 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+/*
+ * Copyright (C) Fadhil Riyanto <me@fadev.org>
+ * Aho-Corasick automaton over byte strings, every key is found in one
+ * pass over the input
+ *
+ * states are numbered breadth first, the AC_DENSE_MAX shallowest ones
+ * (where a scan spends nearly all of its time) get a full 256 entry
+ * row with the failure links already folded in. deeper states keep
+ * their edges sorted in flat arrays and fall back through the failure
+ * links until they reach a dense state
+ */
+
+#ifndef AHO_CORASICK_H
+#define AHO_CORASICK_H
+
+#include <stdint.h>
+
+#define AC_DENSE_MAX 256
+
+/* build-time trie node, children are a sibling list */
+struct ac_node {
+        uint32_t child;
+        uint32_t sibling;
+        uint32_t out; /* first key ending here, index into keys, or 0 */
+        uint8_t byte;
+};
+
+struct ac {
+        /* building */
+        struct ac_node *nodes;
+        uint32_t nnodes;
+        uint32_t nodes_cap;
+        uint32_t *key_ids;  /* key i -> caller id */
+        uint32_t *key_next; /* next key ending at the same node */
+        uint32_t nkeys;
+        uint32_t keys_cap;
+
+        /* compiled, read only while scanning */
+        uint32_t nstates;
+        uint32_t ndense;
+        uint32_t *dense; /* ndense rows of 256 */
+        uint32_t *fail;
+        uint32_t *edge_first; /* nstates + 1, into edge_byte / edge_next */
+        uint8_t *edge_byte;
+        uint32_t *edge_next;
+        uint32_t *out_first; /* nstates + 1, into out */
+        uint32_t *out;       /* caller ids of keys ending at the state */
+        uint32_t *dict;      /* next state on the fail chain with output */
+};
+
+/* called with the caller id and the offset one past the key's end */
+typedef void (*ac_match_fn)(void *ctx, uint32_t id, uint64_t end);
+
+int ac_init(struct ac *ac);
+int ac_add(struct ac *ac, const uint8_t *key, uint32_t len, uint32_t id);
+int ac_compile(struct ac *ac);
+void ac_free(struct ac *ac);
+
+/* every key ending inside data[start, end) that also starts there */
+void ac_scan(const struct ac *ac, const uint8_t *data, uint64_t start,
+             uint64_t end, ac_match_fn fn, void *ctx);
+
+#endif /* AHO_CORASICK_H */
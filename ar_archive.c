@@ -0,0 +1,306 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+/*
+ * Copyright (C) Fadhil Riyanto <me@fadev.org>
+ */
+
+#include "ar_archive.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * member header, every field is space padded ascii
+ */
+struct ar_hdr {
+        char ar_name[16];
+        char ar_date[12];
+        char ar_uid[6];
+        char ar_gid[6];
+        char ar_mode[8];
+        char ar_size[10];
+        char ar_fmag[2];
+};
+
+static uint64_t __ar_decimal(const char *p, int len) {
+        uint64_t ret = 0;
+
+        for (int i = 0; i < len && p[i] >= '0' && p[i] <= '9'; i++) {
+                ret = ret * 10 + (p[i] - '0');
+        }
+
+        return ret;
+}
+
+static uint64_t __ar_be(const uint8_t *p, int width) {
+        uint64_t ret = 0;
+
+        for (int i = 0; i < width; i++) {
+                ret = (ret << 8) | p[i];
+        }
+
+        return ret;
+}
+
+static uint32_t __ar_le32(const uint8_t *p) {
+        return (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 |
+               (uint32_t)p[3] << 24;
+}
+
+/*
+ * ar_symbol only knows the member header offset, members are in file
+ * order so a binary search is enough
+ */
+static int64_t __ar_member_at(struct ar_archive *ar, uint64_t hdr_offset) {
+        uint64_t lo = 0;
+        uint64_t hi = ar->nmembers;
+
+        while (lo < hi) {
+                uint64_t mid = lo + (hi - lo) / 2;
+
+                if (ar->members[mid].hdr_offset == hdr_offset)
+                        return mid;
+                if (ar->members[mid].hdr_offset < hdr_offset)
+                        lo = mid + 1;
+                else
+                        hi = mid;
+        }
+
+        return -1;
+}
+
+static void __ar_add_symbol(struct ar_archive *ar, uint64_t *cap,
+                            const char *name, uint64_t hdr_offset) {
+        int64_t member = __ar_member_at(ar, hdr_offset);
+        if (member < 0)
+                return;
+
+        if (ar->nsymbols == *cap) {
+                *cap = *cap ? *cap * 2 : 64;
+                ar->symbols = (struct ar_symbol *)realloc(
+                    ar->symbols, *cap * sizeof(struct ar_symbol));
+        }
+
+        ar->symbols[ar->nsymbols].name = name;
+        ar->symbols[ar->nsymbols].member = member;
+        ar->nsymbols = ar->nsymbols + 1;
+}
+
+/*
+ * GNU / SysV index: count, count offsets (big endian, 4 or 8 bytes
+ * wide for "/SYM64/"), then count NUL terminated names
+ */
+static void __ar_parse_gnu_index(struct ar_archive *ar, const uint8_t *data,
+                                 uint64_t size, int width) {
+        uint64_t cap = 0;
+
+        if (size < (uint64_t)width)
+                return;
+
+        uint64_t count = __ar_be(data, width);
+        if (count > (size - width) / width)
+                return;
+
+        const uint8_t *offsets = data + width;
+        uint64_t names_off = width + count * width;
+        uint64_t names_size = size - names_off;
+
+        ar->symbol_names = (char *)malloc(names_size + 1);
+        memcpy(ar->symbol_names, data + names_off, names_size);
+        ar->symbol_names[names_size] = 0;
+
+        uint64_t pos = 0;
+        for (uint64_t i = 0; i < count && pos < names_size; i++) {
+                __ar_add_symbol(ar, &cap, &ar->symbol_names[pos],
+                                __ar_be(offsets + i * width, width));
+                pos = pos + strlen(&ar->symbol_names[pos]) + 1;
+        }
+}
+
+/*
+ * BSD __.SYMDEF: ranlib array size, { strx, offset } pairs (little
+ * endian), string table size, string table
+ */
+static void __ar_parse_bsd_index(struct ar_archive *ar, const uint8_t *data,
+                                 uint64_t size) {
+        uint64_t cap = 0;
+
+        /* both size words, ranlib_size is checked against the rest */
+        if (size < 8)
+                return;
+
+        uint64_t ranlib_size = __ar_le32(data);
+        if (ranlib_size > size - 8)
+                return;
+
+        const uint8_t *ranlib = data + 4;
+        uint64_t strtab_size = __ar_le32(data + 4 + ranlib_size);
+        const uint8_t *strtab = data + 8 + ranlib_size;
+
+        if (strtab_size > size - 8 - ranlib_size)
+                return;
+
+        ar->symbol_names = (char *)malloc(strtab_size + 1);
+        memcpy(ar->symbol_names, strtab, strtab_size);
+        ar->symbol_names[strtab_size] = 0;
+
+        for (uint64_t i = 0; i + 8 <= ranlib_size; i += 8) {
+                uint32_t strx = __ar_le32(ranlib + i);
+                if (strx >= strtab_size)
+                        continue;
+
+                __ar_add_symbol(ar, &cap, &ar->symbol_names[strx],
+                                __ar_le32(ranlib + i + 4));
+        }
+}
+
+int ar_is_archive(const uint8_t *data, uint64_t size) {
+        return size >= AR_MAGIC_LEN &&
+               memcmp(data, AR_MAGIC, AR_MAGIC_LEN) == 0;
+}
+
+int ar_parse(const uint8_t *data, uint64_t size, struct ar_archive *ar) {
+        const uint8_t *longnames = NULL;
+        uint64_t longnames_size = 0;
+        const uint8_t *index = NULL;
+        uint64_t index_size = 0;
+        int index_kind = 0; /* 4: GNU, 8: GNU 64 bit, 1: BSD */
+        uint64_t cap = 0;
+        uint64_t off = AR_MAGIC_LEN;
+
+        memset(ar, 0, sizeof(struct ar_archive));
+
+        if (size >= AR_MAGIC_LEN &&
+            memcmp(data, AR_THIN_MAGIC, AR_MAGIC_LEN) == 0) {
+                fprintf(stderr, "thin archives are not supported\n");
+                return -1;
+        }
+
+        if (!ar_is_archive(data, size)) {
+                return -1;
+        }
+
+        while (off + sizeof(struct ar_hdr) <= size) {
+                const struct ar_hdr *hdr = (const struct ar_hdr *)(data + off);
+                uint64_t data_off = off + sizeof(struct ar_hdr);
+                uint64_t member_size = __ar_decimal(hdr->ar_size, 10);
+                char *name = NULL;
+
+                if (hdr->ar_fmag[0] != '`' || hdr->ar_fmag[1] != '\n') {
+                        fprintf(stderr, "corrupted ar member header at %lu\n",
+                                (unsigned long)off);
+                        ar_free(ar);
+                        return -1;
+                }
+
+                if (member_size > size - data_off) {
+                        fprintf(stderr, "truncated ar member at %lu\n",
+                                (unsigned long)off);
+                        member_size = size - data_off;
+                }
+
+                if (memcmp(hdr->ar_name, "/ ", 2) == 0) {
+                        index = data + data_off;
+                        index_size = member_size;
+                        index_kind = 4;
+                        goto next;
+                }
+
+                if (memcmp(hdr->ar_name, "/SYM64/ ", 8) == 0) {
+                        index = data + data_off;
+                        index_size = member_size;
+                        index_kind = 8;
+                        goto next;
+                }
+
+                if (memcmp(hdr->ar_name, "// ", 3) == 0) {
+                        longnames = data + data_off;
+                        longnames_size = member_size;
+                        goto next;
+                }
+
+                if (hdr->ar_name[0] == '/' && hdr->ar_name[1] >= '0' &&
+                    hdr->ar_name[1] <= '9') {
+                        /* GNU long name, "/off" into the "//" member */
+                        uint64_t name_off = __ar_decimal(hdr->ar_name + 1, 15);
+                        uint64_t len = 0;
+
+                        if (longnames == NULL || name_off >= longnames_size) {
+                                fprintf(stderr,
+                                        "ar member at %lu names a missing "
+                                        "long name\n",
+                                        (unsigned long)off);
+                                ar_free(ar);
+                                return -1;
+                        }
+
+                        while (name_off + len < longnames_size &&
+                               longnames[name_off + len] != '\n')
+                                len++;
+                        if (len > 0 && longnames[name_off + len - 1] == '/')
+                                len--;
+
+                        name = strndup((const char *)longnames + name_off, len);
+                } else if (memcmp(hdr->ar_name, "#1/", 3) == 0) {
+                        /* BSD long name, stored in front of the data */
+                        uint64_t len = __ar_decimal(hdr->ar_name + 3, 13);
+                        if (len > member_size)
+                                len = member_size;
+
+                        name = strndup((const char *)data + data_off, len);
+                        data_off = data_off + len;
+                        member_size = member_size - len;
+                } else {
+                        int len = 16;
+
+                        while (len > 0 && hdr->ar_name[len - 1] == ' ')
+                                len--;
+                        if (len > 0 && hdr->ar_name[len - 1] == '/')
+                                len--;
+
+                        name = strndup(hdr->ar_name, len);
+                }
+
+                if (strncmp(name, "__.SYMDEF", 9) == 0) {
+                        index = data + data_off;
+                        index_size = member_size;
+                        index_kind = 1;
+                        free(name);
+                        goto next;
+                }
+
+                if (ar->nmembers == cap) {
+                        cap = cap ? cap * 2 : 64;
+                        ar->members = (struct ar_member *)realloc(
+                            ar->members, cap * sizeof(struct ar_member));
+                }
+
+                ar->members[ar->nmembers].name = name;
+                ar->members[ar->nmembers].hdr_offset = off;
+                ar->members[ar->nmembers].offset = data_off;
+                ar->members[ar->nmembers].size = member_size;
+                ar->nmembers = ar->nmembers + 1;
+
+        next:
+                off = data_off + member_size;
+                off = off + (off & 1);
+        }
+
+        if (index_kind == 1) {
+                __ar_parse_bsd_index(ar, index, index_size);
+        } else if (index_kind) {
+                __ar_parse_gnu_index(ar, index, index_size, index_kind);
+        }
+
+        return 0;
+}
+
+void ar_free(struct ar_archive *ar) {
+        for (uint64_t i = 0; i < ar->nmembers; i++) {
+                free(ar->members[i].name);
+        }
+
+        free(ar->members);
+        free(ar->symbols);
+        free(ar->symbol_names);
+        memset(ar, 0, sizeof(struct ar_archive));
+}
@@ -0,0 +1,45 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+/*
+ * Copyright (C) Fadhil Riyanto <me@fadev.org>
+ * static library (ar archive) reader, members are located in place,
+ * nothing is extracted
+ */
+
+#ifndef AR_ARCHIVE_H
+#define AR_ARCHIVE_H
+
+#include <stdint.h>
+
+#define AR_MAGIC "!<arch>\n"
+#define AR_THIN_MAGIC "!<thin>\n"
+#define AR_MAGIC_LEN 8
+
+struct ar_member {
+        char *name;
+        uint64_t hdr_offset; /* offset of the 60 byte member header */
+        uint64_t offset;     /* offset of member data */
+        uint64_t size;
+};
+
+/* one entry of the archive symbol index ("/", "/SYM64/", __.SYMDEF) */
+struct ar_symbol {
+        const char *name;
+        uint64_t member; /* index into ar_archive.members */
+};
+
+struct ar_archive {
+        struct ar_member *members;
+        uint64_t nmembers;
+
+        struct ar_symbol *symbols;
+        uint64_t nsymbols;
+
+        /* copy of the index string table, ar_symbol.name points here */
+        char *symbol_names;
+};
+
+int ar_is_archive(const uint8_t *data, uint64_t size);
+int ar_parse(const uint8_t *data, uint64_t size, struct ar_archive *ar);
+void ar_free(struct ar_archive *ar);
+
+#endif /* AR_ARCHIVE_H */
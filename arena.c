@@ -0,0 +1,98 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+/*
+ * Copyright (C) Fadhil Riyanto <me@fadev.org>
+ */
+
+#include "arena.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define ARENA_HDR_SIZE                                                         \
+        ((sizeof(struct arena_chunk) + ARENA_ALIGN - 1) &                      \
+         ~(size_t)(ARENA_ALIGN - 1))
+#define ARENA_DATA(c) ((uint8_t *)(c) + ARENA_HDR_SIZE)
+
+void arena_init(struct arena *a) {
+        memset(a, 0, sizeof(struct arena));
+}
+
+static void __arena_free_list(struct arena_chunk *c) {
+        while (c) {
+                struct arena_chunk *next = c->next;
+
+                free(c);
+                c = next;
+        }
+}
+
+void arena_destroy(struct arena *a) {
+        __arena_free_list(a->chunk);
+        __arena_free_list(a->spare);
+        memset(a, 0, sizeof(struct arena));
+}
+
+/* a spare chunk with room for size, or a new one */
+static struct arena_chunk *__arena_chunk(struct arena *a, size_t size) {
+        struct arena_chunk **link = &a->spare;
+
+        for (; *link; link = &(*link)->next) {
+                struct arena_chunk *c = *link;
+
+                if (c->size >= size) {
+                        *link = c->next;
+                        return c;
+                }
+        }
+
+        size_t want = size > ARENA_CHUNK_SIZE ? size : ARENA_CHUNK_SIZE;
+        struct arena_chunk *c =
+            (struct arena_chunk *)malloc(ARENA_HDR_SIZE + want);
+        if (c == NULL)
+                return NULL;
+
+        c->size = want;
+        a->nmallocs = a->nmallocs + 1;
+        return c;
+}
+
+void *arena_alloc(struct arena *a, size_t size) {
+        struct arena_chunk *c = a->chunk;
+
+        size = (size + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1);
+
+        if (c == NULL || c->size - c->used < size) {
+                c = __arena_chunk(a, size);
+                if (c == NULL)
+                        return NULL;
+
+                c->used = 0;
+                c->next = a->chunk;
+                a->chunk = c;
+        }
+
+        void *p = ARENA_DATA(c) + c->used;
+
+        c->used = c->used + size;
+        a->nallocs = a->nallocs + 1;
+        return p;
+}
+
+struct arena_mark arena_mark(struct arena *a) {
+        struct arena_mark mark = { a->chunk, a->chunk ? a->chunk->used : 0 };
+
+        return mark;
+}
+
+/* chunks newer than the mark go to the spare list */
+void arena_release(struct arena *a, struct arena_mark mark) {
+        while (a->chunk && a->chunk != mark.chunk) {
+                struct arena_chunk *c = a->chunk;
+
+                a->chunk = c->next;
+                c->next = a->spare;
+                a->spare = c;
+        }
+
+        if (a->chunk)
+                a->chunk->used = mark.used;
+}
@@ -0,0 +1,49 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+/*
+ * Copyright (C) Fadhil Riyanto <me@fadev.org>
+ * bump allocator, allocations are carved out of big chunks and are
+ * never freed one by one, arena_release() drops everything allocated
+ * since a mark in one go
+ *
+ * released chunks are kept for reuse, an arena that handles one file
+ * after another stops calling malloc once it has seen the biggest one
+ */
+
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define ARENA_CHUNK_SIZE (64 * 1024)
+#define ARENA_ALIGN 16
+
+struct arena_chunk {
+        struct arena_chunk *next;
+        size_t size; /* usable bytes after the header */
+        size_t used;
+};
+
+struct arena {
+        struct arena_chunk *chunk; /* current, chunks before it are full */
+        struct arena_chunk *spare; /* released, ready for reuse */
+
+        uint64_t nallocs;  /* arena_alloc() calls served */
+        uint64_t nmallocs; /* chunks taken from malloc */
+};
+
+struct arena_mark {
+        struct arena_chunk *chunk;
+        size_t used;
+};
+
+void arena_init(struct arena *a);
+void arena_destroy(struct arena *a);
+
+/* ARENA_ALIGN aligned, NULL when malloc fails */
+void *arena_alloc(struct arena *a, size_t size);
+
+struct arena_mark arena_mark(struct arena *a);
+void arena_release(struct arena *a, struct arena_mark mark);
+
+#endif /* ARENA_H */
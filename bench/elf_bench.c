@@ -0,0 +1,352 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+/*
+ * Copyright (C) Fadhil Riyanto <me@fadev.org>
+ * throughput of ./elf64 per mode and input, one CSV row each:
+ *
+ *   ./elf_bench -n 5 -m hexdump,sh,ph,syms /tmp/a.elf /tmp/b.elf
+ *
+ * the timed runs are plain, best wall time wins, MB/s is the input size
+ * over it. one more run under ptrace counts the syscalls, it is never
+ * timed. output of ./elf64 goes to /dev/null
+ *
+ * -c drops the input from the page cache before every timed run
+ * (POSIX_FADV_DONTNEED, works without root as long as the pages are
+ * clean), so readahead hints and --populate show up in the numbers
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ptrace.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#define BENCH_MAX_TRACEES 256
+
+#define BENCH_MAX_FLAGS 3
+
+struct bench_mode {
+        const char *name;
+        const char *flags[BENCH_MAX_FLAGS]; /* NULL terminated */
+};
+
+static const struct bench_mode bench_modes[] = {
+        {"hexdump", {"--hexdump"}},
+        {"sh", {"--sh"}},
+        {"ph", {"--ph"}},
+        {"syms", {"--syms"}},
+        {"header", {"--header"}},
+        {"build-id", {"--build-id"}},
+        {"section", {"--section", ".text"}},
+        {"hexdump-populate", {"--hexdump", "--populate"}},
+        {"syms-populate", {"--syms", "--populate"}},
+        {"syms-hugepage", {"--syms", "--hugepage"}},
+};
+
+struct bench_result {
+        double wall;     /* best of the runs, seconds */
+        double cpu;      /* user + sys of that run */
+        uint64_t calls;  /* every syscall of the traced run */
+        uint64_t reads;  /* read, pread64, readv */
+        uint64_t writes; /* write, writev */
+        uint64_t seeks;  /* lseek */
+        uint64_t mmaps;  /* mmap */
+        uint64_t out;    /* bytes written to stdout */
+};
+
+static uint64_t __now_ns(void) {
+        struct timespec ts;
+
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/* stdout and stderr to /dev/null, then exec */
+static void __child_exec(const char *exe, char **args) {
+        int fd = open("/dev/null", O_WRONLY);
+
+        if (fd >= 0) {
+                dup2(fd, 1);
+                dup2(fd, 2);
+                close(fd);
+        }
+
+        execv(exe, args);
+        _exit(127);
+}
+
+/* clean pages of path leave the page cache */
+static void __drop_cache(const char *path) {
+        int fd = open(path, O_RDONLY);
+
+        if (fd < 0)
+                return;
+
+        fdatasync(fd);
+        posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+        close(fd);
+}
+
+static int __run_timed(const char *exe, char **args, const char *path,
+                       int runs, int cold, struct bench_result *r) {
+        r->wall = -1;
+
+        for (int i = 0; i < runs; i++) {
+                struct rusage ru;
+                int status;
+
+                if (cold)
+                        __drop_cache(path);
+
+                uint64_t start = __now_ns();
+                pid_t pid = fork();
+
+                if (pid < 0) {
+                        perror("fork()");
+                        return -1;
+                }
+                if (pid == 0)
+                        __child_exec(exe, args);
+
+                if (wait4(pid, &status, 0, &ru) < 0) {
+                        perror("wait4()");
+                        return -1;
+                }
+
+                double wall = (__now_ns() - start) / 1e9;
+                if (!WIFEXITED(status) || WEXITSTATUS(status) == 127) {
+                        fprintf(stderr, "%s did not run\n", exe);
+                        return -1;
+                }
+
+                if (r->wall < 0 || wall < r->wall) {
+                        r->wall = wall;
+                        r->cpu = ru.ru_utime.tv_sec + ru.ru_stime.tv_sec +
+                                 (ru.ru_utime.tv_usec + ru.ru_stime.tv_usec) /
+                                     1e6;
+                }
+        }
+
+        return 0;
+}
+
+static void __count_syscall(struct bench_result *r,
+                            struct __ptrace_syscall_info *entry,
+                            int64_t ret) {
+        r->calls = r->calls + 1;
+
+        switch (entry->entry.nr) {
+        case SYS_read:
+        case SYS_pread64:
+        case SYS_readv:
+                r->reads = r->reads + 1;
+                break;
+        case SYS_write:
+        case SYS_writev:
+                r->writes = r->writes + 1;
+                if (entry->entry.args[0] == 1 && ret > 0)
+                        r->out = r->out + ret;
+                break;
+        case SYS_lseek:
+                r->seeks = r->seeks + 1;
+                break;
+        case SYS_mmap:
+                r->mmaps = r->mmaps + 1;
+                break;
+        default:
+                break;
+        }
+}
+
+/*
+ * every thread of the child is followed, the entry stop of each
+ * syscall is kept per thread until its exit stop gives the result
+ */
+static int __run_traced(const char *exe, char **args,
+                        struct bench_result *r) {
+        static struct __ptrace_syscall_info entries[BENCH_MAX_TRACEES];
+        static pid_t tids[BENCH_MAX_TRACEES];
+        struct __ptrace_syscall_info info;
+        int ntids = 0;
+        int status;
+
+        pid_t pid = fork();
+        if (pid < 0) {
+                perror("fork()");
+                return -1;
+        }
+        if (pid == 0) {
+                ptrace(PTRACE_TRACEME, 0, NULL, NULL);
+                raise(SIGSTOP);
+                __child_exec(exe, args);
+        }
+
+        if (waitpid(pid, &status, 0) < 0 || !WIFSTOPPED(status)) {
+                fprintf(stderr, "child did not stop\n");
+                return -1;
+        }
+
+        if (ptrace(PTRACE_SETOPTIONS, pid, NULL,
+                   PTRACE_O_TRACESYSGOOD | PTRACE_O_TRACECLONE |
+                       PTRACE_O_EXITKILL) < 0) {
+                perror("ptrace()");
+                kill(pid, SIGKILL);
+                return -1;
+        }
+        ptrace(PTRACE_SYSCALL, pid, NULL, NULL);
+
+        for (;;) {
+                int sig = 0;
+                pid_t tid = waitpid(-1, &status, __WALL);
+
+                if (tid < 0)
+                        break;
+                if (WIFEXITED(status) || WIFSIGNALED(status))
+                        continue;
+
+                if (WSTOPSIG(status) == (SIGTRAP | 0x80)) {
+                        int slot = 0;
+
+                        while (slot < ntids && tids[slot] != tid)
+                                slot++;
+                        if (slot == ntids && ntids < BENCH_MAX_TRACEES)
+                                tids[ntids++] = tid;
+
+                        ptrace(PTRACE_GET_SYSCALL_INFO, tid,
+                               (void *)sizeof(info), &info);
+                        if (info.op == PTRACE_SYSCALL_INFO_ENTRY &&
+                            slot < BENCH_MAX_TRACEES)
+                                entries[slot] = info;
+                        else if (info.op == PTRACE_SYSCALL_INFO_EXIT &&
+                                 slot < BENCH_MAX_TRACEES)
+                                __count_syscall(r, &entries[slot],
+                                                info.exit.rval);
+                } else if (WSTOPSIG(status) != SIGTRAP &&
+                           WSTOPSIG(status) != SIGSTOP) {
+                        sig = WSTOPSIG(status);
+                }
+
+                ptrace(PTRACE_SYSCALL, tid, NULL, (void *)(long)sig);
+        }
+
+        return 0;
+}
+
+static const struct bench_mode *__find_mode(const char *name) {
+        for (size_t i = 0; i < sizeof(bench_modes) / sizeof(bench_modes[0]);
+             i++) {
+                if (strcmp(bench_modes[i].name, name) == 0)
+                        return &bench_modes[i];
+        }
+
+        return NULL;
+}
+
+static void __usage(const char *prog) {
+        fprintf(stderr,
+                "usage: %s [-c] [-n runs] [-e elf64] [-m mode,...] FILE...\n"
+                "modes: hexdump, sh, ph, syms, header, build-id, section,\n"
+                "       hexdump-populate, syms-populate, syms-hugepage\n"
+                "-c: cold page cache before every timed run\n",
+                prog);
+}
+
+int main(int argc, char **argv) {
+        const char *exe = "./elf64";
+        char *modes = strdup("hexdump,sh,ph,syms");
+        int runs = 3;
+        int cold = 0;
+        int opt;
+
+        while ((opt = getopt(argc, argv, "cn:e:m:")) != -1) {
+                switch (opt) {
+                case 'c':
+                        cold = 1;
+                        break;
+                case 'n':
+                        runs = atoi(optarg);
+                        break;
+                case 'e':
+                        exe = optarg;
+                        break;
+                case 'm':
+                        free(modes);
+                        modes = strdup(optarg);
+                        break;
+                default:
+                        __usage(argv[0]);
+                        return 1;
+                }
+        }
+
+        if (optind >= argc || runs <= 0) {
+                __usage(argv[0]);
+                return 1;
+        }
+
+        printf("file,bytes,mode,cache,runs,wall_s,cpu_s,mb_s,syscalls,reads,"
+               "writes,lseeks,mmaps,out_bytes\n");
+
+        for (int f = optind; f < argc; f++) {
+                struct stat st;
+
+                if (stat(argv[f], &st) < 0) {
+                        fprintf(stderr, "%s: %s\n", argv[f], strerror(errno));
+                        continue;
+                }
+
+                char *save = NULL;
+                char *list = strdup(modes);
+
+                for (char *name = strtok_r(list, ",", &save); name;
+                     name = strtok_r(NULL, ",", &save)) {
+                        const struct bench_mode *m = __find_mode(name);
+                        struct bench_result r;
+
+                        if (m == NULL) {
+                                fprintf(stderr, "unknown mode %s\n", name);
+                                continue;
+                        }
+
+                        char *args[BENCH_MAX_FLAGS + 3];
+                        int nargs = 0;
+
+                        args[nargs++] = (char *)exe;
+                        for (int i = 0; i < BENCH_MAX_FLAGS && m->flags[i];
+                             i++) {
+                                args[nargs++] = (char *)m->flags[i];
+                        }
+                        args[nargs++] = argv[f];
+                        args[nargs] = NULL;
+
+                        memset(&r, 0, sizeof(r));
+                        if (__run_timed(exe, args, argv[f], runs, cold, &r) <
+                                0 ||
+                            __run_traced(exe, args, &r) < 0)
+                                return 1;
+
+                        printf("%s,%lu,%s,%s,%d,%.6f,%.6f,%.2f,%lu,%lu,%lu,"
+                               "%lu,%lu,%lu\n",
+                               argv[f], (unsigned long)st.st_size, m->name,
+                               cold ? "cold" : "warm", runs, r.wall, r.cpu,
+                               st.st_size / 1e6 / (r.wall > 0 ? r.wall : 1e-9),
+                               (unsigned long)r.calls, (unsigned long)r.reads,
+                               (unsigned long)r.writes, (unsigned long)r.seeks,
+                               (unsigned long)r.mmaps, (unsigned long)r.out);
+                        fflush(stdout);
+                }
+
+                free(list);
+        }
+
+        free(modes);
+        return 0;
+}
@@ -0,0 +1,340 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+/*
+ * Copyright (C) Fadhil Riyanto <me@fadev.org>
+ * synthetic ELF64 relocatable-looking files for scaling benchmarks,
+ * section, symbol and segment counts are free, the file can be grown
+ * sparse to any size after the real content
+ *
+ *   ./gen_elf -s 1000000 -y 1000000 -p 64 -S 64G /tmp/big.elf
+ *
+ * layout: ehdr, phdrs, 16 bytes of data per section, .symtab,
+ * .strtab, .shstrtab, section headers, then the sparse tail
+ */
+
+#include <elf.h>
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define GEN_DATA_SIZE 16
+#define GEN_MAX_SECTIONS (1U << 20)
+
+struct gen_config {
+        uint32_t nsections;
+        uint64_t nsymbols;
+        uint32_t nsegments;
+        uint64_t size;
+        const char *path;
+};
+
+struct gen_strtab {
+        char *buf;
+        uint64_t len;
+        uint64_t cap;
+};
+
+/* offset of the copied string */
+static uint64_t __strtab_add(struct gen_strtab *s, const char *str) {
+        uint64_t len = strlen(str) + 1;
+        uint64_t off = s->len;
+
+        if (s->len + len > s->cap) {
+                while (s->len + len > s->cap)
+                        s->cap = s->cap ? s->cap * 2 : 4096;
+                s->buf = (char *)realloc(s->buf, s->cap);
+                if (s->buf == NULL) {
+                        perror("realloc()");
+                        exit(1);
+                }
+        }
+
+        memcpy(s->buf + s->len, str, len);
+        s->len = s->len + len;
+        return off;
+}
+
+/* 4k, 16M, 64G, plain bytes without a suffix */
+static int __parse_size(const char *arg, uint64_t *out) {
+        char *end;
+        uint64_t v = strtoull(arg, &end, 0);
+
+        switch (*end) {
+        case 'k':
+        case 'K':
+                v = v << 10;
+                end++;
+                break;
+        case 'm':
+        case 'M':
+                v = v << 20;
+                end++;
+                break;
+        case 'g':
+        case 'G':
+                v = v << 30;
+                end++;
+                break;
+        default:
+                break;
+        }
+
+        if (end == arg || *end != '\0')
+                return -1;
+
+        *out = v;
+        return 0;
+}
+
+static void __usage(const char *prog) {
+        fprintf(stderr,
+                "usage: %s [-s sections] [-y symbols] [-p segments] "
+                "[-S size] OUT\n",
+                prog);
+}
+
+static int __parse_args(int argc, char **argv, struct gen_config *c) {
+        uint64_t v;
+        int opt;
+
+        c->nsections = 16;
+        c->nsymbols = 16;
+        c->nsegments = 1;
+        c->size = 0;
+
+        while ((opt = getopt(argc, argv, "s:y:p:S:")) != -1) {
+                if (opt == '?' || __parse_size(optarg, &v) < 0) {
+                        __usage(argv[0]);
+                        return -1;
+                }
+
+                switch (opt) {
+                case 's':
+                        c->nsections = v;
+                        break;
+                case 'y':
+                        c->nsymbols = v;
+                        break;
+                case 'p':
+                        c->nsegments = v;
+                        break;
+                case 'S':
+                        c->size = v;
+                        break;
+                }
+        }
+
+        if (optind + 1 != argc) {
+                __usage(argv[0]);
+                return -1;
+        }
+
+        if (c->nsections == 0 || c->nsections > GEN_MAX_SECTIONS ||
+            c->nsegments >= PN_XNUM) {
+                fprintf(stderr, "sections must be 1..%u, segments below %u\n",
+                        GEN_MAX_SECTIONS, PN_XNUM);
+                return -1;
+        }
+
+        c->path = argv[optind];
+        return 0;
+}
+
+/*
+ * the phdrs split the section data in nsegments equal PT_LOAD slices,
+ * vaddr == offset so every byte maps back to itself
+ */
+static void __write_phdrs(FILE *f, struct gen_config *c, uint64_t data_off,
+                          uint64_t data_size) {
+        uint64_t slice;
+
+        if (c->nsegments == 0)
+                return;
+
+        slice = data_size / c->nsegments;
+        for (uint32_t i = 0; i < c->nsegments; i++) {
+                Elf64_Phdr phdr;
+                uint64_t off = data_off + i * slice;
+
+                memset(&phdr, 0, sizeof(phdr));
+                phdr.p_type = PT_LOAD;
+                phdr.p_flags = i == 0 ? PF_R | PF_X : PF_R | PF_W;
+                phdr.p_offset = off;
+                phdr.p_vaddr = off;
+                phdr.p_paddr = off;
+                phdr.p_filesz = i + 1 == c->nsegments ? data_size - i * slice
+                                                      : slice;
+                phdr.p_memsz = phdr.p_filesz;
+                phdr.p_align = 16;
+                fwrite(&phdr, sizeof(phdr), 1, f);
+        }
+}
+
+static int __generate(struct gen_config *c) {
+        struct gen_strtab strtab = {0};
+        struct gen_strtab shstrtab = {0};
+        uint8_t data[GEN_DATA_SIZE];
+        char name[32];
+        Elf64_Ehdr ehdr;
+        Elf64_Shdr shdr;
+        Elf64_Sym sym;
+
+        /* null, user sections, .symtab, .strtab, .shstrtab */
+        uint64_t shnum = (uint64_t)c->nsections + 4;
+        uint64_t sec_symtab = c->nsections + 1;
+        uint64_t sec_strtab = c->nsections + 2;
+        uint64_t sec_shstrtab = c->nsections + 3;
+        uint32_t *sec_names =
+            (uint32_t *)malloc((shnum + 1) * sizeof(uint32_t));
+
+        FILE *f = fopen(c->path, "wb");
+        if (f == NULL || sec_names == NULL) {
+                fprintf(stderr, "%s: %s\n", c->path, strerror(errno));
+                return -1;
+        }
+
+        sec_names[0] = __strtab_add(&shstrtab, "");
+        for (uint32_t i = 1; i <= c->nsections; i++) {
+                snprintf(name, sizeof(name), ".s%u", i);
+                sec_names[i] = __strtab_add(&shstrtab, name);
+        }
+        sec_names[sec_symtab] = __strtab_add(&shstrtab, ".symtab");
+        sec_names[sec_strtab] = __strtab_add(&shstrtab, ".strtab");
+        sec_names[sec_shstrtab] = __strtab_add(&shstrtab, ".shstrtab");
+
+        uint64_t data_off = sizeof(Elf64_Ehdr) +
+                            (uint64_t)c->nsegments * sizeof(Elf64_Phdr);
+        uint64_t data_size = (uint64_t)c->nsections * GEN_DATA_SIZE;
+        uint64_t symtab_off = data_off + data_size;
+        uint64_t symtab_size = (c->nsymbols + 1) * sizeof(Elf64_Sym);
+
+        memset(&ehdr, 0, sizeof(ehdr));
+        memcpy(ehdr.e_ident, ELFMAG, SELFMAG);
+        ehdr.e_ident[EI_CLASS] = ELFCLASS64;
+        ehdr.e_ident[EI_DATA] = ELFDATA2LSB;
+        ehdr.e_ident[EI_VERSION] = EV_CURRENT;
+        ehdr.e_type = ET_REL;
+        ehdr.e_machine = EM_X86_64;
+        ehdr.e_version = EV_CURRENT;
+        ehdr.e_phoff = c->nsegments ? sizeof(Elf64_Ehdr) : 0;
+        ehdr.e_ehsize = sizeof(Elf64_Ehdr);
+        ehdr.e_phentsize = sizeof(Elf64_Phdr);
+        ehdr.e_phnum = c->nsegments;
+        ehdr.e_shentsize = sizeof(Elf64_Shdr);
+
+        /* past SHN_LORESERVE the real counts go to section 0 */
+        ehdr.e_shnum = shnum < SHN_LORESERVE ? shnum : 0;
+        ehdr.e_shstrndx =
+            sec_shstrtab < SHN_LORESERVE ? sec_shstrtab : SHN_XINDEX;
+
+        fwrite(&ehdr, sizeof(ehdr), 1, f);
+        __write_phdrs(f, c, data_off, data_size);
+
+        for (uint32_t i = 0; i < c->nsections; i++) {
+                for (int j = 0; j < GEN_DATA_SIZE; j++) {
+                        data[j] = (uint8_t)(i * 31 + j);
+                }
+                fwrite(data, 1, GEN_DATA_SIZE, f);
+        }
+
+        /* symbols point at the first 0xfeff sections, no SYMTAB_SHNDX */
+        uint64_t sym_sections = c->nsections < SHN_LORESERVE - 1
+                                    ? c->nsections
+                                    : SHN_LORESERVE - 1;
+
+        memset(&sym, 0, sizeof(sym));
+        __strtab_add(&strtab, "");
+        fwrite(&sym, sizeof(sym), 1, f);
+        for (uint64_t i = 0; i < c->nsymbols; i++) {
+                uint64_t sec = i % sym_sections;
+
+                snprintf(name, sizeof(name), "sym_%lu", (unsigned long)i);
+                sym.st_name = __strtab_add(&strtab, name);
+                sym.st_info = ELF64_ST_INFO(i % 4 == 0 ? STB_LOCAL
+                                                       : STB_GLOBAL,
+                                            i % 2 ? STT_FUNC : STT_OBJECT);
+                sym.st_shndx = sec + 1;
+                sym.st_value = data_off + sec * GEN_DATA_SIZE;
+                sym.st_size = GEN_DATA_SIZE;
+                fwrite(&sym, sizeof(sym), 1, f);
+        }
+
+        uint64_t strtab_off = symtab_off + symtab_size;
+        uint64_t shstrtab_off = strtab_off + strtab.len;
+        uint64_t shoff = (shstrtab_off + shstrtab.len + 7) & ~7ULL;
+
+        fwrite(strtab.buf, 1, strtab.len, f);
+        fwrite(shstrtab.buf, 1, shstrtab.len, f);
+        for (uint64_t pad = shstrtab_off + shstrtab.len; pad < shoff; pad++) {
+                fputc(0, f);
+        }
+
+        memset(&shdr, 0, sizeof(shdr));
+        if (ehdr.e_shnum == 0)
+                shdr.sh_size = shnum;
+        if (ehdr.e_shstrndx == SHN_XINDEX)
+                shdr.sh_link = sec_shstrtab;
+        fwrite(&shdr, sizeof(shdr), 1, f);
+
+        for (uint64_t i = 1; i < shnum; i++) {
+                memset(&shdr, 0, sizeof(shdr));
+                shdr.sh_name = sec_names[i];
+
+                if (i == sec_symtab) {
+                        shdr.sh_type = SHT_SYMTAB;
+                        shdr.sh_offset = symtab_off;
+                        shdr.sh_size = symtab_size;
+                        shdr.sh_link = sec_strtab;
+                        shdr.sh_info = 1;
+                        shdr.sh_addralign = 8;
+                        shdr.sh_entsize = sizeof(Elf64_Sym);
+                } else if (i == sec_strtab || i == sec_shstrtab) {
+                        shdr.sh_type = SHT_STRTAB;
+                        shdr.sh_offset =
+                            i == sec_strtab ? strtab_off : shstrtab_off;
+                        shdr.sh_size =
+                            i == sec_strtab ? strtab.len : shstrtab.len;
+                        shdr.sh_addralign = 1;
+                } else {
+                        shdr.sh_type = SHT_PROGBITS;
+                        shdr.sh_flags = SHF_ALLOC;
+                        shdr.sh_offset = data_off + (i - 1) * GEN_DATA_SIZE;
+                        shdr.sh_addr = shdr.sh_offset;
+                        shdr.sh_size = GEN_DATA_SIZE;
+                        shdr.sh_addralign = 16;
+                }
+
+                fwrite(&shdr, sizeof(shdr), 1, f);
+        }
+
+        /* e_shoff is only known now */
+        ehdr.e_shoff = shoff;
+        if (fseek(f, 0, SEEK_SET) == 0)
+                fwrite(&ehdr, sizeof(ehdr), 1, f);
+
+        uint64_t end = shoff + shnum * sizeof(Elf64_Shdr);
+
+        if (fflush(f) != 0 ||
+            (c->size > end && ftruncate(fileno(f), c->size) < 0)) {
+                fprintf(stderr, "%s: %s\n", c->path, strerror(errno));
+                fclose(f);
+                return -1;
+        }
+
+        fclose(f);
+        free(sec_names);
+        free(strtab.buf);
+        free(shstrtab.buf);
+        return 0;
+}
+
+int main(int argc, char **argv) {
+        struct gen_config c;
+
+        if (__parse_args(argc, argv, &c) < 0)
+                return 1;
+
+        return __generate(&c) < 0 ? 1 : 0;
+}
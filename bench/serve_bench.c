@@ -0,0 +1,199 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+/*
+ * Copyright (C) Fadhil Riyanto <me@fadev.org>
+ * per-request latency of a --serve daemon over one connection against
+ * a fresh ./elf64 process for every request
+ *
+ *   ./elf64 --serve /tmp/elf64.sock &
+ *   ./serve_bench /tmp/elf64.sock 1000 -- --addr2sym 0x1129 /bin/ls
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <spawn.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+extern char **environ;
+
+static uint64_t __now_ns(void) {
+        struct timespec ts;
+
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static int __cmp_u64(const void *a, const void *b) {
+        uint64_t x = *(const uint64_t *)a;
+        uint64_t y = *(const uint64_t *)b;
+
+        return x < y ? -1 : x > y;
+}
+
+static int __full(int fd, void *buf, size_t n, int wr) {
+        size_t done = 0;
+
+        while (done < n) {
+                ssize_t ret = wr ? write(fd, (char *)buf + done, n - done)
+                                 : read(fd, (char *)buf + done, n - done);
+                if (ret < 0 && errno == EINTR)
+                        continue;
+                if (ret <= 0)
+                        return -1;
+                done = done + ret;
+        }
+
+        return 0;
+}
+
+static void __report(const char *name, uint64_t *lat, int n) {
+        uint64_t sum = 0;
+
+        qsort(lat, n, sizeof(uint64_t), __cmp_u64);
+        for (int i = 0; i < n; i++) {
+                sum = sum + lat[i];
+        }
+
+        printf("%s,%d,%.1f,%.1f,%.1f\n", name, n, sum / (double)n / 1000.0,
+               lat[n / 2] / 1000.0, lat[(uint64_t)n * 99 / 100] / 1000.0);
+}
+
+/* one connection, requests back to back */
+static int __bench_serve(const char *sock, int n, int argc, char **argv,
+                         uint64_t *lat) {
+        struct sockaddr_un addr;
+        char cwd[PATH_MAX];
+        char *req = NULL;
+        size_t req_len = 0;
+
+        memset(&addr, 0, sizeof(addr));
+        addr.sun_family = AF_UNIX;
+        snprintf(addr.sun_path, sizeof(addr.sun_path), "%s", sock);
+
+        int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (fd < 0 || connect(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+                perror("connect()");
+                return -1;
+        }
+
+        if (getcwd(cwd, sizeof(cwd)) == NULL) {
+                perror("getcwd()");
+                return -1;
+        }
+
+        FILE *stream = open_memstream(&req, &req_len);
+        uint32_t count = argc + 1;
+
+        fwrite(&count, sizeof(count), 1, stream);
+        for (int i = -1; i < argc; i++) {
+                const char *arg = i < 0 ? cwd : argv[i];
+                uint32_t len = strlen(arg);
+
+                fwrite(&len, sizeof(len), 1, stream);
+                fwrite(arg, 1, len, stream);
+        }
+        fclose(stream);
+
+        char *resp = NULL;
+        uint64_t resp_cap = 0;
+
+        for (int i = 0; i < n; i++) {
+                uint32_t status;
+                uint64_t len;
+                uint64_t start = __now_ns();
+
+                if (__full(fd, req, req_len, 1) < 0 ||
+                    __full(fd, &status, sizeof(status), 0) < 0 ||
+                    __full(fd, &len, sizeof(len), 0) < 0) {
+                        fprintf(stderr, "server went away\n");
+                        return -1;
+                }
+
+                if (len > resp_cap) {
+                        resp_cap = len;
+                        resp = (char *)realloc(resp, resp_cap);
+                }
+                if (__full(fd, resp, len, 0) < 0) {
+                        fprintf(stderr, "short answer\n");
+                        return -1;
+                }
+
+                lat[i] = __now_ns() - start;
+        }
+
+        count = 0;
+        __full(fd, &count, sizeof(count), 1);
+        close(fd);
+        free(resp);
+        free(req);
+        return 0;
+}
+
+/* posix_spawn + waitpid of ./elf64, output to /dev/null */
+static int __bench_exec(int n, int argc, char **argv, uint64_t *lat) {
+        posix_spawn_file_actions_t fa;
+        char **args = (char **)calloc(argc + 2, sizeof(char *));
+
+        args[0] = (char *)"./elf64";
+        memcpy(args + 1, argv, argc * sizeof(char *));
+
+        posix_spawn_file_actions_init(&fa);
+        posix_spawn_file_actions_addopen(&fa, 1, "/dev/null", O_WRONLY, 0);
+        posix_spawn_file_actions_addopen(&fa, 2, "/dev/null", O_WRONLY, 0);
+
+        for (int i = 0; i < n; i++) {
+                pid_t pid;
+                int status;
+                uint64_t start = __now_ns();
+
+                if (posix_spawn(&pid, args[0], &fa, NULL, args, environ)) {
+                        perror("posix_spawn()");
+                        return -1;
+                }
+                waitpid(pid, &status, 0);
+
+                lat[i] = __now_ns() - start;
+        }
+
+        posix_spawn_file_actions_destroy(&fa);
+        free(args);
+        return 0;
+}
+
+int main(int argc, char **argv) {
+        if (argc < 4 || strcmp(argv[3], "--") != 0) {
+                fprintf(stderr, "usage: %s SOCKET N -- ARGS...\n", argv[0]);
+                return 1;
+        }
+
+        int n = atoi(argv[2]);
+        if (n <= 0) {
+                fprintf(stderr, "N must be positive\n");
+                return 1;
+        }
+
+        uint64_t *lat = (uint64_t *)malloc(n * sizeof(uint64_t));
+
+        printf("mode,requests,avg_us,p50_us,p99_us\n");
+
+        if (__bench_serve(argv[1], n, argc - 4, argv + 4, lat) < 0) {
+                return 1;
+        }
+        __report("serve", lat, n);
+
+        if (__bench_exec(n, argc - 4, argv + 4, lat) < 0) {
+                return 1;
+        }
+        __report("exec", lat, n);
+
+        free(lat);
+        return 0;
+}
@@ -0,0 +1,251 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+/*
+ * Copyright (C) Fadhil Riyanto <me@fadev.org>
+ */
+
+#include "columnar.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define COL_INIT_ROWS 1024
+#define COL_ALIGN(x) (((x) + 7) & ~(uint64_t)7)
+
+static uint8_t __col_width(uint8_t type) {
+        switch (type) {
+        case COL_U8:
+                return 1;
+        case COL_U16:
+                return 2;
+        case COL_U32:
+        case COL_STR:
+                return 4;
+        default:
+                return 8;
+        }
+}
+
+static void __col_dict_reset(struct col_dict *d) {
+        memset(d->slots, 0, d->nslots * sizeof(uint32_t));
+        d->n = 0;
+        d->size = 0;
+        d->offsets[0] = 0;
+}
+
+int col_table_init(struct col_table *t, const char *name,
+                   const struct col_def *defs, uint16_t ncolumns) {
+        memset(t, 0, sizeof(struct col_table));
+        t->name = name;
+        t->defs = defs;
+        t->ncolumns = ncolumns;
+        t->cap = COL_INIT_ROWS;
+
+        t->columns =
+            (struct col_column *)calloc(ncolumns, sizeof(struct col_column));
+        if (t->columns == NULL) {
+                return -1;
+        }
+
+        for (uint16_t i = 0; i < ncolumns; i++) {
+                t->columns[i].width = __col_width(defs[i].type);
+                t->columns[i].data =
+                    (uint8_t *)malloc(t->cap * t->columns[i].width);
+                if (t->columns[i].data == NULL)
+                        return -1;
+        }
+
+        t->dict.nslots = 1024;
+        t->dict.slots = (uint32_t *)calloc(t->dict.nslots, sizeof(uint32_t));
+        t->dict.offsets_cap = 512;
+        t->dict.offsets = (uint64_t *)malloc(t->dict.offsets_cap *
+                                             sizeof(uint64_t));
+        t->dict.cap = 16384;
+        t->dict.bytes = (char *)malloc(t->dict.cap);
+        if (!t->dict.slots || !t->dict.offsets || !t->dict.bytes) {
+                return -1;
+        }
+
+        t->dict.offsets[0] = 0;
+        return 0;
+}
+
+void col_put_u64(struct col_table *t, uint16_t column, uint64_t v) {
+        struct col_column *c = &t->columns[column];
+        uint8_t *p = c->data + t->nrows * c->width;
+
+        switch (c->width) {
+        case 1:
+                *p = (uint8_t)v;
+                break;
+        case 2: {
+                uint16_t x = (uint16_t)v;
+                memcpy(p, &x, 2);
+                break;
+        }
+        case 4: {
+                uint32_t x = (uint32_t)v;
+                memcpy(p, &x, 4);
+                break;
+        }
+        default:
+                memcpy(p, &v, 8);
+                break;
+        }
+}
+
+static uint64_t __col_hash(const char *s, size_t len) {
+        uint64_t h = 0xcbf29ce484222325ULL;
+
+        for (size_t i = 0; i < len; i++) {
+                h = (h ^ (uint8_t)s[i]) * 0x100000001b3ULL;
+        }
+
+        return h;
+}
+
+static void __col_dict_grow(struct col_dict *d) {
+        uint64_t nslots = d->nslots * 2;
+        uint32_t *slots = (uint32_t *)calloc(nslots, sizeof(uint32_t));
+
+        for (uint64_t id = 0; id < d->n; id++) {
+                const char *s = d->bytes + d->offsets[id];
+                size_t len = d->offsets[id + 1] - d->offsets[id] - 1;
+                uint64_t i = __col_hash(s, len) & (nslots - 1);
+
+                while (slots[i])
+                        i = (i + 1) & (nslots - 1);
+                slots[i] = id + 1;
+        }
+
+        free(d->slots);
+        d->slots = slots;
+        d->nslots = nslots;
+}
+
+/* id of s in the block dictionary, added on first sight */
+static uint32_t __col_dict_id(struct col_dict *d, const char *s) {
+        size_t len = strlen(s);
+        uint64_t i = __col_hash(s, len) & (d->nslots - 1);
+
+        while (d->slots[i]) {
+                uint32_t id = d->slots[i] - 1;
+                uint64_t off = d->offsets[id];
+
+                if (d->offsets[id + 1] - off - 1 == len &&
+                    memcmp(d->bytes + off, s, len) == 0)
+                        return id;
+
+                i = (i + 1) & (d->nslots - 1);
+        }
+
+        if (d->size + len + 1 > d->cap) {
+                while (d->size + len + 1 > d->cap)
+                        d->cap = d->cap * 2;
+                d->bytes = (char *)realloc(d->bytes, d->cap);
+        }
+
+        if (d->n + 2 > d->offsets_cap) {
+                d->offsets_cap = d->offsets_cap * 2;
+                d->offsets = (uint64_t *)realloc(
+                    d->offsets, d->offsets_cap * sizeof(uint64_t));
+        }
+
+        memcpy(d->bytes + d->size, s, len + 1);
+        d->size = d->size + len + 1;
+
+        uint32_t id = d->n;
+        d->n = d->n + 1;
+        d->offsets[d->n] = d->size;
+        d->slots[i] = id + 1;
+
+        if (d->n * 2 > d->nslots)
+                __col_dict_grow(d);
+
+        return id;
+}
+
+void col_put_str(struct col_table *t, uint16_t column, const char *s) {
+        col_put_u64(t, column, __col_dict_id(&t->dict, s ? s : ""));
+}
+
+void col_row_end(struct col_table *t) {
+        t->nrows = t->nrows + 1;
+        if (t->nrows < t->cap) {
+                return;
+        }
+
+        t->cap = t->cap * 2;
+        for (uint16_t i = 0; i < t->ncolumns; i++) {
+                t->columns[i].data = (uint8_t *)realloc(
+                    t->columns[i].data, t->cap * t->columns[i].width);
+        }
+}
+
+int col_table_flush(struct col_table *t, FILE *out) {
+        static const uint8_t zero[8];
+        struct col_block_hdr hdr;
+        struct col_column_hdr col;
+        uint64_t off;
+
+        if (t->nrows == 0) {
+                return 0;
+        }
+
+        off = sizeof(hdr) + t->ncolumns * sizeof(col);
+        memset(&hdr, 0, sizeof(hdr));
+        memcpy(hdr.magic, COL_MAGIC, 4);
+        hdr.version = COL_VERSION;
+        hdr.ncolumns = t->ncolumns;
+        hdr.byte_order = COL_BYTE_ORDER;
+        hdr.nrows = t->nrows;
+        hdr.ndict = t->dict.n;
+        strncpy(hdr.table, t->name, sizeof(hdr.table) - 1);
+
+        for (uint16_t i = 0; i < t->ncolumns; i++) {
+                off = off + COL_ALIGN(t->nrows * t->columns[i].width);
+        }
+        hdr.dict_off = off;
+        hdr.size = off + (t->dict.n + 1) * sizeof(uint64_t) +
+                   COL_ALIGN(t->dict.size);
+
+        fwrite(&hdr, sizeof(hdr), 1, out);
+
+        off = sizeof(hdr) + t->ncolumns * sizeof(col);
+        for (uint16_t i = 0; i < t->ncolumns; i++) {
+                memset(&col, 0, sizeof(col));
+                strncpy(col.name, t->defs[i].name, sizeof(col.name) - 1);
+                col.type = t->defs[i].type;
+                col.width = t->columns[i].width;
+                col.offset = off;
+                fwrite(&col, sizeof(col), 1, out);
+
+                off = off + COL_ALIGN(t->nrows * t->columns[i].width);
+        }
+
+        for (uint16_t i = 0; i < t->ncolumns; i++) {
+                uint64_t len = t->nrows * t->columns[i].width;
+
+                fwrite(t->columns[i].data, 1, len, out);
+                fwrite(zero, 1, COL_ALIGN(len) - len, out);
+        }
+
+        fwrite(t->dict.offsets, sizeof(uint64_t), t->dict.n + 1, out);
+        fwrite(t->dict.bytes, 1, t->dict.size, out);
+        fwrite(zero, 1, COL_ALIGN(t->dict.size) - t->dict.size, out);
+
+        t->nrows = 0;
+        __col_dict_reset(&t->dict);
+
+        return ferror(out) ? -1 : 0;
+}
+
+void col_table_free(struct col_table *t) {
+        for (uint16_t i = 0; t->columns && i < t->ncolumns; i++) {
+                free(t->columns[i].data);
+        }
+
+        free(t->columns);
+        free(t->dict.slots);
+        free(t->dict.offsets);
+        free(t->dict.bytes);
+        memset(t, 0, sizeof(struct col_table));
+}
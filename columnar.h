@@ -0,0 +1,104 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+/*
+ * Copyright (C) Fadhil Riyanto <me@fadev.org>
+ * columnar table writer, rows are kept column by column and written out
+ * as self-describing blocks, string columns hold ids into a dictionary
+ * the block carries, every string is stored once per block
+ *
+ * block layout (byte order of the producer, see byte_order):
+ *
+ *   struct col_block_hdr
+ *   struct col_column_hdr [ncolumns]
+ *   column data, nrows * width bytes each, 8 byte aligned
+ *   uint64_t dict_offsets[ndict + 1], at dict_off
+ *   dictionary strings, NUL terminated, string i is at
+ *   dict_off + (ndict + 1) * 8 + dict_offsets[i]
+ *
+ * blocks of any table follow each other, a stream of blocks can be
+ * concatenated with cat
+ */
+
+#ifndef COLUMNAR_H
+#define COLUMNAR_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+#define COL_MAGIC "ECOL"
+#define COL_VERSION 1
+#define COL_BYTE_ORDER 0x01020304
+
+enum col_type {
+        COL_U8 = 1,
+        COL_U16,
+        COL_U32,
+        COL_U64,
+        COL_I64,
+        COL_STR /* uint32_t dictionary id */
+};
+
+struct col_block_hdr {
+        char magic[4]; /* "ECOL" */
+        uint16_t version;
+        uint16_t ncolumns;
+        uint32_t byte_order; /* COL_BYTE_ORDER as the producer wrote it */
+        uint32_t reserved;
+        uint64_t size; /* whole block, this header included */
+        uint64_t nrows;
+        uint64_t ndict;
+        uint64_t dict_off; /* from the block start */
+        char table[16];
+};
+
+struct col_column_hdr {
+        char name[16];
+        uint8_t type; /* enum col_type */
+        uint8_t width;
+        uint8_t reserved[6];
+        uint64_t offset; /* from the block start */
+};
+
+struct col_def {
+        const char *name; /* at most 15 bytes */
+        uint8_t type;
+};
+
+struct col_column {
+        uint8_t *data;
+        uint8_t width;
+};
+
+struct col_dict {
+        uint32_t *slots; /* id + 1, 0 is empty */
+        uint64_t nslots; /* power of two */
+        uint64_t *offsets;
+        uint64_t n;
+        uint64_t offsets_cap;
+        char *bytes;
+        uint64_t size;
+        uint64_t cap;
+};
+
+struct col_table {
+        const char *name;
+        const struct col_def *defs;
+        uint16_t ncolumns;
+        struct col_column *columns;
+        uint64_t nrows;
+        uint64_t cap; /* rows */
+        struct col_dict dict;
+};
+
+int col_table_init(struct col_table *t, const char *name,
+                   const struct col_def *defs, uint16_t ncolumns);
+
+/* fill the columns of the current row, then col_row_end() */
+void col_put_u64(struct col_table *t, uint16_t column, uint64_t v);
+void col_put_str(struct col_table *t, uint16_t column, const char *s);
+void col_row_end(struct col_table *t);
+
+/* one block with every pending row, rows and dictionary start over */
+int col_table_flush(struct col_table *t, FILE *out);
+void col_table_free(struct col_table *t);
+
+#endif /* COLUMNAR_H */
@@ -0,0 +1,254 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+/*
+ * Copyright (C) Fadhil Riyanto <me@fadev.org>
+ */
+
+#include "dedup.h"
+#include <stdlib.h>
+#include <string.h>
+
+static uint64_t __dedup_fnv(const char *s) {
+        uint64_t h = 0xcbf29ce484222325ULL;
+
+        for (; *s; s++)
+                h = (h ^ (uint8_t)*s) * 0x100000001b3ULL;
+        return h;
+}
+
+/* the content hash is already uniform, the size only has to be mixed */
+static inline uint64_t __dedup_key(uint64_t hash, uint64_t size) {
+        return hash ^ (size * 0x9e3779b97f4a7c15ULL);
+}
+
+static int __dedup_strs_grow(struct dedup_strs *s) {
+        uint32_t nslots = s->nslots ? s->nslots * 2 : 256;
+        uint32_t *slots = (uint32_t *)calloc(nslots, sizeof(uint32_t));
+
+        if (slots == NULL)
+                return -1;
+
+        for (uint32_t id = 0; id < s->n; id++) {
+                uint32_t i = __dedup_fnv(s->pool + s->off[id]) & (nslots - 1);
+
+                while (slots[i])
+                        i = (i + 1) & (nslots - 1);
+                slots[i] = id + 1;
+        }
+
+        free(s->slots);
+        s->slots = slots;
+        s->nslots = nslots;
+        return 0;
+}
+
+/* id of str, added when new, -1 when out of memory */
+static int64_t __dedup_intern(struct dedup_strs *s, const char *str) {
+        if (s->n * 2 >= s->nslots && __dedup_strs_grow(s) < 0)
+                return -1;
+
+        uint32_t i = __dedup_fnv(str) & (s->nslots - 1);
+        for (; s->slots[i]; i = (i + 1) & (s->nslots - 1)) {
+                if (strcmp(s->pool + s->off[s->slots[i] - 1], str) == 0)
+                        return s->slots[i] - 1;
+        }
+
+        uint64_t len = strlen(str) + 1;
+        if (s->len + len > s->cap) {
+                uint64_t cap = s->cap ? s->cap * 2 : 4096;
+
+                while (cap < s->len + len)
+                        cap *= 2;
+
+                char *pool = (char *)realloc(s->pool, cap);
+                if (pool == NULL)
+                        return -1;
+                s->pool = pool;
+                s->cap = cap;
+        }
+
+        if (s->n == s->cap_ids) {
+                uint32_t cap = s->cap_ids ? s->cap_ids * 2 : 256;
+                uint64_t *off =
+                    (uint64_t *)realloc(s->off, cap * sizeof(uint64_t));
+
+                if (off == NULL)
+                        return -1;
+                s->off = off;
+                s->cap_ids = cap;
+        }
+
+        memcpy(s->pool + s->len, str, len);
+        s->off[s->n] = s->len;
+        s->len += len;
+        s->slots[i] = s->n + 1;
+        return s->n++;
+}
+
+static void __dedup_strs_free(struct dedup_strs *s) {
+        free(s->pool);
+        free(s->off);
+        free(s->slots);
+        memset(s, 0, sizeof(struct dedup_strs));
+}
+
+/* by_name / by_lib follow the id count of their strings */
+static int __dedup_stat(struct dedup_stat **stat, uint32_t *cap,
+                        uint32_t id) {
+        if (id < *cap)
+                return 0;
+
+        uint32_t n = *cap ? *cap : 256;
+        while (n <= id)
+                n *= 2;
+
+        struct dedup_stat *p =
+            (struct dedup_stat *)realloc(*stat, n * sizeof(struct dedup_stat));
+        if (p == NULL)
+                return -1;
+
+        memset(p + *cap, 0, (n - *cap) * sizeof(struct dedup_stat));
+        *stat = p;
+        *cap = n;
+        return 0;
+}
+
+static int __dedup_grow(struct dedup *d) {
+        uint64_t nslots = d->nslots ? d->nslots * 2 : 4096;
+        uint32_t *slots = (uint32_t *)calloc(nslots, sizeof(uint32_t));
+
+        if (slots == NULL)
+                return -1;
+
+        for (uint64_t e = 0; e < d->n; e++) {
+                uint64_t i = __dedup_key(d->entries[e].hash,
+                                         d->entries[e].size) &
+                             (nslots - 1);
+
+                while (slots[i])
+                        i = (i + 1) & (nslots - 1);
+                slots[i] = e + 1;
+        }
+
+        free(d->slots);
+        d->slots = slots;
+        d->nslots = nslots;
+        return 0;
+}
+
+int dedup_init(struct dedup *d) {
+        memset(d, 0, sizeof(struct dedup));
+        pthread_mutex_init(&d->lock, NULL);
+        return __dedup_grow(d);
+}
+
+void dedup_free(struct dedup *d) {
+        free(d->entries);
+        free(d->slots);
+        free(d->by_name);
+        free(d->by_lib);
+        __dedup_strs_free(&d->paths);
+        __dedup_strs_free(&d->names);
+        __dedup_strs_free(&d->libs);
+        pthread_mutex_destroy(&d->lock);
+        memset(d, 0, sizeof(struct dedup));
+}
+
+/* first copy of hash / size, a new entry when there is none */
+static struct dedup_entry *__dedup_find(struct dedup *d, uint64_t hash,
+                                        uint64_t size, int *fresh) {
+        if (d->n * 2 >= d->nslots && __dedup_grow(d) < 0)
+                return NULL;
+
+        uint64_t i = __dedup_key(hash, size) & (d->nslots - 1);
+        for (; d->slots[i]; i = (i + 1) & (d->nslots - 1)) {
+                struct dedup_entry *e = &d->entries[d->slots[i] - 1];
+
+                if (e->hash == hash && e->size == size) {
+                        *fresh = 0;
+                        return e;
+                }
+        }
+
+        if (d->n == d->cap) {
+                uint64_t cap = d->cap ? d->cap * 2 : 4096;
+                struct dedup_entry *p = (struct dedup_entry *)realloc(
+                    d->entries, cap * sizeof(struct dedup_entry));
+
+                if (p == NULL)
+                        return NULL;
+                d->entries = p;
+                d->cap = cap;
+        }
+
+        d->slots[i] = d->n + 1;
+        *fresh = 1;
+        return &d->entries[d->n++];
+}
+
+int dedup_add(struct dedup *d, const char *path, const struct dedup_sec *secs,
+              uint64_t n) {
+        const char *slash = strrchr(path, '/');
+        int64_t path_id = -1;
+        int ret = 0;
+
+        pthread_mutex_lock(&d->lock);
+
+        int64_t lib = __dedup_intern(&d->libs, slash ? slash + 1 : path);
+        if (lib < 0 || __dedup_stat(&d->by_lib, &d->by_lib_cap, lib) < 0) {
+                ret = -1;
+                goto out;
+        }
+
+        d->files++;
+        d->by_lib[lib].files++;
+
+        for (uint64_t i = 0; i < n; i++) {
+                const struct dedup_sec *s = &secs[i];
+                int64_t name = __dedup_intern(&d->names, s->name);
+                int fresh;
+
+                if (name < 0 ||
+                    __dedup_stat(&d->by_name, &d->by_name_cap, name) < 0) {
+                        ret = -1;
+                        break;
+                }
+
+                struct dedup_entry *e = __dedup_find(d, s->hash, s->size,
+                                                     &fresh);
+                if (e == NULL) {
+                        ret = -1;
+                        break;
+                }
+
+                d->sections++;
+                d->bytes += s->size;
+                d->by_name[name].copies++;
+                d->by_lib[lib].copies++;
+
+                if (!fresh) {
+                        e->copies++;
+                        d->wasted += s->size;
+                        d->by_name[name].wasted += s->size;
+                        d->by_lib[lib].wasted += s->size;
+                        continue;
+                }
+
+                /* the path is only kept by inputs holding a first copy */
+                if (path_id < 0)
+                        path_id = __dedup_intern(&d->paths, path);
+
+                e->hash = s->hash;
+                e->size = s->size;
+                e->copies = 1;
+                e->path = path_id < 0 ? DEDUP_NONE : path_id;
+                e->name = name;
+                if (path_id < 0) {
+                        ret = -1;
+                        break;
+                }
+        }
+
+out:
+        pthread_mutex_unlock(&d->lock);
+        return ret;
+}
@@ -0,0 +1,89 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+/*
+ * Copyright (C) Fadhil Riyanto <me@fadev.org>
+ * --dedup, identical sections across a file set
+ *
+ * one entry per distinct (content hash, size): the number of copies
+ * and where the first copy was seen, nothing else of a section is
+ * kept, so 100k inputs cost their distinct sections and names only
+ *
+ * every copy after the first is wasted, summed by section name and by
+ * library (file name without the directory)
+ */
+
+#ifndef DEDUP_H
+#define DEDUP_H
+
+#include <pthread.h>
+#include <stdint.h>
+
+#define DEDUP_NONE UINT32_MAX
+
+/* interned strings, ids count from 0 */
+struct dedup_strs {
+        char *pool;
+        uint64_t len;
+        uint64_t cap;
+        uint64_t *off; /* id -> offset in pool */
+        uint32_t n;
+        uint32_t cap_ids;
+        uint32_t *slots; /* id + 1, 0 is empty */
+        uint32_t nslots; /* power of two */
+};
+
+struct dedup_entry {
+        uint64_t hash;
+        uint64_t size;
+        uint32_t copies;
+        uint32_t path; /* first copy, dedup.paths id, DEDUP_NONE if lost */
+        uint32_t name; /* first copy, dedup.names id */
+};
+
+struct dedup_stat {
+        uint64_t copies; /* sections, first copies included */
+        uint64_t wasted; /* bytes of the copies after the first */
+        uint64_t files;  /* libraries only */
+};
+
+struct dedup {
+        pthread_mutex_t lock;
+
+        struct dedup_entry *entries;
+        uint64_t n;
+        uint64_t cap;
+        uint32_t *slots; /* entry index + 1, 0 is empty */
+        uint64_t nslots; /* power of two */
+
+        struct dedup_strs paths; /* files holding a first copy */
+        struct dedup_strs names; /* section names */
+        struct dedup_strs libs;  /* file names */
+        struct dedup_stat *by_name; /* by names id */
+        struct dedup_stat *by_lib;  /* by libs id */
+        uint32_t by_name_cap;
+        uint32_t by_lib_cap;
+
+        uint64_t files;
+        uint64_t sections;
+        uint64_t bytes;
+        uint64_t wasted;
+};
+
+/* one section of an input */
+struct dedup_sec {
+        uint64_t hash;
+        uint64_t size;
+        const char *name;
+};
+
+int dedup_init(struct dedup *d);
+void dedup_free(struct dedup *d);
+
+/* the sections of one input, safe from any thread */
+int dedup_add(struct dedup *d, const char *path, const struct dedup_sec *secs,
+              uint64_t n);
+
+static inline const char *dedup_str(const struct dedup_strs *s, uint32_t id) {
+        return s->pool + s->off[id];
+}
+
+#endif /* DEDUP_H */
@@ -0,0 +1,114 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+/*
+ * Copyright (C) Fadhil Riyanto <me@fadev.org>
+ */
+
+#include "diff.h"
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#define DIFF_BLOCK 64
+
+static void __diff_extend(struct diff_ranges *out, uint64_t start,
+                          uint64_t end, uint64_t gap) {
+        if (out->n && start <= out->r[out->n - 1].end + gap) {
+                if (end > out->r[out->n - 1].end)
+                        out->r[out->n - 1].end = end;
+                return;
+        }
+
+        if (out->n == out->cap) {
+                uint64_t cap = out->cap ? out->cap * 2 : 64;
+                struct diff_range *r = (struct diff_range *)realloc(
+                    out->r, cap * sizeof(struct diff_range));
+                if (r == NULL)
+                        return;
+
+                out->r = r;
+                out->cap = cap;
+        }
+
+        out->r[out->n].start = start;
+        out->r[out->n].end = end;
+        out->n++;
+}
+
+void diff_ranges_add(struct diff_ranges *out, uint64_t start, uint64_t end,
+                     uint64_t gap) {
+        if (start >= end)
+                return;
+
+        out->bytes += end - start;
+        __diff_extend(out, start, end, gap);
+}
+
+/* bit i set when a[i] != b[i], 0 for an identical block */
+static inline uint64_t __diff_block(const uint8_t *a, const uint8_t *b) {
+#ifdef __SSE2__
+        __m128i e0 = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)a),
+                                    _mm_loadu_si128((const __m128i *)b));
+        __m128i e1 =
+            _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)(a + 16)),
+                           _mm_loadu_si128((const __m128i *)(b + 16)));
+        __m128i e2 =
+            _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)(a + 32)),
+                           _mm_loadu_si128((const __m128i *)(b + 32)));
+        __m128i e3 =
+            _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)(a + 48)),
+                           _mm_loadu_si128((const __m128i *)(b + 48)));
+        __m128i all =
+            _mm_and_si128(_mm_and_si128(e0, e1), _mm_and_si128(e2, e3));
+
+        if (_mm_movemask_epi8(all) == 0xffff)
+                return 0;
+
+        return (uint64_t)(~_mm_movemask_epi8(e0) & 0xffff) |
+               (uint64_t)(~_mm_movemask_epi8(e1) & 0xffff) << 16 |
+               (uint64_t)(~_mm_movemask_epi8(e2) & 0xffff) << 32 |
+               (uint64_t)(~_mm_movemask_epi8(e3) & 0xffff) << 48;
+#else
+        uint64_t bits = 0;
+
+        if (memcmp(a, b, DIFF_BLOCK) == 0)
+                return 0;
+
+        for (uint32_t i = 0; i < DIFF_BLOCK; i++) {
+                if (a[i] != b[i])
+                        bits |= (uint64_t)1 << i;
+        }
+        return bits;
+#endif
+}
+
+void diff_scan(const uint8_t *a, const uint8_t *b, uint64_t size,
+               uint64_t gap, struct diff_ranges *out) {
+        uint64_t i = 0;
+
+        for (; i + DIFF_BLOCK <= size; i += DIFF_BLOCK) {
+                uint64_t bits = __diff_block(a + i, b + i);
+
+                out->bytes += __builtin_popcountll(bits);
+                while (bits) {
+                        uint64_t at = i + __builtin_ctzll(bits);
+
+                        __diff_extend(out, at, at + 1, gap);
+                        bits = bits & (bits - 1);
+                }
+        }
+
+        for (; i < size; i++) {
+                if (a[i] != b[i]) {
+                        out->bytes++;
+                        __diff_extend(out, i, i + 1, gap);
+                }
+        }
+}
+
+void diff_ranges_free(struct diff_ranges *out) {
+        free(out->r);
+        memset(out, 0, sizeof(struct diff_ranges));
+}
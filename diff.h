@@ -0,0 +1,39 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+/*
+ * Copyright (C) Fadhil Riyanto <me@fadev.org>
+ * --diff, byte ranges where two buffers differ
+ *
+ * both sides are walked in 64-byte blocks, four 16-byte compares each
+ * (SSE2), only a block that differs is looked at byte by byte
+ */
+
+#ifndef DIFF_H
+#define DIFF_H
+
+#include <stdint.h>
+
+struct diff_range {
+        uint64_t start;
+        uint64_t end;
+};
+
+struct diff_ranges {
+        struct diff_range *r;
+        uint64_t n;
+        uint64_t cap;
+        uint64_t bytes; /* differing bytes over all ranges */
+};
+
+/*
+ * ranges where a[0, size) and b[0, size) differ, appended to out in
+ * order, a range starting within gap bytes of the last one extends it
+ */
+void diff_scan(const uint8_t *a, const uint8_t *b, uint64_t size,
+               uint64_t gap, struct diff_ranges *out);
+
+/* [start, end) differs as a whole, e.g. bytes only one side has */
+void diff_ranges_add(struct diff_ranges *out, uint64_t start, uint64_t end,
+                     uint64_t gap);
+void diff_ranges_free(struct diff_ranges *out);
+
+#endif /* DIFF_H */
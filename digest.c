@@ -0,0 +1,555 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+/*
+ * Copyright (C) Fadhil Riyanto <me@fadev.org>
+ */
+
+#include "digest.h"
+#include <pthread.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define DIGEST_X86 1
+#include <cpuid.h>
+#include <immintrin.h>
+#endif
+
+#define CRC32C_POLY 0x82f63b78 /* Castagnoli, reflected */
+
+static uint32_t crc32c_table[8][256];
+static int digest_has_sse42;
+static int digest_has_sha;
+static pthread_once_t digest_once = PTHREAD_ONCE_INIT;
+
+static void __digest_setup(void) {
+        for (uint32_t i = 0; i < 256; i++) {
+                uint32_t c = i;
+
+                for (int k = 0; k < 8; k++)
+                        c = c & 1 ? (c >> 1) ^ CRC32C_POLY : c >> 1;
+                crc32c_table[0][i] = c;
+        }
+
+        for (uint32_t i = 0; i < 256; i++) {
+                uint32_t c = crc32c_table[0][i];
+
+                for (int t = 1; t < 8; t++) {
+                        c = crc32c_table[0][c & 0xff] ^ (c >> 8);
+                        crc32c_table[t][i] = c;
+                }
+        }
+
+#ifdef DIGEST_X86
+        unsigned int a, b, c, d;
+
+        if (__get_cpuid(1, &a, &b, &c, &d)) {
+                digest_has_sse42 = !!(c & bit_SSE4_2);
+                digest_has_sha = (c & bit_SSSE3) && (c & bit_SSE4_1);
+        }
+        if (!__get_cpuid_count(7, 0, &a, &b, &c, &d) || !(b & bit_SHA))
+                digest_has_sha = 0;
+#endif
+}
+
+/* slicing by 8 */
+static uint32_t __crc32c_sw(uint32_t crc, const uint8_t *p, uint64_t n) {
+        for (; n >= 8; n -= 8, p += 8) {
+                uint64_t v;
+
+                memcpy(&v, p, 8);
+                v ^= crc;
+                crc = crc32c_table[7][v & 0xff] ^
+                      crc32c_table[6][(v >> 8) & 0xff] ^
+                      crc32c_table[5][(v >> 16) & 0xff] ^
+                      crc32c_table[4][(v >> 24) & 0xff] ^
+                      crc32c_table[3][(v >> 32) & 0xff] ^
+                      crc32c_table[2][(v >> 40) & 0xff] ^
+                      crc32c_table[1][(v >> 48) & 0xff] ^
+                      crc32c_table[0][v >> 56];
+        }
+
+        for (; n; n--, p++)
+                crc = crc32c_table[0][(crc ^ *p) & 0xff] ^ (crc >> 8);
+        return crc;
+}
+
+#ifdef DIGEST_X86
+__attribute__((target("sse4.2"))) static uint32_t
+__crc32c_hw(uint32_t crc, const uint8_t *p, uint64_t n) {
+#ifdef __x86_64__
+        uint64_t c = crc;
+
+        for (; n >= 8; n -= 8, p += 8) {
+                uint64_t v;
+
+                memcpy(&v, p, 8);
+                c = _mm_crc32_u64(c, v);
+        }
+        crc = (uint32_t)c;
+#endif
+        for (; n; n--, p++)
+                crc = _mm_crc32_u8(crc, *p);
+        return crc;
+}
+#endif
+
+uint32_t crc32c(uint32_t crc, const uint8_t *p, uint64_t n) {
+        pthread_once(&digest_once, __digest_setup);
+
+        crc = ~crc;
+#ifdef DIGEST_X86
+        if (digest_has_sse42)
+                return ~__crc32c_hw(crc, p, n);
+#endif
+        return ~__crc32c_sw(crc, p, n);
+}
+
+/* zlib's crc32_combine(), GF(2) matrices for appending zero bits */
+static uint32_t __gf2_times(const uint32_t *mat, uint32_t vec) {
+        uint32_t sum = 0;
+
+        for (; vec; vec >>= 1, mat++) {
+                if (vec & 1)
+                        sum ^= *mat;
+        }
+        return sum;
+}
+
+static void __gf2_square(uint32_t *square, const uint32_t *mat) {
+        for (int n = 0; n < 32; n++)
+                square[n] = __gf2_times(mat, mat[n]);
+}
+
+uint32_t crc32c_combine(uint32_t crc_a, uint32_t crc_b, uint64_t len_b) {
+        uint32_t even[32];
+        uint32_t odd[32];
+        uint32_t row = 1;
+
+        if (len_b == 0)
+                return crc_a;
+
+        odd[0] = CRC32C_POLY;
+        for (int n = 1; n < 32; n++) {
+                odd[n] = row;
+                row <<= 1;
+        }
+
+        __gf2_square(even, odd); /* 2 zero bits */
+        __gf2_square(odd, even); /* 4 zero bits */
+
+        do {
+                __gf2_square(even, odd);
+                if (len_b & 1)
+                        crc_a = __gf2_times(even, crc_a);
+                len_b >>= 1;
+                if (len_b == 0)
+                        break;
+
+                __gf2_square(odd, even);
+                if (len_b & 1)
+                        crc_a = __gf2_times(odd, crc_a);
+                len_b >>= 1;
+        } while (len_b);
+
+        return crc_a ^ crc_b;
+}
+
+/* XXH64 */
+#define XXH_P1 0x9e3779b185ebca87ULL
+#define XXH_P2 0xc2b2ae3d27d4eb4fULL
+#define XXH_P3 0x165667b19e3779f9ULL
+#define XXH_P4 0x85ebca77c2b2ae63ULL
+#define XXH_P5 0x27d4eb2f165667c5ULL
+
+static inline uint64_t __rotl64(uint64_t x, int r) {
+        return (x << r) | (x >> (64 - r));
+}
+
+static inline uint64_t __xxh_round(uint64_t acc, uint64_t in) {
+        acc += in * XXH_P2;
+        acc = __rotl64(acc, 31);
+        return acc * XXH_P1;
+}
+
+static inline uint64_t __xxh_merge(uint64_t acc, uint64_t v) {
+        acc ^= __xxh_round(0, v);
+        return acc * XXH_P1 + XXH_P4;
+}
+
+static inline uint64_t __load64(const uint8_t *p) {
+        uint64_t v;
+
+        memcpy(&v, p, 8);
+        return v;
+}
+
+static inline uint32_t __load32(const uint8_t *p) {
+        uint32_t v;
+
+        memcpy(&v, p, 4);
+        return v;
+}
+
+static void __xxh64_stripes(struct digest_xxh64 *s, const uint8_t *p,
+                            uint64_t n) {
+        uint64_t v0 = s->v[0];
+        uint64_t v1 = s->v[1];
+        uint64_t v2 = s->v[2];
+        uint64_t v3 = s->v[3];
+
+        for (; n >= 32; n -= 32, p += 32) {
+                v0 = __xxh_round(v0, __load64(p));
+                v1 = __xxh_round(v1, __load64(p + 8));
+                v2 = __xxh_round(v2, __load64(p + 16));
+                v3 = __xxh_round(v3, __load64(p + 24));
+        }
+
+        s->v[0] = v0;
+        s->v[1] = v1;
+        s->v[2] = v2;
+        s->v[3] = v3;
+}
+
+static void __xxh64_update(struct digest_xxh64 *s, const uint8_t *p,
+                           uint64_t n) {
+        s->total += n;
+
+        if (s->buffered) {
+                uint32_t take = 32 - s->buffered;
+
+                if (n < take) {
+                        memcpy(s->buf + s->buffered, p, n);
+                        s->buffered += n;
+                        return;
+                }
+
+                memcpy(s->buf + s->buffered, p, take);
+                __xxh64_stripes(s, s->buf, 32);
+                s->buffered = 0;
+                p += take;
+                n -= take;
+        }
+
+        uint64_t whole = n & ~(uint64_t)31;
+        __xxh64_stripes(s, p, whole);
+        memcpy(s->buf, p + whole, n - whole);
+        s->buffered = n - whole;
+}
+
+static uint64_t __xxh64_final(const struct digest_xxh64 *s) {
+        const uint8_t *p = s->buf;
+        uint32_t n = s->buffered;
+        uint64_t h;
+
+        if (s->total >= 32) {
+                h = __rotl64(s->v[0], 1) + __rotl64(s->v[1], 7) +
+                    __rotl64(s->v[2], 12) + __rotl64(s->v[3], 18);
+                h = __xxh_merge(h, s->v[0]);
+                h = __xxh_merge(h, s->v[1]);
+                h = __xxh_merge(h, s->v[2]);
+                h = __xxh_merge(h, s->v[3]);
+        } else {
+                h = s->v[2] + XXH_P5; /* v[2] is still the seed */
+        }
+
+        h += s->total;
+
+        for (; n >= 8; n -= 8, p += 8) {
+                h ^= __xxh_round(0, __load64(p));
+                h = __rotl64(h, 27) * XXH_P1 + XXH_P4;
+        }
+        if (n >= 4) {
+                h ^= (uint64_t)__load32(p) * XXH_P1;
+                h = __rotl64(h, 23) * XXH_P2 + XXH_P3;
+                p += 4;
+                n -= 4;
+        }
+        for (; n; n--, p++) {
+                h ^= *p * XXH_P5;
+                h = __rotl64(h, 11) * XXH_P1;
+        }
+
+        h ^= h >> 33;
+        h *= XXH_P2;
+        h ^= h >> 29;
+        h *= XXH_P3;
+        h ^= h >> 32;
+        return h;
+}
+
+/* SHA-256 */
+static const uint32_t sha256_k[64] = {
+        0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b,
+        0x59f111f1, 0x923f82a4, 0xab1c5ed5, 0xd807aa98, 0x12835b01,
+        0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7,
+        0xc19bf174, 0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc,
+        0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da, 0x983e5152,
+        0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147,
+        0x06ca6351, 0x14292967, 0x27b70a85, 0x2e1b2138, 0x4d2c6dfc,
+        0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+        0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819,
+        0xd6990624, 0xf40e3585, 0x106aa070, 0x19a4c116, 0x1e376c08,
+        0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f,
+        0x682e6ff3, 0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208,
+        0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+};
+
+static inline uint32_t __rotr32(uint32_t x, int r) {
+        return (x >> r) | (x << (32 - r));
+}
+
+static void __sha256_sw(uint32_t *h, const uint8_t *p, uint64_t nblocks) {
+        for (; nblocks; nblocks--, p += 64) {
+                uint32_t w[64];
+                uint32_t s[8];
+
+                for (int i = 0; i < 16; i++)
+                        w[i] = (uint32_t)p[4 * i] << 24 |
+                               (uint32_t)p[4 * i + 1] << 16 |
+                               (uint32_t)p[4 * i + 2] << 8 | p[4 * i + 3];
+
+                for (int i = 16; i < 64; i++) {
+                        uint32_t s0 = __rotr32(w[i - 15], 7) ^
+                                      __rotr32(w[i - 15], 18) ^
+                                      (w[i - 15] >> 3);
+                        uint32_t s1 = __rotr32(w[i - 2], 17) ^
+                                      __rotr32(w[i - 2], 19) ^
+                                      (w[i - 2] >> 10);
+
+                        w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+                }
+
+                memcpy(s, h, sizeof(s));
+                for (int i = 0; i < 64; i++) {
+                        uint32_t e1 = __rotr32(s[4], 6) ^ __rotr32(s[4], 11) ^
+                                      __rotr32(s[4], 25);
+                        uint32_t ch = (s[4] & s[5]) ^ (~s[4] & s[6]);
+                        uint32_t t1 = s[7] + e1 + ch + sha256_k[i] + w[i];
+                        uint32_t e0 = __rotr32(s[0], 2) ^ __rotr32(s[0], 13) ^
+                                      __rotr32(s[0], 22);
+                        uint32_t maj =
+                            (s[0] & s[1]) ^ (s[0] & s[2]) ^ (s[1] & s[2]);
+
+                        s[7] = s[6];
+                        s[6] = s[5];
+                        s[5] = s[4];
+                        s[4] = s[3] + t1;
+                        s[3] = s[2];
+                        s[2] = s[1];
+                        s[1] = s[0];
+                        s[0] = t1 + e0 + maj;
+                }
+
+                for (int i = 0; i < 8; i++)
+                        h[i] += s[i];
+        }
+}
+
+#ifdef DIGEST_X86
+/*
+ * four rounds per step, the message schedule of step g is finished
+ * two steps ahead with sha256msg1 / sha256msg2
+ */
+__attribute__((target("sha,sse4.1,ssse3"))) static void
+__sha256_ni(uint32_t *h, const uint8_t *p, uint64_t nblocks) {
+        const __m128i shuf =
+            _mm_set_epi64x(0x0c0d0e0f08090a0bULL, 0x0405060700010203ULL);
+        __m128i tmp = _mm_loadu_si128((const __m128i *)&h[0]);
+        __m128i s1 = _mm_loadu_si128((const __m128i *)&h[4]);
+        __m128i s0;
+
+        tmp = _mm_shuffle_epi32(tmp, 0xb1);       /* CDAB */
+        s1 = _mm_shuffle_epi32(s1, 0x1b);         /* EFGH */
+        s0 = _mm_alignr_epi8(tmp, s1, 8);         /* ABEF */
+        s1 = _mm_blend_epi16(s1, tmp, 0xf0);      /* CDGH */
+
+        for (; nblocks; nblocks--, p += 64) {
+                __m128i abef = s0;
+                __m128i cdgh = s1;
+                __m128i m[4];
+
+                for (int g = 0; g < 16; g++) {
+                        if (g < 4)
+                                m[g] = _mm_shuffle_epi8(
+                                    _mm_loadu_si128(
+                                        (const __m128i *)(p + 16 * g)),
+                                    shuf);
+
+                        __m128i msg = _mm_add_epi32(
+                            m[g & 3],
+                            _mm_loadu_si128(
+                                (const __m128i *)&sha256_k[4 * g]));
+                        s1 = _mm_sha256rnds2_epu32(s1, s0, msg);
+
+                        if (g >= 3 && g <= 14) {
+                                __m128i next = _mm_add_epi32(
+                                    m[(g + 1) & 3],
+                                    _mm_alignr_epi8(m[g & 3],
+                                                    m[(g - 1) & 3], 4));
+                                m[(g + 1) & 3] =
+                                    _mm_sha256msg2_epu32(next, m[g & 3]);
+                        }
+
+                        msg = _mm_shuffle_epi32(msg, 0x0e);
+                        s0 = _mm_sha256rnds2_epu32(s0, s1, msg);
+
+                        if (g >= 1 && g <= 12)
+                                m[(g - 1) & 3] = _mm_sha256msg1_epu32(
+                                    m[(g - 1) & 3], m[g & 3]);
+                }
+
+                s0 = _mm_add_epi32(s0, abef);
+                s1 = _mm_add_epi32(s1, cdgh);
+        }
+
+        tmp = _mm_shuffle_epi32(s0, 0x1b);        /* FEBA */
+        s1 = _mm_shuffle_epi32(s1, 0xb1);         /* DCHG */
+        s0 = _mm_blend_epi16(tmp, s1, 0xf0);      /* DCBA */
+        s1 = _mm_alignr_epi8(s1, tmp, 8);         /* ABEF */
+
+        _mm_storeu_si128((__m128i *)&h[0], s0);
+        _mm_storeu_si128((__m128i *)&h[4], s1);
+}
+#endif
+
+static void __sha256_blocks(uint32_t *h, const uint8_t *p,
+                            uint64_t nblocks) {
+#ifdef DIGEST_X86
+        if (digest_has_sha) {
+                __sha256_ni(h, p, nblocks);
+                return;
+        }
+#endif
+        __sha256_sw(h, p, nblocks);
+}
+
+static void __sha256_update(struct digest_sha256 *s, const uint8_t *p,
+                            uint64_t n) {
+        s->total += n;
+
+        if (s->buffered) {
+                uint32_t take = 64 - s->buffered;
+
+                if (n < take) {
+                        memcpy(s->buf + s->buffered, p, n);
+                        s->buffered += n;
+                        return;
+                }
+
+                memcpy(s->buf + s->buffered, p, take);
+                __sha256_blocks(s->h, s->buf, 1);
+                s->buffered = 0;
+                p += take;
+                n -= take;
+        }
+
+        __sha256_blocks(s->h, p, n / 64);
+        memcpy(s->buf, p + (n & ~(uint64_t)63), n & 63);
+        s->buffered = n & 63;
+}
+
+static void __sha256_final(struct digest_sha256 *s, uint8_t *out) {
+        uint64_t bits = s->total * 8;
+        uint8_t pad[72];
+        uint32_t n = 64 - (s->buffered + 8) % 64;
+
+        memset(pad, 0, sizeof(pad));
+        pad[0] = 0x80;
+        for (int i = 0; i < 8; i++)
+                pad[n + i] = bits >> (56 - 8 * i);
+
+        uint64_t total = s->total;
+        __sha256_update(s, pad, n + 8);
+        s->total = total;
+
+        for (int i = 0; i < 8; i++) {
+                out[4 * i] = s->h[i] >> 24;
+                out[4 * i + 1] = s->h[i] >> 16;
+                out[4 * i + 2] = s->h[i] >> 8;
+                out[4 * i + 3] = s->h[i];
+        }
+}
+
+static const char *const digest_names[] = {
+        [DIGEST_CRC32C] = "crc32c",
+        [DIGEST_XXH64] = "xxh64",
+        [DIGEST_SHA256] = "sha256",
+};
+
+int digest_parse(const char *name) {
+        for (int i = 0; i < (int)(sizeof(digest_names) / sizeof(char *));
+             i++) {
+                if (strcmp(name, digest_names[i]) == 0)
+                        return i;
+        }
+        return -1;
+}
+
+const char *digest_name(int algo) {
+        return digest_names[algo];
+}
+
+const char *digest_impl(int algo) {
+        pthread_once(&digest_once, __digest_setup);
+
+        switch (algo) {
+        case DIGEST_CRC32C:
+                return digest_has_sse42 ? "sse4.2" : "slice-by-8";
+        case DIGEST_SHA256:
+                return digest_has_sha ? "sha-ni" : "generic";
+        default:
+                return "generic";
+        }
+}
+
+void digest_init(struct digest_ctx *c, int algo) {
+        static const uint32_t sha256_h0[8] = {
+                0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+                0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19,
+        };
+
+        pthread_once(&digest_once, __digest_setup);
+        memset(c, 0, sizeof(struct digest_ctx));
+        c->algo = algo;
+
+        if (algo == DIGEST_XXH64) {
+                c->u.xxh.v[0] = XXH_P1 + XXH_P2; /* seed 0 */
+                c->u.xxh.v[1] = XXH_P2;
+                c->u.xxh.v[2] = 0;
+                c->u.xxh.v[3] = -XXH_P1;
+        } else if (algo == DIGEST_SHA256) {
+                memcpy(c->u.sha.h, sha256_h0, sizeof(sha256_h0));
+        }
+}
+
+void digest_update(struct digest_ctx *c, const uint8_t *p, uint64_t n) {
+        switch (c->algo) {
+        case DIGEST_CRC32C:
+                c->u.crc = crc32c(c->u.crc, p, n);
+                break;
+        case DIGEST_XXH64:
+                __xxh64_update(&c->u.xxh, p, n);
+                break;
+        case DIGEST_SHA256:
+                __sha256_update(&c->u.sha, p, n);
+                break;
+        }
+}
+
+uint32_t digest_final(struct digest_ctx *c, uint8_t *out) {
+        uint64_t h;
+
+        switch (c->algo) {
+        case DIGEST_CRC32C:
+                for (int i = 0; i < 4; i++)
+                        out[i] = c->u.crc >> (24 - 8 * i);
+                return 4;
+        case DIGEST_XXH64:
+                h = __xxh64_final(&c->u.xxh);
+                for (int i = 0; i < 8; i++)
+                        out[i] = h >> (56 - 8 * i);
+                return 8;
+        default:
+                __sha256_final(&c->u.sha, out);
+                return 32;
+        }
+}
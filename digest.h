@@ -0,0 +1,67 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+/*
+ * Copyright (C) Fadhil Riyanto <me@fadev.org>
+ * --hash, CRC32C, XXH64 and SHA-256 with streaming updates
+ *
+ * the instruction set is picked once at run time: SSE4.2 crc32 for
+ * CRC32C and the SHA extensions for SHA-256, a portable version of
+ * each otherwise, XXH64 is plain C, its four lanes already keep the
+ * pipeline busy
+ *
+ * CRC32C of two pieces can be combined without the data, so one range
+ * may be hashed in parts on several threads
+ */
+
+#ifndef DIGEST_H
+#define DIGEST_H
+
+#include <stdint.h>
+
+#define DIGEST_MAX 32 /* bytes, SHA-256 */
+
+enum digest_algo {
+        DIGEST_CRC32C,
+        DIGEST_XXH64,
+        DIGEST_SHA256,
+};
+
+struct digest_xxh64 {
+        uint64_t v[4];
+        uint64_t total;
+        uint8_t buf[32];
+        uint32_t buffered;
+};
+
+struct digest_sha256 {
+        uint32_t h[8];
+        uint64_t total;
+        uint8_t buf[64];
+        uint32_t buffered;
+};
+
+struct digest_ctx {
+        int algo;
+        union {
+                uint32_t crc;
+                struct digest_xxh64 xxh;
+                struct digest_sha256 sha;
+        } u;
+};
+
+/* enum digest_algo by name, -1 when unknown */
+int digest_parse(const char *name);
+const char *digest_name(int algo);
+/* which implementation this CPU gets */
+const char *digest_impl(int algo);
+
+void digest_init(struct digest_ctx *c, int algo);
+void digest_update(struct digest_ctx *c, const uint8_t *p, uint64_t n);
+/* digest in big-endian order, returns its length in bytes */
+uint32_t digest_final(struct digest_ctx *c, uint8_t *out);
+
+/* CRC32C of data, continuing from crc (0 for a fresh one) */
+uint32_t crc32c(uint32_t crc, const uint8_t *p, uint64_t n);
+/* crc32c(A || B) from crc32c(A), crc32c(B) and the length of B */
+uint32_t crc32c_combine(uint32_t crc_a, uint32_t crc_b, uint64_t len_b);
+
+#endif /* DIGEST_H */
@@ -4,38 +4,77 @@
  */
 
 #include <errno.h>
-#define USE_PRETTY_PRINT_PAD_COUNT
-
+#define HEXDUMP_STREAM elf_out
+
+#include "ar_archive.h"
+#include "arena.h"
+#include "columnar.h"
+#include "dedup.h"
+#include "diff.h"
+#include "digest.h"
+#include "elf_cache.h"
+#include "elf_stats.h"
 #include "elf64_hexdump.h"
+#include "entropy.h"
 #include "getopt_custom.h"
 #include "hexdump.h"
+#include "interval.h"
+#include "json_writer.h"
+#include "libelfhexdump.h"
+#include "manifest.h"
+#include "map_lru.h"
 #include "print_pretty.h"
+#include "proc_maps.h"
+#include "rules.h"
+#include "search.h"
+#include "simhash.h"
+#include "size_report.h"
+#include "str_scan.h"
+#include "thread_pool.h"
 #include <asm-generic/errno-base.h>
+#include <dirent.h>
 #include <elf.h>
 #include <fcntl.h>
 #include <getopt.h>
 #include <inttypes.h>
+#include <limits.h>
+#include <signal.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
+#include <sys/inotify.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
 #include <sys/stat.h>
 #include <sys/types.h>
+#include <sys/un.h>
 #include <unistd.h>
 
 #define SIZE(x, y) sizeof(x) / sizeof(y)
 // #define EI_NIDENT 16
 #define FILE_BUFSIZE 4096 /* BYTES */
 
-enum ELF_arch_type {
-        ELF32,
-        ELF64,
-        NOT_ELF,
-        UNDEFINED_ARCH /* need triage */
-};
-
 static char elf_magic[5] = { 0x7F, 0x45, 0x4C, 0x46, 0x0 };
 
+/*
+ * every printer writes here, main thread points it at stdout, archive
+ * workers point it at their own per-member buffer
+ */
+static __thread FILE *elf_out;
+
+/* diagnostics, NULL means stderr, --serve sends them to the client */
+static __thread FILE *elf_err;
+#define ELF_ERR (elf_err ? elf_err : stderr)
+
+/*
+ * parse-time memory of the file being processed, owned by whoever runs
+ * the file (main, a batch or archive worker, a --serve connection) and
+ * released to a mark once the file is done
+ */
+static __thread struct arena *elf_arena;
+
 struct file_off_control {
         u_int64_t offset;
         int n;
@@ -51,1691 +90,8473 @@ static struct option long_options[] = {
         { "sh", 0, 0, GETOPT_CUSTOM_SECTION_HEADER },
         { "hexdump", 0, 0, GETOPT_CUSTOM_HEXDUMP },
         { "section", 1, 0, GETOPT_CUSTOM_LOOKUP_SECTION },
+        { "syms", 0, 0, GETOPT_CUSTOM_SYMBOLS },
+        { "build-id", 0, 0, GETOPT_CUSTOM_BUILD_ID },
+        { "jobs", 1, 0, GETOPT_CUSTOM_JOBS },
+        { "files-from", 1, 0, GETOPT_CUSTOM_FILES_FROM },
+        { "cache", 1, 0, GETOPT_CUSTOM_CACHE },
+        { "addr2sym", 1, 0, GETOPT_CUSTOM_ADDR2SYM },
+        { "bytes", 1, 0, GETOPT_CUSTOM_BYTES },
+        { "serve", 1, 0, GETOPT_CUSTOM_SERVE },
+        { "client", 1, 0, GETOPT_CUSTOM_CLIENT },
+        { "format", 1, 0, GETOPT_CUSTOM_FORMAT },
+        { "stats", 0, 0, GETOPT_CUSTOM_STATS },
+        { "populate", 0, 0, GETOPT_CUSTOM_POPULATE },
+        { "hugepage", 0, 0, GETOPT_CUSTOM_HUGEPAGE },
+        { "follow", 0, 0, GETOPT_CUSTOM_FOLLOW },
+        { "pid", 1, 0, GETOPT_CUSTOM_PID },
+        { "search", 1, 0, GETOPT_CUSTOM_SEARCH },
+        { "search-in", 1, 0, GETOPT_CUSTOM_SEARCH_IN },
+        { "rules", 1, 0, GETOPT_CUSTOM_RULES },
+        { "diff", 0, 0, GETOPT_CUSTOM_DIFF },
+        { "entropy", 0, 0, GETOPT_CUSTOM_ENTROPY },
+        { "entropy-block", 1, 0, GETOPT_CUSTOM_ENTROPY_BLOCK },
+        { "strings", 0, 0, GETOPT_CUSTOM_STRINGS },
+        { "strings-min", 1, 0, GETOPT_CUSTOM_STRINGS_MIN },
+        { "strings-enc", 1, 0, GETOPT_CUSTOM_STRINGS_ENC },
+        { "skip-debug", 0, 0, GETOPT_CUSTOM_SKIP_DEBUG },
+        { "hash", 1, 0, GETOPT_CUSTOM_HASH },
+        { "verify", 1, 0, GETOPT_CUSTOM_VERIFY },
+        { "dedup", 0, 0, GETOPT_CUSTOM_DEDUP },
+        { "simhash", 0, 0, GETOPT_CUSTOM_SIMHASH },
+        { "simhash-pairs", 1, 0, GETOPT_CUSTOM_SIMHASH_PAIRS },
+        { "size-report", 0, 0, GETOPT_CUSTOM_SIZE_REPORT },
+        { "size-baseline", 1, 0, GETOPT_CUSTOM_SIZE_BASELINE },
+        { "layout", 0, 0, GETOPT_CUSTOM_LAYOUT },
         NULL
 };
 
-__cold static void __debug_config(struct config *config) {
-        printf("config->filename: %s\n"
-               "config->show_header: %d\n"
-               "config->show_header_struct: %d\n"
-               "config->hexdump: %d\n"
-               "config->show_program_header: %d\n"
-               "config->lookup_section_name: %s\n",
-
-               config->filename, config->show_header,
-               config->show_header_struct, config->hexdump,
-               config->show_program_header, config->lookup_section_name);
-}
-
 void __print_process_elf_type(unsigned short e_type) {
         switch (e_type) {
         case ET_NONE:
-                printf("No file type (ET_NONE)");
+                fprintf(elf_out, "No file type (ET_NONE)");
                 break;
         case ET_REL:
-                printf("Relocatable file (ET_REL)");
+                fprintf(elf_out, "Relocatable file (ET_REL)");
                 break;
         case ET_EXEC:
-                printf("Executable file (ET_EXEC)");
+                fprintf(elf_out, "Executable file (ET_EXEC)");
                 break;
         case ET_DYN:
-                printf("Shared object file (ET_DYN)");
+                fprintf(elf_out, "Shared object file (ET_DYN)");
                 break;
         case ET_CORE:
-                printf("Core file (ET_CORE)");
+                fprintf(elf_out, "Core file (ET_CORE)");
                 break;
         case ET_NUM:
-                printf("Number of defined types (ET_NUM) - This should not be "
-                       "a real file type.");
+                fprintf(elf_out,
+                        "Number of defined types (ET_NUM) - This should not be "
+                        "a real file type.");
                 break;
         case ET_LOOS:
-                printf("OS-specific range start (ET_LOOS)");
+                fprintf(elf_out, "OS-specific range start (ET_LOOS)");
                 break;
         case ET_HIOS:
-                printf("OS-specific range end (ET_HIOS)");
+                fprintf(elf_out, "OS-specific range end (ET_HIOS)");
                 break;
         case ET_LOPROC:
-                printf("Processor-specific range start (ET_LOPROC)");
+                fprintf(elf_out, "Processor-specific range start (ET_LOPROC)");
                 break;
         case ET_HIPROC:
-                printf("Processor-specific range end (ET_HIPROC)");
+                fprintf(elf_out, "Processor-specific range end (ET_HIPROC)");
                 break;
         default:
                 // For OS-specific or Processor-specific types not explicitly
                 // listed, or unknown types within these ranges.
                 if (e_type >= ET_LOOS && e_type <= ET_HIOS) {
-                        printf("OS-specific type (0x%hx, within range "
-                               "0x%hx-0x%hx)",
-                               e_type, ET_LOOS, ET_HIOS);
+                        fprintf(elf_out,
+                                "OS-specific type (0x%hx, within range "
+                                "0x%hx-0x%hx)",
+                                e_type, ET_LOOS, ET_HIOS);
                 } else if (e_type >= ET_LOPROC && e_type <= ET_HIPROC) {
-                        printf("Processor-specific type (0x%hx, within range "
-                               "0x%hx-0x%hx)",
-                               e_type, ET_LOPROC, ET_HIPROC);
+                        fprintf(elf_out,
+                                "Processor-specific type (0x%hx, within range "
+                                "0x%hx-0x%hx)",
+                                e_type, ET_LOPROC, ET_HIPROC);
                 } else {
-                        printf("Unknown or reserved type (0x%hx)", e_type);
+                        fprintf(elf_out,
+                                "Unknown or reserved type (0x%hx)", e_type);
                 }
                 break;
         }
 }
 
-void __print_machine(int em) {
-        switch (em) {
-        case 0:
-                printf("No machine");
-                break;
-        case 1:
-                printf("AT&T WE 32100");
-                break;
-        case 2:
-                printf("SUN SPARC");
-                break;
-        case 3:
-                printf("Intel 80386");
-                break;
-        case 4:
-                printf("Motorola m68k family");
-                break;
-        case 5:
-                printf("Motorola m88k family");
-                break;
-        case 6:
-                printf("Intel MCU");
-                break;
-        case 7:
-                printf("Intel 80860");
-                break;
-        case 8:
-                printf("MIPS R3000 big-endian");
-                break;
-        case 9:
-                printf("IBM System/370");
-                break;
-        case 10:
-                printf("MIPS R3000 little-endian");
-                break;
-        case 15:
-                printf("HPPA");
-                break;
-        case 17:
-                printf("Fujitsu VPP500");
-                break;
-        case 18:
-                printf("Sun's \"v8plus\"");
-                break;
-        case 19:
-                printf("Intel 80960");
-                break;
-        case 20:
-                printf("PowerPC");
-                break;
-        case 21:
-                printf("PowerPC 64-bit");
-                break;
-        case 22:
-                printf("IBM S390");
-                break;
-        case 23:
-                printf("IBM SPU/SPC");
-                break;
-        case 36:
-                printf("NEC V800 series");
-                break;
-        case 37:
-                printf("Fujitsu FR20");
-                break;
-        case 38:
-                printf("TRW RH-32");
-                break;
-        case 39:
-                printf("Motorola RCE");
-                break;
-        case 40:
-                printf("ARM");
-                break;
-        case 41:
-                printf("Digital Alpha");
-                break;
-        case 42:
-                printf("Hitachi SH");
-                break;
-        case 43:
-                printf("SPARC v9 64-bit");
-                break;
-        case 44:
-                printf("Siemens Tricore");
-                break;
-        case 45:
-                printf("Argonaut RISC Core");
-                break;
-        case 46:
-                printf("Hitachi H8/300");
-                break;
-        case 47:
-                printf("Hitachi H8/300H");
-                break;
-        case 48:
-                printf("Hitachi H8S");
-                break;
-        case 49:
-                printf("Hitachi H8/500");
-                break;
-        case 50:
-                printf("Intel Merced");
-                break;
-        case 51:
-                printf("Stanford MIPS-X");
-                break;
-        case 52:
-                printf("Motorola Coldfire");
-                break;
-        case 53:
-                printf("Motorola M68HC12");
-                break;
-        case 54:
-                printf("Fujitsu MMA Multimedia Accelerator");
-                break;
-        case 55:
-                printf("Siemens PCP");
-                break;
-        case 56:
-                printf("Sony nCPU embedded RISC");
-                break;
-        case 57:
-                printf("Denso NDR1 microprocessor");
-                break;
-        case 58:
-                printf("Motorola Start*Core processor");
-                break;
-        case 59:
-                printf("Toyota ME16 processor");
-                break;
-        case 60:
-                printf("STMicroelectronic ST100 processor");
-                break;
-        case 61:
-                printf("Advanced Logic Corp. Tinyj emb.fam");
-                break;
-        case 62:
-                printf("AMD x86-64 architecture");
-                break;
-        case 63:
-                printf("Sony DSP Processor");
-                break;
-        case 64:
-                printf("Digital PDP-10");
-                break;
-        case 65:
-                printf("Digital PDP-11");
-                break;
-        case 66:
-                printf("Siemens FX66 microcontroller");
-                break;
-        case 67:
-                printf("STMicroelectronics ST9+ 8/16 mc");
-                break;
-        case 68:
-                printf("STmicroelectronics ST7 8 bit mc");
-                break;
-        case 69:
-                printf("Motorola MC68HC16 microcontroller");
-                break;
-        case 70:
-                printf("Motorola MC68HC11 microcontroller");
-                break;
-        case 71:
-                printf("Motorola MC68HC08 microcontroller");
-                break;
-        case 72:
-                printf("Motorola MC68HC05 microcontroller");
-                break;
-        case 73:
-                printf("Silicon Graphics SVx");
-                break;
-        case 74:
-                printf("STMicroelectronics ST19 8 bit mc");
-                break;
-        case 75:
-                printf("Digital VAX");
-                break;
-        case 76:
-                printf("Axis Communications 32-bit emb.proc");
-                break;
-        case 77:
-                printf("Infineon Technologies 32-bit emb.proc");
-                break;
-        case 78:
-                printf("Element 14 64-bit DSP Processor");
-                break;
-        case 79:
-                printf("LSI Logic 16-bit DSP Processor");
-                break;
-        case 80:
-                printf("Donald Knuth's educational 64-bit proc");
-                break;
-        case 81:
-                printf("Harvard University machine-independent object files");
-                break;
-        case 82:
-                printf("SiTera Prism");
-                break;
-        case 83:
-                printf("Atmel AVR 8-bit microcontroller");
-                break;
-        case 84:
-                printf("Fujitsu FR30");
-                break;
-        case 85:
-                printf("Mitsubishi D10V");
-                break;
-        case 86:
-                printf("Mitsubishi D30V");
-                break;
-        case 87:
-                printf("NEC v850");
-                break;
-        case 88:
-                printf("Mitsubishi M32R");
-                break;
-        case 89:
-                printf("Matsushita MN10300");
-                break;
-        case 90:
-                printf("Matsushita MN10200");
-                break;
-        case 91:
-                printf("picoJava");
-                break;
-        case 92:
-                printf("OpenRISC 32-bit embedded processor");
-                break;
-        case 93:
-                printf("ARC International ARCompact");
-                break;
-        case 94:
-                printf("Tensilica Xtensa Architecture");
-                break;
-        case 95:
-                printf("Alphamosaic VideoCore");
-                break;
-        case 96:
-                printf("Thompson Multimedia General Purpose Proc");
-                break;
-        case 97:
-                printf("National Semi. 32000");
-                break;
-        case 98:
-                printf("Tenor Network TPC");
-                break;
-        case 99:
-                printf("Trebia SNP 1000");
-                break;
-        case 100:
-                printf("STMicroelectronics ST200");
-                break;
-        case 101:
-                printf("Ubicom IP2xxx");
-                break;
-        case 102:
-                printf("MAX processor");
-                break;
-        case 103:
-                printf("National Semi. CompactRISC");
-                break;
-        case 104:
-                printf("Fujitsu F2MC16");
-                break;
-        case 105:
-                printf("Texas Instruments msp430");
-                break;
-        case 106:
-                printf("Analog Devices Blackfin DSP");
-                break;
-        case 107:
-                printf("Seiko Epson S1C33 family");
-                break;
-        case 108:
-                printf("Sharp embedded microprocessor");
-                break;
-        case 109:
-                printf("Arca RISC");
-                break;
-        case 110:
-                printf("PKU-Unity & MPRC Peking Uni. mc series");
-                break;
-        case 111:
-                printf("eXcess configurable cpu");
-                break;
-        case 112:
-                printf("Icera Semi. Deep Execution Processor");
-                break;
-        case 113:
-                printf("Altera Nios II");
-                break;
-        case 114:
-                printf("National Semi. CompactRISC CRX");
-                break;
-        case 115:
-                printf("Motorola XGATE");
-                break;
-        case 116:
-                printf("Infineon C16x/XC16x");
-                break;
-        case 117:
-                printf("Renesas M16C");
-                break;
-        case 118:
-                printf("Microchip Technology dsPIC30F");
-                break;
-        case 119:
-                printf("Freescale Communication Engine RISC");
-                break;
-        case 120:
-                printf("Renesas M32C");
-                break;
-        case 131:
-                printf("Altium TSK3000");
-                break;
-        case 132:
-                printf("Freescale RS08");
-                break;
-        case 133:
-                printf("Analog Devices SHARC family");
-                break;
-        case 134:
-                printf("Cyan Technology eCOG2");
-                break;
-        case 135:
-                printf("Sunplus S+core7 RISC");
-                break;
-        case 136:
-                printf("New Japan Radio (NJR) 24-bit DSP");
-                break;
-        case 137:
-                printf("Broadcom VideoCore III");
-                break;
-        case 138:
-                printf("RISC for Lattice FPGA");
-                break;
-        case 139:
-                printf("Seiko Epson C17");
-                break;
-        case 140:
-                printf("Texas Instruments TMS320C6000 DSP");
-                break;
-        case 141:
-                printf("Texas Instruments TMS320C2000 DSP");
-                break;
-        case 142:
-                printf("Texas Instruments TMS320C55x DSP");
-                break;
-        case 143:
-                printf("Texas Instruments App. Specific RISC");
-                break;
-        case 144:
-                printf("Texas Instruments Prog. Realtime Unit");
-                break;
-        case 160:
-                printf("STMicroelectronics 64bit VLIW DSP");
-                break;
-        case 161:
-                printf("Cypress M8C");
-                break;
-        case 162:
-                printf("Renesas R32C");
-                break;
-        case 163:
-                printf("NXP Semi. TriMedia");
-                break;
-        case 164:
-                printf("QUALCOMM DSP6");
-                break;
-        case 165:
-                printf("Intel 8051 and variants");
-                break;
-        case 166:
-                printf("STMicroelectronics STxP7x");
-                break;
-        case 167:
-                printf("Andes Tech. compact code emb. RISC");
-                break;
-        case 168:
-                printf("Cyan Technology eCOG1X");
-                break;
-        case 169:
-                printf("Dallas Semi. MAXQ30 mc");
-                break;
-        case 170:
-                printf("New Japan Radio (NJR) 16-bit DSP");
-                break;
-        case 171:
-                printf("M2000 Reconfigurable RISC");
-                break;
-        case 172:
-                printf("Cray NV2 vector architecture");
-                break;
-        case 173:
-                printf("Renesas RX");
-                break;
-        case 174:
-                printf("Imagination Tech. META");
-                break;
-        case 175:
-                printf("MCST Elbrus");
-                break;
-        case 176:
-                printf("Cyan Technology eCOG16");
-                break;
-        case 177:
-                printf("National Semi. CompactRISC CR16");
-                break;
-        case 178:
-                printf("Freescale Extended Time Processing Unit");
-                break;
-        case 179:
-                printf("Infineon Tech. SLE9X");
-                break;
-        case 180:
-                printf("Intel L10M");
-                break;
-        case 181:
-                printf("Intel K10M");
-                break;
-        case 183:
-                printf("ARM AARCH64");
-                break;
-        case 185:
-                printf("Amtel 32-bit microprocessor");
-                break;
-        case 186:
-                printf("STMicroelectronics STM8");
-                break;
-        case 187:
-                printf("Tilera TILE64");
-                break;
-        case 188:
-                printf("Tilera TILEPro");
-                break;
-        case 189:
-                printf("Xilinx MicroBlaze");
-                break;
-        case 190:
-                printf("NVIDIA CUDA");
-                break;
-        case 191:
-                printf("Tilera TILE-Gx");
-                break;
-        case 192:
-                printf("CloudShield");
-                break;
-        case 193:
-                printf("KIPO-KAIST Core-A 1st gen.");
-                break;
-        case 194:
-                printf("KIPO-KAIST Core-A 2nd gen.");
-                break;
-        case 195:
-                printf("Synopsys ARCv2 ISA.");
-                break;
-        case 196:
-                printf("Open8 RISC");
-                break;
-        case 197:
-                printf("Renesas RL78");
-                break;
-        case 198:
-                printf("Broadcom VideoCore V");
-                break;
-        case 199:
-                printf("Renesas 78KOR");
-                break;
-        case 200:
-                printf("Freescale 56800EX DSC");
-                break;
-        case 201:
-                printf("Beyond BA1");
-                break;
-        case 202:
-                printf("Beyond BA2");
-                break;
-        case 203:
-                printf("XMOS xCORE");
-                break;
-        case 204:
-                printf("Microchip 8-bit PIC(r)");
-                break;
-        case 205:
-                printf("Intel Graphics Technology");
-                break;
-        case 210:
-                printf("KM211 KM32");
-                break;
-        case 211:
-                printf("KM211 KMX32");
-                break;
-        case 212:
-                printf("KM211 KMX16");
-                break;
-        case 213:
-                printf("KM211 KMX8");
-                break;
-        case 214:
-                printf("KM211 KVARC");
-                break;
-        case 215:
-                printf("Paneve CDP");
-                break;
-        case 216:
-                printf("Cognitive Smart Memory Processor");
-                break;
-        case 217:
-                printf("Bluechip CoolEngine");
-                break;
-        case 218:
-                printf("Nanoradio Optimized RISC");
-                break;
-        case 219:
-                printf("CSR Kalimba");
-                break;
-        case 220:
-                printf("Zilog Z80");
-                break;
-        case 221:
-                printf("Controls and Data Services VISIUMcore");
-                break;
-        case 222:
-                printf("FTDI Chip FT32");
-                break;
-        case 223:
-                printf("Moxie processor");
-                break;
-        case 224:
-                printf("AMD GPU");
-                break;
-        case 243:
-                printf("RISC-V");
-                break;
-        case 247:
-                printf("Linux BPF -- in-kernel virtual machine");
-                break;
-        case 252:
-                printf("C-SKY");
-                break;
-        case 258:
-                printf("LoongArch");
-                break;
-        default:
-                printf("Unknown machine");
-                break;
-        }
+/* e_machine names, indexed by value, NULL where unassigned */
+static const char *const __machine_names[] = {
+        [0] = "No machine",
+        [1] = "AT&T WE 32100",
+        [2] = "SUN SPARC",
+        [3] = "Intel 80386",
+        [4] = "Motorola m68k family",
+        [5] = "Motorola m88k family",
+        [6] = "Intel MCU",
+        [7] = "Intel 80860",
+        [8] = "MIPS R3000 big-endian",
+        [9] = "IBM System/370",
+        [10] = "MIPS R3000 little-endian",
+        [15] = "HPPA",
+        [17] = "Fujitsu VPP500",
+        [18] = "Sun's \"v8plus\"",
+        [19] = "Intel 80960",
+        [20] = "PowerPC",
+        [21] = "PowerPC 64-bit",
+        [22] = "IBM S390",
+        [23] = "IBM SPU/SPC",
+        [36] = "NEC V800 series",
+        [37] = "Fujitsu FR20",
+        [38] = "TRW RH-32",
+        [39] = "Motorola RCE",
+        [40] = "ARM",
+        [41] = "Digital Alpha",
+        [42] = "Hitachi SH",
+        [43] = "SPARC v9 64-bit",
+        [44] = "Siemens Tricore",
+        [45] = "Argonaut RISC Core",
+        [46] = "Hitachi H8/300",
+        [47] = "Hitachi H8/300H",
+        [48] = "Hitachi H8S",
+        [49] = "Hitachi H8/500",
+        [50] = "Intel Merced",
+        [51] = "Stanford MIPS-X",
+        [52] = "Motorola Coldfire",
+        [53] = "Motorola M68HC12",
+        [54] = "Fujitsu MMA Multimedia Accelerator",
+        [55] = "Siemens PCP",
+        [56] = "Sony nCPU embedded RISC",
+        [57] = "Denso NDR1 microprocessor",
+        [58] = "Motorola Start*Core processor",
+        [59] = "Toyota ME16 processor",
+        [60] = "STMicroelectronic ST100 processor",
+        [61] = "Advanced Logic Corp. Tinyj emb.fam",
+        [62] = "AMD x86-64 architecture",
+        [63] = "Sony DSP Processor",
+        [64] = "Digital PDP-10",
+        [65] = "Digital PDP-11",
+        [66] = "Siemens FX66 microcontroller",
+        [67] = "STMicroelectronics ST9+ 8/16 mc",
+        [68] = "STmicroelectronics ST7 8 bit mc",
+        [69] = "Motorola MC68HC16 microcontroller",
+        [70] = "Motorola MC68HC11 microcontroller",
+        [71] = "Motorola MC68HC08 microcontroller",
+        [72] = "Motorola MC68HC05 microcontroller",
+        [73] = "Silicon Graphics SVx",
+        [74] = "STMicroelectronics ST19 8 bit mc",
+        [75] = "Digital VAX",
+        [76] = "Axis Communications 32-bit emb.proc",
+        [77] = "Infineon Technologies 32-bit emb.proc",
+        [78] = "Element 14 64-bit DSP Processor",
+        [79] = "LSI Logic 16-bit DSP Processor",
+        [80] = "Donald Knuth's educational 64-bit proc",
+        [81] = "Harvard University machine-independent object files",
+        [82] = "SiTera Prism",
+        [83] = "Atmel AVR 8-bit microcontroller",
+        [84] = "Fujitsu FR30",
+        [85] = "Mitsubishi D10V",
+        [86] = "Mitsubishi D30V",
+        [87] = "NEC v850",
+        [88] = "Mitsubishi M32R",
+        [89] = "Matsushita MN10300",
+        [90] = "Matsushita MN10200",
+        [91] = "picoJava",
+        [92] = "OpenRISC 32-bit embedded processor",
+        [93] = "ARC International ARCompact",
+        [94] = "Tensilica Xtensa Architecture",
+        [95] = "Alphamosaic VideoCore",
+        [96] = "Thompson Multimedia General Purpose Proc",
+        [97] = "National Semi. 32000",
+        [98] = "Tenor Network TPC",
+        [99] = "Trebia SNP 1000",
+        [100] = "STMicroelectronics ST200",
+        [101] = "Ubicom IP2xxx",
+        [102] = "MAX processor",
+        [103] = "National Semi. CompactRISC",
+        [104] = "Fujitsu F2MC16",
+        [105] = "Texas Instruments msp430",
+        [106] = "Analog Devices Blackfin DSP",
+        [107] = "Seiko Epson S1C33 family",
+        [108] = "Sharp embedded microprocessor",
+        [109] = "Arca RISC",
+        [110] = "PKU-Unity & MPRC Peking Uni. mc series",
+        [111] = "eXcess configurable cpu",
+        [112] = "Icera Semi. Deep Execution Processor",
+        [113] = "Altera Nios II",
+        [114] = "National Semi. CompactRISC CRX",
+        [115] = "Motorola XGATE",
+        [116] = "Infineon C16x/XC16x",
+        [117] = "Renesas M16C",
+        [118] = "Microchip Technology dsPIC30F",
+        [119] = "Freescale Communication Engine RISC",
+        [120] = "Renesas M32C",
+        [131] = "Altium TSK3000",
+        [132] = "Freescale RS08",
+        [133] = "Analog Devices SHARC family",
+        [134] = "Cyan Technology eCOG2",
+        [135] = "Sunplus S+core7 RISC",
+        [136] = "New Japan Radio (NJR) 24-bit DSP",
+        [137] = "Broadcom VideoCore III",
+        [138] = "RISC for Lattice FPGA",
+        [139] = "Seiko Epson C17",
+        [140] = "Texas Instruments TMS320C6000 DSP",
+        [141] = "Texas Instruments TMS320C2000 DSP",
+        [142] = "Texas Instruments TMS320C55x DSP",
+        [143] = "Texas Instruments App. Specific RISC",
+        [144] = "Texas Instruments Prog. Realtime Unit",
+        [160] = "STMicroelectronics 64bit VLIW DSP",
+        [161] = "Cypress M8C",
+        [162] = "Renesas R32C",
+        [163] = "NXP Semi. TriMedia",
+        [164] = "QUALCOMM DSP6",
+        [165] = "Intel 8051 and variants",
+        [166] = "STMicroelectronics STxP7x",
+        [167] = "Andes Tech. compact code emb. RISC",
+        [168] = "Cyan Technology eCOG1X",
+        [169] = "Dallas Semi. MAXQ30 mc",
+        [170] = "New Japan Radio (NJR) 16-bit DSP",
+        [171] = "M2000 Reconfigurable RISC",
+        [172] = "Cray NV2 vector architecture",
+        [173] = "Renesas RX",
+        [174] = "Imagination Tech. META",
+        [175] = "MCST Elbrus",
+        [176] = "Cyan Technology eCOG16",
+        [177] = "National Semi. CompactRISC CR16",
+        [178] = "Freescale Extended Time Processing Unit",
+        [179] = "Infineon Tech. SLE9X",
+        [180] = "Intel L10M",
+        [181] = "Intel K10M",
+        [183] = "ARM AARCH64",
+        [185] = "Amtel 32-bit microprocessor",
+        [186] = "STMicroelectronics STM8",
+        [187] = "Tilera TILE64",
+        [188] = "Tilera TILEPro",
+        [189] = "Xilinx MicroBlaze",
+        [190] = "NVIDIA CUDA",
+        [191] = "Tilera TILE-Gx",
+        [192] = "CloudShield",
+        [193] = "KIPO-KAIST Core-A 1st gen.",
+        [194] = "KIPO-KAIST Core-A 2nd gen.",
+        [195] = "Synopsys ARCv2 ISA.",
+        [196] = "Open8 RISC",
+        [197] = "Renesas RL78",
+        [198] = "Broadcom VideoCore V",
+        [199] = "Renesas 78KOR",
+        [200] = "Freescale 56800EX DSC",
+        [201] = "Beyond BA1",
+        [202] = "Beyond BA2",
+        [203] = "XMOS xCORE",
+        [204] = "Microchip 8-bit PIC(r)",
+        [205] = "Intel Graphics Technology",
+        [210] = "KM211 KM32",
+        [211] = "KM211 KMX32",
+        [212] = "KM211 KMX16",
+        [213] = "KM211 KMX8",
+        [214] = "KM211 KVARC",
+        [215] = "Paneve CDP",
+        [216] = "Cognitive Smart Memory Processor",
+        [217] = "Bluechip CoolEngine",
+        [218] = "Nanoradio Optimized RISC",
+        [219] = "CSR Kalimba",
+        [220] = "Zilog Z80",
+        [221] = "Controls and Data Services VISIUMcore",
+        [222] = "FTDI Chip FT32",
+        [223] = "Moxie processor",
+        [224] = "AMD GPU",
+        [243] = "RISC-V",
+        [247] = "Linux BPF -- in-kernel virtual machine",
+        [252] = "C-SKY",
+        [258] = "LoongArch",
+};
+
+/* NULL when the machine has no name */
+static const char *__machine_name(Elf64_Half em) {
+        if (em >= SIZE(__machine_names, __machine_names[0]))
+                return NULL;
+
+        return __machine_names[em];
 }
 
 void __print_elf_version(unsigned int elf_version) {
         switch (elf_version) {
         case EV_NONE:
-                printf("ELF Version: EV_NONE (Invalid ELF version)\n");
+                fprintf(elf_out,
+                        "ELF Version: EV_NONE (Invalid ELF version)\n");
                 break;
         case EV_CURRENT:
-                printf("ELF Version: EV_CURRENT (Current version)\n");
+                fprintf(elf_out, "ELF Version: EV_CURRENT (Current version)\n");
                 break;
         case EV_NUM:
                 // EV_NUM is typically used to indicate the count of valid
                 // versions, not a valid version itself.
-                printf("ELF Version: EV_NUM (Number of defined versions - not "
-                       "a valid version identifier)\n");
+                fprintf(elf_out,
+                        "ELF Version: EV_NUM (Number of defined versions - not "
+                        "a valid version identifier)\n");
                 break;
         default:
-                printf("ELF Version: Unknown or reserved version (0x%x)\n",
-                       elf_version);
+                fprintf(elf_out,
+                        "ELF Version: Unknown or reserved version (0x%x)\n",
+                        elf_version);
                 break;
         }
 }
 
-void __print_elf_section_header_type(Elf64_Word sh_type) {
-        switch (sh_type) {
-        case 0:
-                PRINT_PRETTY("NULL", 4, 18);
-                break;
-        case SHT_PROGBITS:
-                PRINT_PRETTY("PROGBITS", 8, 18);
-                break;
-        case SHT_SYMTAB:
-                PRINT_PRETTY("SYMTAB", 6, 18);
-                break;
-        case SHT_STRTAB:
-                PRINT_PRETTY("STRTAB", 6, 18);
-                break;
-        case SHT_RELA:
-                PRINT_PRETTY("RELA", 4, 18);
-                break;
-        case SHT_HASH:
-                PRINT_PRETTY("HASH", 4, 18);
-                break;
-        case SHT_DYNAMIC:
-                PRINT_PRETTY("DYNAMIC", 7, 18);
-                break;
-        case SHT_NOTE:
-                PRINT_PRETTY("NOTE", 4, 18);
-                break;
-        case SHT_NOBITS:
-                PRINT_PRETTY("NOBITS", 6, 18);
-                break;
-        case SHT_REL:
-                PRINT_PRETTY("REL", 3, 18);
-                break;
-        case SHT_SHLIB:
-                PRINT_PRETTY("SHLIB", 5, 18);
-                break;
-        case SHT_DYNSYM:
-                PRINT_PRETTY("DYNSYM", 6, 18);
-                break;
-        case SHT_INIT_ARRAY:
-                PRINT_PRETTY("INIT_ARRAY", 10, 18);
-                break;
-        case SHT_FINI_ARRAY:
-                PRINT_PRETTY("FINI_ARRAY", 10, 18);
-                break;
-        case SHT_PREINIT_ARRAY:
-                PRINT_PRETTY("PREINIT_ARRAY", 13, 18);
-                break;
-        case SHT_GROUP:
-                PRINT_PRETTY("GROUP", 5, 18);
-                break;
-        case SHT_SYMTAB_SHNDX:
-                PRINT_PRETTY("SYMTAB_SHNDX", 12, 18);
-                break;
-        case SHT_RELR:
-                PRINT_PRETTY("RELR", 4, 18);
-                break;
-        case SHT_NUM:
-                PRINT_PRETTY("NUM", 3, 18);
-                break;
-        case SHT_LOOS:
-                PRINT_PRETTY("LOOS", 4, 18);
-                break;
-        case SHT_GNU_ATTRIBUTES:
-                PRINT_PRETTY("GNU_ATTRIBUTES", 14, 18);
-                break;
-        case SHT_GNU_HASH:
-                PRINT_PRETTY("GNU_HASH", 8, 18);
-                break;
-        case SHT_GNU_LIBLIST:
-                PRINT_PRETTY("GNU_LIBLIST", 11, 18);
-                break;
-        case SHT_CHECKSUM:
-                PRINT_PRETTY("CHECKSUM", 8, 18);
-                break;
-        case SHT_LOSUNW:
-                PRINT_PRETTY("LOSUNW", 6, 18);
-                break;
-        // case SHT_SUNW_move:
-        //         PRINT_PRETTY("SUNW_move", 9, 18);
-        //         break;
-        case SHT_SUNW_COMDAT:
-                PRINT_PRETTY("SUNW_COMDAT", 11, 18);
-                break;
-        case SHT_SUNW_syminfo:
-                PRINT_PRETTY("SUNW_syminfo", 13, 18);
-                break;
-        case SHT_GNU_verdef:
-                PRINT_PRETTY("GNU_verdef", 10, 18);
-                break;
-        case SHT_GNU_verneed:
-                PRINT_PRETTY("GNU_verneed", 11, 18);
-                break;
-        case SHT_GNU_versym:
-                PRINT_PRETTY("GNU_versym", 10, 18);
-                break;
-        // case SHT_HISUNW:
-        //         PRINT_PRETTY("HISUNW", 6, 18);
-        //         break;
-        // case SHT_HIOS:
-        //         PRINT_PRETTY("HIOS", 4, 18);
-        //         break;
-        case SHT_LOPROC:
-                PRINT_PRETTY("LOPROC", 6, 18);
-                break;
-        case SHT_HIPROC:
-                PRINT_PRETTY("HIPROC", 6, 18);
-                break;
-        case SHT_LOUSER:
-                PRINT_PRETTY("LOUSER", 6, 18);
-                break;
-        case SHT_HIUSER:
-                PRINT_PRETTY("HIUSER", 6, 18);
-                break;
-        default:
-                PRINT_PRETTY("Unknown SHT type", 17, 18);
-                break;
+/* first match of value, NULL if none */
+static const char *__elf_name_find(const struct elf_name *names, size_t n,
+                                   Elf64_Word value) {
+        for (size_t i = 0; i < n; i++) {
+                if (names[i].value == value)
+                        return names[i].name;
         }
+
+        return NULL;
 }
 
-__cold static void __print_elf64_hdr(Elf64_Ehdr *ehdr, struct config *config) {
+static const char *const __sh_type_names[] = {
+        [SHT_NULL] = "NULL",
+        [SHT_PROGBITS] = "PROGBITS",
+        [SHT_SYMTAB] = "SYMTAB",
+        [SHT_STRTAB] = "STRTAB",
+        [SHT_RELA] = "RELA",
+        [SHT_HASH] = "HASH",
+        [SHT_DYNAMIC] = "DYNAMIC",
+        [SHT_NOTE] = "NOTE",
+        [SHT_NOBITS] = "NOBITS",
+        [SHT_REL] = "REL",
+        [SHT_SHLIB] = "SHLIB",
+        [SHT_DYNSYM] = "DYNSYM",
+        [SHT_INIT_ARRAY] = "INIT_ARRAY",
+        [SHT_FINI_ARRAY] = "FINI_ARRAY",
+        [SHT_PREINIT_ARRAY] = "PREINIT_ARRAY",
+        [SHT_GROUP] = "GROUP",
+        [SHT_SYMTAB_SHNDX] = "SYMTAB_SHNDX",
+        [SHT_RELR] = "RELR",
+        [SHT_NUM] = "NUM",
+};
+
+/* OS, processor and user ranges, too sparse for an index */
+static const struct elf_name __sh_type_os_names[] = {
+        {SHT_LOOS, "LOOS"},
+        {SHT_GNU_ATTRIBUTES, "GNU_ATTRIBUTES"},
+        {SHT_GNU_HASH, "GNU_HASH"},
+        {SHT_GNU_LIBLIST, "GNU_LIBLIST"},
+        {SHT_CHECKSUM, "CHECKSUM"},
+        {SHT_LOSUNW, "LOSUNW"},
+        {SHT_SUNW_COMDAT, "SUNW_COMDAT"},
+        {SHT_SUNW_syminfo, "SUNW_syminfo"},
+        {SHT_GNU_verdef, "GNU_verdef"},
+        {SHT_GNU_verneed, "GNU_verneed"},
+        {SHT_GNU_versym, "GNU_versym"},
+        {SHT_LOPROC, "LOPROC"},
+        {SHT_HIPROC, "HIPROC"},
+        {SHT_LOUSER, "LOUSER"},
+        {SHT_HIUSER, "HIUSER"},
+};
+
+/* NULL when the type has no name */
+static const char *__sh_type_name(Elf64_Word sh_type) {
+        if (sh_type < SIZE(__sh_type_names, __sh_type_names[0]))
+                return __sh_type_names[sh_type];
+
+        return __elf_name_find(__sh_type_os_names,
+                               SIZE(__sh_type_os_names, struct elf_name),
+                               sh_type);
+}
+
+/*
+ * ELF32 headers come widened from the library, values are the same,
+ * only the class label differs
+ */
+__cold static void __print_elf_hdr(struct ehd_file *elf,
+                                   struct config *config) {
+        const Elf64_Ehdr *ehdr = ehd_header(elf);
+
         if (config->show_header_struct == 1) {
-                printf("{\n");
-                printf("  e_ident = ");
+                fprintf(elf_out, "{\n");
+                fprintf(elf_out, "  e_ident = ");
                 VT_SIMPLE_HEXDUMP(ehdr->e_ident, 16);
-                printf("\n");
-                printf("  e_type = %hu,\n", ehdr->e_type);
-                printf("  e_machine = %u,\n", ehdr->e_machine);
-                printf("  e_version = 0x%x,\n", ehdr->e_version);
-                printf("  e_entry = 0x%016" PRIx64 "\n", ehdr->e_entry);
-                printf("  e_phoff = 0x%016" PRIx64 "\n", ehdr->e_phoff);
-                printf("  e_shoff = 0x%016" PRIx64 "\n", ehdr->e_shoff);
-                printf("  e_flags = 0x%x,\n", ehdr->e_flags);
-                printf("  e_ehsize = %" PRIu16 ",\n", ehdr->e_ehsize);
-                printf("  e_phentsize = %" PRIu16 ",\n", ehdr->e_phentsize);
-                printf("  e_phnum = %" PRIu16 ",\n", ehdr->e_phnum);
-                printf("  e_shentsize = %" PRIu16 ",\n", ehdr->e_shentsize);
-                printf("  e_shnum = %" PRIu16 ",\n", ehdr->e_shnum);
-                printf("  e_shstrndx = %" PRIu16 ",\n", ehdr->e_shstrndx);
-                printf("}\n");
+                fprintf(elf_out, "\n");
+                fprintf(elf_out, "  e_type = %hu,\n", ehdr->e_type);
+                fprintf(elf_out, "  e_machine = %u,\n", ehdr->e_machine);
+                fprintf(elf_out, "  e_version = 0x%x,\n", ehdr->e_version);
+                fprintf(elf_out,
+                        "  e_entry = 0x%016" PRIx64 "\n", ehdr->e_entry);
+                fprintf(elf_out,
+                        "  e_phoff = 0x%016" PRIx64 "\n", ehdr->e_phoff);
+                fprintf(elf_out,
+                        "  e_shoff = 0x%016" PRIx64 "\n", ehdr->e_shoff);
+                fprintf(elf_out, "  e_flags = 0x%x,\n", ehdr->e_flags);
+                fprintf(elf_out, "  e_ehsize = %" PRIu16 ",\n", ehdr->e_ehsize);
+                fprintf(elf_out,
+                        "  e_phentsize = %" PRIu16 ",\n", ehdr->e_phentsize);
+                fprintf(elf_out, "  e_phnum = %" PRIu16 ",\n", ehdr->e_phnum);
+                fprintf(elf_out,
+                        "  e_shentsize = %" PRIu16 ",\n", ehdr->e_shentsize);
+                fprintf(elf_out, "  e_shnum = %" PRIu16 ",\n", ehdr->e_shnum);
+                fprintf(elf_out,
+                        "  e_shstrndx = %" PRIu16 ",\n", ehdr->e_shstrndx);
+                fprintf(elf_out, "}\n");
 
                 return;
         } else if (config->show_header == 1) {
-                printf("ELF64 class\n");
+                fprintf(elf_out, "%s class\n",
+                        ehd_class(elf) == ELFCLASS64 ? "ELF64" : "ELF32");
 
-                printf("\tType\t\t\t\t");
+                fprintf(elf_out, "\tType\t\t\t\t");
                 __print_process_elf_type(ehdr->e_type);
-                printf("\n");
+                fprintf(elf_out, "\n");
 
-                printf("\tMachine\t\t\t\t");
-                __print_machine(ehdr->e_machine);
-                printf("\n");
+                const char *machine = __machine_name(ehdr->e_machine);
 
-                printf("\tVersion\t\t\t\t");
+                fprintf(elf_out, "\tMachine\t\t\t\t%s\n",
+                        machine ? machine : "Unknown machine");
+
+                fprintf(elf_out, "\tVersion\t\t\t\t");
                 __print_elf_version(ehdr->e_version);
 
-                printf("\tEntry point address\t\t0x%016" PRIx64 "\n",
-                       ehdr->e_entry);
-                printf("\tStart of program headers\t%" PRIu64
-                       " (bytes into file)\n",
-                       ehdr->e_phoff);
-                printf("\tStart of section headers\t%" PRIu64
-                       " (bytes into file)\n",
-                       ehdr->e_shoff);
-                printf("\tFlags\t\t\t\t0x%x\n", ehdr->e_flags);
-                printf("\tSize of this header\t\t%" PRIu16 " (bytes)\n",
-                       ehdr->e_ehsize);
-                printf("\tSize of program headers\t\t%" PRIu16 " (bytes)\n",
-                       ehdr->e_phentsize);
-                printf("\tNumber of program headers\t%" PRIu16 "\n",
-                       ehdr->e_phnum);
-                printf("\tSize of section headers\t\t%" PRIu16 " (bytes)\n",
-                       ehdr->e_shentsize);
-                printf("\tNumber of section headers\t%" PRIu16 "\n",
-                       ehdr->e_shnum);
-                printf("\tSection header string table idx\t%" PRIu16 "\n",
-                       ehdr->e_shstrndx);
+                fprintf(elf_out, "\tEntry point address\t\t0x%016" PRIx64 "\n",
+                        ehdr->e_entry);
+                fprintf(elf_out,
+                        "\tStart of program headers\t%" PRIu64
+                        " (bytes into file)\n",
+                        ehdr->e_phoff);
+                fprintf(elf_out,
+                        "\tStart of section headers\t%" PRIu64
+                        " (bytes into file)\n",
+                        ehdr->e_shoff);
+                fprintf(elf_out, "\tFlags\t\t\t\t0x%x\n", ehdr->e_flags);
+                fprintf(elf_out,
+                        "\tSize of this header\t\t%" PRIu16 " (bytes)\n",
+                        ehdr->e_ehsize);
+                fprintf(elf_out,
+                        "\tSize of program headers\t\t%" PRIu16 " (bytes)\n",
+                        ehdr->e_phentsize);
+                fprintf(elf_out, "\tNumber of program headers\t%" PRIu16,
+                        ehdr->e_phnum);
+                if (ehdr->e_phnum == PN_XNUM)
+                        fprintf(elf_out, " (%" PRIu32 ")", ehd_phnum(elf));
+                fprintf(elf_out, "\n");
+                fprintf(elf_out,
+                        "\tSize of section headers\t\t%" PRIu16 " (bytes)\n",
+                        ehdr->e_shentsize);
+                fprintf(elf_out, "\tNumber of section headers\t%" PRIu16,
+                        ehdr->e_shnum);
+                if (ehdr->e_shnum == 0 && ehd_shnum(elf) != 0)
+                        fprintf(elf_out, " (%" PRIu64 ")", ehd_shnum(elf));
+                fprintf(elf_out, "\n");
+                fprintf(elf_out, "\tSection header string table idx\t%" PRIu16,
+                        ehdr->e_shstrndx);
+                if (ehdr->e_shstrndx == SHN_XINDEX)
+                        fprintf(elf_out, " (%" PRIu32 ")", ehd_shstrndx(elf));
+                fprintf(elf_out, "\n");
         } else {
                 // NOP
         }
 }
 
-__cold static void __print_elf32_hdr(Elf32_Ehdr *ehdr, struct config *config) {
-        if (config->show_header_struct == 1) {
-                printf("{\n");
-                printf("  e_ident = ");
-                VT_SIMPLE_HEXDUMP(ehdr->e_ident, 16);
-                printf("\n");
-                printf("  e_type = %u,\n", ehdr->e_type);
-                printf("  e_machine = %u,\n", ehdr->e_machine);
-                printf("  e_version = 0x%x,\n", ehdr->e_version);
-                printf("  e_entry = 0x%016" PRIx32 "\n", ehdr->e_entry);
-                printf("  e_phoff = 0x%016" PRIx32 "\n", ehdr->e_phoff);
-                printf("  e_shoff = 0x%016" PRIx32 "\n", ehdr->e_shoff);
-                printf("  e_flags = 0x%x,\n", ehdr->e_flags);
-                printf("  e_ehsize = %" PRIu16 ",\n", ehdr->e_ehsize);
-                printf("  e_phentsize = %" PRIu16 ",\n", ehdr->e_phentsize);
-                printf("  e_phnum = %" PRIu16 ",\n", ehdr->e_phnum);
-                printf("  e_shentsize = %" PRIu16 ",\n", ehdr->e_shentsize);
-                printf("  e_shnum = %" PRIu16 ",\n", ehdr->e_shnum);
-                printf("  e_shstrndx = %" PRIu16 ",\n", ehdr->e_shstrndx);
-                printf("}\n");
+static const char *const __p_type_names[] = {
+        [PT_NULL] = "NULL",
+        [PT_LOAD] = "LOAD",
+        [PT_DYNAMIC] = "DYNAMIC",
+        [PT_INTERP] = "INTERP",
+        [PT_NOTE] = "NOTE",
+        [PT_SHLIB] = "SHLIB",
+        [PT_PHDR] = "PHDR",
+        [PT_TLS] = "TLS",
+        [PT_NUM] = "NUM",
+};
 
-                return;
-        } else if (config->show_header) {
-                printf("ELF32 class\n");
+static const struct elf_name __p_type_os_names[] = {
+        {PT_GNU_EH_FRAME, "GNU_EH_FRAME"},
+        {PT_GNU_STACK, "GNU_STACK"},
+        {PT_GNU_RELRO, "GNU_RELRO"},
+        {PT_GNU_PROPERTY, "GNU_PROPERTY"},
+        {PT_GNU_SFRAME, "GNU_SFRAME"},
+        {PT_SUNWBSS, "LOSUNW/SUNWBSS"},
+        {PT_SUNWSTACK, "SUNWSTACK"},
+};
 
-                printf("\tType\t\t\t\t");
-                __print_process_elf_type(ehdr->e_type);
-                printf("\n");
+/* NULL when the type has no name */
+static const char *__p_type_name(Elf64_Word p_type) {
+        if (p_type < SIZE(__p_type_names, __p_type_names[0]))
+                return __p_type_names[p_type];
+
+        return __elf_name_find(__p_type_os_names,
+                               SIZE(__p_type_os_names, struct elf_name),
+                               p_type);
+}
+
+/* the ph table type cell, ranges are named when the value is not */
+static const char *__p_type_label(Elf64_Word p_type) {
+        const char *name = __p_type_name(p_type);
+
+        if (name != NULL)
+                return name;
+        if (p_type >= PT_LOOS && p_type <= PT_HIOS)
+                return "OS_SPESIFIC";
+        if (p_type >= PT_LOPROC && p_type <= PT_HIPROC)
+                return "PROCESSOR_SPESIFIC";
+
+        return "UNKNOWN";
+}
+
+/* R, W and X combinations by value, the masks on their own */
+static const char *const __p_flags_names[] = {
+        [PF_X] = "X",
+        [PF_W] = "W",
+        [PF_R] = "R",
+        [PF_R | PF_W] = "RW",
+        [PF_R | PF_X] = "RX",
+        [PF_R | PF_X | PF_W] = "RXW",
+};
+
+static const char *__p_flags_name(Elf64_Word p_flags) {
+        const char *name = NULL;
+
+        if (p_flags < SIZE(__p_flags_names, __p_flags_names[0]))
+                name = __p_flags_names[p_flags];
+        else if (p_flags == PF_MASKOS)
+                name = "MASKOS";
+        else if (p_flags == PF_MASKPROC)
+                name = "MASKPROC";
+
+        return name != NULL ? name : "UNDEF";
+}
+
+static const struct pretty_col ph_table_cols[] = {
+        {"type", 16, 0},
+        {"flags", 9, 0},
+        {"offset", 19, 0},
+        {"virtual addr", 19, 0},
+        {"physical addr", 19, 0},
+        {"file size", 19, 0},
+        {"mem size", 19, 0},
+        {"align", 19, 0},
+};
+
+/* PROGRAM HEADER */
+__cold static void __print_ph_table(struct ehd_file *elf) {
+        struct pretty_table t;
+        Elf64_Phdr phdr;
+
+        pretty_table_init(&t, elf_out, ph_table_cols, SIZE(ph_table_cols,
+                                                            struct pretty_col));
+        pretty_table_header(&t);
+
+        for (uint64_t i = 0; i < ehd_phnum(elf); i++) {
+                if (ehd_segment(elf, i, &phdr) != EHD_OK) {
+                        pretty_table_flush(&t);
+                        fprintf(ELF_ERR, "program header table is outside "
+                                         "of the file\n");
+                        break;
+                }
+
+                pretty_cell_str(&t, __p_type_label(phdr.p_type));
+                pretty_cell_str(&t, __p_flags_name(phdr.p_flags));
+                pretty_cell_hex(&t, phdr.p_offset, 16);
+                pretty_cell_hex(&t, phdr.p_vaddr, 16);
+                pretty_cell_hex(&t, phdr.p_paddr, 16);
+                pretty_cell_hex(&t, phdr.p_filesz, 16);
+                pretty_cell_hex(&t, phdr.p_memsz, 16);
+                pretty_cell_hex(&t, phdr.p_align, 1);
+                pretty_row_end(&t);
+        }
+
+        pretty_table_flush(&t);
+}
+
+#define SH_COL_NAME 1
+
+static const struct pretty_col sh_table_cols[] = {
+        {"n", 8, 0},
+        {"name", 17, PRETTY_TRUNCATE},
+        {"types", 18, 0},
+        {"flags", 6, 0},
+        {"virtual addr", 19, 0},
+        {"offset", 19, 0},
+        {"sh size", 19, 0},
+        {"sh link", 10, 0},
+        {"info", 5, 0},
+        {"align", 6, 0},
+        {"entry size", 19, 0},
+};
+
+/*
+ * the name column grows to the longest section name, names longer than
+ * PRETTY_MAX_WIDTH are still cut
+ */
+__cold static void __print_sh_table(struct ehd_file *elf) {
+        struct pretty_table t;
+        Elf64_Shdr shdr;
+        uint64_t shnum = ehd_shnum(elf);
+
+        pretty_table_init(&t, elf_out, sh_table_cols, SIZE(sh_table_cols,
+                                                            struct pretty_col));
+
+        for (uint64_t i = 0; i < shnum; i++) {
+                if (ehd_section(elf, i, &shdr) != EHD_OK)
+                        break;
+
+                pretty_table_fit(&t, SH_COL_NAME,
+                                 strlen(ehd_section_name(elf, &shdr)));
+        }
+
+        pretty_table_header(&t);
+
+        for (uint64_t i = 0; i < shnum; i++) {
+                if (ehd_section(elf, i, &shdr) != EHD_OK) {
+                        pretty_table_flush(&t);
+                        fprintf(ELF_ERR,
+                                "section header table is bigger than file\n");
+                        break;
+                }
+
+                const char *type = __sh_type_name(shdr.sh_type);
+
+                pretty_cell_u64(&t, i);
+                pretty_cell_str(&t, ehd_section_name(elf, &shdr));
+                pretty_cell_str(&t, type ? type : "Unknown SHT type");
+                pretty_cell_u64(&t, shdr.sh_flags);
+                pretty_cell_hex(&t, shdr.sh_addr, 16);
+                pretty_cell_u64(&t, shdr.sh_offset);
+                pretty_cell_hex(&t, shdr.sh_size, 16);
+                pretty_cell_u64(&t, shdr.sh_link);
+                pretty_cell_u64(&t, shdr.sh_info);
+                pretty_cell_u64(&t, shdr.sh_addralign);
+                pretty_cell_hex(&t, shdr.sh_entsize, 16);
+                pretty_row_end(&t);
+        }
+
+        pretty_table_flush(&t);
+}
+
+static const struct pretty_col sym_table_cols[] = {
+        {"n", 8, 0},
+        {"value", 19, 0},
+        {"size", 10, 0},
+        {"type", 9, 0},
+        {"bind", 8, 0},
+        {"vis", 10, 0},
+        {"ndx", 8, 0},
+        {"name", 17, PRETTY_NOPAD},
+};
+
+static const char *const __st_type_names[] = {
+        [STT_NOTYPE] = "NOTYPE",
+        [STT_OBJECT] = "OBJECT",
+        [STT_FUNC] = "FUNC",
+        [STT_SECTION] = "SECTION",
+        [STT_FILE] = "FILE",
+        [STT_COMMON] = "COMMON",
+        [STT_TLS] = "TLS",
+        [STT_GNU_IFUNC] = "IFUNC",
+};
+
+/* NULL when the value has no name */
+static const char *__st_type_name(unsigned char st_type) {
+        if (st_type < SIZE(__st_type_names, __st_type_names[0]))
+                return __st_type_names[st_type];
+
+        return NULL;
+}
+
+static const char *const __st_bind_names[] = {
+        [STB_LOCAL] = "LOCAL",
+        [STB_GLOBAL] = "GLOBAL",
+        [STB_WEAK] = "WEAK",
+        [STB_GNU_UNIQUE] = "UNIQUE",
+};
+
+/* NULL when the value has no name */
+static const char *__st_bind_name(unsigned char st_bind) {
+        if (st_bind < SIZE(__st_bind_names, __st_bind_names[0]))
+                return __st_bind_names[st_bind];
+
+        return NULL;
+}
+
+/* ELF64_ST_VISIBILITY() is two bits, every value is here */
+static const char *const __st_visibility_names[] = {
+        [STV_DEFAULT] = "DEFAULT",
+        [STV_INTERNAL] = "INTERNAL",
+        [STV_HIDDEN] = "HIDDEN",
+        [STV_PROTECTED] = "PROTECTED",
+};
+
+static const char *__st_visibility_name(unsigned char st_other) {
+        return __st_visibility_names[ELF64_ST_VISIBILITY(st_other)];
+}
+
+/*
+ * st_shndx == SHN_XINDEX means the real section index lives in the
+ * SHT_SYMTAB_SHNDX table linked to this symtab
+ */
+__cold static void __print_elf_symtab(struct ehd_symtab *st) {
+        struct pretty_table t;
+        Elf64_Sym sym;
+        uint32_t xindex;
+
+        pretty_table_init(&t, elf_out, sym_table_cols,
+                          SIZE(sym_table_cols, struct pretty_col));
+        pretty_table_header(&t);
+
+        for (uint64_t i = 0; ehd_symbol(st, i, &sym) == EHD_OK; i++) {
+                const char *type = __st_type_name(ELF64_ST_TYPE(sym.st_info));
+                const char *bind = __st_bind_name(ELF64_ST_BIND(sym.st_info));
+
+                pretty_cell_u64(&t, i);
+                pretty_cell_hex(&t, sym.st_value, 16);
+                pretty_cell_u64(&t, sym.st_size);
+                pretty_cell_str(&t, type ? type : "UNKNOWN");
+                pretty_cell_str(&t, bind ? bind : "UNKNOWN");
+                pretty_cell_str(&t, __st_visibility_name(sym.st_other));
+
+                if (sym.st_shndx == SHN_UNDEF) {
+                        pretty_cell(&t, "UND", 3);
+                } else if (sym.st_shndx == SHN_ABS) {
+                        pretty_cell(&t, "ABS", 3);
+                } else if (sym.st_shndx == SHN_COMMON) {
+                        pretty_cell(&t, "COM", 3);
+                } else if (sym.st_shndx == SHN_XINDEX) {
+                        if (ehd_symbol_xindex(st, i, &xindex) == EHD_OK)
+                                pretty_cell_u64(&t, xindex);
+                        else
+                                pretty_cell(&t, "XINDEX", 6);
+                } else {
+                        pretty_cell_u64(&t, sym.st_shndx);
+                }
+
+                pretty_cell_str(&t, ehd_symbol_name(st, &sym));
+                pretty_row_end(&t);
+        }
+
+        pretty_table_flush(&t);
+}
+
+static void *__arena_ehd_alloc(void *ctx, size_t size) {
+        return arena_alloc((struct arena *)ctx, size);
+}
+
+static void __arena_ehd_free(void *ctx, void *ptr, size_t size) {
+        /* released with the rest of the file */
+}
+
+/* libelfhexdump allocations into this thread's arena */
+static const struct ehd_allocator *__ehd_allocator(struct ehd_allocator *a) {
+        a->alloc = __arena_ehd_alloc;
+        a->free = __arena_ehd_free;
+        a->ctx = elf_arena;
+        return elf_arena ? a : NULL;
+}
+
+/* scratch memory for the current file, never freed by hand */
+static void *__file_alloc(size_t size) {
+        return elf_arena ? arena_alloc(elf_arena, size) : NULL;
+}
+
+/* folds the allocation counts into --stats, then frees every chunk */
+static void __arena_done(struct arena *a) {
+        elf_stats_arena(a->nallocs, a->nmallocs);
+        arena_destroy(a);
+}
+
+static int __open_file(const char *filename) {
+        int fd = open(filename, O_RDONLY);
+
+        if (fd < 0) {
+                fprintf(ELF_ERR, "open() %s: %s\n", filename, strerror(errno));
+                return -1;
+        }
+
+        return fd;
+}
+
+__cold static enum ELF_arch_type __elf_magic_type(const uint8_t *buf,
+                                                  uint64_t size) {
+        if (size >= AR_MAGIC_LEN && ar_is_archive(buf, size)) {
+                return AR_ARCHIVE;
+        }
+
+        if (size >= EI_NIDENT && buf[0] == elf_magic[0] &&
+            buf[1] == elf_magic[1] && buf[2] == elf_magic[2] &&
+            buf[3] == elf_magic[3]) {
+                if (buf[4] == 1) {
+                        return ELF32;
+                } else if (buf[4] == 2) {
+                        return ELF64;
+                } else {
+                        return UNDEFINED_ARCH;
+                }
+        } else {
+                return NOT_ELF;
+        }
+}
+
+__cold static enum ELF_arch_type read_elf_magic(int fd) {
+        u_int8_t buf[64];
+        size_t bufsize = SIZE(buf, u_int8_t);
+        memset(buf, 0, bufsize);
+
+        ssize_t ret = pread(fd, buf, bufsize, 0);
+        // VT_HEXDUMP(buf, bufsize);
+
+        return __elf_magic_type(buf, ret > 0 ? ret : 0);
+}
+
+/*
+ * hexdump streams every byte, build-id, --section, --addr2sym and
+ * --bytes touch a few pages, anything that walks the tables keeps the
+ * kernel's default readahead
+ */
+static enum elf_access __access_profile(struct config *config) {
+        if (config->hexdump || (config->npatterns && !config->search_in) ||
+            config->rules || config->entropy || config->strings ||
+            config->hash || config->dedup)
+                return ACCESS_SEQUENTIAL;
+
+        if (config->show_header || config->show_header_struct ||
+            config->show_program_header || config->show_section_header ||
+            config->show_symbols || config->format == FORMAT_COLUMNAR ||
+            config->size_report || config->layout)
+                return ACCESS_NORMAL;
+
+        /* --search-in and --simhash prefetch their sections themselves */
+        if (config->show_build_id || config->lookup_section_name[0] ||
+            config->naddrs || config->show_bytes || config->npatterns ||
+            config->simhash)
+                return ACCESS_RANDOM;
+
+        return ACCESS_NORMAL;
+}
+
+/* page cache hints, they cover read() as well as the mapping */
+static void __advise_file(int fd, enum elf_access access) {
+        if (access == ACCESS_SEQUENTIAL) {
+                posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+                posix_fadvise(fd, 0, 0, POSIX_FADV_WILLNEED);
+        } else if (access == ACCESS_RANDOM) {
+                posix_fadvise(fd, 0, 0, POSIX_FADV_RANDOM);
+        }
+}
+
+/* WILLNEED for the one stretch of a mapping a restricted scan reads */
+static void __advise_range(const uint8_t *data, uint64_t size) {
+        uintptr_t page = sysconf(_SC_PAGESIZE);
+        uintptr_t start = (uintptr_t)data & ~(page - 1);
+
+        if (size)
+                madvise((void *)start, (uintptr_t)data + size - start,
+                        MADV_WILLNEED);
+}
+
+/*
+ * the whole input is mapped read only once, every parser works on a
+ * view into it (whole file, or one archive member)
+ *
+ * MADV_HUGEPAGE on a file mapping only takes effect when the kernel
+ * has read-only THP for page cache, otherwise it is a no-op
+ */
+static int __map_file(int fd, struct elf_view *view, struct config *config) {
+        enum elf_access access = __access_profile(config);
+        int64_t filesize = __get_file_n(fd);
+        int flags = MAP_PRIVATE;
+
+        view->data = NULL;
+        view->size = 0;
+
+        if (filesize <= 0) {
+                return filesize < 0 ? -1 : 0;
+        }
+
+        if (config->populate)
+                flags = flags | MAP_POPULATE;
+
+        void *map = mmap(NULL, filesize, PROT_READ, flags, fd, 0);
+        if (map == MAP_FAILED) {
+                perror("mmap()");
+                return -1;
+        }
+
+        if (access == ACCESS_SEQUENTIAL) {
+                madvise(map, filesize, MADV_SEQUENTIAL);
+                madvise(map, filesize, MADV_WILLNEED);
+        } else if (access == ACCESS_RANDOM) {
+                madvise(map, filesize, MADV_RANDOM);
+        }
+
+        if (config->hugepage)
+                madvise(map, filesize, MADV_HUGEPAGE);
+
+        view->data = (const uint8_t *)map;
+        view->size = filesize;
+        return 0;
+}
+
+static void __unmap_file(struct elf_view *view) {
+        if (view->data) {
+                munmap((void *)view->data, view->size);
+        }
+
+        view->data = NULL;
+        view->size = 0;
+}
+
+/*
+ * print every SHT_SYMTAB / SHT_DYNSYM
+ */
+__cold static void __dump_symtabs(struct ehd_file *elf) {
+        Elf64_Shdr shdr;
+
+        for (uint64_t i = 0; ehd_section(elf, i, &shdr) == EHD_OK; i++) {
+                struct ehd_symtab st;
+
+                if (shdr.sh_type != SHT_SYMTAB && shdr.sh_type != SHT_DYNSYM) {
+                        continue;
+                }
+
+                ehd_symtab(elf, i, &st);
+
+                fprintf(elf_out,
+                        "\nsymbol table '%s' contains %" PRIu64 " entries\n",
+                        ehd_section_name(elf, &shdr), st.nsyms);
+                __print_elf_symtab(&st);
+        }
+}
+
+__cold static void __print_build_id(struct ehd_file *elf) {
+        const uint8_t *id;
+        uint32_t size;
+
+        if (ehd_build_id(elf, &id, &size) != EHD_OK) {
+                fprintf(elf_out, "build-id: none\n");
+                return;
+        }
+
+        fprintf(elf_out, "build-id: ");
+        for (uint32_t i = 0; i < size; i++) {
+                fprintf(elf_out, "%02x", id[i]);
+        }
+        fprintf(elf_out, "\n");
+}
+
+/*
+ * --section NAME, hexdump of the section content, left column is the
+ * file offset
+ */
+__cold static void __dump_section_bytes(struct ehd_file *elf,
+                                        const char *name) {
+        Elf64_Shdr shdr;
+
+        if (ehd_section_by_name(elf, name, &shdr, NULL) != EHD_OK) {
+                fprintf(ELF_ERR, "section '%s' not found\n", name);
+                return;
+        }
+
+        fprintf(elf_out,
+                "section '%s': offset 0x%016" PRIx64 ", addr 0x%016" PRIx64
+                ", size %" PRIu64 "\n",
+                name, shdr.sh_offset, shdr.sh_addr, shdr.sh_size);
+
+        if (shdr.sh_type == SHT_NOBITS) {
+                fprintf(elf_out, "section occupies no file space\n");
+                return;
+        }
+
+        const uint8_t *bytes = ehd_section_bytes(elf, &shdr);
+        if (bytes == NULL) {
+                fprintf(ELF_ERR, "section '%s' is outside of the file\n", name);
+                return;
+        }
+
+        HEXDUMP_AT(bytes, shdr.sh_size, shdr.sh_offset);
+}
+
+/*
+ * --addr2sym
+ */
+__cold static void __print_addr2sym(struct config *config,
+                                    struct ehd_sym_index *idx) {
+        const char *name;
+        uint64_t off;
+
+        for (uint64_t i = 0; i < config->naddrs; i++) {
+                fprintf(elf_out, "0x%016" PRIx64 " ", config->addrs[i]);
+
+                if (ehd_addr2sym(idx, config->addrs[i], &name, &off) !=
+                    EHD_OK) {
+                        fprintf(elf_out, "??\n");
+                } else if (off) {
+                        fprintf(elf_out, "%s+0x%" PRIx64 "\n", name, off);
+                } else {
+                        fprintf(elf_out, "%s\n", name);
+                }
+        }
+}
+
+/*
+ * --bytes OFF:LEN, any input, ELF or not
+ */
+__cold static void __dump_bytes(struct elf_view *src, struct config *config) {
+        uint64_t off = config->bytes_off;
+        uint64_t len = config->bytes_len;
+
+        if (off > src->size || len > src->size - off) {
+                fprintf(ELF_ERR,
+                        "bytes 0x%" PRIx64 ":%" PRIu64
+                        " are outside of the file (%" PRIu64 " bytes)\n",
+                        off, len, src->size);
+                return;
+        }
+
+        HEXDUMP_AT(src->data + off, len, off);
+}
+
+/*
+ * --format json|ndjson
+ *
+ * json: one object per input, records of one kind are grouped under
+ * the kind's key (an array, or a single object for one-off records)
+ *
+ * ndjson: one record per line, each one says which file (and archive
+ * member) it belongs to and what kind of record it is
+ *
+ * addresses are "0x..." strings, every other number is a plain integer
+ */
+struct elf_json {
+        struct json_writer w;
+        int ndjson;
+        const char *file;
+        const char *member; /* archive member or NULL */
+        struct elf_json *prev;
+};
+
+/* writer of the input being processed on this thread, NULL for text */
+static __thread struct elf_json *elf_json;
+
+static const char *__arch_type_name(enum ELF_arch_type type) {
+        switch (type) {
+        case ELF32:
+                return "ELF32";
+        case ELF64:
+                return "ELF64";
+        case AR_ARCHIVE:
+                return "AR";
+        case UNDEFINED_ARCH:
+                return "UNDEFINED_ARCH";
+        default:
+                return "NOT_ELF";
+        }
+}
+
+/* key is only used by json, for a record that is not in a list */
+static void __json_record_begin(struct elf_json *j, const char *key,
+                                const char *record) {
+        if (!j->ndjson) {
+                if (key)
+                        json_key(&j->w, key);
+                json_object_begin(&j->w);
+                return;
+        }
+
+        json_object_begin(&j->w);
+        if (j->file)
+                json_key_str(&j->w, "file", j->file);
+        if (j->member)
+                json_key_str(&j->w, "member", j->member);
+        json_key_str(&j->w, "record", record);
+}
+
+static void __json_record_end(struct elf_json *j) {
+        json_object_end(&j->w);
+        if (j->ndjson)
+                json_newline(&j->w);
+}
+
+static void __json_list_begin(struct elf_json *j, const char *key) {
+        if (!j->ndjson) {
+                json_key(&j->w, key);
+                json_array_begin(&j->w);
+        }
+}
+
+static void __json_list_end(struct elf_json *j) {
+        if (!j->ndjson)
+                json_array_end(&j->w);
+}
+
+/* named enum value, the raw number as hex when it has no name */
+static void __json_name(struct json_writer *w, const char *key,
+                        const char *name, uint64_t value) {
+        json_key(w, key);
+        if (name)
+                json_str(w, name);
+        else
+                json_hex(w, value);
+}
+
+/*
+ * starts the document of one input or archive member on this thread,
+ * nothing happens with --format text
+ */
+static void __json_doc_open(struct elf_json *j, struct config *config,
+                            const char *member, enum ELF_arch_type type,
+                            uint64_t size) {
+        if (config->format != FORMAT_JSON && config->format != FORMAT_NDJSON) {
+                return;
+        }
+
+        json_init(&j->w, elf_out);
+        j->ndjson = config->format == FORMAT_NDJSON;
+        j->file = config->filename;
+        j->member = member;
+        j->prev = elf_json;
+        elf_json = j;
+
+        if (j->ndjson) {
+                __json_record_begin(j, NULL, member ? "member" : "file");
+        } else {
+                json_object_begin(&j->w);
+                json_key_str(&j->w, member ? "member" : "file",
+                             member ? member : j->file);
+        }
+
+        json_key_str(&j->w, "type", __arch_type_name(type));
+        json_key_u64(&j->w, "size", size);
+
+        if (j->ndjson)
+                __json_record_end(j);
+}
+
+/* --dedup, --simhash-pairs and --size-report cover the whole set */
+static int __json_set_report(const struct config *config) {
+        return (config->format == FORMAT_JSON ||
+                config->format == FORMAT_NDJSON) &&
+               (config->dedup || config->simhash_set || config->size_report);
+}
+
+/*
+ * the document of the set reports after a batch, a single input keeps
+ * its own document open for them instead, closed by __json_doc_close()
+ */
+static void __json_set_open(struct elf_json *j, struct config *config) {
+        json_init(&j->w, elf_out);
+        j->ndjson = config->format == FORMAT_NDJSON;
+        j->file = NULL;
+        j->member = NULL;
+        j->prev = elf_json;
+        elf_json = j;
+
+        if (!j->ndjson)
+                json_object_begin(&j->w);
+}
+
+/* archive members are embedded by the caller, no newline for them */
+static void __json_doc_close(struct elf_json *j, struct config *config) {
+        if (config->format != FORMAT_JSON && config->format != FORMAT_NDJSON) {
+                return;
+        }
+
+        if (!j->ndjson) {
+                json_object_end(&j->w);
+                if (j->member == NULL)
+                        json_newline(&j->w);
+        }
+
+        struct elf_stats_mark mark;
+
+        elf_stats_begin(&mark);
+        json_flush(&j->w);
+        elf_stats_end(&mark, STATS_FLUSH);
+        elf_json = j->prev;
+}
+
+__cold static void __json_elf_hdr(struct elf_json *j, struct ehd_file *elf) {
+        const Elf64_Ehdr *ehdr = ehd_header(elf);
+        struct json_writer *w = &j->w;
+
+        __json_record_begin(j, "header", "header");
+        json_key_str(w, "class",
+                     ehd_class(elf) == ELFCLASS64 ? "ELF64" : "ELF32");
+        json_key(w, "ident");
+        json_hex_begin(w);
+        json_hex_bytes(w, ehdr->e_ident, EI_NIDENT);
+        json_hex_end(w);
+        json_key_u64(w, "type", ehdr->e_type);
+        json_key_u64(w, "machine", ehdr->e_machine);
+        json_key_u64(w, "version", ehdr->e_version);
+        json_key_hex(w, "entry", ehdr->e_entry);
+        json_key_u64(w, "phoff", ehdr->e_phoff);
+        json_key_u64(w, "shoff", ehdr->e_shoff);
+        json_key_u64(w, "flags", ehdr->e_flags);
+        json_key_u64(w, "ehsize", ehdr->e_ehsize);
+        json_key_u64(w, "phentsize", ehdr->e_phentsize);
+        json_key_u64(w, "phnum", ehd_phnum(elf));
+        json_key_u64(w, "shentsize", ehdr->e_shentsize);
+        json_key_u64(w, "shnum", ehd_shnum(elf));
+        json_key_u64(w, "shstrndx", ehd_shstrndx(elf));
+        __json_record_end(j);
+}
+
+__cold static void __json_ph_table(struct elf_json *j, struct ehd_file *elf) {
+        struct json_writer *w = &j->w;
+        Elf64_Phdr phdr;
+
+        __json_list_begin(j, "segments");
+
+        for (uint64_t i = 0; i < ehd_phnum(elf); i++) {
+                if (ehd_segment(elf, i, &phdr) != EHD_OK) {
+                        fprintf(ELF_ERR, "program header table is outside "
+                                         "of the file\n");
+                        break;
+                }
+
+                __json_record_begin(j, NULL, "segment");
+                json_key_u64(w, "index", i);
+                __json_name(w, "type", __p_type_name(phdr.p_type),
+                            phdr.p_type);
+                json_key_u64(w, "flags", phdr.p_flags);
+                json_key_u64(w, "offset", phdr.p_offset);
+                json_key_hex(w, "vaddr", phdr.p_vaddr);
+                json_key_hex(w, "paddr", phdr.p_paddr);
+                json_key_u64(w, "filesz", phdr.p_filesz);
+                json_key_u64(w, "memsz", phdr.p_memsz);
+                json_key_u64(w, "align", phdr.p_align);
+                __json_record_end(j);
+        }
+
+        __json_list_end(j);
+}
+
+__cold static void __json_sh_table(struct elf_json *j, struct ehd_file *elf) {
+        struct json_writer *w = &j->w;
+        Elf64_Shdr shdr;
+
+        __json_list_begin(j, "sections");
+
+        for (uint64_t i = 0; i < ehd_shnum(elf); i++) {
+                if (ehd_section(elf, i, &shdr) != EHD_OK) {
+                        fprintf(ELF_ERR,
+                                "section header table is bigger than file\n");
+                        break;
+                }
+
+                __json_record_begin(j, NULL, "section");
+                json_key_u64(w, "index", i);
+                json_key_str(w, "name", ehd_section_name(elf, &shdr));
+                __json_name(w, "type", __sh_type_name(shdr.sh_type),
+                            shdr.sh_type);
+                json_key_u64(w, "flags", shdr.sh_flags);
+                json_key_hex(w, "addr", shdr.sh_addr);
+                json_key_u64(w, "offset", shdr.sh_offset);
+                json_key_u64(w, "size", shdr.sh_size);
+                json_key_u64(w, "link", shdr.sh_link);
+                json_key_u64(w, "info", shdr.sh_info);
+                json_key_u64(w, "addralign", shdr.sh_addralign);
+                json_key_u64(w, "entsize", shdr.sh_entsize);
+                __json_record_end(j);
+        }
+
+        __json_list_end(j);
+}
+
+/*
+ * every SHT_SYMTAB / SHT_DYNSYM as one flat list, each symbol names
+ * its table, shndx has SHN_XINDEX already resolved
+ */
+__cold static void __json_symtabs(struct elf_json *j, struct ehd_file *elf) {
+        struct json_writer *w = &j->w;
+        Elf64_Shdr shdr;
+        Elf64_Sym sym;
+
+        __json_list_begin(j, "symbols");
+
+        for (uint64_t i = 0; ehd_section(elf, i, &shdr) == EHD_OK; i++) {
+                struct ehd_symtab st;
+
+                if (shdr.sh_type != SHT_SYMTAB && shdr.sh_type != SHT_DYNSYM) {
+                        continue;
+                }
+
+                ehd_symtab(elf, i, &st);
+                const char *table = ehd_section_name(elf, &shdr);
+
+                for (uint64_t n = 0; ehd_symbol(&st, n, &sym) == EHD_OK; n++) {
+                        uint32_t shndx = sym.st_shndx;
+
+                        if (shndx == SHN_XINDEX)
+                                ehd_symbol_xindex(&st, n, &shndx);
+
+                        __json_record_begin(j, NULL, "symbol");
+                        json_key_str(w, "symtab", table);
+                        json_key_u64(w, "index", n);
+                        json_key_str(w, "name", ehd_symbol_name(&st, &sym));
+                        json_key_hex(w, "value", sym.st_value);
+                        json_key_u64(w, "size", sym.st_size);
+                        __json_name(w, "type",
+                                    __st_type_name(ELF64_ST_TYPE(sym.st_info)),
+                                    ELF64_ST_TYPE(sym.st_info));
+                        __json_name(w, "bind",
+                                    __st_bind_name(ELF64_ST_BIND(sym.st_info)),
+                                    ELF64_ST_BIND(sym.st_info));
+                        __json_name(w, "visibility",
+                                    __st_visibility_name(sym.st_other),
+                                    ELF64_ST_VISIBILITY(sym.st_other));
+                        json_key_u64(w, "shndx", shndx);
+                        __json_record_end(j);
+                }
+        }
+
+        __json_list_end(j);
+}
+
+__cold static void __json_build_id(struct elf_json *j, struct ehd_file *elf) {
+        const uint8_t *id;
+        uint32_t size;
+
+        if (j->ndjson) {
+                __json_record_begin(j, NULL, "build_id");
+        }
+
+        json_key(&j->w, "build_id");
+        if (ehd_build_id(elf, &id, &size) == EHD_OK) {
+                json_hex_begin(&j->w);
+                json_hex_bytes(&j->w, id, size);
+                json_hex_end(&j->w);
+        } else {
+                json_null(&j->w);
+        }
+
+        if (j->ndjson) {
+                __json_record_end(j);
+        }
+}
+
+/* --section NAME, the content goes out as one hex string */
+__cold static void __json_section_bytes(struct elf_json *j,
+                                        struct ehd_file *elf,
+                                        const char *name) {
+        struct json_writer *w = &j->w;
+        Elf64_Shdr shdr;
+        uint64_t index;
+
+        if (ehd_section_by_name(elf, name, &shdr, &index) != EHD_OK) {
+                fprintf(ELF_ERR, "section '%s' not found\n", name);
+                return;
+        }
+
+        const uint8_t *bytes = shdr.sh_type == SHT_NOBITS
+                                   ? NULL
+                                   : ehd_section_bytes(elf, &shdr);
+        if (bytes == NULL && shdr.sh_type != SHT_NOBITS) {
+                fprintf(ELF_ERR, "section '%s' is outside of the file\n", name);
+        }
+
+        __json_record_begin(j, "section", "section_bytes");
+        json_key_str(w, "name", name);
+        json_key_u64(w, "index", index);
+        json_key_u64(w, "offset", shdr.sh_offset);
+        json_key_hex(w, "addr", shdr.sh_addr);
+        json_key_u64(w, "size", shdr.sh_size);
+        json_key(w, "hex");
+        if (bytes) {
+                json_hex_begin(w);
+                json_hex_bytes(w, bytes, shdr.sh_size);
+                json_hex_end(w);
+        } else {
+                json_null(w);
+        }
+        __json_record_end(j);
+}
+
+__cold static void __json_addr2sym(struct elf_json *j, struct config *config,
+                                   struct ehd_sym_index *idx) {
+        struct json_writer *w = &j->w;
+        const char *name;
+        uint64_t off;
+
+        __json_list_begin(j, "addr2sym");
+
+        for (uint64_t i = 0; i < config->naddrs; i++) {
+                __json_record_begin(j, NULL, "addr2sym");
+                json_key_hex(w, "addr", config->addrs[i]);
+
+                if (ehd_addr2sym(idx, config->addrs[i], &name, &off) ==
+                    EHD_OK) {
+                        json_key_str(w, "symbol", name);
+                        json_key_u64(w, "offset", off);
+                } else {
+                        json_key(w, "symbol");
+                        json_null(w);
+                }
+
+                __json_record_end(j);
+        }
+
+        __json_list_end(j);
+}
+
+/* --bytes OFF:LEN */
+__cold static void __json_bytes(struct elf_json *j, struct elf_view *src,
+                                struct config *config) {
+        uint64_t off = config->bytes_off;
+        uint64_t len = config->bytes_len;
+
+        if (off > src->size || len > src->size - off) {
+                fprintf(ELF_ERR,
+                        "bytes 0x%" PRIx64 ":%" PRIu64
+                        " are outside of the file (%" PRIu64 " bytes)\n",
+                        off, len, src->size);
+                return;
+        }
+
+        __json_record_begin(j, "bytes", "bytes");
+        json_key_u64(&j->w, "offset", off);
+        json_key_u64(&j->w, "size", len);
+        json_key(&j->w, "hex");
+        json_hex_begin(&j->w);
+        json_hex_bytes(&j->w, src->data + off, len);
+        json_hex_end(&j->w);
+        __json_record_end(j);
+}
+
+/* --hexdump, the file is read in FILE_BUFSIZE chunks like the text dump */
+__cold static void __json_hexdump(struct elf_json *j, int fd) {
+        char *buf = (char *)__file_alloc(FILE_BUFSIZE);
+        int64_t size = __get_file_n(fd);
+        uint64_t off = 0;
+
+        if (buf == NULL)
+                return;
+
+        __json_record_begin(j, "hexdump", "hexdump");
+        json_key_u64(&j->w, "offset", 0);
+        json_key_u64(&j->w, "size", size < 0 ? 0 : size);
+        json_key(&j->w, "hex");
+        json_hex_begin(&j->w);
+
+        while (size > 0 && off < (uint64_t)size) {
+                ssize_t n = pread(fd, buf, FILE_BUFSIZE, off);
+                if (n <= 0)
+                        break;
+
+                json_hex_bytes(&j->w, (const uint8_t *)buf, n);
+                off = off + n;
+        }
+
+        json_hex_end(&j->w);
+        __json_record_end(j);
+}
+
+__cold static void __json_elf(struct elf_json *j, struct ehd_file *elf,
+                              struct config *config,
+                              struct ehd_sym_index *idx) {
+        if (config->show_header || config->show_header_struct) {
+                __json_elf_hdr(j, elf);
+        }
+
+        if (config->show_program_header) {
+                __json_ph_table(j, elf);
+        }
+
+        if (config->show_section_header) {
+                __json_sh_table(j, elf);
+        }
+
+        if (config->show_symbols) {
+                __json_symtabs(j, elf);
+        }
+
+        if (config->lookup_section_name[0] != 0) {
+                __json_section_bytes(j, elf, config->lookup_section_name);
+        }
+
+        if (config->show_build_id) {
+                __json_build_id(j, elf);
+        }
+
+        if (config->naddrs && idx) {
+                __json_addr2sym(j, config, idx);
+        }
+}
+
+/*
+ * --format columnar, every ELF image becomes rows of the sections,
+ * symbols and relocations tables, rows of many inputs share a block
+ * (and its string dictionary) until COL_BLOCK_ROWS is reached
+ */
+#define COL_BLOCK_ROWS (1 << 20)
+
+static const struct col_def col_sections_def[] = {
+        [COL_SEC_FILE] = { "file", COL_STR },
+        [COL_SEC_MEMBER] = { "member", COL_STR },
+        [COL_SEC_INDEX] = { "index", COL_U32 },
+        [COL_SEC_NAME] = { "name", COL_STR },
+        [COL_SEC_TYPE] = { "type", COL_U32 },
+        [COL_SEC_FLAGS] = { "flags", COL_U64 },
+        [COL_SEC_ADDR] = { "addr", COL_U64 },
+        [COL_SEC_OFFSET] = { "offset", COL_U64 },
+        [COL_SEC_SIZE] = { "size", COL_U64 },
+        [COL_SEC_LINK] = { "link", COL_U32 },
+        [COL_SEC_INFO] = { "info", COL_U32 },
+        [COL_SEC_ADDRALIGN] = { "addralign", COL_U64 },
+        [COL_SEC_ENTSIZE] = { "entsize", COL_U64 },
+};
+
+static const struct col_def col_symbols_def[] = {
+        [COL_SYM_FILE] = { "file", COL_STR },
+        [COL_SYM_MEMBER] = { "member", COL_STR },
+        [COL_SYM_SYMTAB] = { "symtab", COL_STR },
+        [COL_SYM_INDEX] = { "index", COL_U32 },
+        [COL_SYM_NAME] = { "name", COL_STR },
+        [COL_SYM_VALUE] = { "value", COL_U64 },
+        [COL_SYM_SIZE] = { "size", COL_U64 },
+        [COL_SYM_TYPE] = { "type", COL_U8 },
+        [COL_SYM_BIND] = { "bind", COL_U8 },
+        [COL_SYM_VISIBILITY] = { "visibility", COL_U8 },
+        [COL_SYM_SHNDX] = { "shndx", COL_U32 },
+};
+
+static const struct col_def col_relocs_def[] = {
+        [COL_REL_FILE] = { "file", COL_STR },
+        [COL_REL_MEMBER] = { "member", COL_STR },
+        [COL_REL_SECTION] = { "section", COL_STR },
+        [COL_REL_TARGET] = { "target", COL_U32 },
+        [COL_REL_INDEX] = { "index", COL_U32 },
+        [COL_REL_OFFSET] = { "offset", COL_U64 },
+        [COL_REL_TYPE] = { "type", COL_U32 },
+        [COL_REL_SYM] = { "sym", COL_U32 },
+        [COL_REL_SYMBOL] = { "symbol", COL_STR },
+        [COL_REL_ADDEND] = { "addend", COL_I64 },
+};
+
+#define COL_NCOLUMNS(def) (sizeof(def) / sizeof(def[0]))
+
+/* tables of the inputs processed on this thread, NULL unless columnar */
+static __thread struct elf_columnar *elf_col;
+
+static int __col_init(struct elf_columnar *c) {
+        memset(c, 0, sizeof(struct elf_columnar));
+
+        if (col_table_init(&c->sections, "sections", col_sections_def,
+                           COL_NCOLUMNS(col_sections_def)) < 0 ||
+            col_table_init(&c->symbols, "symbols", col_symbols_def,
+                           COL_NCOLUMNS(col_symbols_def)) < 0 ||
+            col_table_init(&c->relocs, "relocations", col_relocs_def,
+                           COL_NCOLUMNS(col_relocs_def)) < 0) {
+                fprintf(ELF_ERR, "columnar: out of memory\n");
+                return -1;
+        }
+
+        return 0;
+}
+
+/* writes what is left and frees the tables */
+static void __col_finish(struct elf_columnar *c, FILE *out) {
+        struct elf_stats_mark mark;
+
+        elf_stats_begin(&mark);
+        col_table_flush(&c->sections, out);
+        col_table_flush(&c->symbols, out);
+        col_table_flush(&c->relocs, out);
+        elf_stats_end(&mark, STATS_FLUSH);
+
+        col_table_free(&c->sections);
+        col_table_free(&c->symbols);
+        col_table_free(&c->relocs);
+}
+
+static void __col_row_end(struct col_table *t) {
+        col_row_end(t);
+        if (t->nrows >= COL_BLOCK_ROWS)
+                col_table_flush(t, elf_out);
+}
+
+__cold static void __col_sections(struct elf_columnar *c,
+                                  struct ehd_file *elf, const char *file) {
+        struct col_table *t = &c->sections;
+        Elf64_Shdr shdr;
+
+        for (uint64_t i = 0; ehd_section(elf, i, &shdr) == EHD_OK; i++) {
+                col_put_str(t, COL_SEC_FILE, file);
+                col_put_str(t, COL_SEC_MEMBER, c->member);
+                col_put_u64(t, COL_SEC_INDEX, i);
+                col_put_str(t, COL_SEC_NAME, ehd_section_name(elf, &shdr));
+                col_put_u64(t, COL_SEC_TYPE, shdr.sh_type);
+                col_put_u64(t, COL_SEC_FLAGS, shdr.sh_flags);
+                col_put_u64(t, COL_SEC_ADDR, shdr.sh_addr);
+                col_put_u64(t, COL_SEC_OFFSET, shdr.sh_offset);
+                col_put_u64(t, COL_SEC_SIZE, shdr.sh_size);
+                col_put_u64(t, COL_SEC_LINK, shdr.sh_link);
+                col_put_u64(t, COL_SEC_INFO, shdr.sh_info);
+                col_put_u64(t, COL_SEC_ADDRALIGN, shdr.sh_addralign);
+                col_put_u64(t, COL_SEC_ENTSIZE, shdr.sh_entsize);
+                __col_row_end(t);
+        }
+}
+
+__cold static void __col_symtab(struct elf_columnar *c, struct ehd_file *elf,
+                                const char *file, uint64_t section,
+                                const char *table) {
+        struct col_table *t = &c->symbols;
+        struct ehd_symtab st;
+        Elf64_Sym sym;
+
+        if (ehd_symtab(elf, section, &st) != EHD_OK) {
+                return;
+        }
+
+        for (uint64_t n = 0; ehd_symbol(&st, n, &sym) == EHD_OK; n++) {
+                uint32_t shndx = sym.st_shndx;
+
+                if (shndx == SHN_XINDEX)
+                        ehd_symbol_xindex(&st, n, &shndx);
+
+                col_put_str(t, COL_SYM_FILE, file);
+                col_put_str(t, COL_SYM_MEMBER, c->member);
+                col_put_str(t, COL_SYM_SYMTAB, table);
+                col_put_u64(t, COL_SYM_INDEX, n);
+                col_put_str(t, COL_SYM_NAME, ehd_symbol_name(&st, &sym));
+                col_put_u64(t, COL_SYM_VALUE, sym.st_value);
+                col_put_u64(t, COL_SYM_SIZE, sym.st_size);
+                col_put_u64(t, COL_SYM_TYPE, ELF64_ST_TYPE(sym.st_info));
+                col_put_u64(t, COL_SYM_BIND, ELF64_ST_BIND(sym.st_info));
+                col_put_u64(t, COL_SYM_VISIBILITY,
+                            ELF64_ST_VISIBILITY(sym.st_other));
+                col_put_u64(t, COL_SYM_SHNDX, shndx);
+                __col_row_end(t);
+        }
+}
+
+/* symbol names are looked up in the table the relocations link to */
+__cold static void __col_reltab(struct elf_columnar *c, struct ehd_file *elf,
+                                const char *file, uint64_t section,
+                                const char *table) {
+        struct col_table *t = &c->relocs;
+        struct ehd_reltab rt;
+        struct ehd_symtab st;
+        Elf64_Rela rel;
+        Elf64_Sym sym;
+
+        if (ehd_reltab(elf, section, &rt) != EHD_OK) {
+                return;
+        }
+
+        int have_syms = ehd_symtab(elf, rt.symtab, &st) == EHD_OK;
+
+        for (uint64_t n = 0; ehd_reloc(&rt, n, &rel) == EHD_OK; n++) {
+                uint32_t symi = ELF64_R_SYM(rel.r_info);
+                const char *name = "";
+
+                if (symi && have_syms && ehd_symbol(&st, symi, &sym) == EHD_OK)
+                        name = ehd_symbol_name(&st, &sym);
+
+                col_put_str(t, COL_REL_FILE, file);
+                col_put_str(t, COL_REL_MEMBER, c->member);
+                col_put_str(t, COL_REL_SECTION, table);
+                col_put_u64(t, COL_REL_TARGET, rt.target);
+                col_put_u64(t, COL_REL_INDEX, n);
+                col_put_u64(t, COL_REL_OFFSET, rel.r_offset);
+                col_put_u64(t, COL_REL_TYPE, ELF64_R_TYPE(rel.r_info));
+                col_put_u64(t, COL_REL_SYM, symi);
+                col_put_str(t, COL_REL_SYMBOL, name);
+                col_put_u64(t, COL_REL_ADDEND, (uint64_t)rel.r_addend);
+                __col_row_end(t);
+        }
+}
+
+__cold static void __col_elf(struct elf_columnar *c, struct ehd_file *elf,
+                             struct config *config) {
+        Elf64_Shdr shdr;
+
+        __col_sections(c, elf, config->filename);
+
+        for (uint64_t i = 0; ehd_section(elf, i, &shdr) == EHD_OK; i++) {
+                const char *name = ehd_section_name(elf, &shdr);
+
+                if (shdr.sh_type == SHT_SYMTAB || shdr.sh_type == SHT_DYNSYM)
+                        __col_symtab(c, elf, config->filename, i, name);
+                else if (shdr.sh_type == SHT_REL || shdr.sh_type == SHT_RELA)
+                        __col_reltab(c, elf, config->filename, i, name);
+        }
+}
+
+/*
+ * run every requested mode on one ELF image, ELF32 and ELF64 share
+ * this path, the library hands out widened tables
+ */
+__cold static void __process_elf(struct ehd_file *elf, struct config *config,
+                                 struct ehd_sym_index *idx) {
+        struct ehd_sym_index *own = NULL;
+        struct ehd_allocator alloc;
+        struct elf_stats_mark mark;
+
+        if (elf_col) {
+                elf_stats_begin(&mark);
+                __col_elf(elf_col, elf, config);
+                elf_stats_end(&mark, STATS_RENDER);
+                return;
+        }
+
+        /* idx is the prebuilt index of a --serve entry, or none yet */
+        if (config->naddrs && idx == NULL) {
+                elf_stats_begin(&mark);
+                if (ehd_sym_index_build(elf, __ehd_allocator(&alloc),
+                                        &own) == EHD_OK)
+                        idx = own;
+                elf_stats_end(&mark, STATS_NAMES);
+        }
+
+        elf_stats_begin(&mark);
+
+        if (elf_json) {
+                __json_elf(elf_json, elf, config, idx);
+                elf_stats_end(&mark, STATS_RENDER);
+                ehd_sym_index_free(own);
+                return;
+        }
+
+        __print_elf_hdr(elf, config);
+
+        if (config->show_program_header) {
+                __print_ph_table(elf);
+        }
+
+        if (config->show_section_header) {
+                __print_sh_table(elf);
+        }
+
+        if (config->show_symbols) {
+                __dump_symtabs(elf);
+        }
+
+        if (config->lookup_section_name[0] != 0) {
+                __dump_section_bytes(elf, config->lookup_section_name);
+        }
+
+        if (config->show_build_id) {
+                __print_build_id(elf);
+        }
+
+        if (config->naddrs && idx) {
+                __print_addr2sym(config, idx);
+        }
+
+        elf_stats_end(&mark, STATS_RENDER);
+        ehd_sym_index_free(own);
+}
+
+__cold static void process_elf_image(struct elf_view *src,
+                                     enum ELF_arch_type type,
+                                     struct config *config) {
+        struct ehd_allocator alloc;
+        struct elf_stats_mark mark;
+        struct ehd_file *elf;
+
+        elf_stats_begin(&mark);
+        int ret = ehd_open_mem(src->data, src->size, __ehd_allocator(&alloc),
+                               &elf);
+        elf_stats_end(&mark, STATS_HEADER);
+        if (ret != EHD_OK) {
+                fprintf(ELF_ERR, "%s\n", ehd_strerror(ret));
+                return;
+        }
+
+        __process_elf(elf, config, NULL);
+        ehd_close(elf);
+}
+
+/*
+ * archive members are rendered concurrently, each one into its own
+ * buffer, main thread writes them out in archive order
+ */
+struct archive_job {
+        struct elf_view *src;
+        struct ar_archive *ar;
+        struct config *config;
+        struct arena *arenas; /* one per pool worker, threaded only */
+
+        pthread_mutex_t lock;
+        pthread_cond_t cond;
+};
+
+struct archive_result {
+        struct archive_job *job;
+        uint64_t index;
+
+        char *buf;
+        size_t len;
+        int done;
+};
+
+static void __archive_member_worker(struct thread_pool *tp, int worker,
+                                    void *arg) {
+        struct archive_result *result = (struct archive_result *)arg;
+        struct archive_job *job = result->job;
+        struct ar_member *member = &job->ar->members[result->index];
+        struct elf_view member_view = { .data = job->src->data + member->offset,
+                                        .size = member->size };
+        FILE *prev_out = elf_out;
+        struct arena *prev_arena = elf_arena;
+        struct arena_mark scope;
+        struct elf_json json;
+        char *buf = NULL;
+        size_t len = 0;
+
+        FILE *stream = open_memstream(&buf, &len);
+        if (stream == NULL) {
+                perror("open_memstream()");
+                goto done;
+        }
+
+        elf_out = stream;
+        if (tp) {
+                elf_arena = &job->arenas[worker];
+        }
+        scope = arena_mark(elf_arena);
+
+        enum ELF_arch_type type =
+            __elf_magic_type(member_view.data, member_view.size);
+
+        if (job->config->format == FORMAT_TEXT) {
+                fprintf(elf_out, "\n%s(%s):\n", job->config->filename,
+                        member->name);
+        }
+
+        __json_doc_open(&json, job->config, member->name, type,
+                        member_view.size);
+        if (elf_col) {
+                elf_col->member = member->name;
+        }
+
+        if (type == ELF64 || type == ELF32) {
+                process_elf_image(&member_view, type, job->config);
+        } else if (job->config->format == FORMAT_TEXT) {
+                fprintf(elf_out, "not an ELF member, skipped\n");
+        }
+
+        if (elf_col) {
+                elf_col->member = NULL;
+        }
+        __json_doc_close(&json, job->config);
+        fclose(stream);
+        elf_out = prev_out;
+        arena_release(elf_arena, scope);
+        elf_arena = prev_arena;
+
+done:
+        pthread_mutex_lock(&job->lock);
+        result->buf = buf;
+        result->len = len;
+        result->done = 1;
+        pthread_cond_broadcast(&job->cond);
+        pthread_mutex_unlock(&job->lock);
+}
+
+__cold static void __print_archive_index(struct ar_archive *ar) {
+        fprintf(elf_out, "archive index:\n");
+
+        for (uint64_t i = 0; i < ar->nsymbols; i++) {
+                fprintf(elf_out, "%s in %s\n", ar->symbols[i].name,
+                        ar->members[ar->symbols[i].member].name);
+        }
+}
+
+/* member count, plus the archive symbol index with --syms */
+__cold static void __json_archive_index(struct elf_json *j,
+                                        struct ar_archive *ar,
+                                        struct config *config) {
+        __json_record_begin(j, "archive", "archive");
+        json_key_u64(&j->w, "members", ar->nmembers);
+        json_key_u64(&j->w, "indexed_symbols", ar->nsymbols);
+        __json_record_end(j);
+
+        if (!config->show_symbols) {
+                return;
+        }
+
+        __json_list_begin(j, "archive_index");
+
+        for (uint64_t i = 0; i < ar->nsymbols; i++) {
+                __json_record_begin(j, NULL, "archive_symbol");
+                json_key_str(&j->w, "symbol", ar->symbols[i].name);
+                json_key_str(&j->w, "defined_in",
+                             ar->members[ar->symbols[i].member].name);
+                __json_record_end(j);
+        }
+
+        __json_list_end(j);
+}
+
+/*
+ * jobs <= 1 renders every member on the calling thread (batch mode
+ * already runs one file per worker), with --format json every member
+ * is one object of the "members" array
+ */
+__cold static void __process_archive(struct elf_view *src,
+                                     struct config *config, int jobs) {
+        struct ar_archive ar;
+        struct thread_pool tp;
+        struct archive_job job = { 0 };
+
+        if (ar_parse(src->data, src->size, &ar) < 0) {
+                fprintf(ELF_ERR, "invalid ar archive\n");
+                return;
+        }
+
+        if (elf_json) {
+                __json_archive_index(elf_json, &ar, config);
+        } else if (config->format == FORMAT_TEXT) {
+                fprintf(elf_out,
+                        "archive %s: %" PRIu64 " members, %" PRIu64
+                        " indexed symbols\n",
+                        config->filename, ar.nmembers, ar.nsymbols);
+        }
+
+        if (config->show_symbols && config->format == FORMAT_TEXT) {
+                __print_archive_index(&ar);
+        }
+
+        job.src = src;
+        job.ar = &ar;
+        job.config = config;
+        pthread_mutex_init(&job.lock, NULL);
+        pthread_cond_init(&job.cond, NULL);
+
+        struct archive_result *results = (struct archive_result *)calloc(
+            ar.nmembers ? ar.nmembers : 1, sizeof(struct archive_result));
+        for (uint64_t i = 0; i < ar.nmembers; i++) {
+                results[i].job = &job;
+                results[i].index = i;
+        }
+
+        if (elf_json) {
+                __json_list_begin(elf_json, "members");
+        }
+
+        /* columnar rows go to this thread's tables, members in order */
+        int threaded = jobs > 1 && ar.nmembers > 1 && elf_col == NULL &&
+                       thread_pool_init(&tp, jobs) == 0;
+
+        if (threaded) {
+                job.arenas = (struct arena *)calloc(tp.nthreads,
+                                                    sizeof(struct arena));
+                for (int i = 0; i < tp.nthreads; i++) {
+                        arena_init(&job.arenas[i]);
+                }
+        }
+
+        for (uint64_t i = 0; threaded && i < ar.nmembers; i++) {
+                thread_pool_submit(&tp, -1, __archive_member_worker,
+                                   &results[i]);
+        }
+
+        for (uint64_t i = 0; i < ar.nmembers; i++) {
+                if (!threaded) {
+                        __archive_member_worker(NULL, 0, &results[i]);
+                }
+
+                pthread_mutex_lock(&job.lock);
+                while (!results[i].done) {
+                        pthread_cond_wait(&job.cond, &job.lock);
+                }
+                pthread_mutex_unlock(&job.lock);
+
+                if (elf_json) {
+                        json_raw(&elf_json->w, results[i].buf, results[i].len);
+                } else {
+                        fwrite(results[i].buf, 1, results[i].len, elf_out);
+                }
+                free(results[i].buf);
+                results[i].buf = NULL;
+        }
+
+        if (elf_json) {
+                __json_list_end(elf_json);
+        }
+
+        if (threaded) {
+                thread_pool_wait(&tp);
+                for (int i = 0; i < tp.nthreads; i++) {
+                        __arena_done(&job.arenas[i]);
+                }
+                thread_pool_destroy(&tp);
+                free(job.arenas);
+        }
+
+        pthread_cond_destroy(&job.cond);
+        pthread_mutex_destroy(&job.lock);
+        free(results);
+        ar_free(&ar);
+}
+
+static int parse_opt(int argc, char *argv[], struct config *config) {
+        int retval = 0;
+        char opt = 0;
+        int index = 0;
+
+        u_int64_t conv_optarg = 0;
+        char *end;
+
+        while (1) {
+                opt = getopt_long(argc, argv, "", long_options, &index);
+
+                if (opt == -1) {
+                        break;
+                }
+
+                if (!__cache_serves(opt))
+                        config->cache_unserved = 1;
+
+                switch (opt) {
+                case '?':
+                        /* getopt_long said why, unless opterr is off */
+                        retval = -1;
+                        break;
+
+                case GETOPT_CUSTOM_FILE:
+                        config->filename = optarg;
+                        __add_input(config, optarg);
+                        break;
+
+                case GETOPT_CUSTOM_FILES_FROM:
+                        config->files_from = optarg;
+                        break;
+
+                case GETOPT_CUSTOM_CACHE:
+                        config->cache_path = optarg;
+                        break;
+
+                case GETOPT_CUSTOM_HEADER:
+                        config->show_header = 1;
+                        break;
+
+                case GETOPT_CUSTOM_HEADER_STRUCT:
+                        config->show_header_struct = 1;
+                        break;
+
+                case GETOPT_CUSTOM_PROGRAM_HEADER:
+                        config->show_program_header = 1;
+                        break;
+
+                case GETOPT_CUSTOM_PROGRAM_HEADER_STRUCT:
+                        config->show_program_header_struct = 1;
+                        break;
+
+                case GETOPT_CUSTOM_SECTION_HEADER:
+                        config->show_section_header = 1;
+                        break;
+
+                case GETOPT_CUSTOM_HEXDUMP:
+                        config->hexdump = 1;
+                        break;
+                case GETOPT_CUSTOM_LOOKUP_SECTION:
+                        snprintf(config->lookup_section_name, 1024, "%s",
+                                 optarg);
+                        break;
+
+                case GETOPT_CUSTOM_SYMBOLS:
+                        config->show_symbols = 1;
+                        break;
+
+                case GETOPT_CUSTOM_BUILD_ID:
+                        config->show_build_id = 1;
+                        break;
+
+                case GETOPT_CUSTOM_JOBS:
+                        config->jobs = atoi(optarg);
+                        break;
+
+                case GETOPT_CUSTOM_ADDR2SYM:
+                        __add_addr(config, strtoull(optarg, NULL, 0));
+                        break;
+
+                case GETOPT_CUSTOM_BYTES:
+                        if (__parse_bytes(config, optarg) < 0) {
+                                fprintf(ELF_ERR, "--bytes wants OFF:LEN\n");
+                                retval = -1;
+                        }
+                        break;
+
+                case GETOPT_CUSTOM_SERVE:
+                        config->serve_path = optarg;
+                        break;
+
+                case GETOPT_CUSTOM_CLIENT:
+                        config->client_path = optarg;
+                        break;
+
+                case GETOPT_CUSTOM_STATS:
+                        config->stats = 1;
+                        break;
+
+                case GETOPT_CUSTOM_POPULATE:
+                        config->populate = 1;
+                        break;
+
+                case GETOPT_CUSTOM_HUGEPAGE:
+                        config->hugepage = 1;
+                        break;
+
+                case GETOPT_CUSTOM_FOLLOW:
+                        config->follow = 1;
+                        break;
+
+                case GETOPT_CUSTOM_DIFF:
+                        config->diff = 1;
+                        break;
+
+                case GETOPT_CUSTOM_ENTROPY:
+                        config->entropy = 1;
+                        break;
+
+                case GETOPT_CUSTOM_ENTROPY_BLOCK:
+                        config->entropy_block = strtoull(optarg, &end, 0);
+                        if (config->entropy_block == 0 || *end != 0) {
+                                fprintf(ELF_ERR, "--entropy-block wants a "
+                                                 "byte count above 0\n");
+                                retval = -1;
+                        }
+                        break;
+
+                case GETOPT_CUSTOM_STRINGS:
+                        config->strings = 1;
+                        break;
+
+                case GETOPT_CUSTOM_STRINGS_MIN:
+                        config->strings_min = strtoul(optarg, NULL, 0);
+                        if (config->strings_min == 0) {
+                                fprintf(ELF_ERR, "--strings-min wants a "
+                                                 "length above 0\n");
+                                retval = -1;
+                        }
+                        break;
+
+                case GETOPT_CUSTOM_STRINGS_ENC:
+                        if (strcmp(optarg, "ascii") == 0) {
+                                config->strings_enc = STR_ASCII;
+                        } else if (strcmp(optarg, "utf16le") == 0) {
+                                config->strings_enc = STR_UTF16LE;
+                        } else if (strcmp(optarg, "both") == 0) {
+                                config->strings_enc = STR_ASCII | STR_UTF16LE;
+                        } else {
+                                fprintf(ELF_ERR, "--strings-enc wants ascii, "
+                                                 "utf16le or both\n");
+                                retval = -1;
+                        }
+                        break;
+
+                case GETOPT_CUSTOM_SKIP_DEBUG:
+                        config->skip_debug = 1;
+                        break;
+
+                case GETOPT_CUSTOM_HASH:
+                        if (digest_parse(optarg) < 0) {
+                                fprintf(ELF_ERR, "--hash wants crc32c, xxh64 "
+                                                 "or sha256\n");
+                                retval = -1;
+                                break;
+                        }
+                        config->hash = 1;
+                        config->hash_algo = digest_parse(optarg);
+                        break;
+
+                case GETOPT_CUSTOM_DEDUP:
+                        if (config->dedup)
+                                break;
+
+                        config->dedup =
+                            (struct dedup *)malloc(sizeof(struct dedup));
+                        if (config->dedup == NULL ||
+                            dedup_init(config->dedup) < 0) {
+                                free(config->dedup);
+                                config->dedup = NULL;
+                                retval = -1;
+                        }
+                        break;
+
+                case GETOPT_CUSTOM_SIMHASH:
+                        config->simhash = 1;
+                        break;
+
+                case GETOPT_CUSTOM_SIMHASH_PAIRS:
+                        config->simhash = 1;
+                        config->simhash_pairs = strtoull(optarg, NULL, 0);
+                        if (config->simhash_pairs == 0) {
+                                fprintf(ELF_ERR, "--simhash-pairs wants a "
+                                                 "count above 0\n");
+                                retval = -1;
+                                break;
+                        }
+
+                        if (config->simhash_set)
+                                break;
+
+                        config->simhash_set = (struct simhash_set *)malloc(
+                            sizeof(struct simhash_set));
+                        if (config->simhash_set == NULL ||
+                            simhash_set_init(config->simhash_set) < 0) {
+                                free(config->simhash_set);
+                                config->simhash_set = NULL;
+                                retval = -1;
+                        }
+                        break;
+
+                case GETOPT_CUSTOM_SIZE_BASELINE:
+                case GETOPT_CUSTOM_SIZE_REPORT:
+                        if (opt == GETOPT_CUSTOM_SIZE_BASELINE)
+                                config->size_baseline = optarg;
+                        if (config->size_report)
+                                break;
+
+                        config->size_report = (struct size_report *)malloc(
+                            sizeof(struct size_report));
+                        if (config->size_report == NULL ||
+                            size_report_init(config->size_report) < 0) {
+                                free(config->size_report);
+                                config->size_report = NULL;
+                                retval = -1;
+                        }
+                        break;
+
+                case GETOPT_CUSTOM_LAYOUT:
+                        config->layout = 1;
+                        break;
+
+                case GETOPT_CUSTOM_VERIFY:
+                        if (config->verify == NULL)
+                                config->verify = (struct manifest *)malloc(
+                                    sizeof(struct manifest));
+                        else
+                                manifest_free(config->verify);
+
+                        if (manifest_load(config->verify, optarg, ELF_ERR) <
+                            0) {
+                                free(config->verify);
+                                config->verify = NULL;
+                                retval = -1;
+                        }
+                        break;
+
+                case GETOPT_CUSTOM_SEARCH:
+                        if (__add_pattern(config, optarg) < 0) {
+                                fprintf(ELF_ERR, "--search wants hex bytes "
+                                                 "with ? nibbles or "
+                                                 "str:TEXT\n");
+                                retval = -1;
+                        }
+                        break;
+
+                case GETOPT_CUSTOM_SEARCH_IN:
+                        config->search_in = optarg;
+                        break;
+
+                case GETOPT_CUSTOM_RULES:
+                        if (config->rules == NULL)
+                                config->rules = (struct rule_set *)malloc(
+                                    sizeof(struct rule_set));
+                        else
+                                rules_free(config->rules);
+
+                        if (rules_load(config->rules, optarg, ELF_ERR) < 0) {
+                                free(config->rules);
+                                config->rules = NULL;
+                                retval = -1;
+                        }
+                        break;
+
+                case GETOPT_CUSTOM_PID:
+                        config->pid = atoi(optarg);
+                        if (config->pid <= 0) {
+                                fprintf(ELF_ERR, "--pid wants a process id\n");
+                                retval = -1;
+                        }
+                        break;
+
+                case GETOPT_CUSTOM_FORMAT:
+                        if (strcmp(optarg, "text") == 0) {
+                                config->format = FORMAT_TEXT;
+                        } else if (strcmp(optarg, "json") == 0) {
+                                config->format = FORMAT_JSON;
+                        } else if (strcmp(optarg, "ndjson") == 0) {
+                                config->format = FORMAT_NDJSON;
+                        } else if (strcmp(optarg, "columnar") == 0) {
+                                config->format = FORMAT_COLUMNAR;
+                        } else {
+                                fprintf(ELF_ERR, "--format wants text, json, "
+                                                 "ndjson or columnar\n");
+                                retval = -1;
+                        }
+                        break;
+                }
+        }
+
+        /* bare arguments are inputs too */
+        for (int i = optind; i < argc; i++) {
+                __add_input(config, argv[i]);
+        }
+
+        /* --verify alone checks the manifest's own files and algorithm */
+        if (config->verify && !config->hash) {
+                config->hash = 1;
+                config->hash_algo = config->verify->n
+                                        ? config->verify->entries[0].algo
+                                        : DIGEST_SHA256;
+        }
+
+        if (config->verify && config->nfiles == 0 &&
+            config->files_from == NULL) {
+                struct manifest *m = config->verify;
+
+                for (uint64_t i = 0; i < m->n; i++) {
+                        if (i == 0 || strcmp(m->entries[i - 1].path,
+                                             m->entries[i].path) != 0)
+                                __add_input(config, m->entries[i].path);
+                }
+                m->inputs = 1;
+        }
+
+        if (config->filename == NULL && config->nfiles > 0) {
+                config->filename = config->files[0];
+        }
+
+        return retval;
+}
+
+static void __add_addr(struct config *config, uint64_t addr) {
+        if (config->naddrs == config->addrs_cap) {
+                config->addrs_cap = config->addrs_cap ? config->addrs_cap * 2
+                                                      : 16;
+                config->addrs = (uint64_t *)realloc(
+                    config->addrs, config->addrs_cap * sizeof(uint64_t));
+        }
+
+        config->addrs[config->naddrs] = addr;
+        config->naddrs = config->naddrs + 1;
+}
+
+static int __add_pattern(struct config *config, const char *text) {
+        if (config->npatterns == config->patterns_cap) {
+                config->patterns_cap =
+                    config->patterns_cap ? config->patterns_cap * 2 : 4;
+                config->patterns = (struct search_pattern *)realloc(
+                    config->patterns,
+                    config->patterns_cap * sizeof(struct search_pattern));
+        }
+
+        if (search_compile(text, &config->patterns[config->npatterns]) < 0)
+                return -1;
+
+        config->npatterns = config->npatterns + 1;
+        return 0;
+}
+
+static int __parse_bytes(struct config *config, const char *arg) {
+        char *end;
+
+        config->bytes_off = strtoull(arg, &end, 0);
+        if (*end != ':') {
+                return -1;
+        }
+
+        config->bytes_len = strtoull(end + 1, &end, 0);
+        if (*end != 0) {
+                return -1;
+        }
+
+        config->show_bytes = 1;
+        return 0;
+}
+
+static void __add_input(struct config *config, char *path) {
+        if (config->nfiles == config->files_cap) {
+                config->files_cap = config->files_cap ? config->files_cap * 2
+                                                      : 16;
+                config->files = (char **)realloc(
+                    config->files, config->files_cap * sizeof(char *));
+        }
+
+        config->files[config->nfiles] = path;
+        config->nfiles = config->nfiles + 1;
+}
+
+/*
+ * --files-from PATH, one input per line, "-" reads stdin
+ * lines are kept until exit, config->files points into them
+ */
+static int __read_files_from(struct config *config) {
+        FILE *fh = stdin;
+        char *line = NULL;
+        size_t cap = 0;
+        ssize_t len;
+
+        if (strcmp(config->files_from, "-") != 0) {
+                fh = fopen(config->files_from, "r");
+                if (fh == NULL) {
+                        perror("fopen() --files-from");
+                        return -1;
+                }
+        }
+
+        while ((len = getline(&line, &cap, fh)) >= 0) {
+                while (len > 0 &&
+                       (line[len - 1] == '\n' || line[len - 1] == '\r'))
+                        line[--len] = 0;
+
+                if (len == 0)
+                        continue;
+
+                __add_input(config, strdup(line));
+                config->owned_from = config->owned_from + 1;
+        }
+
+        free(line);
+        if (fh != stdin)
+                fclose(fh);
+
+        return 0;
+}
+
+static void alloc_config_struct(struct config *config) {
+        config->lookup_section_name = (char *)malloc(1024);
+        memset(config->lookup_section_name, 0, 1024);
+}
+
+static void free_config_struct(struct config *config) {
+        /* --files-from entries are the last owned_from inputs */
+        for (uint64_t i = config->nfiles - config->owned_from;
+             i < config->nfiles; i++) {
+                free(config->files[i]);
+        }
+
+        free(config->files);
+        free(config->addrs);
+        free(config->patterns);
+        free(config->lookup_section_name);
+
+        if (config->rules) {
+                rules_free(config->rules);
+                free(config->rules);
+        }
+
+        if (config->verify) {
+                manifest_free(config->verify);
+                free(config->verify);
+        }
+
+        if (config->dedup) {
+                dedup_free(config->dedup);
+                free(config->dedup);
+        }
+
+        if (config->simhash_set) {
+                simhash_set_free(config->simhash_set);
+                free(config->simhash_set);
+        }
+
+        if (config->size_report) {
+                size_report_free(config->size_report);
+                free(config->size_report);
+        }
+}
+
+__hot static int64_t __get_file_n(int fd) {
+        struct stat statbuf;
+        memset(&statbuf, 0, sizeof(struct stat));
+
+        int ret = fstat(fd, &statbuf);
+        if (ret == 0) {
+                // asm volatile("nop");
+
+                return statbuf.st_size;
+        } else {
+                perror("fstat()");
+                return -1;
+        }
+}
+
+__hot static int _start_hexdump(int fd) {
+        struct file_off_control file_off_control = { .offset = FILE_BUFSIZE,
+                                                     .n = 0 };
+        // memset(&file_off_control, 0, sizeof(struct file_off_control));
+
+        int filesize = __get_file_n(fd);
+
+        char *buf = (char *)__file_alloc(sizeof(char) * FILE_BUFSIZE);
+        if (buf == NULL)
+                return -1;
+
+        VT_TITLE(buf, filesize);
+        for (int i = 0; i < (filesize / FILE_BUFSIZE); i++) {
+                lseek(fd, (file_off_control.offset * file_off_control.n),
+                      SEEK_SET);
+                elf_stats_lseek();
+                read(fd, buf, FILE_BUFSIZE);
+                HEXDUMP(buf, FILE_BUFSIZE);
+
+                file_off_control.n = file_off_control.n + 1;
+        }
+
+        int last_off = file_off_control.offset * file_off_control.n;
+        int n = filesize - last_off;
+
+        lseek(fd, SEEK_SET, last_off);
+        elf_stats_lseek();
+        memset(buf, 0, n);
+        read(fd, buf, n);
+        HEXDUMP(buf, n);
+        return 0;
+}
+
+/* rows of [off, size) numbered by file offset, returns the new end */
+static uint64_t __follow_dump(int fd, uint64_t off, uint64_t size) {
+        char buf[FILE_BUFSIZE];
+
+        while (off < size) {
+                size_t want = size - off < FILE_BUFSIZE ? size - off
+                                                        : FILE_BUFSIZE;
+                ssize_t n = pread(fd, buf, want, off);
+                if (n <= 0)
+                        break;
+
+                HEXDUMP_AT(buf, n, off);
+                off = off + n;
+        }
+
+        fflush(elf_out);
+        return off;
+}
+
+/*
+ * --follow, like tail -f: dump the file, then wait on inotify and dump
+ * only what was appended since the last end, nothing is read twice.
+ * the file shrinking below the last end is a truncation, the dump
+ * starts over from offset 0
+ *
+ * the watch is set before the first dump so no append is missed, it
+ * ends once the file is unlinked (IN_ATTRIB, no links left) or the
+ * watch goes away
+ */
+__cold static int __follow(struct config *config) {
+        char events[4096]
+            __attribute__((aligned(__alignof__(struct inotify_event))));
+        uint64_t off = 0;
+        int ret = 0;
+
+        if (config->nfiles != 1 || __is_dir(config->files[0]) ||
+            config->format != FORMAT_TEXT) {
+                fprintf(ELF_ERR, "--follow wants one file and the text "
+                                 "format\n");
+                return -1;
+        }
+
+        int fd = __open_file(config->files[0]);
+        if (fd < 0)
+                return -1;
+
+        int in = inotify_init1(IN_CLOEXEC);
+        if (in < 0 || inotify_add_watch(in, config->files[0],
+                                        IN_MODIFY | IN_ATTRIB) < 0) {
+                perror("inotify");
+                if (in >= 0)
+                        close(in);
+                close(fd);
+                return -1;
+        }
+
+        __advise_file(fd, ACCESS_SEQUENTIAL);
+
+        for (;;) {
+                struct stat st;
+
+                if (fstat(fd, &st) < 0) {
+                        perror("fstat()");
+                        ret = -1;
+                        break;
+                }
+
+                uint64_t size = st.st_size;
+                if (size < off) {
+                        fprintf(ELF_ERR, "%s: file truncated\n",
+                                config->files[0]);
+                        off = 0;
+                }
+
+                off = __follow_dump(fd, off, size);
+                if (st.st_nlink == 0)
+                        break;
+
+                ssize_t n = read(in, events, sizeof(events));
+                if (n < 0 && errno == EINTR)
+                        continue;
+                if (n <= 0)
+                        break;
+
+                int gone = 0;
+                for (char *p = events; p < events + n;
+                     p += sizeof(struct inotify_event) +
+                          ((struct inotify_event *)p)->len) {
+                        if (((struct inotify_event *)p)->mask & IN_IGNORED)
+                                gone = 1;
+                }
+
+                if (gone)
+                        break;
+        }
+
+        close(in);
+        close(fd);
+        return ret;
+}
+
+/*
+ * --pid, ELF files mapped into the process, labels come from their
+ * section headers moved by the load bias
+ */
+struct pid_image {
+        const char *path; /* as listed in /proc/PID/maps */
+        struct elf_view view;
+        struct ehd_file *elf; /* NULL when not an ELF file */
+        uint64_t bias;
+        int has_bias;
+};
+
+#define PID_CHUNK (64 * 1024)
+#define PID_BATCH (1024 * 1024)
+#define PID_TITLE_SIZE 512
+
+/* one range of live memory to dump */
+struct pid_range {
+        uint64_t start;
+        uint64_t end;
+        uint64_t label; /* row number of start */
+        char title[PID_TITLE_SIZE]; /* printed before the rows */
+};
+
+static int __pid_image_open(struct config *config, pid_t pid,
+                            const struct proc_map *map,
+                            struct pid_image *img) {
+        char path[64];
+
+        memset(img, 0, sizeof(struct pid_image));
+        img->path = map->path;
+
+        /* the mapped file itself, the path may be from another mount ns */
+        snprintf(path, sizeof(path), "/proc/%d/map_files/%" PRIx64 "-%" PRIx64,
+                 (int)pid, map->start, map->end);
+        int fd = open(path, O_RDONLY | O_CLOEXEC);
+        if (fd < 0)
+                fd = open(map->path, O_RDONLY | O_CLOEXEC);
+        if (fd < 0)
+                return -1;
+
+        if (read_elf_magic(fd) == NOT_ELF || __map_file(fd, &img->view,
+                                                        config) < 0) {
+                close(fd);
+                return -1;
+        }
+        close(fd);
+
+        if (img->view.data == NULL ||
+            ehd_open_mem(img->view.data, img->view.size, NULL, &img->elf) !=
+                EHD_OK) {
+                __unmap_file(&img->view);
+                img->elf = NULL;
+                return -1;
+        }
+
+        return 0;
+}
+
+/*
+ * the kernel maps a PT_LOAD at bias + page_down(p_vaddr) from file
+ * offset page_down(p_offset), the first mapping that matches gives bias
+ */
+static void __pid_image_bias(struct pid_image *img,
+                             const struct proc_maps *maps) {
+        uint64_t page = sysconf(_SC_PAGESIZE);
+        Elf64_Phdr phdr;
+
+        for (uint64_t i = 0; ehd_segment(img->elf, i, &phdr) == EHD_OK; i++) {
+                if (phdr.p_type != PT_LOAD)
+                        continue;
+
+                for (uint64_t m = 0; m < maps->n; m++) {
+                        const struct proc_map *map = &maps->maps[m];
+
+                        if (map->path == NULL ||
+                            strcmp(map->path, img->path) != 0 ||
+                            map->offset != (phdr.p_offset & ~(page - 1)))
+                                continue;
+
+                        img->bias = map->start - (phdr.p_vaddr & ~(page - 1));
+                        img->has_bias = 1;
+                        return;
+                }
+        }
+}
+
+/* one image per mapped path, NULL entries for files that are not ELF */
+static struct pid_image *__pid_images(struct config *config, pid_t pid,
+                                      const struct proc_maps *maps,
+                                      uint64_t *n) {
+        struct pid_image *images =
+            (struct pid_image *)calloc(maps->n + 1, sizeof(struct pid_image));
+
+        *n = 0;
+        for (uint64_t i = 0; images && i < maps->n; i++) {
+                const struct proc_map *map = &maps->maps[i];
+
+                if (map->path == NULL || map->path[0] != '/' ||
+                    __pid_image_find(images, *n, map->path))
+                        continue;
+
+                if (__pid_image_open(config, pid, map, &images[*n]) == 0)
+                        __pid_image_bias(&images[*n], maps);
+
+                *n = *n + 1;
+        }
+
+        return images;
+}
+
+static struct pid_image *__pid_image_find(struct pid_image *images,
+                                          uint64_t n, const char *path) {
+        for (uint64_t i = 0; i < n; i++) {
+                if (strcmp(images[i].path, path) == 0)
+                        return &images[i];
+        }
+
+        return NULL;
+}
+
+static void __pid_images_free(struct pid_image *images, uint64_t n) {
+        for (uint64_t i = 0; i < n; i++) {
+                if (images[i].elf)
+                        ehd_close(images[i].elf);
+                __unmap_file(&images[i].view);
+        }
+
+        free(images);
+}
+
+/* names of the SHF_ALLOC sections overlapping [start, end) */
+static void __pid_label(struct pid_image *img, uint64_t start, uint64_t end,
+                        char *out, size_t size) {
+        Elf64_Shdr shdr;
+        size_t len = 0;
+
+        out[0] = 0;
+        if (img == NULL || img->elf == NULL || !img->has_bias)
+                return;
+
+        for (uint64_t i = 0; ehd_section(img->elf, i, &shdr) == EHD_OK; i++) {
+                uint64_t addr = shdr.sh_addr + img->bias;
+
+                if (!(shdr.sh_flags & SHF_ALLOC) || shdr.sh_size == 0 ||
+                    addr >= end || addr + shdr.sh_size <= start)
+                        continue;
+
+                const char *name = ehd_section_name(img->elf, &shdr);
+                size_t n = strlen(name) + (len ? 1 : 0);
+
+                if (len + n + 4 >= size) {
+                        snprintf(out + len, size - len, " ...");
+                        return;
+                }
+
+                len += snprintf(out + len, size - len, "%s%s", len ? " " : "",
+                                name);
+        }
+}
+
+static const struct pretty_col pid_table_cols[] = {
+        {"start", 19, 0},
+        {"end", 19, 0},
+        {"perms", 6, 0},
+        {"offset", 11, 0},
+        {"path", 6, 0},
+        {"sections", 8, PRETTY_NOPAD},
+};
+
+#define PID_COL_PATH 4
+
+__cold static void __pid_map_table(const struct proc_maps *maps,
+                                   struct pid_image *images,
+                                   uint64_t nimages) {
+        struct pretty_table t;
+        char label[PID_TITLE_SIZE];
+
+        pretty_table_init(&t, elf_out, pid_table_cols,
+                          SIZE(pid_table_cols, struct pretty_col));
+        for (uint64_t i = 0; i < maps->n; i++) {
+                if (maps->maps[i].path)
+                        pretty_table_fit(&t, PID_COL_PATH,
+                                         strlen(maps->maps[i].path));
+        }
+
+        pretty_table_header(&t);
+
+        for (uint64_t i = 0; i < maps->n; i++) {
+                const struct proc_map *map = &maps->maps[i];
+                struct pid_image *img =
+                    map->path ? __pid_image_find(images, nimages, map->path)
+                              : NULL;
+
+                __pid_label(img, map->start, map->end, label, sizeof(label));
+                pretty_cell_hex(&t, map->start, 16);
+                pretty_cell_hex(&t, map->end, 16);
+                pretty_cell_str(&t, map->perms);
+                pretty_cell_hex(&t, map->offset, 8);
+                pretty_cell_str(&t, map->path ? map->path : "");
+                pretty_cell_str(&t, label);
+                pretty_row_end(&t);
+        }
+
+        pretty_table_flush(&t);
+}
+
+/*
+ * hexdump of every range in order, up to PROC_MEM_MAX_IOV chunks of
+ * one or more ranges go out in a single read. the rest of a range is
+ * skipped at the first byte that can not be read
+ */
+__cold static void __pid_dump(struct proc_mem *pm, struct pid_range *r,
+                              uint64_t n) {
+        uint8_t *buf = (uint8_t *)malloc(PID_BATCH);
+        uint64_t i = 0;
+        uint64_t pos = n ? r[0].start : 0;
+
+        while (buf && i < n) {
+                struct iovec iov[PROC_MEM_MAX_IOV];
+                uint64_t j = i;
+                uint64_t p = pos;
+                size_t total = 0;
+                int niov = 0;
+
+                while (j < n && niov < PROC_MEM_MAX_IOV && total < PID_BATCH) {
+                        if (p >= r[j].end) {
+                                if (++j < n)
+                                        p = r[j].start;
+                                continue;
+                        }
+
+                        size_t len = r[j].end - p;
+                        if (len > PID_CHUNK)
+                                len = PID_CHUNK;
+                        if (len > PID_BATCH - total)
+                                len = PID_BATCH - total;
+
+                        iov[niov].iov_base = (void *)(uintptr_t)p;
+                        iov[niov].iov_len = len;
+                        niov++;
+                        total = total + len;
+                        p = p + len;
+                }
+
+                if (niov == 0)
+                        break;
+
+                ssize_t got = proc_mem_readv(pm, iov, niov, buf);
+                if (got < 0) {
+                        fprintf(ELF_ERR, "process %d: %s\n", (int)pm->pid,
+                                strerror(errno));
+                        break;
+                }
+
+                size_t used = 0;
+                for (int k = 0; k < niov; k++) {
+                        while (pos >= r[i].end) {
+                                pos = r[++i].start;
+                        }
+
+                        if (pos == r[i].start && r[i].title[0])
+                                fprintf(elf_out, "%s\n", r[i].title);
+
+                        size_t ok = (size_t)got - used;
+                        if (ok > iov[k].iov_len)
+                                ok = iov[k].iov_len;
+
+                        HEXDUMP_AT(buf + used, ok,
+                                   r[i].label + (pos - r[i].start));
+                        used = used + ok;
+                        pos = pos + ok;
+
+                        if (ok < iov[k].iov_len) {
+                                fprintf(elf_out,
+                                        "|0x%016" PRIx64 "| unreadable, "
+                                        "%" PRIu64 " bytes\n",
+                                        r[i].label + (pos - r[i].start),
+                                        r[i].end - pos);
+                                if (++i < n)
+                                        pos = r[i].start;
+                                break;
+                        }
+                }
+        }
+
+        fflush(elf_out);
+        free(buf);
+}
+
+/*
+ * --section NAME of the running executable, rows are numbered by file
+ * offset like --section on the file, so the two diff line by line
+ */
+__cold static void __pid_section(struct proc_mem *pm,
+                                 struct pid_image *images, uint64_t nimages,
+                                 const char *name) {
+        struct pid_range range;
+        char exe[PATH_MAX];
+        char link[64];
+        Elf64_Shdr shdr;
+
+        snprintf(link, sizeof(link), "/proc/%d/exe", (int)pm->pid);
+        ssize_t len = readlink(link, exe, sizeof(exe) - 1);
+        if (len < 0) {
+                fprintf(ELF_ERR, "readlink() %s: %s\n", link, strerror(errno));
+                return;
+        }
+        exe[len] = 0;
+
+        struct pid_image *img = __pid_image_find(images, nimages, exe);
+        if (img == NULL || img->elf == NULL || !img->has_bias) {
+                fprintf(ELF_ERR, "%s is not mapped as an ELF file\n", exe);
+                return;
+        }
+
+        if (ehd_section_by_name(img->elf, name, &shdr, NULL) != EHD_OK) {
+                fprintf(ELF_ERR, "section '%s' not found\n", name);
+                return;
+        }
+
+        if (!(shdr.sh_flags & SHF_ALLOC)) {
+                fprintf(ELF_ERR, "section '%s' is not loaded\n", name);
+                return;
+        }
+
+        range.start = shdr.sh_addr + img->bias;
+        range.end = range.start + shdr.sh_size;
+        range.label = shdr.sh_type == SHT_NOBITS ? range.start
+                                                 : shdr.sh_offset;
+        snprintf(range.title, sizeof(range.title),
+                 "section '%s': offset 0x%016" PRIx64 ", addr 0x%016" PRIx64
+                 ", live 0x%016" PRIx64 ", size %" PRIu64,
+                 name, shdr.sh_offset, shdr.sh_addr, range.start,
+                 shdr.sh_size);
+        __pid_dump(pm, &range, 1);
+}
+
+/* every readable mapping, titled with its maps line and sections */
+__cold static void __pid_hexdump(struct proc_mem *pm,
+                                 const struct proc_maps *maps,
+                                 struct pid_image *images, uint64_t nimages) {
+        struct pid_range *ranges =
+            (struct pid_range *)calloc(maps->n + 1, sizeof(struct pid_range));
+        char label[PID_TITLE_SIZE / 2];
+        uint64_t n = 0;
+
+        for (uint64_t i = 0; ranges && i < maps->n; i++) {
+                const struct proc_map *map = &maps->maps[i];
+                struct pid_image *img =
+                    map->path ? __pid_image_find(images, nimages, map->path)
+                              : NULL;
+
+                if (map->perms[0] != 'r')
+                        continue;
+
+                __pid_label(img, map->start, map->end, label, sizeof(label));
+                ranges[n].start = map->start;
+                ranges[n].end = map->end;
+                ranges[n].label = map->start;
+                snprintf(ranges[n].title, sizeof(ranges[n].title),
+                         "\n0x%016" PRIx64 "-0x%016" PRIx64 " %s %08" PRIx64
+                         " %s%s%s",
+                         map->start, map->end, map->perms, map->offset,
+                         map->path ? map->path : "", label[0] ? "  " : "",
+                         label);
+                n++;
+        }
+
+        __pid_dump(pm, ranges, n);
+        free(ranges);
+}
+
+/*
+ * --pid PID, the maps table with section labels, or with --hexdump,
+ * --section NAME and --bytes ADDR:LEN the live memory
+ */
+__cold static int __process_pid(struct config *config) {
+        struct proc_maps maps;
+        struct proc_mem pm;
+        uint64_t nimages;
+
+        if (config->format != FORMAT_TEXT) {
+                fprintf(ELF_ERR, "--pid prints text only\n");
+                return -1;
+        }
+
+        if (proc_maps_read(config->pid, &maps) < 0) {
+                fprintf(ELF_ERR, "/proc/%d/maps: %s\n", (int)config->pid,
+                        strerror(errno));
+                return -1;
+        }
+
+        struct pid_image *images =
+            __pid_images(config, config->pid, &maps, &nimages);
+        proc_mem_init(&pm, config->pid);
+
+        if (!config->hexdump && !config->show_bytes &&
+            config->lookup_section_name[0] == 0)
+                __pid_map_table(&maps, images, nimages);
+
+        if (config->lookup_section_name[0])
+                __pid_section(&pm, images, nimages,
+                              config->lookup_section_name);
+
+        if (config->show_bytes) {
+                struct pid_range range = { config->bytes_off,
+                                           config->bytes_off +
+                                               config->bytes_len,
+                                           config->bytes_off, "" };
+
+                __pid_dump(&pm, &range, 1);
+        }
+
+        if (config->hexdump)
+                __pid_hexdump(&pm, &maps, images, nimages);
+
+        proc_mem_close(&pm);
+        if (images)
+                __pid_images_free(images, nimages);
+        proc_maps_free(&maps);
+        return 0;
+}
+
+/*
+ * --diff A B, the header tables are compared field by field and the
+ * sections by content, the n-th section called X in A is paired with
+ * the n-th one called X in B so a shifted layout still lines up
+ */
+#define DIFF_GAP 16       /* differing bytes this close share a range */
+#define DIFF_MAX_ROWS 256 /* per section, the rest is only counted */
+
+struct diff_field {
+        const char *name;
+        uint32_t off;
+        uint32_t size;
+};
+
+#define DIFF_FIELD(type, f)                                                    \
+        { #f, offsetof(type, f), sizeof(((type *)0)->f) }
+
+static const struct diff_field diff_ehdr_fields[] = {
+        DIFF_FIELD(Elf64_Ehdr, e_ident),
+        DIFF_FIELD(Elf64_Ehdr, e_type),
+        DIFF_FIELD(Elf64_Ehdr, e_machine),
+        DIFF_FIELD(Elf64_Ehdr, e_version),
+        DIFF_FIELD(Elf64_Ehdr, e_entry),
+        DIFF_FIELD(Elf64_Ehdr, e_phoff),
+        DIFF_FIELD(Elf64_Ehdr, e_shoff),
+        DIFF_FIELD(Elf64_Ehdr, e_flags),
+        DIFF_FIELD(Elf64_Ehdr, e_ehsize),
+        DIFF_FIELD(Elf64_Ehdr, e_phentsize),
+        DIFF_FIELD(Elf64_Ehdr, e_phnum),
+        DIFF_FIELD(Elf64_Ehdr, e_shentsize),
+        DIFF_FIELD(Elf64_Ehdr, e_shnum),
+        DIFF_FIELD(Elf64_Ehdr, e_shstrndx),
+};
+
+static const struct diff_field diff_phdr_fields[] = {
+        DIFF_FIELD(Elf64_Phdr, p_type),
+        DIFF_FIELD(Elf64_Phdr, p_flags),
+        DIFF_FIELD(Elf64_Phdr, p_offset),
+        DIFF_FIELD(Elf64_Phdr, p_vaddr),
+        DIFF_FIELD(Elf64_Phdr, p_paddr),
+        DIFF_FIELD(Elf64_Phdr, p_filesz),
+        DIFF_FIELD(Elf64_Phdr, p_memsz),
+        DIFF_FIELD(Elf64_Phdr, p_align),
+};
+
+/* sh_name is left out, it moves whenever .shstrtab changes */
+static const struct diff_field diff_shdr_fields[] = {
+        DIFF_FIELD(Elf64_Shdr, sh_type),
+        DIFF_FIELD(Elf64_Shdr, sh_flags),
+        DIFF_FIELD(Elf64_Shdr, sh_addr),
+        DIFF_FIELD(Elf64_Shdr, sh_offset),
+        DIFF_FIELD(Elf64_Shdr, sh_size),
+        DIFF_FIELD(Elf64_Shdr, sh_link),
+        DIFF_FIELD(Elf64_Shdr, sh_info),
+        DIFF_FIELD(Elf64_Shdr, sh_addralign),
+        DIFF_FIELD(Elf64_Shdr, sh_entsize),
+};
+
+struct diff_side {
+        const char *path;
+        int fd;
+        struct elf_view view;
+        struct ehd_file *elf;
+};
+
+struct diff_sec {
+        const char *name;
+        uint64_t index;
+        uint64_t nth; /* sections before it with the same name */
+};
+
+struct diff_totals {
+        uint64_t fields;
+        uint64_t sections;
+        uint64_t sections_differ;
+        uint64_t bytes;
+};
+
+static uint64_t __diff_field_value(const uint8_t *p,
+                                   const struct diff_field *f) {
+        uint8_t u8;
+        uint16_t u16;
+        uint32_t u32;
+        uint64_t u64;
+
+        switch (f->size) {
+        case 1:
+                memcpy(&u8, p + f->off, 1);
+                return u8;
+        case 2:
+                memcpy(&u16, p + f->off, 2);
+                return u16;
+        case 4:
+                memcpy(&u32, p + f->off, 4);
+                return u32;
+        default:
+                memcpy(&u64, p + f->off, 8);
+                return u64;
+        }
+}
+
+static uint64_t __diff_fields(const char *label, const void *a,
+                              const void *b,
+                              const struct diff_field *fields, uint32_t n) {
+        const uint8_t *pa = (const uint8_t *)a;
+        const uint8_t *pb = (const uint8_t *)b;
+        uint64_t changed = 0;
+
+        for (uint32_t i = 0; i < n; i++) {
+                const struct diff_field *f = &fields[i];
+
+                if (memcmp(pa + f->off, pb + f->off, f->size) == 0)
+                        continue;
+
+                changed++;
+                fprintf(elf_out, "%s %s ", label, f->name);
+                if (f->size <= sizeof(uint64_t)) {
+                        fprintf(elf_out, "0x%" PRIx64 " -> 0x%" PRIx64 "\n",
+                                __diff_field_value(pa, f),
+                                __diff_field_value(pb, f));
+                        continue;
+                }
+
+                for (uint32_t k = 0; k < f->size; k++)
+                        fprintf(elf_out, "%02x", pa[f->off + k]);
+                fprintf(elf_out, " -> ");
+                for (uint32_t k = 0; k < f->size; k++)
+                        fprintf(elf_out, "%02x", pb[f->off + k]);
+                fprintf(elf_out, "\n");
+        }
+
+        return changed;
+}
+
+/* one 16 byte row of each side, blank where a side has run out */
+static void __diff_row(const char *label, uint64_t row, const uint8_t *a,
+                       uint64_t na, const uint8_t *b, uint64_t nb) {
+        fprintf(elf_out, "%s+0x%08" PRIx64 " ", label, row);
+
+        for (uint64_t i = row; i < row + 16; i++) {
+                if (i < na)
+                        fprintf(elf_out, " %02x", a[i]);
+                else
+                        fprintf(elf_out, "   ");
+        }
+
+        fprintf(elf_out, "  |");
+        for (uint64_t i = row; i < row + 16 && i < nb; i++) {
+                fprintf(elf_out, " %02x", b[i]);
+        }
+        fprintf(elf_out, "\n");
+}
+
+/* differing bytes of a[0, na) against b[0, nb), 0 when identical */
+static uint64_t __diff_bytes(const char *label, const uint8_t *a,
+                             uint64_t na, const uint8_t *b, uint64_t nb) {
+        struct diff_ranges d = { 0 };
+        uint64_t common = na < nb ? na : nb;
+        uint64_t rows = 0;
+
+        diff_scan(a, b, common, DIFF_GAP, &d);
+        diff_ranges_add(&d, common, na > nb ? na : nb, DIFF_GAP);
+        if (d.n == 0)
+                return 0;
+
+        fprintf(elf_out, "\n%s: %" PRIu64 " %s, %" PRIu64 " %s", label,
+                d.bytes, d.bytes == 1 ? "byte differs" : "bytes differ", d.n,
+                d.n == 1 ? "range" : "ranges");
+        if (na != nb)
+                fprintf(elf_out, ", size 0x%" PRIx64 " -> 0x%" PRIx64, na,
+                        nb);
+        fprintf(elf_out, "\n");
+
+        for (uint64_t i = 0; i < d.n; i++) {
+                uint64_t row = d.r[i].start & ~(uint64_t)15;
+
+                for (; row < d.r[i].end; row += 16) {
+                        if (rows++ < DIFF_MAX_ROWS)
+                                __diff_row(label, row, a, na, b, nb);
+                }
+        }
+
+        if (rows > DIFF_MAX_ROWS)
+                fprintf(elf_out, "%s: %" PRIu64 " more rows not shown\n",
+                        label, rows - DIFF_MAX_ROWS);
+
+        uint64_t bytes = d.bytes;
+        diff_ranges_free(&d);
+        return bytes;
+}
+
+static int __diff_sec_cmp(const void *a, const void *b) {
+        const struct diff_sec *x = (const struct diff_sec *)a;
+        const struct diff_sec *y = (const struct diff_sec *)b;
+        int c = strcmp(x->name, y->name);
+
+        if (c)
+                return c;
+        return x->index < y->index ? -1 : x->index > y->index;
+}
+
+/* every section, sorted by name then index, nth filled in */
+static struct diff_sec *__diff_secs(struct ehd_file *elf, uint64_t *n) {
+        Elf64_Shdr shdr;
+
+        *n = ehd_shnum(elf);
+        struct diff_sec *secs =
+            (struct diff_sec *)malloc((*n + 1) * sizeof(struct diff_sec));
+        if (secs == NULL)
+                return NULL;
+
+        for (uint64_t i = 0; i < *n; i++) {
+                const char *name = NULL;
+
+                if (ehd_section(elf, i, &shdr) == EHD_OK)
+                        name = ehd_section_name(elf, &shdr);
+
+                secs[i].name = name ? name : "";
+                secs[i].index = i;
+        }
+
+        qsort(secs, *n, sizeof(struct diff_sec), __diff_sec_cmp);
+        for (uint64_t i = 0; i < *n; i++) {
+                int same = i && strcmp(secs[i].name, secs[i - 1].name) == 0;
+
+                secs[i].nth = same ? secs[i - 1].nth + 1 : 0;
+        }
+
+        return secs;
+}
+
+/*
+ * B's partner of every A section by index, -1 when there is none,
+ * matched[] marks the B sections that got paired
+ */
+static int64_t *__diff_pair(struct diff_sec *sa, uint64_t na,
+                            struct diff_sec *sb, uint64_t nb,
+                            uint8_t *matched) {
+        int64_t *partner = (int64_t *)malloc((na + 1) * sizeof(int64_t));
+        uint64_t i = 0;
+        uint64_t j = 0;
+
+        if (partner == NULL)
+                return NULL;
+
+        for (uint64_t k = 0; k < na; k++)
+                partner[k] = -1;
+
+        while (i < na && j < nb) {
+                int c = strcmp(sa[i].name, sb[j].name);
+
+                if (c == 0 && sa[i].nth != sb[j].nth)
+                        c = sa[i].nth < sb[j].nth ? -1 : 1;
+
+                if (c < 0) {
+                        i++;
+                } else if (c > 0) {
+                        j++;
+                } else {
+                        partner[sa[i].index] = sb[j].index;
+                        matched[sb[j].index] = 1;
+                        i++;
+                        j++;
+                }
+        }
+
+        return partner;
+}
+
+/* section name, or its index when it has none */
+static const char *__diff_sec_label(const char *name, uint64_t index,
+                                    char *buf, size_t size) {
+        if (name && name[0])
+                return name;
+
+        snprintf(buf, size, "section[%" PRIu64 "]", index);
+        return buf;
+}
+
+static void __diff_section(struct diff_side *a, uint64_t ia,
+                           struct diff_side *b, uint64_t ib,
+                           struct diff_totals *t) {
+        Elf64_Shdr sa;
+        Elf64_Shdr sb;
+        uint64_t na = 0;
+        uint64_t nb = 0;
+        const uint8_t *da = NULL;
+        const uint8_t *db = NULL;
+
+        if (ehd_section(a->elf, ia, &sa) != EHD_OK ||
+            ehd_section(b->elf, ib, &sb) != EHD_OK)
+                return;
+
+        char label[32];
+        const char *name = __diff_sec_label(ehd_section_name(a->elf, &sa),
+                                            ia, label, sizeof(label));
+
+        uint64_t fields =
+            __diff_fields(name, &sa, &sb, diff_shdr_fields,
+                          SIZE(diff_shdr_fields, struct diff_field));
+
+        if (sa.sh_type != SHT_NOBITS && sb.sh_type != SHT_NOBITS) {
+                da = ehd_section_bytes(a->elf, &sa);
+                db = ehd_section_bytes(b->elf, &sb);
+                na = da ? sa.sh_size : 0;
+                nb = db ? sb.sh_size : 0;
+        }
+
+        uint64_t bytes = __diff_bytes(name, da, na, db, nb);
+
+        t->sections++;
+        t->fields += fields;
+        t->bytes += bytes;
+        if (fields || bytes)
+                t->sections_differ++;
+}
+
+static void __diff_elf(struct diff_side *a, struct diff_side *b,
+                       struct diff_totals *t) {
+        Elf64_Phdr pa;
+        Elf64_Phdr pb;
+        char label[32];
+        uint64_t na;
+        uint64_t nb;
+
+        t->fields += __diff_fields("header", ehd_header(a->elf),
+                                   ehd_header(b->elf), diff_ehdr_fields,
+                                   SIZE(diff_ehdr_fields, struct diff_field));
+
+        na = ehd_phnum(a->elf);
+        nb = ehd_phnum(b->elf);
+        for (uint64_t i = 0; i < na || i < nb; i++) {
+                int ha = i < na && ehd_segment(a->elf, i, &pa) == EHD_OK;
+                int hb = i < nb && ehd_segment(b->elf, i, &pb) == EHD_OK;
+
+                snprintf(label, sizeof(label), "segment[%" PRIu64 "]", i);
+                if (ha && hb) {
+                        t->fields += __diff_fields(
+                            label, &pa, &pb, diff_phdr_fields,
+                            SIZE(diff_phdr_fields, struct diff_field));
+                } else if (ha || hb) {
+                        fprintf(elf_out, "%s only in %s (%s)\n", label,
+                                ha ? a->path : b->path,
+                                __p_type_label(ha ? pa.p_type : pb.p_type));
+                        t->fields++;
+                }
+        }
+
+        struct diff_sec *sa = __diff_secs(a->elf, &na);
+        struct diff_sec *sb = __diff_secs(b->elf, &nb);
+        uint8_t *matched = (uint8_t *)calloc(nb + 1, 1);
+        const char **names = (const char **)malloc((na + 1) * sizeof(char *));
+        int64_t *partner = NULL;
+
+        if (sa && sb && matched && names)
+                partner = __diff_pair(sa, na, sb, nb, matched);
+        if (partner == NULL) {
+                fprintf(ELF_ERR, "--diff: out of memory\n");
+                goto out;
+        }
+
+        /* sa is in name order, the loop below goes by index */
+        for (uint64_t k = 0; k < na; k++)
+                names[sa[k].index] = sa[k].name;
+
+        /* A's index order is file order for most linkers */
+        for (uint64_t i = 0; i < na; i++) {
+                if (partner[i] >= 0) {
+                        __diff_section(a, i, b, partner[i], t);
+                        continue;
+                }
+
+                fprintf(elf_out, "%s only in %s\n",
+                        __diff_sec_label(names[i], i, label, sizeof(label)),
+                        a->path);
+                t->sections++;
+                t->sections_differ++;
+        }
+
+        for (uint64_t k = 0; k < nb; k++) {
+                if (!matched[sb[k].index]) {
+                        fprintf(elf_out, "%s only in %s\n",
+                                __diff_sec_label(sb[k].name, sb[k].index,
+                                                 label, sizeof(label)),
+                                b->path);
+                        t->sections++;
+                        t->sections_differ++;
+                }
+        }
+
+out:
+        free(partner);
+        free(names);
+        free(matched);
+        free(sa);
+        free(sb);
+}
+
+static int __diff_open(struct config *config, struct diff_side *s,
+                       const char *path) {
+        struct ehd_allocator alloc;
+
+        memset(s, 0, sizeof(struct diff_side));
+        s->path = path;
+        s->fd = __open_file(path);
+        if (s->fd < 0)
+                return -1;
+
+        __advise_file(s->fd, ACCESS_SEQUENTIAL);
+        if (__map_file(s->fd, &s->view, config) < 0)
+                return -1;
+
+        enum ELF_arch_type type =
+            __elf_magic_type(s->view.data, s->view.size);
+        if ((type == ELF64 || type == ELF32) &&
+            ehd_open_mem(s->view.data, s->view.size, __ehd_allocator(&alloc),
+                         &s->elf) != EHD_OK)
+                s->elf = NULL;
+
+        return 0;
+}
+
+static void __diff_close(struct diff_side *s) {
+        if (s->elf)
+                ehd_close(s->elf);
+        __unmap_file(&s->view);
+        if (s->fd >= 0)
+                close(s->fd);
+}
+
+/* as cmp(1): 0 when identical, 1 when they differ, -1 on trouble */
+__cold static int __diff(struct config *config) {
+        struct diff_side side[2];
+        struct diff_totals t = { 0 };
+        int ret = -1;
+
+        if (config->nfiles != 2 || config->format != FORMAT_TEXT) {
+                fprintf(ELF_ERR, "--diff wants two files and the text "
+                                 "format\n");
+                return -1;
+        }
+
+        side[0].fd = -1;
+        side[1].fd = -1;
+        if (__diff_open(config, &side[0], config->files[0]) < 0 ||
+            __diff_open(config, &side[1], config->files[1]) < 0)
+                goto out;
+
+        struct diff_side *a = &side[0];
+        struct diff_side *b = &side[1];
+
+        /* whole-file check first, identical builds stop here */
+        if (a->view.size == b->view.size &&
+            (a->view.size == 0 ||
+             memcmp(a->view.data, b->view.data, a->view.size) == 0)) {
+                fprintf(elf_out, "%s and %s are identical\n", a->path,
+                        b->path);
+                ret = 0;
+                goto out;
+        }
+
+        if (a->elf == NULL || b->elf == NULL) {
+                t.bytes = __diff_bytes("file", a->view.data, a->view.size,
+                                       b->view.data, b->view.size);
+                fprintf(elf_out, "\n%s and %s differ: %" PRIu64 " %s\n",
+                        a->path, b->path, t.bytes,
+                        t.bytes == 1 ? "byte" : "bytes");
+                ret = 1;
+                goto out;
+        }
+
+        __diff_elf(a, b, &t);
+        fprintf(elf_out,
+                "\n%s and %s differ: %" PRIu64 " header %s, %" PRIu64
+                " of %" PRIu64 " sections, %" PRIu64 " %s\n",
+                a->path, b->path, t.fields, t.fields == 1 ? "field" : "fields",
+                t.sections_differ, t.sections, t.bytes,
+                t.bytes == 1 ? "byte" : "bytes");
+        if (t.fields == 0 && t.sections_differ == 0)
+                fprintf(elf_out, "only bytes outside every section differ\n");
+        ret = 1;
+
+out:
+        __diff_close(&side[0]);
+        __diff_close(&side[1]);
+        return ret;
+}
+
+/*
+ * --cache only answers the modes that read nothing but the header
+ * tables, names and notes (--header, --ph, --sh, --build-id) and the
+ * options that do not change what is read, any other option turns it
+ * off for the run, so a new mode is never served from the cache
+ */
+static int __cache_serves(int opt) {
+        switch (opt) {
+        case GETOPT_CUSTOM_FILE:
+        case GETOPT_CUSTOM_FILES_FROM:
+        case GETOPT_CUSTOM_CACHE:
+        case GETOPT_CUSTOM_HEADER:
+        case GETOPT_CUSTOM_HEADER_STRUCT:
+        case GETOPT_CUSTOM_PROGRAM_HEADER:
+        case GETOPT_CUSTOM_PROGRAM_HEADER_STRUCT:
+        case GETOPT_CUSTOM_SECTION_HEADER:
+        case GETOPT_CUSTOM_BUILD_ID:
+        case GETOPT_CUSTOM_JOBS:
+        case GETOPT_CUSTOM_FORMAT:
+        case GETOPT_CUSTOM_STATS:
+        case GETOPT_CUSTOM_POPULATE:
+        case GETOPT_CUSTOM_HUGEPAGE:
+                return 1;
+        default:
+                return 0;
+        }
+}
+
+static int __cache_usable(struct config *config) {
+        return config->cache && !config->cache_unserved &&
+               config->format != FORMAT_COLUMNAR;
+}
+
+static void __cache_add_range(struct elf_cache_range **ranges, uint64_t *n,
+                              uint64_t *cap, uint64_t offset, uint64_t size) {
+        if (*n == *cap) {
+                *cap = *cap ? *cap * 2 : 16;
+                *ranges = (struct elf_cache_range *)realloc(
+                    *ranges, *cap * sizeof(struct elf_cache_range));
+        }
+
+        (*ranges)[*n].offset = offset;
+        (*ranges)[*n].size = size;
+        *n = *n + 1;
+}
+
+/*
+ * byte ranges read by --header, --ph, --sh and --build-id
+ */
+__cold static uint64_t __cache_ranges(struct ehd_file *elf,
+                                      struct elf_cache_range **ranges) {
+        const Elf64_Ehdr *ehdr = ehd_header(elf);
+        int is64 = ehd_class(elf) == ELFCLASS64;
+        uint64_t phsize = is64 ? sizeof(Elf64_Phdr) : sizeof(Elf32_Phdr);
+        uint64_t shsize = is64 ? sizeof(Elf64_Shdr) : sizeof(Elf32_Shdr);
+        uint64_t n = 0, cap = 0;
+        Elf64_Phdr phdr;
+        Elf64_Shdr shdr;
+
+        __cache_add_range(ranges, &n, &cap, 0,
+                          is64 ? sizeof(Elf64_Ehdr) : sizeof(Elf32_Ehdr));
+        __cache_add_range(ranges, &n, &cap, ehdr->e_phoff,
+                          ehd_phnum(elf) * phsize);
+
+        for (uint64_t i = 0; ehd_segment(elf, i, &phdr) == EHD_OK; i++) {
+                if (phdr.p_type == PT_NOTE)
+                        __cache_add_range(ranges, &n, &cap, phdr.p_offset,
+                                          phdr.p_filesz);
+        }
+
+        if (ehdr->e_shoff == 0) {
+                return n;
+        }
+
+        /* shdr[0] carries the extended counts, keep it even if empty */
+        __cache_add_range(ranges, &n, &cap, ehdr->e_shoff,
+                          (ehd_shnum(elf) ? ehd_shnum(elf) : 1) * shsize);
+
+        for (uint64_t i = 0; ehd_section(elf, i, &shdr) == EHD_OK; i++) {
+                if (i == ehd_shstrndx(elf) || shdr.sh_type == SHT_NOTE)
+                        __cache_add_range(ranges, &n, &cap, shdr.sh_offset,
+                                          shdr.sh_size);
+        }
+
+        return n;
+}
+
+static void __cache_store(struct config *config, int fd,
+                          struct elf_view *view, enum ELF_arch_type type) {
+        struct elf_cache_range *ranges = NULL;
+        uint64_t nranges = 0;
+        struct stat st;
+
+        if (fstat(fd, &st) < 0) {
+                return;
+        }
+
+        if (type == ELF64 || type == ELF32) {
+                struct ehd_file *elf;
+
+                if (ehd_open_mem(view->data, view->size, NULL, &elf) != EHD_OK)
+                        return;
+
+                nranges = __cache_ranges(elf, &ranges);
+                ehd_close(elf);
+        } else if (type != NOT_ELF) {
+                return;
+        }
+
+        elf_cache_store(config->cache, &st, type, view->data, ranges, nranges);
+        free(ranges);
+}
+
+/*
+ * --cache hit, the file itself is never opened, returns the cached
+ * type or -1 on a miss
+ */
+static int __process_cached(struct config *config, int batch) {
+        struct elf_cache_entry entry;
+        struct elf_stats_mark mark;
+        struct stat st;
+        int type;
+
+        /* the lookup stands in for open and magic */
+        elf_stats_begin(&mark);
+        if (stat(config->filename, &st) < 0 ||
+            elf_cache_lookup(config->cache, &st, &entry) < 0) {
+                elf_stats_end(&mark, STATS_MAGIC);
+                return -1;
+        }
+        elf_stats_end(&mark, STATS_MAGIC);
+
+        if (entry.type == ELF64 || entry.type == ELF32) {
+                struct elf_view view = { entry.data, entry.size };
+                struct elf_json json;
+
+                if (batch && config->format == FORMAT_TEXT) {
+                        fprintf(elf_out, "\n%s:\n", config->filename);
+                }
+
+                __json_doc_open(&json, config, NULL,
+                                (enum ELF_arch_type)entry.type, entry.size);
+                process_elf_image(&view, (enum ELF_arch_type)entry.type,
+                                  config);
+                __json_doc_close(&json, config);
+        }
+
+        if (entry.type == NOT_ELF && !batch) {
+                fprintf(ELF_ERR, "NOT A ELF FILE!\n");
+        }
+
+        type = entry.type;
+        elf_cache_release(&entry);
+        return type;
+}
+
+/*
+ * --search, every pattern over the whole input or the --search-in
+ * section / segment. ranges bigger than SEARCH_CHUNK are cut into
+ * chunks scanned on the pool, a match may cross into the next chunk
+ */
+#define SEARCH_CHUNK (4 * 1024 * 1024)
+
+struct search_job {
+        struct config *config;
+        const struct rule_range *ranges; /* --rules, NULL for --search */
+        const uint8_t *data;
+        uint64_t size; /* matches end before this */
+        uint64_t start;
+        uint64_t end; /* matches start in [start, end) */
+        struct search_hits hits;
+};
+
+/* file ranges of the sections, sorted, for labelling hits */
+struct search_sec {
+        uint64_t offset;
+        uint64_t end;
+        uint64_t index;
+};
+
+static void __search_task(struct thread_pool *tp, int worker, void *arg) {
+        struct search_job *job = (struct search_job *)arg;
+        struct config *config = job->config;
+
+        if (job->ranges) {
+                rules_scan(config->rules, job->ranges, job->data, job->size,
+                           job->start, job->end, &job->hits);
+                search_hits_sort(&job->hits);
+                return;
+        }
+
+        for (uint64_t i = 0; i < config->npatterns; i++) {
+                search_scan(&config->patterns[i], i, job->data, job->size,
+                            job->start, job->end, &job->hits);
+        }
+
+        search_hits_sort(&job->hits);
+}
+
+static void __search_scan(struct config *config, const uint8_t *data,
+                          uint64_t start, uint64_t end, int jobs,
+                          const struct rule_range *ranges,
+                          struct search_hits *out) {
+        struct thread_pool tp;
+        uint64_t n = (end - start + SEARCH_CHUNK - 1) / SEARCH_CHUNK;
+
+        memset(out, 0, sizeof(struct search_hits));
+        if (n == 0)
+                return;
+
+        struct search_job *job =
+            (struct search_job *)calloc(n, sizeof(struct search_job));
+        if (job == NULL)
+                return;
+
+        for (uint64_t i = 0; i < n; i++) {
+                job[i].config = config;
+                job[i].ranges = ranges;
+                job[i].data = data;
+                job[i].size = end;
+                job[i].start = start + i * SEARCH_CHUNK;
+                job[i].end = i == n - 1 ? end : job[i].start + SEARCH_CHUNK;
+        }
+
+        if (n > 1 && jobs > 1 &&
+            thread_pool_init(&tp, jobs < (int)n ? jobs : (int)n) == 0) {
+                for (uint64_t i = 0; i < n; i++) {
+                        thread_pool_submit(&tp, -1, __search_task, &job[i]);
+                }
+                thread_pool_wait(&tp);
+                thread_pool_destroy(&tp);
+        } else {
+                for (uint64_t i = 0; i < n; i++) {
+                        __search_task(NULL, 0, &job[i]);
+                }
+        }
+
+        /* chunks are in file order, their hits already sorted */
+        for (uint64_t i = 0; i < n; i++) {
+                if (out->hits == NULL) {
+                        *out = job[i].hits;
+                        continue;
+                }
+
+                struct search_hit *h = (struct search_hit *)realloc(
+                    out->hits,
+                    (out->n + job[i].hits.n) * sizeof(struct search_hit));
+                if (h) {
+                        memcpy(h + out->n, job[i].hits.hits,
+                               job[i].hits.n * sizeof(struct search_hit));
+                        out->hits = h;
+                        out->n = out->n + job[i].hits.n;
+                        out->cap = out->n;
+                }
+                search_hits_free(&job[i].hits);
+        }
+
+        free(job);
+}
+
+/* "seg:N" is program header N, anything else a section name */
+static int __search_range(struct ehd_file *elf, const char *spec,
+                          uint64_t *start, uint64_t *end) {
+        uint64_t size = ehd_size(elf);
+        uint64_t off;
+        uint64_t len;
+
+        if (strncmp(spec, "seg:", 4) == 0) {
+                Elf64_Phdr phdr;
+
+                if (ehd_segment(elf, strtoull(spec + 4, NULL, 0), &phdr) !=
+                    EHD_OK)
+                        return -1;
+
+                off = phdr.p_offset;
+                len = phdr.p_filesz;
+        } else {
+                Elf64_Shdr shdr;
+
+                if (ehd_section_by_name(elf, spec, &shdr, NULL) != EHD_OK ||
+                    shdr.sh_type == SHT_NOBITS)
+                        return -1;
+
+                off = shdr.sh_offset;
+                len = shdr.sh_size;
+        }
+
+        if (off > size || len > size - off)
+                return -1;
+
+        *start = off;
+        *end = off + len;
+        return 0;
+}
+
+static int __search_sec_cmp(const void *a, const void *b) {
+        const struct search_sec *x = (const struct search_sec *)a;
+        const struct search_sec *y = (const struct search_sec *)b;
+
+        return x->offset < y->offset ? -1 : x->offset > y->offset;
+}
+
+static struct search_sec *__search_secs(struct ehd_file *elf, uint64_t *n) {
+        uint64_t shnum = ehd_shnum(elf);
+        Elf64_Shdr shdr;
+
+        *n = 0;
+        struct search_sec *secs = (struct search_sec *)malloc(
+            (shnum + 1) * sizeof(struct search_sec));
+        if (secs == NULL)
+                return NULL;
+
+        for (uint64_t i = 0; ehd_section(elf, i, &shdr) == EHD_OK; i++) {
+                if (shdr.sh_type == SHT_NOBITS || shdr.sh_size == 0)
+                        continue;
+
+                secs[*n].offset = shdr.sh_offset;
+                secs[*n].end = shdr.sh_offset + shdr.sh_size;
+                secs[*n].index = i;
+                *n = *n + 1;
+        }
+
+        qsort(secs, *n, sizeof(struct search_sec), __search_sec_cmp);
+        return secs;
+}
+
+/* section holding file offset off, NULL when none */
+static const char *__search_sec_name(struct ehd_file *elf,
+                                     struct search_sec *secs, uint64_t n,
+                                     uint64_t off) {
+        uint64_t lo = 0;
+        uint64_t hi = n;
+        Elf64_Shdr shdr;
+
+        while (lo < hi) {
+                uint64_t mid = lo + (hi - lo) / 2;
+
+                if (secs[mid].offset <= off)
+                        lo = mid + 1;
+                else
+                        hi = mid;
+        }
+
+        if (lo == 0 || off >= secs[lo - 1].end ||
+            ehd_section(elf, secs[lo - 1].index, &shdr) != EHD_OK)
+                return NULL;
+
+        return ehd_section_name(elf, &shdr);
+}
+
+/* vaddr of file offset off through the PT_LOAD holding it */
+static int __search_vaddr(struct ehd_file *elf, uint64_t off,
+                          uint64_t *vaddr) {
+        Elf64_Phdr phdr;
+
+        for (uint64_t i = 0; ehd_segment(elf, i, &phdr) == EHD_OK; i++) {
+                if (phdr.p_type == PT_LOAD && off >= phdr.p_offset &&
+                    off - phdr.p_offset < phdr.p_filesz) {
+                        *vaddr = phdr.p_vaddr + (off - phdr.p_offset);
+                        return 0;
+                }
+        }
+
+        return -1;
+}
+
+/* a row before and after the rows holding the match */
+static void __search_context(struct elf_view *view, uint64_t off,
+                             uint32_t len, uint64_t *start, uint64_t *end) {
+        *start = off & ~(uint64_t)15;
+        *start = *start >= 16 ? *start - 16 : 0;
+        *end = ((off + len + 15) & ~(uint64_t)15) + 16;
+        if (*end > view->size)
+                *end = view->size;
+}
+
+__cold static void __search(struct config *config, struct elf_view *view,
+                            enum ELF_arch_type type, int jobs) {
+        struct ehd_allocator alloc;
+        struct search_hits hits;
+        struct elf_stats_mark mark;
+        struct ehd_file *elf = NULL;
+        struct search_sec *secs = NULL;
+        uint64_t nsecs = 0;
+        uint64_t start = 0;
+        uint64_t end = view->size;
+
+        if (view->data == NULL)
+                return;
+
+        if ((type == ELF64 || type == ELF32) &&
+            ehd_open_mem(view->data, view->size, __ehd_allocator(&alloc),
+                         &elf) != EHD_OK)
+                elf = NULL;
+
+        if (config->search_in &&
+            (elf == NULL ||
+             __search_range(elf, config->search_in, &start, &end) < 0)) {
+                fprintf(ELF_ERR, "--search-in %s: no such section or "
+                                 "segment in the file\n",
+                        config->search_in);
+                goto out;
+        }
+
+        if (config->search_in)
+                __advise_range(view->data + start, end - start);
+
+        elf_stats_begin(&mark);
+        __search_scan(config, view->data, start, end, jobs, NULL, &hits);
+        if (elf && hits.n)
+                secs = __search_secs(elf, &nsecs);
+
+        if (elf_json)
+                __json_list_begin(elf_json, "search");
+
+        for (uint64_t i = 0; i < hits.n; i++) {
+                struct search_pattern *p =
+                    &config->patterns[hits.hits[i].pattern];
+                uint64_t off = hits.hits[i].offset;
+                const char *sec = NULL;
+                uint64_t vaddr = 0;
+                int has_vaddr = 0;
+                uint64_t cs;
+                uint64_t ce;
+
+                if (elf) {
+                        sec = __search_sec_name(elf, secs, nsecs, off);
+                        has_vaddr = __search_vaddr(elf, off, &vaddr) == 0;
+                }
+                __search_context(view, off, p->len, &cs, &ce);
+
+                if (elf_json) {
+                        struct json_writer *w = &elf_json->w;
+
+                        __json_record_begin(elf_json, NULL, "search");
+                        json_key_str(w, "pattern", p->text);
+                        json_key_u64(w, "offset", off);
+                        json_key(w, "vaddr");
+                        has_vaddr ? json_hex(w, vaddr) : json_null(w);
+                        json_key(w, "section");
+                        sec ? json_str(w, sec) : json_null(w);
+                        json_key_u64(w, "context_offset", cs);
+                        json_key(w, "context");
+                        json_hex_begin(w);
+                        json_hex_bytes(w, view->data + cs, ce - cs);
+                        json_hex_end(w);
+                        __json_record_end(elf_json);
+                        continue;
+                }
+
+                fprintf(elf_out, "\nmatch '%s' at offset 0x%016" PRIx64,
+                        p->text, off);
+                if (has_vaddr)
+                        fprintf(elf_out, ", vaddr 0x%016" PRIx64, vaddr);
+                if (sec)
+                        fprintf(elf_out, ", section %s", sec);
+                fprintf(elf_out, "\n");
+                HEXDUMP_AT(view->data + cs, ce - cs, cs);
+        }
+
+        if (elf_json)
+                __json_list_end(elf_json);
+        else
+                fprintf(elf_out, "%" PRIu64 " matches\n", hits.n);
+
+        elf_stats_end(&mark, STATS_RENDER);
+        free(secs);
+        search_hits_free(&hits);
+
+out:
+        if (elf)
+                ehd_close(elf);
+}
+
+/*
+ * --rules, every rule in one pass over the whole input, a rule bound
+ * to a section only counts inside that section's file range
+ */
+static struct rule_range *__rules_ranges(struct rule_set *rs,
+                                         struct ehd_file *elf,
+                                         uint64_t size) {
+        struct rule_range *ranges = (struct rule_range *)calloc(
+            rs->n + 1, sizeof(struct rule_range));
+        Elf64_Shdr shdr;
+
+        for (uint32_t i = 0; ranges && i < rs->n; i++) {
+                const char *name = rs->rules[i].section;
+
+                if (name == NULL) {
+                        ranges[i].end = size;
+                } else if (elf &&
+                           ehd_section_by_name(elf, name, &shdr, NULL) ==
+                               EHD_OK &&
+                           shdr.sh_type != SHT_NOBITS &&
+                           shdr.sh_offset <= size &&
+                           shdr.sh_size <= size - shdr.sh_offset) {
+                        ranges[i].start = shdr.sh_offset;
+                        ranges[i].end = shdr.sh_offset + shdr.sh_size;
+                }
+        }
+
+        return ranges;
+}
+
+__cold static void __rules(struct config *config, struct elf_view *view,
+                           enum ELF_arch_type type, int jobs) {
+        struct ehd_allocator alloc;
+        struct search_hits hits;
+        struct elf_stats_mark mark;
+        struct ehd_file *elf = NULL;
+        struct search_sec *secs = NULL;
+        uint64_t nsecs = 0;
+
+        if (view->data == NULL)
+                return;
+
+        if ((type == ELF64 || type == ELF32) &&
+            ehd_open_mem(view->data, view->size, __ehd_allocator(&alloc),
+                         &elf) != EHD_OK)
+                elf = NULL;
+
+        struct rule_range *ranges =
+            __rules_ranges(config->rules, elf, view->size);
+        if (ranges == NULL)
+                goto out;
+
+        elf_stats_begin(&mark);
+        __search_scan(config, view->data, 0, view->size, jobs, ranges, &hits);
+        if (elf && hits.n)
+                secs = __search_secs(elf, &nsecs);
+
+        if (elf_json)
+                __json_list_begin(elf_json, "rules");
+
+        for (uint64_t i = 0; i < hits.n; i++) {
+                struct rule *r = &config->rules->rules[hits.hits[i].pattern];
+                uint64_t off = hits.hits[i].offset;
+                const char *sec = NULL;
+                uint64_t vaddr = 0;
+                int has_vaddr = 0;
+
+                if (elf) {
+                        sec = __search_sec_name(elf, secs, nsecs, off);
+                        has_vaddr = __search_vaddr(elf, off, &vaddr) == 0;
+                }
+
+                if (elf_json) {
+                        struct json_writer *w = &elf_json->w;
+
+                        __json_record_begin(elf_json, NULL, "rule");
+                        json_key_str(w, "rule", r->name);
+                        json_key_str(w, "pattern", r->text);
+                        json_key_u64(w, "offset", off);
+                        json_key(w, "vaddr");
+                        has_vaddr ? json_hex(w, vaddr) : json_null(w);
+                        json_key(w, "section");
+                        sec ? json_str(w, sec) : json_null(w);
+                        __json_record_end(elf_json);
+                        continue;
+                }
+
+                fprintf(elf_out, "rule %s at offset 0x%016" PRIx64, r->name,
+                        off);
+                if (has_vaddr)
+                        fprintf(elf_out, ", vaddr 0x%016" PRIx64, vaddr);
+                if (sec)
+                        fprintf(elf_out, ", section %s", sec);
+                fprintf(elf_out, "\n");
+        }
+
+        if (elf_json)
+                __json_list_end(elf_json);
+        else
+                fprintf(elf_out, "%" PRIu64 " rule hits\n", hits.n);
+
+        elf_stats_end(&mark, STATS_RENDER);
+        free(secs);
+        search_hits_free(&hits);
+
+out:
+        free(ranges);
+        if (elf)
+                ehd_close(elf);
+}
+
+/*
+ * --strings, printable runs of the whole input labelled with the
+ * section they start in, .debug_* can be left out of the scan
+ */
+#define STRINGS_MIN 4                     /* default --strings-min */
+#define STRINGS_CHUNK (4 * 1024 * 1024)   /* bytes handed to one task */
+
+struct strings_job {
+        const uint8_t *data;
+        uint64_t start;
+        uint64_t end;
+        uint64_t limit; /* end of the span, runs stop there */
+        uint32_t min;
+        int enc;
+        struct str_hits hits;
+};
+
+struct strings_span {
+        uint64_t start;
+        uint64_t end;
+};
+
+static void __strings_task(struct thread_pool *tp, int worker, void *arg) {
+        struct strings_job *job = (struct strings_job *)arg;
+
+        str_scan(job->data, job->start, job->end, job->limit, job->min,
+                 job->enc, &job->hits);
+}
+
+static int __strings_debug(const char *name) {
+        return name && (strncmp(name, ".debug", 6) == 0 ||
+                        strncmp(name, ".zdebug", 7) == 0);
+}
+
+/* [0, size) without the debug sections, secs sorted by offset */
+static struct strings_span *__strings_spans(struct ehd_file *elf,
+                                            struct search_sec *secs,
+                                            uint64_t nsecs, uint64_t size,
+                                            uint64_t *n) {
+        struct strings_span *spans = (struct strings_span *)malloc(
+            (nsecs + 1) * sizeof(struct strings_span));
+        uint64_t at = 0;
+        Elf64_Shdr shdr;
+
+        *n = 0;
+        if (spans == NULL)
+                return NULL;
+
+        for (uint64_t i = 0; elf && i < nsecs; i++) {
+                if (ehd_section(elf, secs[i].index, &shdr) != EHD_OK ||
+                    !__strings_debug(ehd_section_name(elf, &shdr)))
+                        continue;
+
+                uint64_t start = secs[i].offset < size ? secs[i].offset : size;
+                uint64_t end = secs[i].end < size ? secs[i].end : size;
+
+                if (start > at) {
+                        spans[*n].start = at;
+                        spans[*n].end = start;
+                        (*n)++;
+                }
+                if (end > at)
+                        at = end;
+        }
+
+        if (at < size) {
+                spans[*n].start = at;
+                spans[*n].end = size;
+                (*n)++;
+        }
+
+        return spans;
+}
+
+static void __strings_scan(struct config *config, const uint8_t *data,
+                           struct strings_span *spans, uint64_t nspans,
+                           int jobs, struct str_hits *out) {
+        struct thread_pool tp;
+        uint64_t n = 0;
+
+        memset(out, 0, sizeof(struct str_hits));
+        for (uint64_t i = 0; i < nspans; i++)
+                n += (spans[i].end - spans[i].start + STRINGS_CHUNK - 1) /
+                     STRINGS_CHUNK;
+        if (n == 0)
+                return;
+
+        struct strings_job *job =
+            (struct strings_job *)calloc(n, sizeof(struct strings_job));
+        if (job == NULL)
+                return;
+
+        n = 0;
+        for (uint64_t i = 0; i < nspans; i++) {
+                for (uint64_t off = spans[i].start; off < spans[i].end;
+                     off += STRINGS_CHUNK, n++) {
+                        job[n].data = data;
+                        job[n].start = off;
+                        job[n].end = spans[i].end - off < STRINGS_CHUNK
+                                         ? spans[i].end
+                                         : off + STRINGS_CHUNK;
+                        job[n].limit = spans[i].end;
+                        job[n].min = config->strings_min ? config->strings_min
+                                                         : STRINGS_MIN;
+                        job[n].enc = config->strings_enc ? config->strings_enc
+                                                         : STR_ASCII;
+                }
+        }
+
+        if (n > 1 && jobs > 1 &&
+            thread_pool_init(&tp, jobs < (int)n ? jobs : (int)n) == 0) {
+                for (uint64_t i = 0; i < n; i++) {
+                        thread_pool_submit(&tp, -1, __strings_task, &job[i]);
+                }
+                thread_pool_wait(&tp);
+                thread_pool_destroy(&tp);
+        } else {
+                for (uint64_t i = 0; i < n; i++) {
+                        __strings_task(NULL, 0, &job[i]);
+                }
+        }
+
+        /* spans and their chunks are in file order, hits sorted in each */
+        for (uint64_t i = 0; i < n; i++) {
+                if (out->hits == NULL) {
+                        *out = job[i].hits;
+                        continue;
+                }
+
+                struct str_hit *h = (struct str_hit *)realloc(
+                    out->hits,
+                    (out->n + job[i].hits.n) * sizeof(struct str_hit));
+                if (h) {
+                        memcpy(h + out->n, job[i].hits.hits,
+                               job[i].hits.n * sizeof(struct str_hit));
+                        out->hits = h;
+                        out->n = out->n + job[i].hits.n;
+                        out->cap = out->n;
+                }
+                str_hits_free(&job[i].hits);
+        }
+
+        free(job);
+}
+
+/* the characters of a hit, UTF-16LE narrowed into buf */
+static const char *__strings_text(const uint8_t *data,
+                                  const struct str_hit *h, char **buf,
+                                  uint64_t *cap, uint64_t *len) {
+        if (h->enc == STR_ASCII) {
+                *len = h->len;
+                return (const char *)data + h->offset;
+        }
+
+        *len = h->len / 2;
+        if (*len > *cap) {
+                char *p = (char *)realloc(*buf, *len);
+                if (p == NULL) {
+                        *len = 0;
+                        return "";
+                }
+                *buf = p;
+                *cap = *len;
+        }
+
+        for (uint64_t i = 0; i < *len; i++)
+                (*buf)[i] = data[h->offset + 2 * i];
+        return *buf;
+}
+
+__cold static void __strings(struct config *config, struct elf_view *view,
+                             enum ELF_arch_type type, int jobs) {
+        struct ehd_allocator alloc;
+        struct elf_stats_mark mark;
+        struct str_hits hits;
+        struct ehd_file *elf = NULL;
+        struct search_sec *secs = NULL;
+        struct strings_span whole = { 0, view->size };
+        struct strings_span *spans = &whole;
+        uint64_t nspans = 1;
+        uint64_t nsecs = 0;
+        char *buf = NULL;
+        uint64_t cap = 0;
+        int both = config->strings_enc == (STR_ASCII | STR_UTF16LE);
+
+        if (view->data == NULL)
+                return;
+
+        if ((type == ELF64 || type == ELF32) &&
+            ehd_open_mem(view->data, view->size, __ehd_allocator(&alloc),
+                         &elf) == EHD_OK)
+                secs = __search_secs(elf, &nsecs);
+
+        if (config->skip_debug && secs) {
+                spans = __strings_spans(elf, secs, nsecs, view->size, &nspans);
+                if (spans == NULL)
+                        goto out;
+        }
+
+        elf_stats_begin(&mark);
+        __strings_scan(config, view->data, spans, nspans, jobs, &hits);
+
+        if (elf_json)
+                __json_list_begin(elf_json, "strings");
+
+        for (uint64_t i = 0; i < hits.n; i++) {
+                struct str_hit *h = &hits.hits[i];
+                const char *sec = NULL;
+                uint64_t len;
+
+                if (secs)
+                        sec = __search_sec_name(elf, secs, nsecs, h->offset);
+
+                const char *text =
+                    __strings_text(view->data, h, &buf, &cap, &len);
+
+                if (elf_json) {
+                        struct json_writer *w = &elf_json->w;
+
+                        __json_record_begin(elf_json, NULL, "string");
+                        json_key_u64(w, "offset", h->offset);
+                        json_key(w, "section");
+                        sec ? json_str(w, sec) : json_null(w);
+                        json_key_str(w, "encoding", h->enc == STR_ASCII
+                                                        ? "ascii"
+                                                        : "utf16le");
+                        json_key(w, "text");
+                        json_strn(w, text, len);
+                        __json_record_end(elf_json);
+                        continue;
+                }
+
+                fprintf(elf_out, "0x%08" PRIx64 "  ", h->offset);
+                if (elf)
+                        fprintf(elf_out, "%-20s ", sec ? sec : "-");
+                if (both)
+                        fputs(h->enc == STR_ASCII ? "ascii   " : "utf16le ",
+                              elf_out);
+                fwrite(text, 1, len, elf_out);
+                fputc('\n', elf_out);
+        }
+
+        if (elf_json)
+                __json_list_end(elf_json);
+        else
+                fprintf(elf_out, "%" PRIu64 " strings\n", hits.n);
+
+        elf_stats_end(&mark, STATS_RENDER);
+        str_hits_free(&hits);
+
+out:
+        free(buf);
+        if (spans != &whole)
+                free(spans);
+        free(secs);
+        if (elf)
+                ehd_close(elf);
+}
+
+/*
+ * --hash ALGO, a digest of every section and segment, written in the
+ * --verify manifest format
+ *
+ * ranges are swept in address order a piece at a time, every range
+ * overlapping the piece takes its bytes while they are still in cache,
+ * so a segment and the sections inside it cost one read of the input
+ *
+ * overlapping ranges form a cluster, one task each, CRC32C clusters
+ * are cut further into HASH_CHUNK tasks and their parts combined
+ */
+#define HASH_PIECE (256 * 1024)         /* bytes swept at once */
+#define HASH_CHUNK (16 * 1024 * 1024)   /* CRC32C bytes handed to one task */
+
+struct hash_range {
+        uint64_t start;
+        uint64_t end;
+        uint64_t index;   /* section or segment index */
+        const char *name; /* section name, NULL for segments */
+        char *label;      /* "section:.text", "segment:2", "file" */
+        uint8_t digest[DIGEST_MAX];
+        uint32_t len;
+};
+
+struct hash_job {
+        const uint8_t *data;
+        struct hash_range **ranges; /* the cluster, sorted by start */
+        uint64_t nranges;
+        uint64_t start;
+        uint64_t end;
+        struct digest_ctx *ctx; /* one per range of the cluster */
+};
+
+static void __hash_task(struct thread_pool *tp, int worker, void *arg) {
+        struct hash_job *job = (struct hash_job *)arg;
+
+        for (uint64_t at = job->start; at < job->end; at += HASH_PIECE) {
+                uint64_t end = job->end - at < HASH_PIECE ? job->end
+                                                          : at + HASH_PIECE;
+
+                for (uint64_t i = 0; i < job->nranges; i++) {
+                        const struct hash_range *r = job->ranges[i];
+
+                        if (r->start >= end)
+                                break;
+
+                        uint64_t lo = r->start > at ? r->start : at;
+                        uint64_t hi = r->end < end ? r->end : end;
+
+                        if (lo < hi)
+                                digest_update(&job->ctx[i], job->data + lo,
+                                              hi - lo);
+                }
+        }
+}
+
+static int __hash_range_cmp(const void *a, const void *b) {
+        const struct hash_range *x = *(struct hash_range *const *)a;
+        const struct hash_range *y = *(struct hash_range *const *)b;
+
+        if (x->start != y->start)
+                return x->start < y->start ? -1 : 1;
+        return x->end > y->end ? -1 : x->end < y->end;
+}
+
+static int __hash_name_cmp(const void *a, const void *b) {
+        const struct hash_range *x = *(struct hash_range *const *)a;
+        const struct hash_range *y = *(struct hash_range *const *)b;
+        int c = strcmp(x->name, y->name);
+
+        if (c)
+                return c;
+        return x->index < y->index ? -1 : x->index > y->index;
+}
+
+/*
+ * section:NAME, the second .text of a file is section:.text#2, so the
+ * label of every section stays unique
+ */
+static int __hash_labels(struct hash_range *ranges, uint64_t n,
+                         struct hash_range **by) {
+        uint64_t nsecs = 0;
+        uint64_t dup = 0;
+
+        for (uint64_t i = 0; i < n; i++) {
+                struct hash_range *r = &ranges[i];
+                size_t size = (r->name ? strlen(r->name) : 0) + 48;
+
+                r->label = (char *)malloc(size);
+                if (r->label == NULL)
+                        return -1;
+
+                if (r->name)
+                        by[nsecs++] = r;
+                else if (r->index == UINT64_MAX)
+                        snprintf(r->label, size, "file");
+                else
+                        snprintf(r->label, size, "segment:%" PRIu64,
+                                 r->index);
+        }
+
+        qsort(by, nsecs, sizeof(struct hash_range *), __hash_name_cmp);
+
+        for (uint64_t i = 0; i < nsecs; i++) {
+                struct hash_range *r = by[i];
+                size_t size = strlen(r->name) + 48;
+
+                dup = i > 0 && strcmp(by[i - 1]->name, r->name) == 0 ? dup + 1
+                                                                     : 1;
+                if (r->name[0] == 0)
+                        snprintf(r->label, size, "section:[%" PRIu64 "]",
+                                 r->index);
+                else if (dup > 1)
+                        snprintf(r->label, size, "section:%s#%" PRIu64,
+                                 r->name, dup);
+                else
+                        snprintf(r->label, size, "section:%s", r->name);
+        }
+
+        return 0;
+}
+
+/* sections with file bytes and every segment, or the whole file */
+static struct hash_range *__hash_ranges(struct ehd_file *elf, uint64_t size,
+                                        int segments, uint64_t *n) {
+        uint64_t shnum = elf ? ehd_shnum(elf) : 0;
+        uint64_t phnum = elf && segments ? ehd_phnum(elf) : 0;
+        struct hash_range *ranges = (struct hash_range *)calloc(
+            shnum + phnum + 1, sizeof(struct hash_range));
+        Elf64_Shdr shdr;
+        Elf64_Phdr phdr;
+
+        *n = 0;
+        if (ranges == NULL)
+                return NULL;
+
+        for (uint64_t i = 1; i < shnum; i++) {
+                if (ehd_section(elf, i, &shdr) != EHD_OK ||
+                    shdr.sh_type == SHT_NOBITS)
+                        continue;
+
+                const char *name = ehd_section_name(elf, &shdr);
+                struct hash_range *r = &ranges[(*n)++];
+
+                r->start = shdr.sh_offset < size ? shdr.sh_offset : size;
+                r->end = shdr.sh_size < size - r->start
+                             ? r->start + shdr.sh_size
+                             : size;
+                r->index = i;
+                r->name = name ? name : "";
+        }
+
+        for (uint64_t i = 0; i < phnum; i++) {
+                if (ehd_segment(elf, i, &phdr) != EHD_OK)
+                        continue;
+
+                struct hash_range *r = &ranges[(*n)++];
+
+                r->start = phdr.p_offset < size ? phdr.p_offset : size;
+                r->end = phdr.p_filesz < size - r->start
+                             ? r->start + phdr.p_filesz
+                             : size;
+                r->index = i;
+        }
+
+        if (*n == 0) {
+                ranges[0].end = size;
+                ranges[0].index = UINT64_MAX;
+                *n = 1;
+        }
+
+        return ranges;
+}
+
+/* the tasks of the clusters of order[0, n), NULL when out of memory */
+static struct hash_job *__hash_jobs(const uint8_t *data,
+                                    struct hash_range **order, uint64_t n,
+                                    int algo, uint64_t *njobs) {
+        uint64_t chunk = algo == DIGEST_CRC32C ? HASH_CHUNK : UINT64_MAX;
+        uint64_t nctx = 0;
+        struct hash_job *job = NULL;
+
+        /* twice over the clusters, counting then filling */
+        for (int fill = 0; fill < 2; fill++) {
+                struct digest_ctx *ctx = fill ? job->ctx : NULL;
+
+                *njobs = 0;
+                for (uint64_t i = 0, j; i < n; i = j) {
+                        uint64_t end = order[i]->end;
+
+                        for (j = i + 1; j < n && order[j]->start < end; j++)
+                                if (order[j]->end > end)
+                                        end = order[j]->end;
+
+                        uint64_t at = order[i]->start;
+                        do {
+                                uint64_t stop = end - at < chunk ? end
+                                                                 : at + chunk;
+
+                                if (fill) {
+                                        struct hash_job *k = &job[*njobs];
+
+                                        k->data = data;
+                                        k->ranges = &order[i];
+                                        k->nranges = j - i;
+                                        k->start = at;
+                                        k->end = stop;
+                                        k->ctx = ctx;
+                                        for (uint64_t r = 0; r < j - i; r++)
+                                                digest_init(&ctx[r], algo);
+                                        ctx += j - i;
+                                } else {
+                                        nctx += j - i;
+                                }
+
+                                (*njobs)++;
+                                at = stop;
+                        } while (at < end);
+                }
+
+                if (fill)
+                        break;
+
+                job = (struct hash_job *)calloc(*njobs,
+                                                sizeof(struct hash_job));
+                if (job == NULL)
+                        return NULL;
+
+                job->ctx = (struct digest_ctx *)malloc(
+                    nctx * sizeof(struct digest_ctx));
+                if (job->ctx == NULL) {
+                        free(job);
+                        return NULL;
+                }
+        }
+
+        return job;
+}
+
+/* digests of the ranges, the CRC32C parts joined in file order */
+static void __hash_finish(struct hash_job *job, uint64_t njobs, int algo) {
+        for (uint64_t k = 0; k < njobs; k++) {
+                struct hash_job *first = &job[k];
+
+                if (algo != DIGEST_CRC32C) {
+                        for (uint64_t r = 0; r < first->nranges; r++)
+                                first->ranges[r]->len = digest_final(
+                                    &first->ctx[r], first->ranges[r]->digest);
+                        continue;
+                }
+
+                /* the tasks of one cluster share its ranges */
+                uint64_t last = k;
+                while (last + 1 < njobs &&
+                       job[last + 1].ranges == first->ranges)
+                        last++;
+
+                for (uint64_t r = 0; r < first->nranges; r++) {
+                        struct hash_range *range = first->ranges[r];
+                        struct digest_ctx *c = &first->ctx[r];
+
+                        for (uint64_t p = k + 1; p <= last; p++) {
+                                uint64_t lo = range->start > job[p].start
+                                                  ? range->start
+                                                  : job[p].start;
+                                uint64_t hi = range->end < job[p].end
+                                                  ? range->end
+                                                  : job[p].end;
+
+                                if (lo < hi)
+                                        c->u.crc = crc32c_combine(
+                                            c->u.crc, job[p].ctx[r].u.crc,
+                                            hi - lo);
+                        }
+                        range->len = digest_final(c, range->digest);
+                }
+                k = last;
+        }
+}
+
+static void __hash_run(const uint8_t *data, struct hash_range **order,
+                       uint64_t n, int algo, int jobs) {
+        struct thread_pool tp;
+        uint64_t njobs;
+
+        qsort(order, n, sizeof(struct hash_range *), __hash_range_cmp);
+
+        struct hash_job *job = __hash_jobs(data, order, n, algo, &njobs);
+        if (job == NULL)
+                return;
+
+        if (njobs > 1 && jobs > 1 &&
+            thread_pool_init(&tp, jobs < (int)njobs ? jobs : (int)njobs) ==
+                0) {
+                for (uint64_t i = 0; i < njobs; i++) {
+                        thread_pool_submit(&tp, -1, __hash_task, &job[i]);
+                }
+                thread_pool_wait(&tp);
+                thread_pool_destroy(&tp);
+        } else {
+                for (uint64_t i = 0; i < njobs; i++) {
+                        __hash_task(NULL, 0, &job[i]);
+                }
+        }
+
+        __hash_finish(job, njobs, algo);
+        free(job->ctx);
+        free(job);
+}
+
+/* "ok", "failed" or "new" against --verify, counted there */
+static const char *__hash_check(struct manifest *m, const char *path,
+                                const struct hash_range *r, int algo) {
+        struct manifest_entry *e = manifest_find(m, path, r->label);
+
+        if (e == NULL) {
+                __atomic_add_fetch(&m->added, 1, __ATOMIC_RELAXED);
+                return "new";
+        }
+
+        __atomic_store_n(&e->seen, 1, __ATOMIC_RELAXED);
+        __atomic_add_fetch(&m->checked, 1, __ATOMIC_RELAXED);
+
+        if (e->algo != algo || e->len != r->len ||
+            memcmp(e->digest, r->digest, r->len) != 0) {
+                __atomic_add_fetch(&m->failed, 1, __ATOMIC_RELAXED);
+                return "failed";
+        }
+
+        return "ok";
+}
+
+__cold static void __hash(struct config *config, struct elf_view *view,
+                          enum ELF_arch_type type, int jobs) {
+        struct ehd_allocator alloc;
+        struct elf_stats_mark mark;
+        struct ehd_file *elf = NULL;
+        struct hash_range *ranges;
+        struct hash_range **order = NULL;
+        uint64_t n = 0;
+        int algo = config->hash_algo;
+        char hex[DIGEST_MAX * 2 + 1];
+
+        if (view->data == NULL)
+                return;
+
+        if ((type == ELF64 || type == ELF32) &&
+            ehd_open_mem(view->data, view->size, __ehd_allocator(&alloc),
+                         &elf) != EHD_OK)
+                elf = NULL;
+
+        ranges = __hash_ranges(elf, view->size, 1, &n);
+
+        if (ranges)
+                order = (struct hash_range **)malloc(
+                    n * sizeof(struct hash_range *));
+        if (order == NULL || __hash_labels(ranges, n, order) < 0)
+                goto out;
+
+        elf_stats_begin(&mark);
+        for (uint64_t i = 0; i < n; i++)
+                order[i] = &ranges[i];
+        __hash_run(view->data, order, n, algo, jobs);
+
+        if (elf_json)
+                __json_list_begin(elf_json, "hashes");
+
+        for (uint64_t i = 0; i < n; i++) {
+                struct hash_range *r = &ranges[i];
+                const char *status = NULL;
+
+                for (uint32_t k = 0; k < r->len; k++)
+                        sprintf(hex + 2 * k, "%02x", r->digest[k]);
+                hex[2 * r->len] = 0;
+
+                if (config->verify)
+                        status = __hash_check(config->verify,
+                                              config->filename, r, algo);
+
+                if (elf_json) {
+                        struct json_writer *w = &elf_json->w;
+
+                        __json_record_begin(elf_json, NULL, "hash");
+                        json_key_str(w, "range", r->label);
+                        json_key_u64(w, "offset", r->start);
+                        json_key_u64(w, "size", r->end - r->start);
+                        json_key_str(w, "algo", digest_name(algo));
+                        json_key_str(w, "digest", hex);
+                        if (status)
+                                json_key_str(w, "status", status);
+                        __json_record_end(elf_json);
+                        continue;
+                }
+
+                if (status == NULL)
+                        fprintf(elf_out, "%s:%s %s %s\n", digest_name(algo),
+                                hex, r->label, config->filename);
+                else if (strcmp(status, "ok") != 0)
+                        fprintf(elf_out, "%-7s %s %s\n",
+                                status[0] == 'n' ? "NEW" : "FAILED", r->label,
+                                config->filename);
+        }
+
+        if (elf_json)
+                __json_list_end(elf_json);
+
+        elf_stats_end(&mark, STATS_RENDER);
+
+out:
+        for (uint64_t i = 0; ranges && i < n; i++)
+                free(ranges[i].label);
+        free(ranges);
+        free(order);
+        if (elf)
+                ehd_close(elf);
+}
+
+static int __verify_path_cmp(const void *a, const void *b) {
+        const struct manifest_entry *x = *(struct manifest_entry *const *)a;
+        const struct manifest_entry *y = *(struct manifest_entry *const *)b;
+        int c = strcmp(x->path, y->path);
+
+        if (c)
+                return c;
+        return x < y ? -1 : x > y;
+}
+
+/*
+ * end of a --verify run, ranges of a checked path that no input
+ * produced are missing, 0 when everything matched
+ *
+ * a path is checked when any of its ranges was seen, or always when
+ * the inputs came from the manifest itself
+ */
+static int __verify_report(struct config *config) {
+        struct manifest *m = config->verify;
+        FILE *out = config->format == FORMAT_TEXT ? elf_out : ELF_ERR;
+        uint64_t missing = 0;
+
+        struct manifest_entry **by = (struct manifest_entry **)malloc(
+            (m->n + 1) * sizeof(struct manifest_entry *));
+        if (by == NULL)
+                return -1;
+
+        for (uint64_t i = 0; i < m->n; i++)
+                by[i] = &m->entries[i];
+        qsort(by, m->n, sizeof(struct manifest_entry *), __verify_path_cmp);
+
+        for (uint64_t i = 0, j; i < m->n; i = j) {
+                int checked = m->inputs;
+
+                for (j = i; j < m->n && strcmp(by[j]->path, by[i]->path) == 0;
+                     j++)
+                        checked = checked || by[j]->seen;
+
+                for (uint64_t k = i; checked && k < j; k++) {
+                        struct manifest_entry *e = by[k];
+
+                        if (e->seen || manifest_find(m, e->path, e->range) != e)
+                                continue;
+
+                        fprintf(out, "%-7s %s %s\n", "MISSING", e->range,
+                                e->path);
+                        missing++;
+                }
+        }
+
+        fprintf(out,
+                "%" PRIu64 " ranges checked, %" PRIu64 " failed, %" PRIu64
+                " new, %" PRIu64 " missing\n",
+                m->checked, m->failed, m->added, missing);
+
+        free(by);
+        return m->failed || m->added || missing ? -1 : 0;
+}
+
+/*
+ * --dedup, sections of every input hashed with XXH64 by the --hash
+ * sweep and counted in one index, reported once all inputs are done
+ */
+#define DEDUP_TOP 20 /* rows of each text table */
+
+static void __dedup_file(struct config *config, struct elf_view *view,
+                         enum ELF_arch_type type, int jobs) {
+        struct ehd_allocator alloc;
+        struct elf_stats_mark mark;
+        struct ehd_file *elf = NULL;
+        struct hash_range *ranges = NULL;
+        struct hash_range **order = NULL;
+        struct dedup_sec *secs = NULL;
+        uint64_t n = 0;
+        uint64_t m = 0;
+
+        if (view->data == NULL || (type != ELF64 && type != ELF32) ||
+            ehd_open_mem(view->data, view->size, __ehd_allocator(&alloc),
+                         &elf) != EHD_OK)
+                return;
+
+        ranges = __hash_ranges(elf, view->size, 0, &n);
+        if (ranges) {
+                order = (struct hash_range **)malloc(
+                    n * sizeof(struct hash_range *));
+                secs = (struct dedup_sec *)malloc(n *
+                                                  sizeof(struct dedup_sec));
+        }
+        if (order == NULL || secs == NULL)
+                goto out;
+
+        elf_stats_begin(&mark);
+        for (uint64_t i = 0; i < n; i++)
+                order[i] = &ranges[i];
+        __hash_run(view->data, order, n, DIGEST_XXH64, jobs);
+
+        /* empty sections and the whole file stand in for nothing */
+        for (uint64_t i = 0; i < n; i++) {
+                struct hash_range *r = &ranges[i];
+
+                if (r->name == NULL || r->end == r->start)
+                        continue;
+
+                secs[m].hash = 0;
+                for (uint32_t k = 0; k < r->len; k++)
+                        secs[m].hash = secs[m].hash << 8 | r->digest[k];
+                secs[m].size = r->end - r->start;
+                secs[m].name = r->name;
+                m++;
+        }
+
+        if (dedup_add(config->dedup, config->filename, secs, m) < 0)
+                fprintf(ELF_ERR, "%s: dedup index out of memory\n",
+                        config->filename);
+        elf_stats_end(&mark, STATS_RENDER);
+
+out:
+        free(secs);
+        free(order);
+        free(ranges);
+        ehd_close(elf);
+}
+
+static const struct pretty_col dedup_group_cols[] = {
+        {"size", 12, 0},
+        {"copies", 8, 0},
+        {"wasted", 14, 0},
+        {"first", 40, PRETTY_NOPAD},
+};
+
+static const struct pretty_col dedup_name_cols[] = {
+        {"section", 24, PRETTY_TRUNCATE},
+        {"copies", 10, 0},
+        {"wasted", 14, PRETTY_NOPAD},
+};
+
+static const struct pretty_col dedup_lib_cols[] = {
+        {"library", 28, PRETTY_TRUNCATE},
+        {"files", 8, 0},
+        {"sections", 10, 0},
+        {"wasted", 14, PRETTY_NOPAD},
+};
+
+/* sort keys of the report, wasted bytes then id */
+struct dedup_rank {
+        uint64_t wasted;
+        uint64_t id;
+};
+
+static int __dedup_rank_cmp(const void *a, const void *b) {
+        const struct dedup_rank *x = (const struct dedup_rank *)a;
+        const struct dedup_rank *y = (const struct dedup_rank *)b;
+
+        if (x->wasted != y->wasted)
+                return x->wasted > y->wasted ? -1 : 1;
+        return x->id < y->id ? -1 : x->id > y->id;
+}
+
+/* ids of n stats with bytes wasted, most first */
+static struct dedup_rank *__dedup_rank_stats(const struct dedup_stat *stat,
+                                             uint64_t n, uint64_t *nrank) {
+        struct dedup_rank *rank = (struct dedup_rank *)malloc(
+            (n + 1) * sizeof(struct dedup_rank));
+
+        *nrank = 0;
+        if (rank == NULL)
+                return NULL;
+
+        for (uint64_t i = 0; i < n; i++) {
+                if (stat[i].wasted == 0)
+                        continue;
+
+                rank[*nrank].wasted = stat[i].wasted;
+                rank[*nrank].id = i;
+                (*nrank)++;
+        }
+
+        qsort(rank, *nrank, sizeof(struct dedup_rank), __dedup_rank_cmp);
+        return rank;
+}
+
+static struct dedup_rank *__dedup_rank_groups(const struct dedup *d,
+                                              uint64_t *nrank) {
+        struct dedup_rank *rank = (struct dedup_rank *)malloc(
+            (d->n + 1) * sizeof(struct dedup_rank));
+
+        *nrank = 0;
+        if (rank == NULL)
+                return NULL;
+
+        for (uint64_t i = 0; i < d->n; i++) {
+                const struct dedup_entry *e = &d->entries[i];
+
+                if (e->copies < 2)
+                        continue;
+
+                rank[*nrank].wasted = (e->copies - 1) * e->size;
+                rank[*nrank].id = i;
+                (*nrank)++;
+        }
+
+        qsort(rank, *nrank, sizeof(struct dedup_rank), __dedup_rank_cmp);
+        return rank;
+}
+
+static const char *__dedup_first_path(const struct dedup *d,
+                                      const struct dedup_entry *e) {
+        return e->path == DEDUP_NONE ? "-" : dedup_str(&d->paths, e->path);
+}
+
+static void __dedup_text(const struct dedup *d, const struct dedup_rank *g,
+                         uint64_t ng, const struct dedup_rank *s,
+                         uint64_t ns, const struct dedup_rank *l,
+                         uint64_t nl) {
+        struct pretty_table t;
+
+        fprintf(elf_out,
+                "%" PRIu64 " files, %" PRIu64 " sections, %" PRIu64
+                " distinct, %" PRIu64 " bytes, %" PRIu64
+                " wasted (%.1f%%)\n",
+                d->files, d->sections, d->n, d->bytes, d->wasted,
+                d->bytes ? 100.0 * d->wasted / d->bytes : 0.0);
+
+        if (ng == 0)
+                return;
+
+        fprintf(elf_out, "\nmost duplicated sections\n");
+        pretty_table_init(&t, elf_out, dedup_group_cols,
+                          SIZE(dedup_group_cols, struct pretty_col));
+        pretty_table_header(&t);
+        for (uint64_t i = 0; i < ng && i < DEDUP_TOP; i++) {
+                const struct dedup_entry *e = &d->entries[g[i].id];
+                const char *path = __dedup_first_path(d, e);
+                const char *name = dedup_str(&d->names, e->name);
+                size_t plen = strlen(path);
+                size_t nlen = strlen(name);
+                char first[PRETTY_MAX_WIDTH];
+
+                /* path:section, the path is cut from the left */
+                if (plen + nlen + 1 >= sizeof(first) &&
+                    nlen + 2 < sizeof(first))
+                        path += plen - (sizeof(first) - nlen - 2);
+                snprintf(first, sizeof(first), "%s:%s", path, name);
+
+                pretty_cell_u64(&t, e->size);
+                pretty_cell_u64(&t, e->copies);
+                pretty_cell_u64(&t, g[i].wasted);
+                pretty_cell_str(&t, first);
+                pretty_row_end(&t);
+        }
+        pretty_table_flush(&t);
+
+        fprintf(elf_out, "\nwasted by section name\n");
+        pretty_table_init(&t, elf_out, dedup_name_cols,
+                          SIZE(dedup_name_cols, struct pretty_col));
+        pretty_table_header(&t);
+        for (uint64_t i = 0; i < ns && i < DEDUP_TOP; i++) {
+                pretty_cell_str(&t, dedup_str(&d->names, s[i].id));
+                pretty_cell_u64(&t, d->by_name[s[i].id].copies);
+                pretty_cell_u64(&t, s[i].wasted);
+                pretty_row_end(&t);
+        }
+        pretty_table_flush(&t);
+
+        fprintf(elf_out, "\nwasted by library\n");
+        pretty_table_init(&t, elf_out, dedup_lib_cols,
+                          SIZE(dedup_lib_cols, struct pretty_col));
+        pretty_table_header(&t);
+        for (uint64_t i = 0; i < nl && i < DEDUP_TOP; i++) {
+                const struct dedup_stat *st = &d->by_lib[l[i].id];
+
+                pretty_cell_str(&t, dedup_str(&d->libs, l[i].id));
+                pretty_cell_u64(&t, st->files);
+                pretty_cell_u64(&t, st->copies);
+                pretty_cell_u64(&t, l[i].wasted);
+                pretty_row_end(&t);
+        }
+        pretty_table_flush(&t);
+}
+
+/*
+ * "dedup" of the set document, every list in full, or with ndjson one
+ * record for the totals and one for each row
+ */
+static void __dedup_json(struct elf_json *j, const struct dedup *d,
+                         const struct dedup_rank *g, uint64_t ng,
+                         const struct dedup_rank *s, uint64_t ns,
+                         const struct dedup_rank *l, uint64_t nl) {
+        struct json_writer *w = &j->w;
+
+        __json_record_begin(j, "dedup", "dedup");
+        json_key_u64(w, "files", d->files);
+        json_key_u64(w, "nsections", d->sections);
+        json_key_u64(w, "distinct", d->n);
+        json_key_u64(w, "bytes", d->bytes);
+        json_key_u64(w, "wasted", d->wasted);
+        if (j->ndjson)
+                __json_record_end(j);
+
+        __json_list_begin(j, "groups");
+        for (uint64_t i = 0; i < ng; i++) {
+                const struct dedup_entry *e = &d->entries[g[i].id];
+
+                __json_record_begin(j, NULL, "dedup_group");
+                json_key_hex(w, "hash", e->hash);
+                json_key_u64(w, "size", e->size);
+                json_key_u64(w, "copies", e->copies);
+                json_key_u64(w, "wasted", g[i].wasted);
+                json_key_str(w, "first_file", __dedup_first_path(d, e));
+                json_key_str(w, "first_section",
+                             dedup_str(&d->names, e->name));
+                __json_record_end(j);
+        }
+        __json_list_end(j);
+
+        __json_list_begin(j, "sections");
+        for (uint64_t i = 0; i < ns; i++) {
+                __json_record_begin(j, NULL, "dedup_section");
+                json_key_str(w, "name", dedup_str(&d->names, s[i].id));
+                json_key_u64(w, "copies", d->by_name[s[i].id].copies);
+                json_key_u64(w, "wasted", s[i].wasted);
+                __json_record_end(j);
+        }
+        __json_list_end(j);
+
+        __json_list_begin(j, "libraries");
+        for (uint64_t i = 0; i < nl; i++) {
+                const struct dedup_stat *st = &d->by_lib[l[i].id];
+
+                __json_record_begin(j, NULL, "dedup_library");
+                json_key_str(w, "name", dedup_str(&d->libs, l[i].id));
+                json_key_u64(w, "files", st->files);
+                json_key_u64(w, "sections", st->copies);
+                json_key_u64(w, "wasted", l[i].wasted);
+                __json_record_end(j);
+        }
+        __json_list_end(j);
+
+        if (!j->ndjson)
+                __json_record_end(j);
+}
+
+static void __dedup_report(struct config *config) {
+        const struct dedup *d = config->dedup;
+        uint64_t ng, ns, nl;
+
+        struct dedup_rank *g = __dedup_rank_groups(d, &ng);
+        struct dedup_rank *s = __dedup_rank_stats(d->by_name, d->names.n, &ns);
+        struct dedup_rank *l = __dedup_rank_stats(d->by_lib, d->libs.n, &nl);
+
+        if (g && s && l) {
+                if (elf_json)
+                        __dedup_json(elf_json, d, g, ng, s, ns, l, nl);
+                else
+                        __dedup_text(d, g, ng, s, ns, l, nl);
+        }
+
+        free(g);
+        free(s);
+        free(l);
+}
+
+/*
+ * --simhash, TLSH style digests of .text, .rodata and .data, printed
+ * per input, or with --simhash-pairs N kept for the whole batch and the
+ * N closest pairs ranked once every input is done
+ */
+#define SIMHASH_CHUNK 65536 /* pairs scored by one task */
+
+static const char *const simhash_secs[SIMHASH_SECS] = {
+        ".text",
+        ".rodata",
+        ".data",
+};
+
+struct simhash_job {
+        const uint8_t *data;
+        uint64_t size;
+        struct simhash h;
+        int ok;
+};
+
+struct simhash_score_job {
+        const struct simhash_set *set;
+        struct simhash_pair *pairs;
+        uint64_t n;
+};
+
+static void __simhash_task(struct thread_pool *tp, int worker, void *arg) {
+        struct simhash_job *job = (struct simhash_job *)arg;
+
+        job->ok = simhash_compute(job->data, job->size, &job->h) == 0;
+}
+
+static void __simhash_score_task(struct thread_pool *tp, int worker,
+                                 void *arg) {
+        struct simhash_score_job *job = (struct simhash_score_job *)arg;
+
+        for (uint64_t i = 0; i < job->n; i++) {
+                if (simhash_score(job->set, &job->pairs[i]) < 0)
+                        job->pairs[i].distance = UINT32_MAX;
+        }
+}
+
+/* tasks run on the pool when there are jobs to spare */
+static void __simhash_pool(void (*fn)(struct thread_pool *, int, void *),
+                           void *jobs_base, size_t job_size, uint64_t n,
+                           int jobs) {
+        struct thread_pool tp;
+        uint8_t *base = (uint8_t *)jobs_base;
+
+        if (n > 1 && jobs > 1 &&
+            thread_pool_init(&tp, jobs < (int)n ? jobs : (int)n) == 0) {
+                for (uint64_t i = 0; i < n; i++) {
+                        thread_pool_submit(&tp, -1, fn, base + i * job_size);
+                }
+                thread_pool_wait(&tp);
+                thread_pool_destroy(&tp);
+        } else {
+                for (uint64_t i = 0; i < n; i++) {
+                        fn(NULL, 0, base + i * job_size);
+                }
+        }
+}
+
+__cold static void __simhash(struct config *config, struct elf_view *view,
+                             enum ELF_arch_type type, int jobs) {
+        struct ehd_allocator alloc;
+        struct elf_stats_mark mark;
+        struct simhash_job job[SIMHASH_SECS];
+        struct simhash h[SIMHASH_SECS];
+        struct ehd_file *elf = NULL;
+        uint8_t present = 0;
+        char hex[SIMHASH_HEX];
+
+        if (view->data == NULL || (type != ELF64 && type != ELF32) ||
+            ehd_open_mem(view->data, view->size, __ehd_allocator(&alloc),
+                         &elf) != EHD_OK)
+                return;
+
+        elf_stats_begin(&mark);
+        memset(job, 0, sizeof(job));
+        for (int s = 0; s < SIMHASH_SECS; s++) {
+                Elf64_Shdr shdr;
+                uint64_t index;
+
+                if (ehd_section_by_name(elf, simhash_secs[s], &shdr,
+                                        &index) != EHD_OK ||
+                    shdr.sh_type == SHT_NOBITS ||
+                    shdr.sh_offset > view->size ||
+                    shdr.sh_size > view->size - shdr.sh_offset)
+                        continue;
+
+                job[s].data = view->data + shdr.sh_offset;
+                job[s].size = shdr.sh_size;
+                __advise_range(job[s].data, job[s].size);
+        }
+
+        __simhash_pool(__simhash_task, job, sizeof(struct simhash_job),
+                       SIMHASH_SECS, jobs);
+
+        for (int s = 0; s < SIMHASH_SECS; s++) {
+                h[s] = job[s].h;
+                if (job[s].ok)
+                        present |= 1 << s;
+        }
+
+        if (config->simhash_set) {
+                if (simhash_set_add(config->simhash_set, config->filename, h,
+                                    present) < 0)
+                        fprintf(ELF_ERR, "%s: simhash set out of memory\n",
+                                config->filename);
+                goto out;
+        }
+
+        if (elf_json)
+                __json_list_begin(elf_json, "simhash");
+
+        for (int s = 0; s < SIMHASH_SECS; s++) {
+                if (!(present & (1 << s)))
+                        continue;
+
+                simhash_hex(&h[s], hex);
+                if (elf_json) {
+                        struct json_writer *w = &elf_json->w;
+
+                        __json_record_begin(elf_json, NULL, "simhash");
+                        json_key_str(w, "section", simhash_secs[s]);
+                        json_key_u64(w, "size", job[s].size);
+                        json_key_str(w, "digest", hex);
+                        __json_record_end(elf_json);
+                        continue;
+                }
+
+                fprintf(elf_out, "simhash:%s section:%s %s\n", hex,
+                        simhash_secs[s], config->filename);
+        }
+
+        if (elf_json)
+                __json_list_end(elf_json);
+
+out:
+        elf_stats_end(&mark, STATS_RENDER);
+        ehd_close(elf);
+}
+
+static int __simhash_pair_cmp(const void *a, const void *b) {
+        const struct simhash_pair *x = (const struct simhash_pair *)a;
+        const struct simhash_pair *y = (const struct simhash_pair *)b;
+
+        if (x->distance != y->distance)
+                return x->distance < y->distance ? -1 : 1;
+        if (x->a != y->a)
+                return x->a < y->a ? -1 : 1;
+        return x->b < y->b ? -1 : x->b > y->b;
+}
+
+static const struct pretty_col simhash_pair_cols[] = {
+        {"distance", 10, 0},
+        {".text", 8, 0},
+        {".rodata", 9, 0},
+        {".data", 8, 0},
+        {"pair", 40, PRETTY_NOPAD},
+};
+
+static void __simhash_part_cell(struct pretty_table *t, uint32_t v) {
+        if (v == SIMHASH_FAR)
+                pretty_cell_str(t, "-");
+        else
+                pretty_cell_u64(t, v);
+}
+
+/* the closest config->simhash_pairs pairs of the batch */
+static void __simhash_report(struct config *config) {
+        const struct simhash_set *set = config->simhash_set;
+        struct simhash_pair *pairs;
+        struct pretty_table t;
+        uint64_t n;
+        int jobs = config->jobs > 0 ? config->jobs : thread_pool_nproc();
+
+        if (simhash_candidates(set, &pairs, &n) < 0) {
+                fprintf(ELF_ERR, "simhash: out of memory ranking pairs\n");
+                return;
+        }
+
+        uint64_t njobs = (n + SIMHASH_CHUNK - 1) / SIMHASH_CHUNK;
+        struct simhash_score_job *job = (struct simhash_score_job *)calloc(
+            njobs + 1, sizeof(struct simhash_score_job));
+        if (job == NULL) {
+                free(pairs);
+                return;
+        }
+
+        for (uint64_t i = 0; i < njobs; i++) {
+                job[i].set = set;
+                job[i].pairs = pairs + i * SIMHASH_CHUNK;
+                job[i].n = n - i * SIMHASH_CHUNK < SIMHASH_CHUNK
+                               ? n - i * SIMHASH_CHUNK
+                               : SIMHASH_CHUNK;
+        }
+
+        __simhash_pool(__simhash_score_task, job,
+                       sizeof(struct simhash_score_job), njobs, jobs);
+        qsort(pairs, n, sizeof(struct simhash_pair), __simhash_pair_cmp);
+
+        uint64_t top = n < config->simhash_pairs ? n : config->simhash_pairs;
+        while (top > 0 && pairs[top - 1].distance == UINT32_MAX)
+                top--;
+
+        if (elf_json) {
+                struct json_writer *w = &elf_json->w;
+
+                __json_record_begin(elf_json, "simhash_pairs",
+                                    "simhash_pairs");
+                json_key_u64(w, "files", set->n);
+                json_key_u64(w, "candidates", n);
+                if (elf_json->ndjson)
+                        __json_record_end(elf_json);
+
+                __json_list_begin(elf_json, "pairs");
+                for (uint64_t i = 0; i < top; i++) {
+                        struct simhash_pair *p = &pairs[i];
+
+                        __json_record_begin(elf_json, NULL, "simhash_pair");
+                        json_key_str(w, "a", set->files[p->a].path);
+                        json_key_str(w, "b", set->files[p->b].path);
+                        json_key_u64(w, "distance", p->distance);
+                        for (int s = 0; s < SIMHASH_SECS; s++) {
+                                json_key(w, simhash_secs[s]);
+                                if (p->part[s] == SIMHASH_FAR)
+                                        json_null(w);
+                                else
+                                        json_u64(w, p->part[s]);
+                        }
+                        __json_record_end(elf_json);
+                }
+                __json_list_end(elf_json);
+
+                if (!elf_json->ndjson)
+                        __json_record_end(elf_json);
+                goto out;
+        }
+
+        fprintf(elf_out,
+                "%" PRIu64 " files, %" PRIu64 " candidate pairs, "
+                "closest %" PRIu64 "\n\n",
+                set->n, n, top);
+
+        pretty_table_init(&t, elf_out, simhash_pair_cols,
+                          SIZE(simhash_pair_cols, struct pretty_col));
+        pretty_table_header(&t);
+        for (uint64_t i = 0; i < top; i++) {
+                struct simhash_pair *p = &pairs[i];
+                const char *a = set->files[p->a].path;
+                const char *b = set->files[p->b].path;
+                char pair[PRETTY_MAX_WIDTH];
+
+                snprintf(pair, sizeof(pair), "%s  %s", a, b);
+                pretty_cell_u64(&t, p->distance);
+                for (int s = 0; s < SIMHASH_SECS; s++)
+                        __simhash_part_cell(&t, p->part[s]);
+                pretty_cell_str(&t, pair);
+                pretty_row_end(&t);
+        }
+        pretty_table_flush(&t);
+
+out:
+        free(job);
+        free(pairs);
+}
+
+/*
+ * --size-report, every byte of an input is given to one owner: file
+ * bytes by a sweep of the headers and sections in offset order, VM
+ * bytes by a sweep of the mapped ones in address order, what no region
+ * claims is [padding] inside a PT_LOAD and [unmapped] outside it, then
+ * symbols by a sweep in (section, offset) order; overlapping regions
+ * and aliased symbols only get the bytes no earlier one took
+ */
+#define SIZE_TOP 30 /* section and symbol rows of a text table */
+
+static const char size_not_loaded[] = "[not loaded]";
+
+struct size_seg {
+        char label[24]; /* "LOAD RX", the key across inputs */
+        uint64_t foff;
+        uint64_t vaddr;
+        uint64_t file; /* bytes attributed below it */
+        uint64_t vm;
+        uint64_t pad_file;
+        uint64_t pad_vm;
+};
+
+struct size_region {
+        const char *name;
+        uint64_t foff;
+        uint64_t fsize; /* 0 without file bytes */
+        uint64_t vaddr;
+        uint64_t vsize; /* 0 when not mapped */
+        int64_t seg;    /* -1 outside every PT_LOAD */
+        uint64_t file;
+        uint64_t vm;
+};
+
+/* an interval of a region or a segment, in file or address space */
+struct size_span {
+        uint64_t start;
+        uint64_t end;
+        uint64_t id;
+};
+
+struct size_sym {
+        uint64_t shndx;
+        uint64_t off;  /* from the start of the section */
+        uint64_t size; /* cut at the end of the section */
+        const char *name;
+};
+
+static int __size_span_cmp(const void *a, const void *b) {
+        const struct size_span *x = (const struct size_span *)a;
+        const struct size_span *y = (const struct size_span *)b;
+
+        if (x->start != y->start)
+                return x->start < y->start ? -1 : 1;
+        if (x->end != y->end)
+                return x->end > y->end ? -1 : 1;
+        return x->id < y->id ? -1 : x->id > y->id;
+}
+
+static int __size_sym_cmp(const void *a, const void *b) {
+        const struct size_sym *x = (const struct size_sym *)a;
+        const struct size_sym *y = (const struct size_sym *)b;
+
+        if (x->shndx != y->shndx)
+                return x->shndx < y->shndx ? -1 : 1;
+        if (x->off != y->off)
+                return x->off < y->off ? -1 : 1;
+        if (x->size != y->size)
+                return x->size > y->size ? -1 : 1;
+        return strcmp(x->name, y->name);
+}
+
+/*
+ * [a, b) held by no region, segs from s on in start order, the parts
+ * inside a segment are its padding, the rest is returned
+ */
+static uint64_t __size_gap(struct size_seg *segs, const struct size_span *s,
+                           uint64_t ns, uint64_t a, uint64_t b, int vm) {
+        uint64_t outside = 0;
+
+        for (uint64_t j = 0; j < ns && s[j].start < b; j++) {
+                uint64_t lo = a > s[j].start ? a : s[j].start;
+                uint64_t hi = b < s[j].end ? b : s[j].end;
+
+                if (lo >= hi)
+                        continue;
+
+                outside += lo - a;
+                if (vm)
+                        segs[s[j].id].pad_vm += hi - lo;
+                else
+                        segs[s[j].id].pad_file += hi - lo;
+                a = hi;
+        }
+
+        return outside + (b - a);
+}
+
+/*
+ * one pass over the region spans r and segment spans s, both sorted
+ * by start, up to end; regions outside a segment so far get the one
+ * holding their start, the bytes outside every region and segment
+ * are returned
+ */
+static uint64_t __size_sweep(struct size_seg *segs, struct size_span *s,
+                             uint64_t ns, struct size_region *regions,
+                             struct size_span *r, uint64_t nr, uint64_t end,
+                             int vm) {
+        uint64_t pos = 0;
+        uint64_t outside = 0;
+        uint64_t k = 0;
+
+        qsort(s, ns, sizeof(struct size_span), __size_span_cmp);
+        qsort(r, nr, sizeof(struct size_span), __size_span_cmp);
+
+        for (uint64_t i = 0; i < nr; i++) {
+                struct size_region *reg = &regions[r[i].id];
+
+                while (k < ns && s[k].end <= pos)
+                        k++;
+                if (r[i].start > pos)
+                        outside += __size_gap(segs, s + k, ns - k, pos,
+                                              r[i].start, vm);
+
+                while (k < ns && s[k].end <= r[i].start)
+                        k++;
+                if (reg->seg < 0 && k < ns && s[k].start <= r[i].start)
+                        reg->seg = s[k].id;
+
+                uint64_t lo = r[i].start > pos ? r[i].start : pos;
+                if (r[i].end > lo) {
+                        if (vm)
+                                reg->vm = r[i].end - lo;
+                        else
+                                reg->file = r[i].end - lo;
+                        pos = r[i].end;
+                }
+        }
+
+        while (k < ns && s[k].end <= pos)
+                k++;
+        if (end > pos)
+                outside += __size_gap(segs, s + k, ns - k, pos, end, vm);
+
+        return outside;
+}
+
+/* .symtab, or .dynsym when stripped */
+static int __size_symtab(struct ehd_file *elf, struct ehd_symtab *st) {
+        uint64_t dynsym = 0;
+        Elf64_Shdr shdr;
+
+        for (uint64_t i = 1; i < ehd_shnum(elf); i++) {
+                if (ehd_section(elf, i, &shdr) != EHD_OK)
+                        continue;
+                if (shdr.sh_type == SHT_SYMTAB)
+                        return ehd_symtab(elf, i, st);
+                if (shdr.sh_type == SHT_DYNSYM && dynsym == 0)
+                        dynsym = i;
+        }
+
+        return dynsym ? ehd_symtab(elf, dynsym, st) : EHD_ENOENT;
+}
+
+/*
+ * sized symbols, each clipped to its section and to the symbols before
+ * it, are items below the section they are defined in
+ */
+static void __size_symbols(struct ehd_file *elf, struct size_region *sec,
+                           uint64_t shnum, uint64_t tls,
+                           struct size_items *items) {
+        const Elf64_Ehdr *ehdr = ehd_header(elf);
+        struct ehd_symtab st;
+        Elf64_Shdr shdr;
+        Elf64_Sym sym;
+        uint64_t n = 0;
+
+        if (__size_symtab(elf, &st) != EHD_OK || st.nsyms == 0)
+                return;
+
+        struct size_sym *syms =
+            (struct size_sym *)malloc(st.nsyms * sizeof(struct size_sym));
+        if (syms == NULL) {
+                items->failed = 1;
+                return;
+        }
+
+        for (uint64_t i = 0; ehd_symbol(&st, i, &sym) == EHD_OK; i++) {
+                uint64_t shndx = sym.st_shndx;
+                uint32_t x;
+                int type = ELF64_ST_TYPE(sym.st_info);
+
+                if (sym.st_size == 0 || type == STT_SECTION ||
+                    type == STT_FILE)
+                        continue;
+
+                if (shndx == SHN_XINDEX && ehd_symbol_xindex(&st, i, &x) ==
+                                               EHD_OK)
+                        shndx = x;
+                else if (shndx >= SHN_LORESERVE)
+                        continue;
+                if (shndx == SHN_UNDEF || shndx >= shnum ||
+                    ehd_section(elf, shndx, &shdr) != EHD_OK)
+                        continue;
+
+                /* TLS values are offsets into PT_TLS */
+                uint64_t addr = sym.st_value;
+                if (type == STT_TLS && ehdr->e_type != ET_REL)
+                        addr += tls;
+                if (ehdr->e_type != ET_REL)
+                        addr -= shdr.sh_addr;
+                if (addr >= shdr.sh_size)
+                        continue;
+
+                const char *name = ehd_symbol_name(&st, &sym);
+
+                syms[n].shndx = shndx;
+                syms[n].off = addr;
+                syms[n].size = sym.st_size < shdr.sh_size - addr
+                                   ? sym.st_size
+                                   : shdr.sh_size - addr;
+                syms[n].name = name && name[0] ? name : "[unnamed]";
+                n++;
+        }
+
+        qsort(syms, n, sizeof(struct size_sym), __size_sym_cmp);
+
+        uint64_t pos = 0;
+        for (uint64_t i = 0; i < n; i++) {
+                struct size_sym *s = &syms[i];
+                struct size_region *r = &sec[s->shndx];
+
+                if (i == 0 || s->shndx != syms[i - 1].shndx)
+                        pos = 0;
+
+                uint64_t lo = s->off > pos ? s->off : pos;
+                uint64_t hi = s->off + s->size;
+                if (hi <= lo)
+                        continue;
+
+                pos = hi;
+                size_items_add(items, SIZE_SYMBOL, s->name, r->name,
+                               r->fsize ? hi - lo : 0,
+                               r->vsize ? hi - lo : 0);
+        }
+
+        free(syms);
+}
+
+static const char *__size_parent(const struct size_seg *segs, int64_t seg) {
+        return seg < 0 ? size_not_loaded : segs[seg].label;
+}
+
+/* one input into config->size_report, base for the --size-baseline */
+static void __size_file(struct config *config, const char *path,
+                        struct ehd_file *elf, uint64_t size, int base) {
+        const Elf64_Ehdr *ehdr = ehd_header(elf);
+        uint64_t shnum = ehd_shnum(elf);
+        uint32_t phnum = ehd_phnum(elf);
+        struct size_items items = { 0 };
+        uint64_t nregions = shnum + 3;
+        uint64_t nsegs = 0;
+        uint64_t tls = 0;
+        uint64_t vm = 0;
+        Elf64_Phdr phdr;
+        Elf64_Shdr shdr;
+
+        struct size_seg *segs =
+            (struct size_seg *)calloc(phnum + 1, sizeof(struct size_seg));
+        struct size_region *regions = (struct size_region *)calloc(
+            nregions, sizeof(struct size_region));
+        struct size_span *fs = (struct size_span *)malloc(
+            (phnum + 1) * sizeof(struct size_span));
+        struct size_span *vs = (struct size_span *)malloc(
+            (phnum + 1) * sizeof(struct size_span));
+        struct size_span *fr = (struct size_span *)malloc(
+            nregions * sizeof(struct size_span));
+        struct size_span *vr = (struct size_span *)malloc(
+            nregions * sizeof(struct size_span));
+        if (!segs || !regions || !fs || !vs || !fr || !vr) {
+                items.failed = 1;
+                goto out;
+        }
+
+        for (uint32_t i = 0; i < phnum; i++) {
+                if (ehd_segment(elf, i, &phdr) != EHD_OK)
+                        continue;
+                if (phdr.p_type == PT_TLS)
+                        tls = phdr.p_vaddr;
+                if (phdr.p_type != PT_LOAD)
+                        continue;
+
+                struct size_seg *s = &segs[nsegs];
+
+                snprintf(s->label, sizeof(s->label), "LOAD %s",
+                         __p_flags_name(phdr.p_flags & (PF_R | PF_W | PF_X)));
+                s->foff = phdr.p_offset;
+                s->vaddr = phdr.p_vaddr;
+                fs[nsegs].start = phdr.p_offset;
+                fs[nsegs].end = phdr.p_offset + phdr.p_filesz;
+                fs[nsegs].id = nsegs;
+                vs[nsegs].start = phdr.p_vaddr;
+                vs[nsegs].end = phdr.p_vaddr + phdr.p_memsz;
+                vs[nsegs].id = nsegs;
+                nsegs++;
+        }
+
+        /* the three headers, then section i at regions[3 + i] */
+        struct size_region *sec = regions + 3;
+
+        regions[0].name = "[ELF header]";
+        regions[0].fsize = ehdr->e_ehsize;
+        regions[1].name = "[program headers]";
+        regions[1].foff = ehdr->e_phoff;
+        regions[1].fsize = (uint64_t)phnum * ehdr->e_phentsize;
+        regions[2].name = "[section headers]";
+        regions[2].foff = ehdr->e_shoff;
+        regions[2].fsize = shnum * ehdr->e_shentsize;
+
+        for (uint64_t i = 0; i < shnum; i++) {
+                struct size_region *r = &sec[i];
+                const char *name = NULL;
+
+                r->name = "[unnamed]";
+                if (ehd_section(elf, i, &shdr) != EHD_OK ||
+                    shdr.sh_type == SHT_NULL)
+                        continue;
+
+                name = ehd_section_name(elf, &shdr);
+                if (name && name[0])
+                        r->name = name;
+
+                if (shdr.sh_type != SHT_NOBITS) {
+                        r->foff = shdr.sh_offset;
+                        r->fsize = shdr.sh_size;
+                }
+
+                /* .tbss takes no address space of its own */
+                if ((shdr.sh_flags & SHF_ALLOC) &&
+                    !(shdr.sh_type == SHT_NOBITS &&
+                      (shdr.sh_flags & SHF_TLS))) {
+                        r->vaddr = shdr.sh_addr;
+                        r->vsize = shdr.sh_size;
+                }
+        }
+
+        uint64_t nfr = 0;
+        for (uint64_t i = 0; i < nregions; i++) {
+                regions[i].seg = -1;
+                if (regions[i].fsize == 0 || regions[i].foff >= size)
+                        continue;
+
+                uint64_t end = regions[i].foff + regions[i].fsize;
+                fr[nfr].start = regions[i].foff;
+                fr[nfr].end = end < size && end > regions[i].foff ? end
+                                                                  : size;
+                fr[nfr].id = i;
+                nfr++;
+        }
+
+        uint64_t unmapped =
+            __size_sweep(segs, fs, nsegs, regions, fr, nfr, size, 0);
+
+        /* headers a PT_LOAD covers are mapped along with it */
+        for (uint64_t i = 0; i < 3; i++) {
+                struct size_region *r = &regions[i];
+
+                if (r->seg >= 0 && r->fsize) {
+                        r->vaddr = segs[r->seg].vaddr + r->foff -
+                                   segs[r->seg].foff;
+                        r->vsize = r->fsize;
+                }
+        }
+
+        /* no PT_LOAD (ET_REL), every SHF_ALLOC section counts in full */
+        uint64_t nvr = 0;
+        uint64_t vend = 0;
+        for (uint64_t i = 0; i < nregions; i++) {
+                struct size_region *r = &regions[i];
+
+                if (r->vsize == 0)
+                        continue;
+                if (nsegs == 0) {
+                        r->vm = r->vsize;
+                        continue;
+                }
+
+                vr[nvr].start = r->vaddr;
+                vr[nvr].end = r->vaddr + r->vsize > r->vaddr
+                                  ? r->vaddr + r->vsize
+                                  : UINT64_MAX;
+                vr[nvr].id = i;
+                nvr++;
+        }
+        for (uint64_t i = 0; i < nsegs; i++) {
+                if (vs[i].end > vend)
+                        vend = vs[i].end;
+        }
+        if (nsegs)
+                __size_sweep(segs, vs, nsegs, regions, vr, nvr, vend, 1);
+
+        uint64_t nl_file = unmapped;
+        uint64_t nl_vm = 0;
+
+        for (uint64_t i = 0; i < nregions; i++) {
+                struct size_region *r = &regions[i];
+
+                size_items_add(&items, SIZE_SECTION, r->name,
+                               __size_parent(segs, r->seg), r->file, r->vm);
+                if (r->seg >= 0) {
+                        segs[r->seg].file += r->file;
+                        segs[r->seg].vm += r->vm;
+                } else {
+                        nl_file += r->file;
+                        nl_vm += r->vm;
+                }
+        }
+
+        for (uint64_t i = 0; i < nsegs; i++) {
+                struct size_seg *s = &segs[i];
+
+                size_items_add(&items, SIZE_SECTION, "[padding]", s->label,
+                               s->pad_file, s->pad_vm);
+                size_items_add(&items, SIZE_SEGMENT, s->label, "",
+                               s->file + s->pad_file, s->vm + s->pad_vm);
+                vm += s->vm + s->pad_vm;
+        }
+
+        size_items_add(&items, SIZE_SECTION, "[unmapped]", size_not_loaded,
+                       unmapped, 0);
+        size_items_add(&items, SIZE_SEGMENT, size_not_loaded, "", nl_file,
+                       nl_vm);
+        vm += nl_vm;
+
+        __size_symbols(elf, sec, shnum, tls, &items);
+
+out:
+        if (items.failed ||
+            size_report_add(config->size_report, &items, size, vm, base) < 0)
+                fprintf(ELF_ERR, "%s: size report out of memory\n", path);
+
+        size_items_free(&items);
+        free(segs);
+        free(regions);
+        free(fs);
+        free(vs);
+        free(fr);
+        free(vr);
+}
+
+__cold static void __size(struct config *config, struct elf_view *view,
+                          enum ELF_arch_type type) {
+        struct ehd_allocator alloc;
+        struct elf_stats_mark mark;
+        struct ehd_file *elf = NULL;
+
+        if (view->data == NULL || (type != ELF64 && type != ELF32) ||
+            ehd_open_mem(view->data, view->size, __ehd_allocator(&alloc),
+                         &elf) != EHD_OK)
+                return;
+
+        elf_stats_begin(&mark);
+        __size_file(config, config->filename, elf, view->size, 0);
+        elf_stats_end(&mark, STATS_RENDER);
+        ehd_close(elf);
+}
+
+static const char *const size_level_names[] = {
+        [SIZE_SEGMENT] = "segment",
+        [SIZE_SECTION] = "section",
+        [SIZE_SYMBOL] = "symbol",
+};
+
+/* sort keys of the report, file then vm bytes or their change */
+struct size_rank {
+        uint64_t file;
+        uint64_t vm;
+        uint64_t id;
+};
+
+static int __size_rank_cmp(const void *a, const void *b) {
+        const struct size_rank *x = (const struct size_rank *)a;
+        const struct size_rank *y = (const struct size_rank *)b;
+
+        if (x->file != y->file)
+                return x->file > y->file ? -1 : 1;
+        if (x->vm != y->vm)
+                return x->vm > y->vm ? -1 : 1;
+        return x->id < y->id ? -1 : x->id > y->id;
+}
+
+static uint64_t __size_change(uint64_t now, uint64_t base) {
+        return now > base ? now - base : base - now;
+}
+
+/*
+ * rows of one level, biggest first, or with a baseline the biggest
+ * change first and, unless all is set, unchanged rows left out
+ */
+static struct size_rank *__size_rank(const struct size_report *r,
+                                     uint32_t level, int base, int all,
+                                     uint64_t *nrank) {
+        struct size_rank *rank = (struct size_rank *)malloc(
+            (r->n + 1) * sizeof(struct size_rank));
+
+        *nrank = 0;
+        if (rank == NULL)
+                return NULL;
+
+        for (uint64_t i = 0; i < r->n; i++) {
+                const struct size_row *row = &r->rows[i];
+                struct size_rank *k = &rank[*nrank];
+
+                if (row->level != level)
+                        continue;
+
+                k->file = row->file;
+                k->vm = row->vm;
+                if (base) {
+                        k->file = __size_change(row->file, row->base_file);
+                        k->vm = __size_change(row->vm, row->base_vm);
+                        if (!all && k->file == 0 && k->vm == 0)
+                                continue;
+                }
+                k->id = i;
+                (*nrank)++;
+        }
+
+        qsort(rank, *nrank, sizeof(struct size_rank), __size_rank_cmp);
+        return rank;
+}
+
+static void __size_delta_cell(struct pretty_table *t, uint64_t now,
+                              uint64_t base) {
+        char buf[32];
+
+        if (now >= base)
+                snprintf(buf, sizeof(buf), "+%" PRIu64, now - base);
+        else
+                snprintf(buf, sizeof(buf), "-%" PRIu64, base - now);
+        pretty_cell_str(t, buf);
+}
+
+static void __size_table(const struct size_report *r, uint32_t level,
+                         int base, uint64_t limit) {
+        struct pretty_col cols[6];
+        struct pretty_table t;
+        uint16_t ncols = 0;
+        uint64_t n;
+
+        struct size_rank *rank = __size_rank(r, level, base, 0, &n);
+        if (rank == NULL || n == 0) {
+                free(rank);
+                return;
+        }
+
+        cols[ncols++] = (struct pretty_col){ size_level_names[level],
+                                             level == SIZE_SYMBOL ? 40 : 24,
+                                             PRETTY_TRUNCATE };
+        if (level != SIZE_SEGMENT)
+                cols[ncols++] = (struct pretty_col){
+                    size_level_names[level - 1], 16, PRETTY_TRUNCATE };
+        cols[ncols++] = (struct pretty_col){ "file", 14, 0 };
+        if (base)
+                cols[ncols++] = (struct pretty_col){ "+/- file", 14, 0 };
+        cols[ncols++] = (struct pretty_col){ "vm", 14, 0 };
+        cols[ncols++] = (struct pretty_col){ base ? "+/- vm" : "file %",
+                                             14, PRETTY_NOPAD };
+
+        fprintf(elf_out, "\n%ss", size_level_names[level]);
+        if (limit && n > limit)
+                fprintf(elf_out, ", %" PRIu64 " of %" PRIu64, limit, n);
+        fprintf(elf_out, "\n");
+
+        pretty_table_init(&t, elf_out, cols, ncols);
+        pretty_table_header(&t);
+        for (uint64_t i = 0; i < n && (limit == 0 || i < limit); i++) {
+                const struct size_row *row = &r->rows[rank[i].id];
+
+                pretty_cell_str(&t, size_report_str(r, row->name));
+                if (level != SIZE_SEGMENT)
+                        pretty_cell_str(&t, size_report_str(r, row->parent));
+                pretty_cell_u64(&t, row->file);
+                if (base)
+                        __size_delta_cell(&t, row->file, row->base_file);
+                pretty_cell_u64(&t, row->vm);
+                if (base) {
+                        __size_delta_cell(&t, row->vm, row->base_vm);
+                } else {
+                        char pct[16];
+
+                        snprintf(pct, sizeof(pct), "%.1f%%",
+                                 r->file ? 100.0 * row->file / r->file : 0.0);
+                        pretty_cell_str(&t, pct);
+                }
+                pretty_row_end(&t);
+        }
+        pretty_table_flush(&t);
+        free(rank);
+}
+
+static void __size_text(const struct size_report *r, const char *baseline) {
+        fprintf(elf_out,
+                "%" PRIu64 " files, %" PRIu64 " file bytes, %" PRIu64
+                " vm bytes\n",
+                r->files, r->file, r->vm);
+        if (baseline)
+                fprintf(elf_out,
+                        "baseline %s, %" PRIu64 " file bytes, %" PRIu64
+                        " vm bytes\n",
+                        baseline, r->base_file, r->base_vm);
+
+        __size_table(r, SIZE_SEGMENT, baseline != NULL, 0);
+        __size_table(r, SIZE_SECTION, baseline != NULL, SIZE_TOP);
+        __size_table(r, SIZE_SYMBOL, baseline != NULL, SIZE_TOP);
+}
+
+/*
+ * "size_report" of the set document, every row in full, or with ndjson
+ * one record for the totals and one for each row
+ */
+static void __size_json(struct elf_json *j, const struct size_report *r,
+                        const char *baseline) {
+        struct json_writer *w = &j->w;
+
+        __json_record_begin(j, "size_report", "size_report");
+        json_key_u64(w, "files", r->files);
+        json_key_u64(w, "file", r->file);
+        json_key_u64(w, "vm", r->vm);
+        if (baseline) {
+                json_key(w, "baseline");
+                json_object_begin(w);
+                json_key_str(w, "path", baseline);
+                json_key_u64(w, "file", r->base_file);
+                json_key_u64(w, "vm", r->base_vm);
+                json_object_end(w);
+        }
+        if (j->ndjson)
+                __json_record_end(j);
+
+        for (uint32_t level = SIZE_SEGMENT; level <= SIZE_SYMBOL; level++) {
+                uint64_t n;
+                struct size_rank *rank =
+                    __size_rank(r, level, baseline != NULL, 1, &n);
+                char key[16];
+                char record[24];
+
+                snprintf(key, sizeof(key), "%ss", size_level_names[level]);
+                snprintf(record, sizeof(record), "size_%s",
+                         size_level_names[level]);
+                __json_list_begin(j, key);
+                for (uint64_t i = 0; rank && i < n; i++) {
+                        const struct size_row *row = &r->rows[rank[i].id];
+
+                        __json_record_begin(j, NULL, record);
+                        json_key_str(w, "name", size_report_str(r, row->name));
+                        if (level != SIZE_SEGMENT)
+                                json_key_str(w, size_level_names[level - 1],
+                                             size_report_str(r, row->parent));
+                        json_key_u64(w, "file", row->file);
+                        json_key_u64(w, "vm", row->vm);
+                        if (baseline) {
+                                json_key_u64(w, "base_file", row->base_file);
+                                json_key_u64(w, "base_vm", row->base_vm);
+                        }
+                        __json_record_end(j);
+                }
+                __json_list_end(j);
+                free(rank);
+        }
+
+        if (!j->ndjson)
+                __json_record_end(j);
+}
+
+/* -1 when the baseline can not be used, nothing is reported then */
+static int __size_report(struct config *config) {
+        const char *baseline = config->size_baseline;
+
+        if (baseline) {
+                struct diff_side side;
+
+                if (__diff_open(config, &side, baseline) < 0 ||
+                    side.elf == NULL) {
+                        fprintf(ELF_ERR, "%s: baseline is not an ELF file\n",
+                                baseline);
+                        __diff_close(&side);
+                        return -1;
+                }
+
+                __size_file(config, baseline, side.elf, side.view.size, 1);
+                __diff_close(&side);
+        }
+
+        if (elf_json)
+                __size_json(elf_json, config->size_report, baseline);
+        else
+                __size_text(config->size_report, baseline);
+        return 0;
+}
+
+/*
+ * --layout, how the headers, sections, segments and notes tile the
+ * file: the regions owning bytes (headers and sections) go into one
+ * interval index and the PT_LOAD segments into another; whatever
+ * overlaps a region is the run right after it in start order, each
+ * header and section asks the PT_LOAD tree which ones hold it, and a
+ * sweep in offset order finds the gaps and feeds a proportional map
+ * of the whole file
+ *
+ * every region looks at LAYOUT_HITS others at most, a million
+ * sections stacked on the same bytes stay O(n log n)
+ */
+#define LAYOUT_ROW 64      /* cells of a map row */
+#define LAYOUT_ROWS 16     /* most rows of the map */
+#define LAYOUT_HITS 32     /* overlaps looked at per region */
+#define LAYOUT_TOP 16      /* gaps listed in text, largest first */
+#define LAYOUT_FINDINGS 64 /* findings listed in text */
+#define LAYOUT_KEEP 4096   /* findings kept per issue, the rest counted */
+#define LAYOUT_NONE UINT64_MAX
+
+enum layout_kind {
+        LAYOUT_EHDR,
+        LAYOUT_PHDRS,
+        LAYOUT_SHDRS,
+        LAYOUT_SECTION,
+        LAYOUT_SEGMENT,
+        LAYOUT_NOTE,
+};
+
+static const char *const layout_kind_names[] = {
+        [LAYOUT_EHDR] = "ehdr",       [LAYOUT_PHDRS] = "phdrs",
+        [LAYOUT_SHDRS] = "shdrs",     [LAYOUT_SECTION] = "section",
+        [LAYOUT_SEGMENT] = "segment", [LAYOUT_NOTE] = "note",
+};
+
+enum layout_issue {
+        LAYOUT_OVERLAP,      /* two headers or sections share bytes */
+        LAYOUT_CROSS,        /* a section runs over the edge of a PT_LOAD */
+        LAYOUT_UNLOADED,     /* SHF_ALLOC bytes outside every PT_LOAD */
+        LAYOUT_LOAD_OVERLAP, /* two PT_LOAD share file bytes */
+        LAYOUT_PAST_EOF,
+        LAYOUT_MISALIGNED,
+        LAYOUT_ORDER,
+        LAYOUT_BAD_NOTE, /* a note runs past its section or segment */
+};
+
+static const char *const layout_issue_names[] = {
+        [LAYOUT_OVERLAP] = "overlap",
+        [LAYOUT_CROSS] = "cross",
+        [LAYOUT_UNLOADED] = "unloaded",
+        [LAYOUT_LOAD_OVERLAP] = "load-overlap",
+        [LAYOUT_PAST_EOF] = "past-eof",
+        [LAYOUT_MISALIGNED] = "misaligned",
+        [LAYOUT_ORDER] = "order",
+        [LAYOUT_BAD_NOTE] = "bad-note",
+};
+
+/* map keys of the sections, in file order, '*' once they run out */
+static const char layout_keys[] =
+    "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789";
+
+struct layout_region {
+        uint64_t start;
+        uint64_t end; /* may be past the end of the file */
+        uint64_t index; /* section / segment index, note number */
+        const char *name; /* section name, note owner */
+        uint64_t addr;    /* sh_addr / p_vaddr */
+        uint64_t align;   /* sh_addralign / p_align */
+        uint64_t flags;   /* sh_flags / p_flags */
+        uint32_t type;    /* sh_type / p_type / n_type */
+        uint32_t kind;
+        char key; /* map key, 0 until it owns a cell */
+};
+
+struct layout_finding {
+        uint32_t issue;
+        uint64_t a;
+        uint64_t b; /* LAYOUT_NONE for a finding about a alone */
+        uint64_t bytes;
+        const char *what;
+};
+
+struct layout_gap {
+        uint64_t start;
+        uint64_t end;
+        uint64_t after;  /* region ending where it starts, or LAYOUT_NONE */
+        uint64_t before; /* region starting where it ends, or LAYOUT_NONE */
+        uint64_t load;   /* PT_LOAD region holding it, or LAYOUT_NONE */
+};
+
+struct layout_cell {
+        uint64_t bytes; /* of the owner */
+        uint64_t owner; /* region, LAYOUT_NONE for a gap */
+        uint64_t load_bytes;
+        uint64_t load; /* PT_LOAD region, LAYOUT_NONE outside */
+};
+
+/* what a query has seen of the region it was made for */
+struct layout_hits {
+        struct layout *l;
+        const struct ival *self;
+        uint64_t hits;
+        int inside; /* wholly inside a PT_LOAD */
+        int crossed;
+};
+
+struct layout {
+        uint64_t size;
+        int rel; /* ET_REL, nothing is loaded */
+        uint64_t nloads;
+
+        struct layout_region *regions;
+        uint64_t n;
+        uint64_t cap;
+        struct layout_finding *findings;
+        uint64_t nfindings;
+        uint64_t cap_findings;
+        uint64_t dropped; /* findings past LAYOUT_KEEP */
+        struct layout_gap *gaps;
+        uint64_t ngaps;
+        uint64_t cap_gaps;
+        struct ival_index leaves; /* headers and sections */
+        struct ival_index loads;  /* PT_LOAD segments */
+
+        uint64_t count[LAYOUT_NOTE + 1]; /* regions of each kind */
+        uint64_t issues[LAYOUT_BAD_NOTE + 1];
+        uint64_t gap_bytes;
+        uint64_t gap_loaded;
+        int failed; /* out of memory, the layout is incomplete */
+};
+
+/* one more slot of a growing array, NULL when out of memory */
+static void *__layout_push(void **v, uint64_t *n, uint64_t *cap,
+                           size_t size) {
+        if (*n == *cap) {
+                uint64_t c = *cap ? *cap * 2 : 64;
+                void *p = realloc(*v, c * size);
+
+                if (p == NULL)
+                        return NULL;
+                *v = p;
+                *cap = c;
+        }
+
+        return (uint8_t *)*v + (*n)++ * size;
+}
+
+static struct layout_region *__layout_region(struct layout *l, uint32_t kind,
+                                             uint64_t start, uint64_t size,
+                                             uint64_t index) {
+        struct layout_region *r = (struct layout_region *)__layout_push(
+            (void **)&l->regions, &l->n, &l->cap,
+            sizeof(struct layout_region));
+
+        if (r == NULL) {
+                l->failed = 1;
+                return NULL;
+        }
+
+        memset(r, 0, sizeof(struct layout_region));
+        r->start = start;
+        r->end = start + size >= start ? start + size : UINT64_MAX;
+        r->index = index;
+        r->kind = kind;
+        l->count[kind]++;
+        return r;
+}
+
+static void __layout_finding(struct layout *l, uint32_t issue, uint64_t a,
+                             uint64_t b, uint64_t bytes, const char *what) {
+        struct layout_finding *f;
+
+        if (++l->issues[issue] > LAYOUT_KEEP) {
+                l->dropped++;
+                return;
+        }
+
+        f = (struct layout_finding *)__layout_push(
+            (void **)&l->findings, &l->nfindings, &l->cap_findings,
+            sizeof(struct layout_finding));
+        if (f == NULL) {
+                l->failed = 1;
+                return;
+        }
+
+        f->issue = issue;
+        f->a = a;
+        f->b = b;
+        f->bytes = bytes;
+        f->what = what;
+}
+
+/* headers, sections and PT_LOAD own file bytes, the rest lies on top */
+static int __layout_leaf(const struct layout_region *r) {
+        return r->kind != LAYOUT_SEGMENT && r->kind != LAYOUT_NOTE;
+}
+
+static int __layout_load(const struct layout_region *r) {
+        return r->kind == LAYOUT_SEGMENT && r->type == PT_LOAD;
+}
+
+/* the notes of one SHT_NOTE section or PT_NOTE segment, region parent */
+static void __layout_notes(struct layout *l, struct ehd_file *elf,
+                           uint64_t parent) {
+        uint64_t offset = l->regions[parent].start;
+        uint64_t size = l->regions[parent].end - offset;
+        uint64_t align = l->regions[parent].align == 8 ? 8 : 4;
+        const uint8_t *notes = ehd_bytes(elf, offset, size);
+        uint64_t pos = 0;
+
+        if (notes == NULL)
+                return;
+
+        while (pos + sizeof(Elf64_Nhdr) <= size) {
+                Elf64_Nhdr nhdr;
+                memcpy(&nhdr, notes + pos, sizeof(Elf64_Nhdr));
+
+                /* the name follows the header, desc and next note align */
+                uint64_t name_off = pos + sizeof(Elf64_Nhdr);
+                uint64_t desc_off =
+                    (name_off + nhdr.n_namesz + align - 1) & ~(align - 1);
+                uint64_t end =
+                    (desc_off + nhdr.n_descsz + align - 1) & ~(align - 1);
+
+                if (desc_off > size || nhdr.n_descsz > size - desc_off) {
+                        __layout_finding(l, LAYOUT_BAD_NOTE, parent,
+                                         LAYOUT_NONE, 0,
+                                         "note runs past its container");
+                        return;
+                }
+
+                struct layout_region *r = __layout_region(
+                    l, LAYOUT_NOTE, offset + pos,
+                    (end < size ? end : size) - pos,
+                    l->count[LAYOUT_NOTE]);
+                if (r == NULL)
+                        return;
+
+                r->type = nhdr.n_type;
+                r->name = "";
+                if (nhdr.n_namesz && notes[name_off + nhdr.n_namesz - 1] == 0)
+                        r->name = (const char *)notes + name_off;
+                pos = end;
+        }
+}
+
+/*
+ * headers, sections with file bytes, segments and their notes, plus
+ * the findings that need no neighbours: past the end, misaligned, and
+ * out of the usual order by index
+ */
+static void __layout_collect(struct layout *l, struct ehd_file *elf) {
+        const Elf64_Ehdr *ehdr = ehd_header(elf);
+        uint64_t shnum = ehd_shnum(elf);
+        uint32_t phnum = ehd_phnum(elf);
+        uint64_t prev_load = LAYOUT_NONE;
+        uint64_t prev_sec = LAYOUT_NONE;
+        struct layout_region *r;
+        Elf64_Phdr phdr;
+        Elf64_Shdr shdr;
+
+        l->rel = ehdr->e_type == ET_REL;
+        __layout_region(l, LAYOUT_EHDR, 0, ehdr->e_ehsize, 0);
+        if (phnum) {
+                __layout_region(l, LAYOUT_PHDRS, ehdr->e_phoff,
+                                (uint64_t)phnum * ehdr->e_phentsize, 0);
+                if (ehdr->e_phoff != ehdr->e_ehsize)
+                        __layout_finding(l, LAYOUT_ORDER, l->n - 1,
+                                         LAYOUT_NONE, 0,
+                                         "not right after the ELF header");
+        }
+        if (shnum)
+                __layout_region(l, LAYOUT_SHDRS, ehdr->e_shoff,
+                                shnum * ehdr->e_shentsize, 0);
+
+        for (uint64_t i = 1; i < shnum; i++) {
+                if (ehd_section(elf, i, &shdr) != EHD_OK ||
+                    shdr.sh_type == SHT_NOBITS || shdr.sh_size == 0)
+                        continue;
+
+                r = __layout_region(l, LAYOUT_SECTION, shdr.sh_offset,
+                                    shdr.sh_size, i);
+                if (r == NULL)
+                        return;
+
+                const char *name = ehd_section_name(elf, &shdr);
+                r->name = name ? name : "";
+                r->addr = shdr.sh_addr;
+                r->align = shdr.sh_addralign;
+                r->flags = shdr.sh_flags;
+                r->type = shdr.sh_type;
+
+                uint64_t align = shdr.sh_addralign;
+                if (align > 1 && (align & (align - 1)) == 0 &&
+                    (shdr.sh_offset & (align - 1)))
+                        __layout_finding(l, LAYOUT_MISALIGNED, l->n - 1,
+                                         LAYOUT_NONE, 0,
+                                         "sh_offset off sh_addralign");
+                /* the assembler puts .rela.* last, only odd when linked */
+                if (!l->rel && prev_sec != LAYOUT_NONE &&
+                    shdr.sh_offset < l->regions[prev_sec].start)
+                        __layout_finding(l, LAYOUT_ORDER, l->n - 1, prev_sec,
+                                         0, "sh_offset below the section "
+                                            "before it");
+                prev_sec = l->n - 1;
+
+                if (shdr.sh_type == SHT_NOTE)
+                        __layout_notes(l, elf, l->n - 1);
+        }
 
-                printf("\tMachine\t\t\t\t");
-                __print_machine(ehdr->e_machine);
-                printf("\n");
+        /* PT_NOTE only when no SHT_NOTE section had any */
+        int seg_notes = l->count[LAYOUT_NOTE] == 0;
+
+        for (uint32_t i = 0; i < phnum; i++) {
+                if (ehd_segment(elf, i, &phdr) != EHD_OK)
+                        continue;
+
+                r = __layout_region(l, LAYOUT_SEGMENT, phdr.p_offset,
+                                    phdr.p_filesz, i);
+                if (r == NULL)
+                        return;
+
+                r->addr = phdr.p_vaddr;
+                r->align = phdr.p_align;
+                r->flags = phdr.p_flags;
+                r->type = phdr.p_type;
+
+                uint64_t align = phdr.p_align;
+                if (phdr.p_type == PT_LOAD) {
+                        l->nloads++;
+                        if (align > 1 && (align & (align - 1)) == 0 &&
+                            ((phdr.p_offset ^ phdr.p_vaddr) & (align - 1)))
+                                __layout_finding(l, LAYOUT_MISALIGNED,
+                                                 l->n - 1, LAYOUT_NONE, 0,
+                                                 "p_offset and p_vaddr apart "
+                                                 "mod p_align");
+                        if (prev_load != LAYOUT_NONE &&
+                            phdr.p_vaddr < l->regions[prev_load].addr)
+                                __layout_finding(l, LAYOUT_ORDER, l->n - 1,
+                                                 prev_load, 0,
+                                                 "p_vaddr below an earlier "
+                                                 "PT_LOAD");
+                        prev_load = l->n - 1;
+                } else if ((phdr.p_type == PT_PHDR ||
+                            phdr.p_type == PT_INTERP) &&
+                           prev_load != LAYOUT_NONE) {
+                        __layout_finding(l, LAYOUT_ORDER, l->n - 1,
+                                         prev_load, 0, "after a PT_LOAD");
+                }
 
-                printf("\tVersion\t\t\t\t");
-                __print_elf_version(ehdr->e_version);
+                if (phdr.p_type == PT_NOTE && seg_notes && phdr.p_filesz)
+                        __layout_notes(l, elf, l->n - 1);
+        }
+
+        for (uint64_t i = 0; i < l->n; i++) {
+                const struct layout_region *x = &l->regions[i];
+
+                if (x->end > l->size && x->end > x->start)
+                        __layout_finding(l, LAYOUT_PAST_EOF, i, LAYOUT_NONE,
+                                         x->end - (x->start > l->size
+                                                       ? x->start
+                                                       : l->size),
+                                         NULL);
+        }
+}
+
+static int __layout_load_hit(void *arg, const struct ival *iv) {
+        struct layout_hits *h = (struct layout_hits *)arg;
+        const struct layout_region *a = &h->l->regions[h->self->id];
+        const struct layout_region *b = &h->l->regions[iv->id];
 
-                printf("\tEntry point address\t\t0x%016" PRIx32 "\n",
-                       ehdr->e_entry);
-                printf("\tStart of program headers\t%" PRIu32
-                       " (bytes into file)\n",
-                       ehdr->e_phoff);
-                printf("\tStart of section headers\t%" PRIu32
-                       " (bytes into file)\n",
-                       ehdr->e_shoff);
-                printf("\tFlags\t\t\t\t0x%x\n", ehdr->e_flags);
-                printf("\tSize of this header\t\t%" PRIu16 " (bytes)\n",
-                       ehdr->e_ehsize);
-                printf("\tSize of program headers\t\t%" PRIu16 " (bytes)\n",
-                       ehdr->e_phentsize);
-                printf("\tNumber of program headers\t%" PRIu16 "\n",
-                       ehdr->e_phnum);
-                printf("\tSize of section headers\t\t%" PRIu16 " (bytes)\n",
-                       ehdr->e_shentsize);
-                printf("\tNumber of section headers\t%" PRIu16 "\n",
-                       ehdr->e_shnum);
-                printf("\tSection header string table idx\t%" PRIu16 "\n",
-                       ehdr->e_shstrndx);
+        if (b->start <= a->start && a->end <= b->end) {
+                h->inside = 1;
         } else {
-                // NOP
+                h->crossed = 1;
+                __layout_finding(h->l, LAYOUT_CROSS, h->self->id, iv->id,
+                                 0, NULL);
         }
+        return ++h->hits >= LAYOUT_HITS;
 }
 
-__cold static void __print_ph_table_header() {
-        PRINT_PRETTY_PAD_COUNT("type", 4, 16);
-        PRINT_PRETTY_PAD_COUNT("flags", 5, 9);
-        PRINT_PRETTY_PAD_COUNT("offset", 6, 19);
-        PRINT_PRETTY_PAD_COUNT("virtual addr", 12, 19);
-        PRINT_PRETTY_PAD_COUNT("physical addr", 13, 19);
-        PRINT_PRETTY_PAD_COUNT("file size", 9, 19);
-        PRINT_PRETTY_PAD_COUNT("mem size", 8, 19);
-        PRINT_PRETTY_PAD_COUNT("align", 5, 19);
+/*
+ * x in start order: what overlaps v[i] and starts after it is the run
+ * right behind it, as every start in between is below v[i].end
+ */
+static void __layout_overlaps(struct layout *l, const struct ival_index *x,
+                              uint32_t issue) {
+        for (uint64_t i = 0; i < x->n; i++) {
+                const struct ival *a = &x->v[i];
+
+                for (uint64_t j = i + 1;
+                     j < x->n && j - i <= LAYOUT_HITS && x->v[j].start < a->end;
+                     j++) {
+                        const struct ival *b = &x->v[j];
+                        uint64_t end = a->end < b->end ? a->end : b->end;
+
+                        __layout_finding(l, issue, a->id, b->id,
+                                         end - b->start, NULL);
+                }
+        }
+}
 
-        printf("\n");
+static int __layout_first_hit(void *arg, const struct ival *iv) {
+        *(uint64_t *)arg = iv->id;
+        return 1;
+}
 
-        for (int i = 0; i < __init_print_pad_count; i++) {
-                printf("-");
+/*
+ * the leaves in offset order, each piece of the file once: the bytes
+ * of a region no earlier one holds, or a gap between them, as
+ * fn(ctx, start, end, owner, after, before), owner LAYOUT_NONE for a
+ * gap
+ */
+static void __layout_sweep(const struct layout *l,
+                           void (*fn)(void *, uint64_t, uint64_t, uint64_t,
+                                      uint64_t, uint64_t),
+                           void *ctx) {
+        const struct ival_index *x = &l->leaves;
+        uint64_t after = LAYOUT_NONE;
+        uint64_t pos = 0;
+
+        for (uint64_t i = 0; i < x->n && x->v[i].start < l->size; i++) {
+                const struct ival *iv = &x->v[i];
+                uint64_t end = iv->end < l->size ? iv->end : l->size;
+
+                if (iv->start > pos)
+                        fn(ctx, pos, iv->start, LAYOUT_NONE, after, iv->id);
+                if (end > pos) {
+                        fn(ctx, iv->start > pos ? iv->start : pos, end,
+                           iv->id, LAYOUT_NONE, LAYOUT_NONE);
+                        pos = end;
+                        after = iv->id;
+                }
         }
 
-        PRETTY_PRINT_PAD_COUNT_RESET();
-        printf("\n");
+        if (l->size > pos)
+                fn(ctx, pos, l->size, LAYOUT_NONE, after, LAYOUT_NONE);
+}
+
+static void __layout_gap(void *arg, uint64_t start, uint64_t end,
+                         uint64_t owner, uint64_t after, uint64_t before) {
+        struct layout *l = (struct layout *)arg;
+
+        if (owner != LAYOUT_NONE)
+                return;
 
-        // printf("Type\t\t"
-        //        "offset\t\t"
-        //        "virtual addr\t\t"
-        //        "physical addr\t\t"
-        //        "filesz\t\t"
-        //        "flags\t\t"
-        //        "align\n\n");
+        struct layout_gap *g = (struct layout_gap *)__layout_push(
+            (void **)&l->gaps, &l->ngaps, &l->cap_gaps,
+            sizeof(struct layout_gap));
+        if (g == NULL) {
+                l->failed = 1;
+                return;
+        }
+
+        g->start = start;
+        g->end = end;
+        g->after = after;
+        g->before = before;
+        g->load = LAYOUT_NONE;
+        ival_query(&l->loads, start, start + 1, __layout_first_hit,
+                   &g->load);
+
+        l->gap_bytes += end - start;
+        if (g->load != LAYOUT_NONE)
+                l->gap_loaded += end - start;
 }
 
-__cold static void __print_sh_table_header() {
-        PRINT_PRETTY_PAD_COUNT("n", 1, 4);
-        PRINT_PRETTY_PAD_COUNT("name", 4, 17);
-        PRINT_PRETTY_PAD_COUNT("types", 5, 18);
-        PRINT_PRETTY_PAD_COUNT("flags", 5, 6);
-        PRINT_PRETTY_PAD_COUNT("virtual addr", 12, 19);
-        PRINT_PRETTY_PAD_COUNT("offset", 6, 19);
-        PRINT_PRETTY_PAD_COUNT("sh size", 7, 19);
-        PRINT_PRETTY_PAD_COUNT("sh link", 7, 10);
-        PRINT_PRETTY_PAD_COUNT("info", 4, 5);
-        PRINT_PRETTY_PAD_COUNT("align", 5, 6);
-        PRINT_PRETTY_PAD_COUNT("entry size", 10, 19);
+/* overlaps, sections across or outside PT_LOAD, then the gaps */
+static void __layout_check(struct layout *l) {
+        for (uint64_t i = 0; i < l->n; i++) {
+                const struct layout_region *r = &l->regions[i];
+                int ret = 0;
+
+                if (__layout_leaf(r))
+                        ret = ival_add(&l->leaves, r->start, r->end, i);
+                else if (__layout_load(r))
+                        ret = ival_add(&l->loads, r->start, r->end, i);
+                if (ret < 0)
+                        l->failed = 1;
+        }
+
+        ival_build(&l->leaves);
+        ival_build(&l->loads);
+
+        __layout_overlaps(l, &l->leaves, LAYOUT_OVERLAP);
+        __layout_overlaps(l, &l->loads, LAYOUT_LOAD_OVERLAP);
 
-        printf("\n");
+        for (uint64_t i = 0; i < l->leaves.n; i++) {
+                struct layout_hits h = { l, &l->leaves.v[i], 0, 0, 0 };
+                const struct layout_region *r = &l->regions[h.self->id];
 
-        for (int i = 0; i < __init_print_pad_count; i++) {
-                printf("-");
+                ival_query(&l->loads, r->start, r->end, __layout_load_hit,
+                           &h);
+                if (r->kind == LAYOUT_SECTION && (r->flags & SHF_ALLOC) &&
+                    !l->rel && l->nloads && !h.inside && !h.crossed)
+                        __layout_finding(l, LAYOUT_UNLOADED, h.self->id,
+                                         LAYOUT_NONE, 0, NULL);
         }
 
-        PRETTY_PRINT_PAD_COUNT_RESET();
-        printf("\n");
+        __layout_sweep(l, __layout_gap, l);
 }
 
-__cold static void __print_p_type(Elf32_Word p_type) {
-        switch (p_type) {
-        case PT_NULL:
-                PRINT_PRETTY("NULL", strlen("NULL"), 16);
-                break;
-        case PT_LOAD:
-                PRINT_PRETTY("LOAD", strlen("LOAD"), 16);
-                break;
-        case PT_DYNAMIC:
-                PRINT_PRETTY("DYNAMIC", strlen("DYNAMIC"), 16);
-                break;
-        case PT_INTERP:
-                PRINT_PRETTY("INTERP", strlen("INTERP"), 16);
-                break;
-        case PT_NOTE:
-                PRINT_PRETTY("NOTE", strlen("NOTE"), 16);
-                break;
-        case PT_SHLIB:
-                PRINT_PRETTY("SHLIB", strlen("SHLIB"), 16);
-                break;
-        case PT_PHDR:
-                PRINT_PRETTY("PHDR", strlen("PHDR"), 16);
+static void __layout_label(const struct layout_region *r, char *buf,
+                           size_t size) {
+        switch (r->kind) {
+        case LAYOUT_EHDR:
+                snprintf(buf, size, "ELF header");
                 break;
-        case PT_TLS:
-                PRINT_PRETTY("TLS", strlen("TLS"), 16);
+        case LAYOUT_PHDRS:
+                snprintf(buf, size, "program headers");
                 break;
-        case PT_NUM:
-                PRINT_PRETTY("NUM", strlen("NUM"), 16);
+        case LAYOUT_SHDRS:
+                snprintf(buf, size, "section headers");
                 break;
-        case PT_GNU_EH_FRAME:
-                PRINT_PRETTY("GNU_EH_FRAME", strlen("GNU_EH_FRAME"), 16);
+        case LAYOUT_SECTION:
+                if (r->name[0])
+                        snprintf(buf, size, "%s", r->name);
+                else
+                        snprintf(buf, size, "section[%" PRIu64 "]",
+                                 r->index);
                 break;
-        case PT_GNU_STACK:
-                PRINT_PRETTY("GNU_STACK", strlen("GNU_STACK"), 16);
+        case LAYOUT_SEGMENT:
+                snprintf(buf, size, "segment[%" PRIu64 "] %s", r->index,
+                         __p_type_label(r->type));
                 break;
-        case PT_GNU_RELRO:
-                PRINT_PRETTY("GNU_RELRO", strlen("GNU_RELRO"), 16);
-                break;
-        case PT_GNU_PROPERTY:
-                PRINT_PRETTY("GNU_PROPERTY", strlen("GNU_PROPERTY"), 16);
-                break;
-        case PT_GNU_SFRAME:
-                PRINT_PRETTY("GNU_SFRAME", strlen("GNU_SFRAME"), 16);
-                break;
-        case PT_SUNWBSS:
-                PRINT_PRETTY("LOSUNW/SUNWBSS", strlen("LOSUNW/SUNWBSS"), 16);
-                break;
-        case PT_SUNWSTACK:
-                PRINT_PRETTY("SUNWSTACK", strlen("SUNWSTACK"), 16);
+        default:
+                snprintf(buf, size, "note %s 0x%x", r->name, r->type);
                 break;
+        }
+}
+
+struct layout_map {
+        const struct layout *l;
+        struct layout_cell *cells;
+        uint64_t ncells;
+        uint64_t cell; /* bytes per cell */
+};
+
+/* bytes of [start, end) into every cell it touches, the most wins */
+static void __layout_map_piece(void *arg, uint64_t start, uint64_t end,
+                               uint64_t owner, uint64_t after,
+                               uint64_t before) {
+        struct layout_map *m = (struct layout_map *)arg;
+
+        (void)after;
+        (void)before;
+        for (uint64_t c = start / m->cell; c < m->ncells && c * m->cell < end;
+             c++) {
+                uint64_t lo = c * m->cell > start ? c * m->cell : start;
+                uint64_t hi = (c + 1) * m->cell < end ? (c + 1) * m->cell
+                                                      : end;
+
+                if (hi - lo > m->cells[c].bytes) {
+                        m->cells[c].bytes = hi - lo;
+                        m->cells[c].owner = owner;
+                }
+        }
+}
+
+static char __layout_cell_key(const struct layout *l, uint64_t owner) {
+        if (owner == LAYOUT_NONE)
+                return '.';
+
+        switch (l->regions[owner].kind) {
+        case LAYOUT_EHDR:
+                return '@';
+        case LAYOUT_PHDRS:
+                return '=';
+        case LAYOUT_SHDRS:
+                return '#';
         default:
-                if (p_type >= PT_LOOS && p_type <= PT_HIOS) {
-                        PRINT_PRETTY("OS_SPESIFIC", strlen("OS_SPESIFIC"), 16);
-                } else if (p_type >= PT_LOPROC && p_type <= PT_HIPROC) {
-                        PRINT_PRETTY("PROCESSOR_SPESIFIC",
-                                     strlen("PROCESSOR_SPESIFIC"), 16);
-                } else {
-                        PRINT_PRETTY("UNKNOWN", strlen("UNKNOWN"), 16);
+                return l->regions[owner].key ? l->regions[owner].key : '*';
+        }
+}
+
+static char __layout_load_key(const struct layout *l, uint64_t load) {
+        uint64_t index;
+
+        if (load == LAYOUT_NONE)
+                return ' ';
+
+        index = l->regions[load].index;
+        if (index < 10)
+                return '0' + index;
+        if (index < 36)
+                return 'a' + index - 10;
+        return '+';
+}
+
+static void __layout_map(struct layout *l) {
+        struct layout_map m = { l, NULL, 0, 1 };
+        uint64_t key = 0;
+
+        if (l->size == 0)
+                return;
+
+        m.ncells = LAYOUT_ROW * LAYOUT_ROWS;
+        m.cell = (l->size + m.ncells - 1) / m.ncells;
+        m.ncells = (l->size + m.cell - 1) / m.cell;
+        m.cells = (struct layout_cell *)calloc(m.ncells,
+                                               sizeof(struct layout_cell));
+        if (m.cells == NULL)
+                return;
+
+        for (uint64_t c = 0; c < m.ncells; c++) {
+                m.cells[c].owner = LAYOUT_NONE;
+                m.cells[c].load = LAYOUT_NONE;
+        }
+
+        __layout_sweep(l, __layout_map_piece, &m);
+
+        /* loads rarely overlap, each walks only the cells it covers */
+        for (uint64_t i = 0; i < l->loads.n; i++) {
+                const struct ival *iv = &l->loads.v[i];
+                uint64_t end = iv->end < l->size ? iv->end : l->size;
+
+                for (uint64_t c = iv->start / m.cell;
+                     c < m.ncells && c * m.cell < end; c++) {
+                        uint64_t lo = c * m.cell > iv->start ? c * m.cell
+                                                             : iv->start;
+                        uint64_t hi =
+                            (c + 1) * m.cell < end ? (c + 1) * m.cell : end;
+
+                        if (hi - lo > m.cells[c].load_bytes) {
+                                m.cells[c].load_bytes = hi - lo;
+                                m.cells[c].load = iv->id;
+                        }
                 }
-                break;
         }
+
+        /* keys go to the sections owning a cell, in file order */
+        for (uint64_t c = 0; c < m.ncells; c++) {
+                uint64_t owner = m.cells[c].owner;
+
+                if (owner == LAYOUT_NONE ||
+                    l->regions[owner].kind != LAYOUT_SECTION ||
+                    l->regions[owner].key || key >= sizeof(layout_keys) - 1)
+                        continue;
+                l->regions[owner].key = layout_keys[key++];
+        }
+
+        fprintf(elf_out, "\none cell per %" PRIu64 " bytes", m.cell);
+        if (l->nloads)
+                fprintf(elf_out, ", the line below a row is the PT_LOAD "
+                                 "holding it");
+        fputc('\n', elf_out);
+
+        for (uint64_t row = 0; row < m.ncells; row += LAYOUT_ROW) {
+                uint64_t end = row + LAYOUT_ROW < m.ncells ? row + LAYOUT_ROW
+                                                           : m.ncells;
+
+                fprintf(elf_out, "0x%016" PRIx64 "  ", row * m.cell);
+                for (uint64_t c = row; c < end; c++)
+                        fputc(__layout_cell_key(l, m.cells[c].owner),
+                              elf_out);
+                fputc('\n', elf_out);
+
+                if (l->nloads == 0)
+                        continue;
+
+                fprintf(elf_out, "%20s", "");
+                for (uint64_t c = row; c < end; c++)
+                        fputc(__layout_load_key(l, m.cells[c].load),
+                              elf_out);
+                fputc('\n', elf_out);
+        }
+
+        fprintf(elf_out, "@ ELF header  = program headers  # section headers"
+                         "  . gap");
+        if (key == sizeof(layout_keys) - 1)
+                fprintf(elf_out, "  * more sections");
+
+        uint64_t col = 80;
+        for (uint64_t i = 0; i < l->n; i++) {
+                const struct layout_region *r = &l->regions[i];
+                char label[64];
+
+                if (r->kind != LAYOUT_SECTION || r->key == 0)
+                        continue;
+
+                __layout_label(r, label, sizeof(label));
+                if (col + strlen(label) + 4 > 78) {
+                        fputc('\n', elf_out);
+                        col = 0;
+                }
+                col += fprintf(elf_out, "%s%c %s", col ? "  " : "", r->key,
+                               label);
+        }
+        fputc('\n', elf_out);
+        free(m.cells);
+}
+
+static int __layout_gap_cmp(const void *a, const void *b) {
+        const struct layout_gap *x = (const struct layout_gap *)a;
+        const struct layout_gap *y = (const struct layout_gap *)b;
+        uint64_t sx = x->end - x->start;
+        uint64_t sy = y->end - y->start;
+
+        if (sx != sy)
+                return sx > sy ? -1 : 1;
+        return x->start < y->start ? -1 : x->start > y->start;
+}
+
+static const struct pretty_col layout_gap_cols[] = {
+        {"offset", 20, 0},
+        {"size", 12, 0},
+        {"after", 20, PRETTY_TRUNCATE},
+        {"before", 20, PRETTY_TRUNCATE},
+        {"segment", 16, PRETTY_NOPAD},
+};
+
+static void __layout_gap_cell(struct pretty_table *t, const struct layout *l,
+                              uint64_t region) {
+        char label[64];
+
+        if (region == LAYOUT_NONE) {
+                pretty_cell_str(t, "-");
+                return;
+        }
+
+        __layout_label(&l->regions[region], label, sizeof(label));
+        pretty_cell_str(t, label);
+}
+
+static void __layout_gaps(struct layout *l) {
+        struct pretty_table t;
+
+        if (l->ngaps == 0)
+                return;
+
+        /* the gaps are in offset order until here, only JSON needs that */
+        qsort(l->gaps, l->ngaps, sizeof(struct layout_gap), __layout_gap_cmp);
+
+        fprintf(elf_out, "\ngaps");
+        if (l->ngaps > LAYOUT_TOP)
+                fprintf(elf_out, ", largest %u of %" PRIu64, LAYOUT_TOP,
+                        l->ngaps);
+        fprintf(elf_out, "\n");
+
+        pretty_table_init(&t, elf_out, layout_gap_cols,
+                          SIZE(layout_gap_cols, struct pretty_col));
+        pretty_table_header(&t);
+        for (uint64_t i = 0; i < l->ngaps && i < LAYOUT_TOP; i++) {
+                const struct layout_gap *g = &l->gaps[i];
+
+                pretty_cell_hex(&t, g->start, 16);
+                pretty_cell_u64(&t, g->end - g->start);
+                __layout_gap_cell(&t, l, g->after);
+                __layout_gap_cell(&t, l, g->before);
+                __layout_gap_cell(&t, l, g->load);
+                pretty_row_end(&t);
+        }
+        pretty_table_flush(&t);
+}
+
+static void __layout_region_text(const struct layout *l, uint64_t region) {
+        const struct layout_region *r = &l->regions[region];
+        char label[64];
+
+        __layout_label(r, label, sizeof(label));
+        fprintf(elf_out, "%s [0x%" PRIx64 ", 0x%" PRIx64 ")", label,
+                r->start, r->end);
+}
+
+static void __layout_findings(const struct layout *l) {
+        if (l->nfindings == 0)
+                return;
+
+        fprintf(elf_out, "\nfindings\n");
+        for (uint64_t i = 0; i < l->nfindings && i < LAYOUT_FINDINGS; i++) {
+                const struct layout_finding *f = &l->findings[i];
+
+                fprintf(elf_out, "%-13s", layout_issue_names[f->issue]);
+                __layout_region_text(l, f->a);
+                if (f->b != LAYOUT_NONE) {
+                        fprintf(elf_out, " and ");
+                        __layout_region_text(l, f->b);
+                }
+                if (f->bytes)
+                        fprintf(elf_out, ", %" PRIu64 " bytes", f->bytes);
+                if (f->what)
+                        fprintf(elf_out, ", %s", f->what);
+                fputc('\n', elf_out);
+        }
+
+        uint64_t shown =
+            l->nfindings < LAYOUT_FINDINGS ? l->nfindings : LAYOUT_FINDINGS;
+        if (l->nfindings + l->dropped > shown)
+                fprintf(elf_out, "%" PRIu64 " more findings not shown\n",
+                        l->nfindings + l->dropped - shown);
+}
+
+static void __layout_text(struct layout *l) {
+        uint64_t other =
+            l->nfindings + l->dropped - l->issues[LAYOUT_OVERLAP];
+
+        fprintf(elf_out,
+                "layout of %" PRIu64 " bytes: %" PRIu64 " sections, %" PRIu64
+                " segments, %" PRIu64 " notes\n",
+                l->size, l->count[LAYOUT_SECTION], l->count[LAYOUT_SEGMENT],
+                l->count[LAYOUT_NOTE]);
+        fprintf(elf_out,
+                "%" PRIu64 " overlaps, %" PRIu64 " gaps of %" PRIu64
+                " bytes (%" PRIu64 " inside a PT_LOAD), %" PRIu64
+                " other findings\n",
+                l->issues[LAYOUT_OVERLAP], l->ngaps, l->gap_bytes,
+                l->gap_loaded, other);
+
+        __layout_map(l);
+        __layout_gaps(l);
+        __layout_findings(l);
+}
+
+static void __json_layout_region(struct json_writer *w, const char *key,
+                                 const struct layout *l, uint64_t region) {
+        char label[64];
+
+        json_key(w, key);
+        if (region == LAYOUT_NONE) {
+                json_null(w);
+                return;
+        }
+
+        __layout_label(&l->regions[region], label, sizeof(label));
+        json_str(w, label);
+}
+
+__cold static void __json_layout(struct elf_json *j, const struct layout *l) {
+        struct json_writer *w = &j->w;
+
+        __json_record_begin(j, "layout", "layout");
+        json_key_u64(w, "size", l->size);
+        json_key_u64(w, "sections", l->count[LAYOUT_SECTION]);
+        json_key_u64(w, "segments", l->count[LAYOUT_SEGMENT]);
+        json_key_u64(w, "notes", l->count[LAYOUT_NOTE]);
+        json_key_u64(w, "gaps", l->ngaps);
+        json_key_u64(w, "gap_bytes", l->gap_bytes);
+        json_key_u64(w, "gap_loaded", l->gap_loaded);
+        json_key_u64(w, "findings", l->nfindings + l->dropped);
+        __json_record_end(j);
+
+        __json_list_begin(j, "layout_regions");
+        for (uint64_t i = 0; i < l->n; i++) {
+                const struct layout_region *r = &l->regions[i];
+
+                __json_record_begin(j, NULL, "layout_region");
+                json_key_str(w, "kind", layout_kind_names[r->kind]);
+                json_key_u64(w, "index", r->index);
+                if (r->kind == LAYOUT_SECTION || r->kind == LAYOUT_NOTE)
+                        json_key_str(w, "name", r->name);
+                if (r->kind == LAYOUT_SEGMENT)
+                        __json_name(w, "type", __p_type_name(r->type),
+                                    r->type);
+                else if (r->kind != LAYOUT_EHDR && r->kind != LAYOUT_PHDRS &&
+                         r->kind != LAYOUT_SHDRS)
+                        json_key_u64(w, "type", r->type);
+                json_key_u64(w, "start", r->start);
+                json_key_u64(w, "end", r->end);
+                __json_record_end(j);
+        }
+        __json_list_end(j);
+
+        __json_list_begin(j, "layout_gaps");
+        for (uint64_t i = 0; i < l->ngaps; i++) {
+                const struct layout_gap *g = &l->gaps[i];
+
+                __json_record_begin(j, NULL, "layout_gap");
+                json_key_u64(w, "start", g->start);
+                json_key_u64(w, "end", g->end);
+                __json_layout_region(w, "after", l, g->after);
+                __json_layout_region(w, "before", l, g->before);
+                __json_layout_region(w, "segment", l, g->load);
+                __json_record_end(j);
+        }
+        __json_list_end(j);
+
+        /* past LAYOUT_KEEP of an issue only the count above has them */
+        __json_list_begin(j, "layout_findings");
+        for (uint64_t i = 0; i < l->nfindings; i++) {
+                const struct layout_finding *f = &l->findings[i];
+
+                __json_record_begin(j, NULL, "layout_finding");
+                json_key_str(w, "issue", layout_issue_names[f->issue]);
+                __json_layout_region(w, "a", l, f->a);
+                __json_layout_region(w, "b", l, f->b);
+                json_key_u64(w, "bytes", f->bytes);
+                if (f->what)
+                        json_key_str(w, "what", f->what);
+                __json_record_end(j);
+        }
+        __json_list_end(j);
+}
+
+__cold static void __layout(struct config *config, struct elf_view *view,
+                            enum ELF_arch_type type) {
+        struct ehd_allocator alloc;
+        struct elf_stats_mark mark;
+        struct ehd_file *elf = NULL;
+        struct layout l;
+
+        (void)config;
+        if (view->data == NULL || (type != ELF64 && type != ELF32) ||
+            ehd_open_mem(view->data, view->size, __ehd_allocator(&alloc),
+                         &elf) != EHD_OK)
+                return;
+
+        elf_stats_begin(&mark);
+        memset(&l, 0, sizeof(struct layout));
+        l.size = view->size;
+
+        __layout_collect(&l, elf);
+        __layout_check(&l);
+        if (l.failed)
+                fprintf(ELF_ERR, "--layout: out of memory, the layout is "
+                                 "incomplete\n");
+
+        if (elf_json)
+                __json_layout(elf_json, &l);
+        else
+                __layout_text(&l);
+        elf_stats_end(&mark, STATS_RENDER);
+
+        ival_free(&l.leaves);
+        ival_free(&l.loads);
+        free(l.regions);
+        free(l.findings);
+        free(l.gaps);
+        ehd_close(elf);
+}
+
+/*
+ * --entropy, Shannon entropy per block of the whole input, and per
+ * section and segment from their own histograms
+ */
+#define ENTROPY_BLOCK 4096             /* default --entropy-block */
+#define ENTROPY_CHUNK (4 * 1024 * 1024) /* bytes handed to one task */
+#define ENTROPY_SPARK 48                /* cells of a table sparkline */
+#define ENTROPY_ROW 64                  /* blocks per row of the map */
+#define ENTROPY_ROW_NAMES 4             /* section names shown per row */
+
+struct entropy_job {
+        const uint8_t *data;
+        uint64_t start;
+        uint64_t end;
+        uint64_t block; /* 0 for a range job, histogram only */
+        float *bits;    /* per block, indexed from offset 0 */
+        struct entropy_hist hist;
+};
+
+struct entropy_range {
+        const char *name; /* section name, NULL for a segment */
+        uint64_t index;
+        uint32_t type;
+        uint64_t offset;
+        uint64_t size;
+        struct entropy_hist hist;
+};
+
+/* ' ' is exactly one byte value, then one step per bit */
+static const char *const entropy_spark[] = {
+        " ", "▁", "▂", "▃", "▄",
+        "▅", "▆", "▇", "█",
+};
+
+static const char *__entropy_spark(double bits) {
+        if (bits <= 0)
+                return entropy_spark[0];
+        return entropy_spark[1 + (bits < 7 ? (int)bits : 7)];
+}
+
+static void __entropy_task(struct thread_pool *tp, int worker, void *arg) {
+        struct entropy_job *job = (struct entropy_job *)arg;
+
+        if (job->block == 0) {
+                entropy_hist_add(&job->hist, job->data + job->start,
+                                 job->end - job->start);
+                return;
+        }
+
+        for (uint64_t off = job->start; off < job->end; off += job->block) {
+                uint64_t n = job->end - off < job->block ? job->end - off
+                                                         : job->block;
+
+                job->bits[off / job->block] =
+                    entropy_block(job->data + off, n, &job->hist);
+        }
+}
+
+/* sections and segments with bytes in the file */
+static struct entropy_range *__entropy_ranges(struct ehd_file *elf,
+                                              uint64_t size, uint64_t *n) {
+        uint64_t shnum = ehd_shnum(elf);
+        uint64_t phnum = ehd_phnum(elf);
+        Elf64_Shdr shdr;
+        Elf64_Phdr phdr;
+
+        *n = 0;
+        struct entropy_range *r = (struct entropy_range *)calloc(
+            shnum + phnum + 1, sizeof(struct entropy_range));
+        if (r == NULL)
+                return NULL;
+
+        for (uint64_t i = 0; i < shnum; i++) {
+                if (ehd_section(elf, i, &shdr) != EHD_OK ||
+                    shdr.sh_type == SHT_NOBITS || shdr.sh_size == 0 ||
+                    shdr.sh_offset > size ||
+                    shdr.sh_size > size - shdr.sh_offset)
+                        continue;
+
+                const char *name = ehd_section_name(elf, &shdr);
+                r[*n].name = name ? name : "";
+                r[*n].index = i;
+                r[*n].type = shdr.sh_type;
+                r[*n].offset = shdr.sh_offset;
+                r[*n].size = shdr.sh_size;
+                (*n)++;
+        }
+
+        for (uint64_t i = 0; i < phnum; i++) {
+                if (ehd_segment(elf, i, &phdr) != EHD_OK ||
+                    phdr.p_filesz == 0 || phdr.p_offset > size ||
+                    phdr.p_filesz > size - phdr.p_offset)
+                        continue;
+
+                r[*n].index = i;
+                r[*n].type = phdr.p_type;
+                r[*n].offset = phdr.p_offset;
+                r[*n].size = phdr.p_filesz;
+                (*n)++;
+        }
+
+        return r;
+}
+
+/*
+ * blocks of [0, size) and histograms of every range, all cut into
+ * ENTROPY_CHUNK tasks on one pool, whole is the histogram of it all
+ */
+static int __entropy_run(const uint8_t *data, uint64_t size, uint64_t block,
+                         float *bits, struct entropy_range *ranges,
+                         uint64_t nranges, struct entropy_hist *whole,
+                         int jobs) {
+        struct thread_pool tp;
+        uint64_t chunk = ENTROPY_CHUNK - ENTROPY_CHUNK % block;
+        uint64_t n = 0;
+
+        if (chunk == 0)
+                chunk = block;
+
+        uint64_t nblock_jobs = (size + chunk - 1) / chunk;
+        n = nblock_jobs;
+        for (uint64_t i = 0; i < nranges; i++)
+                n += (ranges[i].size + ENTROPY_CHUNK - 1) / ENTROPY_CHUNK;
+
+        struct entropy_job *job =
+            (struct entropy_job *)calloc(n + 1, sizeof(struct entropy_job));
+        if (job == NULL)
+                return -1;
+
+        n = 0;
+        for (uint64_t off = 0; off < size; off += chunk, n++) {
+                job[n].data = data;
+                job[n].start = off;
+                job[n].end = size - off < chunk ? size : off + chunk;
+                job[n].block = block;
+                job[n].bits = bits;
+        }
+
+        for (uint64_t i = 0; i < nranges; i++) {
+                uint64_t end = ranges[i].offset + ranges[i].size;
+
+                for (uint64_t off = ranges[i].offset; off < end;
+                     off += ENTROPY_CHUNK, n++) {
+                        job[n].data = data;
+                        job[n].start = off;
+                        job[n].end = end - off < ENTROPY_CHUNK
+                                         ? end
+                                         : off + ENTROPY_CHUNK;
+                }
+        }
+
+        if (n > 1 && jobs > 1 &&
+            thread_pool_init(&tp, jobs < (int)n ? jobs : (int)n) == 0) {
+                for (uint64_t i = 0; i < n; i++) {
+                        thread_pool_submit(&tp, -1, __entropy_task, &job[i]);
+                }
+                thread_pool_wait(&tp);
+                thread_pool_destroy(&tp);
+        } else {
+                for (uint64_t i = 0; i < n; i++) {
+                        __entropy_task(NULL, 0, &job[i]);
+                }
+        }
+
+        /* range jobs come in range order, each range in offset order */
+        uint64_t k = nblock_jobs;
+        for (uint64_t i = 0; i < nblock_jobs; i++)
+                entropy_hist_merge(whole, &job[i].hist);
+
+        for (uint64_t i = 0; i < nranges; i++) {
+                uint64_t end = ranges[i].offset + ranges[i].size;
+
+                for (uint64_t off = ranges[i].offset; off < end;
+                     off += ENTROPY_CHUNK)
+                        entropy_hist_merge(&ranges[i].hist, &job[k++].hist);
+        }
+
+        free(job);
+        return 0;
+}
+
+/* share of zero bytes and of printable ASCII, in tenths of a percent */
+static void __entropy_shares(const struct entropy_hist *h, uint64_t *zero,
+                             uint64_t *text) {
+        uint64_t printable = h->count['\t'] + h->count['\n'] + h->count['\r'];
+
+        for (uint32_t c = 0x20; c < 0x7f; c++)
+                printable += h->count[c];
+
+        *zero = h->total ? h->count[0] * 1000 / h->total : 0;
+        *text = h->total ? printable * 1000 / h->total : 0;
+}
+
+static void __entropy_cell_milli(struct pretty_table *t, uint64_t v,
+                                 int decimals) {
+        char tmp[32];
+
+        if (decimals == 3)
+                snprintf(tmp, sizeof(tmp), "%" PRIu64 ".%03" PRIu64,
+                         v / 1000, v % 1000);
+        else
+                snprintf(tmp, sizeof(tmp), "%" PRIu64 ".%" PRIu64, v / 10,
+                         v % 10);
+        pretty_cell_str(t, tmp);
+}
+
+/* the blocks of [offset, offset + size), squeezed to ENTROPY_SPARK cells */
+static void __entropy_sparkline(struct pretty_table *t, const float *bits,
+                                uint64_t block, uint64_t offset,
+                                uint64_t size) {
+        char tmp[ENTROPY_SPARK * 4];
+        uint64_t first = offset / block;
+        uint64_t n = (offset + size - 1) / block - first + 1;
+        uint64_t cells = n < ENTROPY_SPARK ? n : ENTROPY_SPARK;
+        size_t len = 0;
+
+        for (uint64_t c = 0; c < cells; c++) {
+                uint64_t lo = first + c * n / cells;
+                uint64_t hi = first + (c + 1) * n / cells;
+                float max = 0;
+
+                for (uint64_t b = lo; b < hi; b++) {
+                        if (bits[b] > max)
+                                max = bits[b];
+                }
+
+                const char *s = __entropy_spark(max);
+                memcpy(tmp + len, s, strlen(s));
+                len += strlen(s);
+        }
+
+        pretty_cell(t, tmp, len);
 }
 
-/* do not forget to cast Elf32_Word to Elf64_Word*/
-__cold static void __print_p_flags(Elf64_Word p_flags) {
-        if (p_flags == PF_X) {
-                PRINT_PRETTY("X", 1, 9);
-        } else if (p_flags == PF_W) {
-                PRINT_PRETTY("W", 1, 9);
-        } else if (p_flags == PF_R) {
-                PRINT_PRETTY("R", 1, 9);
-        } else if (p_flags == PF_MASKOS) {
-                PRINT_PRETTY("MASKOS", 6, 9);
-        } else if (p_flags == PF_MASKPROC) {
-                PRINT_PRETTY("MASKPROC", 7, 9);
-        } else if (p_flags == (PF_R | PF_W)) {
-                PRINT_PRETTY("RW", 2, 9);
-        } else if (p_flags == (PF_R | PF_X)) {
-                PRINT_PRETTY("RX", 2, 9);
-        } else if (p_flags == (PF_R | PF_X | PF_W)) {
-                PRINT_PRETTY("RXW", 3, 9);
+static const struct pretty_col entropy_sh_cols[] = {
+        {"n", 8, 0},
+        {"name", 17, PRETTY_TRUNCATE},
+        {"offset", 19, 0},
+        {"size", 19, 0},
+        {"entropy", 9, 0},
+        {"zero%", 7, 0},
+        {"text%", 7, 0},
+        {"blocks", 8, PRETTY_NOPAD},
+};
+
+static const struct pretty_col entropy_ph_cols[] = {
+        {"n", 8, 0},
+        {"type", 16, 0},
+        {"offset", 19, 0},
+        {"file size", 19, 0},
+        {"entropy", 9, 0},
+        {"zero%", 7, 0},
+        {"text%", 7, 0},
+        {"blocks", 8, PRETTY_NOPAD},
+};
+
+static void __entropy_table(struct entropy_range *ranges, uint64_t n,
+                            int sections, const float *bits,
+                            uint64_t block) {
+        struct pretty_table t;
+        uint64_t zero;
+        uint64_t text;
+
+        if (sections) {
+                pretty_table_init(&t, elf_out, entropy_sh_cols,
+                                  SIZE(entropy_sh_cols, struct pretty_col));
+                for (uint64_t i = 0; i < n; i++) {
+                        if (ranges[i].name)
+                                pretty_table_fit(&t, SH_COL_NAME,
+                                                 strlen(ranges[i].name));
+                }
         } else {
-                PRINT_PRETTY("UNDEF", 5, 9);
+                pretty_table_init(&t, elf_out, entropy_ph_cols,
+                                  SIZE(entropy_ph_cols, struct pretty_col));
         }
+
+        fprintf(elf_out, "\n");
+        pretty_table_header(&t);
+
+        for (uint64_t i = 0; i < n; i++) {
+                struct entropy_range *r = &ranges[i];
+
+                if ((r->name != NULL) != sections)
+                        continue;
+
+                __entropy_shares(&r->hist, &zero, &text);
+                pretty_cell_u64(&t, r->index);
+                if (sections)
+                        pretty_cell_str(&t, r->name);
+                else
+                        pretty_cell_str(&t, __p_type_label(r->type));
+                pretty_cell_hex(&t, r->offset, 16);
+                pretty_cell_hex(&t, r->size, 16);
+                __entropy_cell_milli(
+                    &t, (uint64_t)(entropy_bits(&r->hist) * 1000 + 0.5), 3);
+                __entropy_cell_milli(&t, zero, 1);
+                __entropy_cell_milli(&t, text, 1);
+                __entropy_sparkline(&t, bits, block, r->offset, r->size);
+                pretty_row_end(&t);
+        }
+
+        pretty_table_flush(&t);
+}
+
+static int __entropy_range_cmp(const void *a, const void *b) {
+        const struct entropy_range *x = *(struct entropy_range *const *)a;
+        const struct entropy_range *y = *(struct entropy_range *const *)b;
+
+        if (x->offset != y->offset)
+                return x->offset < y->offset ? -1 : 1;
+        return x->index < y->index ? -1 : x->index > y->index;
+}
+
+/*
+ * ENTROPY_ROW blocks per line, followed by the sections that start in
+ * that stretch, the sections are sorted by offset once and one cursor
+ * follows the rows down
+ */
+static void __entropy_map(const float *bits, uint64_t nblocks,
+                          uint64_t block, struct entropy_range *ranges,
+                          uint64_t nranges) {
+        struct entropy_range **by = NULL;
+        uint64_t nby = 0;
+        uint64_t k = 0;
+
+        if (nranges)
+                by = (struct entropy_range **)calloc(
+                    nranges, sizeof(struct entropy_range *));
+        if (by) {
+                for (uint64_t i = 0; i < nranges; i++) {
+                        if (ranges[i].name)
+                                by[nby++] = &ranges[i];
+                }
+                qsort(by, nby, sizeof(struct entropy_range *),
+                      __entropy_range_cmp);
+        } else if (nranges) {
+                fprintf(ELF_ERR, "--entropy: out of memory, "
+                                 "map without section names\n");
+        }
+
+        fprintf(elf_out,
+                "\none cell per %" PRIu64 " bytes, ' ' a single byte "
+                "value, then one step per bit up to █ for 7-8 bits\n",
+                block);
+
+        for (uint64_t row = 0; row < nblocks; row += ENTROPY_ROW) {
+                uint64_t start = row * block;
+                uint64_t end = (row + ENTROPY_ROW) * block;
+                uint32_t names = 0;
+
+                fprintf(elf_out, "0x%016" PRIx64 "  ", start);
+                for (uint64_t b = row; b < row + ENTROPY_ROW; b++) {
+                        fputs(b < nblocks ? __entropy_spark(bits[b]) : " ",
+                              elf_out);
+                }
+
+                /* rows start at 0 and cover the file, none is skipped */
+                for (; k < nby && by[k]->offset < end; k++) {
+                        if (names++ < ENTROPY_ROW_NAMES)
+                                fprintf(elf_out, " %s", by[k]->name);
+                }
+
+                if (names > ENTROPY_ROW_NAMES)
+                        fprintf(elf_out, " +%u", names - ENTROPY_ROW_NAMES);
+                fprintf(elf_out, "\n");
+        }
+
+        free(by);
+}
+
+static void __json_entropy_hist(struct json_writer *w,
+                                const struct entropy_hist *h) {
+        json_key_u64(w, "size", h->total);
+        json_key(w, "entropy");
+        json_milli(w, (uint64_t)(entropy_bits(h) * 1000 + 0.5));
+        json_key(w, "histogram");
+        json_array_begin(w);
+        for (uint32_t c = 0; c < 256; c++)
+                json_u64(w, h->count[c]);
+        json_array_end(w);
+}
+
+__cold static void __json_entropy(struct elf_json *j, const float *bits,
+                                  uint64_t nblocks, uint64_t block,
+                                  struct entropy_range *ranges,
+                                  uint64_t nranges,
+                                  const struct entropy_hist *whole) {
+        struct json_writer *w = &j->w;
+
+        __json_record_begin(j, "entropy", "entropy");
+        json_key_u64(w, "block", block);
+        __json_entropy_hist(w, whole);
+        json_key(w, "blocks");
+        json_array_begin(w);
+        for (uint64_t i = 0; i < nblocks; i++)
+                json_milli(w, (uint64_t)(bits[i] * 1000 + 0.5f));
+        json_array_end(w);
+        __json_record_end(j);
+
+        __json_list_begin(j, "entropy_ranges");
+        for (uint64_t i = 0; i < nranges; i++) {
+                struct entropy_range *r = &ranges[i];
+
+                __json_record_begin(j, NULL, "entropy_range");
+                if (r->name) {
+                        json_key_str(w, "scope", "section");
+                        json_key_u64(w, "index", r->index);
+                        json_key_str(w, "name", r->name);
+                } else {
+                        json_key_str(w, "scope", "segment");
+                        json_key_u64(w, "index", r->index);
+                        __json_name(w, "type", __p_type_name(r->type),
+                                    r->type);
+                }
+                json_key_u64(w, "offset", r->offset);
+                __json_entropy_hist(w, &r->hist);
+                __json_record_end(j);
+        }
+        __json_list_end(j);
+}
+
+__cold static void __entropy(struct config *config, struct elf_view *view,
+                             enum ELF_arch_type type, int jobs) {
+        struct ehd_allocator alloc;
+        struct elf_stats_mark mark;
+        struct entropy_hist whole;
+        struct ehd_file *elf = NULL;
+        struct entropy_range *ranges = NULL;
+        uint64_t nranges = 0;
+        uint64_t block = config->entropy_block ? config->entropy_block
+                                               : ENTROPY_BLOCK;
+
+        if (view->data == NULL)
+                return;
+
+        uint64_t nblocks = (view->size + block - 1) / block;
+        float *bits = (float *)calloc(nblocks, sizeof(float));
+        if (bits == NULL) {
+                fprintf(ELF_ERR, "--entropy: out of memory\n");
+                return;
+        }
+
+        if ((type == ELF64 || type == ELF32) &&
+            ehd_open_mem(view->data, view->size, __ehd_allocator(&alloc),
+                         &elf) == EHD_OK)
+                ranges = __entropy_ranges(elf, view->size, &nranges);
+
+        memset(&whole, 0, sizeof(whole));
+        elf_stats_begin(&mark);
+        if (__entropy_run(view->data, view->size, block, bits, ranges,
+                          nranges, &whole, jobs) < 0) {
+                fprintf(ELF_ERR, "--entropy: out of memory\n");
+                goto out;
+        }
+
+        if (elf_json) {
+                __json_entropy(elf_json, bits, nblocks, block, ranges,
+                               nranges, &whole);
+                goto out;
+        }
+
+        uint64_t zero;
+        uint64_t text;
+        __entropy_shares(&whole, &zero, &text);
+        fprintf(elf_out,
+                "entropy %.3f bits/byte over %" PRIu64 " bytes, %" PRIu64
+                ".%" PRIu64 "%% zero, %" PRIu64 ".%" PRIu64 "%% text\n",
+                entropy_bits(&whole), whole.total, zero / 10, zero % 10,
+                text / 10, text % 10);
+
+        if (nranges) {
+                __entropy_table(ranges, nranges, 1, bits, block);
+                __entropy_table(ranges, nranges, 0, bits, block);
+        }
+        __entropy_map(bits, nblocks, block, ranges, nranges);
+
+out:
+        elf_stats_end(&mark, STATS_RENDER);
+        free(ranges);
+        free(bits);
+        if (elf)
+                ehd_close(elf);
 }
 
-/* ELF64 PROGRAM HEADER */
-__cold static void __print_elf64_ph_table(Elf64_Phdr *data,
-                                          Elf64_Half e_phnum) {
-        __print_ph_table_header();
+/*
+ * every mode that works on the mapped input, shared with --serve where
+ * cached is the LRU entry holding the already indexed image
+ */
+static void __process_mapped(struct config *config, struct elf_view *view,
+                             enum ELF_arch_type type, int jobs, int batch,
+                             struct map_lru_entry *cached) {
+        if ((type == ELF64 || type == ELF32) && cached && cached->elf) {
+                __process_elf(cached->elf, config,
+                              config->naddrs ? map_lru_symidx(cached) : NULL);
+        } else if (type == ELF64 || type == ELF32) {
+                process_elf_image(view, type, config);
+        }
+
+        if (type == AR_ARCHIVE) {
+                __process_archive(view, config, jobs);
+        }
+
+        if (type == NOT_ELF && !batch) {
+                fprintf(ELF_ERR, "NOT A ELF FILE!\n");
+        }
+
+        if (type == UNDEFINED_ARCH) {
+                fprintf(ELF_ERR, "its confirmed as ELF, but arch is not "
+                                 "x86 (legacy) or x86-64\n");
+        }
 
-        for (int i = 0; i < e_phnum; i++) {
-                __print_p_type(data[i].p_type);
+        if (config->show_bytes && elf_json) {
+                __json_bytes(elf_json, view, config);
+        } else if (config->show_bytes && elf_col == NULL) {
+                __dump_bytes(view, config);
+        }
 
-                /* print flags */
-                __print_p_flags(data[i].p_flags);
+        if (config->npatterns && elf_col == NULL) {
+                __search(config, view, type, jobs);
+        }
 
-                // /* print offset */
-                PRINT_PRETTYF("0x%016lx", data[i].p_offset, 18, 19);
+        if (config->rules && elf_col == NULL) {
+                __rules(config, view, type, jobs);
+        }
 
-                /* print vaddr */
-                PRINT_PRETTYF("0x%016lx", data[i].p_vaddr, 18, 19);
+        if (config->entropy && elf_col == NULL) {
+                __entropy(config, view, type, jobs);
+        }
 
-                /* print paddr */
-                PRINT_PRETTYF("0x%016lx", data[i].p_paddr, 18, 19);
+        if (config->strings && elf_col == NULL) {
+                __strings(config, view, type, jobs);
+        }
 
-                /* print file size */
-                PRINT_PRETTYF("0x%016lx", data[i].p_filesz, 18, 19);
+        if (config->hash && elf_col == NULL) {
+                __hash(config, view, type, jobs);
+        }
 
-                /* print file size */
-                PRINT_PRETTYF("0x%016lx", data[i].p_memsz, 18, 19);
+        if (config->dedup && elf_col == NULL) {
+                __dedup_file(config, view, type, jobs);
+        }
 
-                /* print file size */
-                PRINT_PRETTYF("0x%0lx", data[i].p_align, 18, 19);
+        if (config->simhash && elf_col == NULL) {
+                __simhash(config, view, type, jobs);
+        }
 
-                // char predicted_max_int[20];
-                // sprintf(predicted_max_int, "%lu", data[i].p_filesz);
-                // PRINT_PRETTYF("%s", predicted_max_int,
-                //               strlen(predicted_max_int), 18);
+        if (config->size_report && elf_col == NULL) {
+                __size(config, view, type);
+        }
 
-                /* end */
-                printf("\n");
+        if (config->layout && elf_col == NULL) {
+                __layout(config, view, type);
         }
 }
 
-__cold static void __print_elf32_ph_table(Elf32_Phdr *data,
-                                          Elf64_Half e_phnum) {
-        __print_ph_table_header();
+/*
+ * open, classify and run every mode on one path, config->filename is
+ * the path, returns the detected type or -1 when it can not be opened
+ *
+ * in batch mode non ELF inputs are dropped right after the 64 byte
+ * magic read, nothing is mapped for them
+ */
+/* keep, when given, takes the JSON document and leaves it open */
+static int __process_file(struct config *config, int jobs, int batch,
+                          int *cache_hit, struct elf_json *keep) {
+        struct elf_view view = { 0 };
+        struct elf_stats_mark mark;
+        struct elf_json local;
+        struct elf_json *json = keep ? keep : &local;
+        int type;
+
+        *cache_hit = 0;
+        if (__cache_usable(config) &&
+            (type = __process_cached(config, batch)) >= 0) {
+                *cache_hit = 1;
+                return type;
+        }
 
-        for (int i = 0; i < e_phnum; i++) {
-                __print_p_type(data[i].p_type);
+        elf_stats_begin(&mark);
+        int fd = __open_file(config->filename);
+        if (fd < 0) {
+                return -1;
+        }
 
-                /* print flags */
-                __print_p_flags(data[i].p_flags);
+        __advise_file(fd, __access_profile(config));
+        enum ELF_arch_type elf_arch_type = read_elf_magic(fd);
+        elf_stats_end(&mark, STATS_MAGIC);
 
-                // /* print offset */
-                PRINT_PRETTYF("0x%016x", data[i].p_offset, 18, 19);
+        if (batch && elf_arch_type == NOT_ELF && !config->hexdump &&
+            !config->show_bytes && !config->npatterns && !config->rules &&
+            !config->entropy && !config->strings && !config->hash) {
+                if (__cache_usable(config))
+                        __cache_store(config, fd, &view, elf_arch_type);
 
-                /* print vaddr */
-                PRINT_PRETTYF("0x%016x", data[i].p_vaddr, 18, 19);
+                close(fd);
+                return NOT_ELF;
+        }
 
-                /* print paddr */
-                PRINT_PRETTYF("0x%016x", data[i].p_paddr, 18, 19);
+        if (elf_arch_type == ELF64 || elf_arch_type == ELF32 ||
+            elf_arch_type == AR_ARCHIVE || config->show_bytes ||
+            config->npatterns || config->rules || config->entropy ||
+            config->strings || config->hash) {
+                elf_stats_begin(&mark);
+                if (__map_file(fd, &view, config) < 0) {
+                        close(fd);
+                        return -1;
+                }
+                elf_stats_end(&mark, STATS_MAP);
+                elf_stats_mapped(view.size);
+        }
 
-                /* print file size */
-                PRINT_PRETTYF("0x%016x", data[i].p_filesz, 18, 19);
+        /*
+         * --hash and --simhash lines carry their path, --dedup,
+         * --simhash-pairs and --size-report report at the end
+         */
+        if (batch && config->format == FORMAT_TEXT && !config->hash &&
+            !config->dedup && !config->simhash && !config->size_report) {
+                fprintf(elf_out, "\n%s:\n", config->filename);
+        }
 
-                /* print file size */
-                PRINT_PRETTYF("0x%016x", data[i].p_memsz, 18, 19);
+        __json_doc_open(json, config, NULL, elf_arch_type,
+                        view.data ? view.size : __get_file_n(fd));
+        __process_mapped(config, &view, elf_arch_type, jobs, batch, NULL);
+
+        if (config->hexdump && elf_col == NULL) {
+                elf_stats_begin(&mark);
+                if (elf_json)
+                        __json_hexdump(elf_json, fd);
+                else
+                        _start_hexdump(fd);
+                elf_stats_end(&mark, STATS_RENDER);
+        }
 
-                /* print file size */
-                PRINT_PRETTYF("0x%0x", data[i].p_align, 18, 19);
+        if (keep == NULL)
+                __json_doc_close(json, config);
 
-                /* end */
-                printf("\n");
+        if (__cache_usable(config)) {
+                __cache_store(config, fd, &view, elf_arch_type);
         }
+
+        __unmap_file(&view);
+        close(fd);
+        return elf_arch_type;
 }
 
-/* e_shstrndx is global,
- * we need to cast to int64 from int32 */
-__cold static void __print_elf64_sh_table(int fd, Elf64_Ehdr *ehdr_data,
-                                          Elf64_Shdr *data) {
-        __print_sh_table_header();
+/*
+ * batch mode, every input (file or directory walk step) is a task on
+ * the work-stealing pool, each worker renders into its own buffer and
+ * only takes the stdout lock to write a full chunk
+ */
+#define BATCH_FLUSH_SIZE (64 * 1024)
 
-        char *shstr_string = (char *)malloc(4096);
+struct batch_out {
+        FILE *stream;
+        char *buf;
+        size_t len;
+};
 
-        for (int i = 0; i < ehdr_data->e_shnum; i++) {
-                PRINT_PRETTYF_NUM("%d", i, 4);
+struct batch {
+        struct config *config;
+        struct batch_out *out;       /* one per worker */
+        struct elf_columnar *col;    /* one per worker, columnar only */
+        struct arena *arenas;        /* one per worker */
+        pthread_mutex_t stdout_lock;
+
+        /* atomic counters */
+        uint64_t files;
+        uint64_t elf;
+        uint64_t skipped;
+        uint64_t failed;
+        uint64_t cache_hits;
+};
 
-                /*
-                 * need resolver of sh_name
-                 * but, temporarily I use normal number print instead
-                 */
-                _resolve_e_shstrndx(fd, ehdr_data->e_shstrndx,
-                                    ehdr_data->e_shentsize, data[i].sh_name,
-                                    ehdr_data->e_shoff, shstr_string);
-                // printf("%ld", strlen(shstr_string));
+/* one allocation, the path follows the task */
+struct batch_task {
+        struct batch *batch;
+        char path[];
+};
 
-                PRINT_PRETTYF_NO_OVERFLOW("%s", shstr_string,
-                                          (unsigned long)17);
-                __print_elf_section_header_type(data[i].sh_type);
-                PRINT_PRETTYF_NUM("%ld", data[i].sh_flags, 6);
+static void __batch_flush(struct batch *batch, int worker) {
+        struct batch_out *out = &batch->out[worker];
+        struct elf_stats_mark mark;
 
-                PRINT_PRETTYF("0x%016lx", data[i].sh_addr, 18, 19);
+        elf_stats_begin(&mark);
+        fflush(out->stream);
+        if (out->len > 0) {
+                pthread_mutex_lock(&batch->stdout_lock);
+                fwrite(out->buf, 1, out->len, stdout);
+                pthread_mutex_unlock(&batch->stdout_lock);
+        }
+        elf_stats_end(&mark, STATS_FLUSH);
 
-                PRINT_PRETTYF_NUM("%ld", data[i].sh_offset, 19);
+        fclose(out->stream);
+        free(out->buf);
+        out->buf = NULL;
+        out->len = 0;
+        out->stream = open_memstream(&out->buf, &out->len);
+}
 
-                PRINT_PRETTYF("0x%016lx", data[i].sh_size, 18, 19);
+static void __batch_submit(struct thread_pool *tp, int worker,
+                           struct batch *batch, const char *path, int is_dir);
 
-                PRINT_PRETTYF_NUM("%d", data[i].sh_link, 10);
+static void __batch_file_task(struct thread_pool *tp, int worker, void *arg) {
+        struct batch_task *task = (struct batch_task *)arg;
+        struct batch *batch = task->batch;
+        struct batch_out *out = &batch->out[worker];
+        struct config config = *batch->config;
 
-                PRINT_PRETTYF_NUM("%d", data[i].sh_info, 5);
+        config.filename = task->path;
+        elf_out = out->stream;
+        elf_col = batch->col ? &batch->col[worker] : NULL;
+        elf_arena = &batch->arenas[worker];
 
-                PRINT_PRETTYF_NUM("%ld", data[i].sh_addralign, 6);
+        int cache_hit;
+        struct arena_mark scope = arena_mark(elf_arena);
+        int type = __process_file(&config, 1, 1, &cache_hit, NULL);
 
-                PRINT_PRETTYF("0x%016lx", data[i].sh_entsize, 18, 19);
+        arena_release(elf_arena, scope);
 
-                // PRINT_PRETTYF("0x%016lx", data[i].sh_addr, 12, 19);
-                // PRINT_PRETTYF("0x%016lx", data[i].sh_offset, 8, 19);
-                // PRINT_PRETTYF("0x%016lx", data[i].sh_size, 7, 19);
-                // PRINT_PRETTYF("0x%016x", data[i].sh_link, 7, 19);
-                // PRINT_PRETTYF("0x%016x", data[i].sh_info, 1, 4);
-                // PRINT_PRETTYF("0x%016lx", data[i].sh_addralign, 2, 3);
-                // PRINT_PRETTYF("0x%016lx", data[i].sh_entsize, 10, 19);
+        __atomic_add_fetch(&batch->files, 1, __ATOMIC_RELAXED);
+        __atomic_add_fetch(&batch->cache_hits, cache_hit, __ATOMIC_RELAXED);
+        if (type < 0) {
+                __atomic_add_fetch(&batch->failed, 1, __ATOMIC_RELAXED);
+        } else if (type == NOT_ELF || type == UNDEFINED_ARCH) {
+                __atomic_add_fetch(&batch->skipped, 1, __ATOMIC_RELAXED);
+        } else {
+                __atomic_add_fetch(&batch->elf, 1, __ATOMIC_RELAXED);
+        }
 
-                printf("\n");
+        fflush(out->stream);
+        if (out->len >= BATCH_FLUSH_SIZE) {
+                __batch_flush(batch, worker);
         }
 
-        free(shstr_string);
+        free(task);
 }
 
-__cold static void __print_elf32_sh_table(int fd, Elf32_Ehdr *ehdr_data,
-                                          Elf32_Shdr *data) {
-        //
-        __print_sh_table_header();
-
-        char *shstr_string = (char *)malloc(4096);
+/*
+ * children are queued on this worker's own deque, idle workers steal
+ * them, symlinks are only followed to regular files (no loops)
+ */
+static void __batch_dir_task(struct thread_pool *tp, int worker, void *arg) {
+        struct batch_task *task = (struct batch_task *)arg;
+        struct batch *batch = task->batch;
+        struct dirent *ent;
+
+        DIR *dir = opendir(task->path);
+        if (dir == NULL) {
+                fprintf(ELF_ERR, "opendir() %s: %s\n", task->path,
+                        strerror(errno));
+                __atomic_add_fetch(&batch->failed, 1, __ATOMIC_RELAXED);
+                goto out;
+        }
 
-        for (int i = 0; i < ehdr_data->e_shnum; i++) {
-                PRINT_PRETTYF_NUM("%d", i, 4);
+        while ((ent = readdir(dir)) != NULL) {
+                struct stat st;
+                unsigned char d_type = ent->d_type;
 
-                /*
-                 * need resolver of sh_name
-                 * but, temporarily I use normal number print instead
-                 */
-                _resolve_e_shstrndx32(fd, ehdr_data->e_shstrndx,
-                                    ehdr_data->e_shentsize, data[i].sh_name,
-                                    ehdr_data->e_shoff, shstr_string);
-                // printf("%ld", strlen(shstr_string));
+                if (strcmp(ent->d_name, ".") == 0 ||
+                    strcmp(ent->d_name, "..") == 0)
+                        continue;
 
-                PRINT_PRETTYF_NO_OVERFLOW("%s", shstr_string,
-                                          (unsigned long)17);
-                __print_elf_section_header_type(data[i].sh_type);
-                PRINT_PRETTYF_NUM("%d", data[i].sh_flags, 6);
+                char child[PATH_MAX];
 
-                PRINT_PRETTYF("0x%016x", data[i].sh_addr, 18, 19);
+                if (snprintf(child, sizeof(child), "%s/%s", task->path,
+                             ent->d_name) >= (int)sizeof(child))
+                        continue;
 
-                PRINT_PRETTYF_NUM("%d", data[i].sh_offset, 19);
+                if (d_type == DT_UNKNOWN || d_type == DT_LNK) {
+                        int follow = d_type == DT_LNK;
 
-                PRINT_PRETTYF("0x%016x", data[i].sh_size, 18, 19);
+                        if ((follow ? stat(child, &st) : lstat(child, &st)) < 0)
+                                d_type = DT_UNKNOWN;
+                        else if (S_ISREG(st.st_mode))
+                                d_type = DT_REG;
+                        else if (S_ISDIR(st.st_mode) && !follow)
+                                d_type = DT_DIR;
+                        else
+                                d_type = DT_UNKNOWN;
+                }
 
-                PRINT_PRETTYF_NUM("%d", data[i].sh_link, 10);
+                if (d_type == DT_REG || d_type == DT_DIR) {
+                        __batch_submit(tp, worker, batch, child,
+                                       d_type == DT_DIR);
+                }
+        }
 
-                PRINT_PRETTYF_NUM("%d", data[i].sh_info, 5);
+        closedir(dir);
 
-                PRINT_PRETTYF_NUM("%d", data[i].sh_addralign, 6);
+out:
+        free(task);
+}
 
-                PRINT_PRETTYF("0x%016x", data[i].sh_entsize, 18, 19);
+static void __batch_submit(struct thread_pool *tp, int worker,
+                           struct batch *batch, const char *path, int is_dir) {
+        size_t len = strlen(path) + 1;
+        struct batch_task *task =
+            (struct batch_task *)malloc(sizeof(struct batch_task) + len);
 
-                // PRINT_PRETTYF("0x%016lx", data[i].sh_addr, 12, 19);
-                // PRINT_PRETTYF("0x%016lx", data[i].sh_offset, 8, 19);
-                // PRINT_PRETTYF("0x%016lx", data[i].sh_size, 7, 19);
-                // PRINT_PRETTYF("0x%016x", data[i].sh_link, 7, 19);
-                // PRINT_PRETTYF("0x%016x", data[i].sh_info, 1, 4);
-                // PRINT_PRETTYF("0x%016lx", data[i].sh_addralign, 2, 3);
-                // PRINT_PRETTYF("0x%016lx", data[i].sh_entsize, 10, 19);
+        task->batch = batch;
+        memcpy(task->path, path, len);
+        thread_pool_submit(tp, worker,
+                           is_dir ? __batch_dir_task : __batch_file_task, task);
+}
 
-                printf("\n");
-        }
+static int __is_dir(const char *path) {
+        struct stat st;
 
-        free(shstr_string);
+        return stat(path, &st) == 0 && S_ISDIR(st.st_mode);
 }
 
-static int __open_file(const char *filename) {
-        int fd = open(filename, O_RDONLY);
+__cold static void __process_batch(struct config *config) {
+        struct thread_pool tp;
+        struct batch batch = { 0 };
+        struct timespec start, end;
 
-        if (fd < 0) {
-                perror("open()");
-                return -1;
-        }
+        int jobs = config->jobs > 0 ? config->jobs : thread_pool_nproc();
 
-        return fd;
-}
+        clock_gettime(CLOCK_MONOTONIC, &start);
 
-__cold static enum ELF_arch_type read_elf_magic(int fd) {
-        u_int8_t buf[64];
-        size_t bufsize = SIZE(buf, u_int8_t);
-        memset(buf, 0, bufsize);
+        /* a pool that could not start every thread is torn down */
+        if (thread_pool_init(&tp, jobs) < 0 &&
+            (jobs == 1 || thread_pool_init(&tp, 1) < 0)) {
+                return;
+        }
 
-        read(fd, buf, bufsize);
-        // VT_HEXDUMP(buf, bufsize);
+        batch.config = config;
+        batch.out = (struct batch_out *)calloc(tp.nthreads,
+                                               sizeof(struct batch_out));
+        pthread_mutex_init(&batch.stdout_lock, NULL);
+
+        batch.arenas = (struct arena *)calloc(tp.nthreads,
+                                              sizeof(struct arena));
+        for (int i = 0; i < tp.nthreads; i++) {
+                batch.out[i].stream =
+                    open_memstream(&batch.out[i].buf, &batch.out[i].len);
+                arena_init(&batch.arenas[i]);
+        }
 
-        if (buf[0] == elf_magic[0] && buf[1] == elf_magic[1] &&
-            buf[2] == elf_magic[2] && buf[3] == elf_magic[3]) {
-                if (buf[4] == 1) {
-                        return ELF32;
-                } else if (buf[4] == 2) {
-                        return ELF64;
-                } else {
-                        return UNDEFINED_ARCH;
+        if (config->format == FORMAT_COLUMNAR) {
+                batch.col = (struct elf_columnar *)calloc(
+                    tp.nthreads, sizeof(struct elf_columnar));
+                for (int i = 0; i < tp.nthreads; i++) {
+                        __col_init(&batch.col[i]);
                 }
-        } else {
-                return NOT_ELF;
         }
-}
 
-/*
- * Read ELF header
- * mode: x64
- */
-__cold static void interpret_elf64_hdr(int fd, Elf64_Ehdr *preallocated_hdr) {
-        u_int8_t *buf = (u_int8_t *)malloc(sizeof(Elf64_Ehdr));
-
-        lseek(fd, 0, SEEK_SET);
-        int ret = read(fd, buf, sizeof(Elf64_Ehdr));
-        if (ret < 0) {
-                perror("read()");
-                return;
+        for (uint64_t i = 0; i < config->nfiles; i++) {
+                __batch_submit(&tp, -1, &batch, config->files[i],
+                               __is_dir(config->files[i]));
         }
 
-        memcpy(preallocated_hdr, buf, sizeof(Elf64_Ehdr));
-
-        free(buf);
-}
+        thread_pool_wait(&tp);
 
-/*
- * Read ELF header
- * mode: x86
- */
-__cold static void interpret_elf32_hdr(int fd, Elf32_Ehdr *preallocated_hdr) {
-        u_int8_t *buf = (u_int8_t *)malloc(sizeof(Elf32_Ehdr));
+        /* workers are idle now, their buffers can be touched from here */
+        for (int i = 0; i < tp.nthreads; i++) {
+                if (batch.col) {
+                        __col_finish(&batch.col[i], batch.out[i].stream);
+                }
 
-        lseek(fd, 0, SEEK_SET);
-        int ret = read(fd, buf, sizeof(Elf32_Ehdr));
-        if (ret < 0) {
-                perror("read()");
-                return;
+                __batch_flush(&batch, i);
+                fclose(batch.out[i].stream);
+                free(batch.out[i].buf);
+                __arena_done(&batch.arenas[i]);
         }
 
-        memcpy(preallocated_hdr, buf, sizeof(Elf32_Ehdr));
-
-        free(buf);
+        thread_pool_destroy(&tp);
+        pthread_mutex_destroy(&batch.stdout_lock);
+        free(batch.out);
+        free(batch.col);
+        free(batch.arenas);
+
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        double secs = (end.tv_sec - start.tv_sec) +
+                      (end.tv_nsec - start.tv_nsec) / 1e9;
+
+        fprintf(ELF_ERR,
+                "batch: %" PRIu64 " files, %" PRIu64 " ELF, %" PRIu64
+                " skipped, %" PRIu64 " failed in %.3fs (%.0f files/sec)\n",
+                batch.files, batch.elf, batch.skipped, batch.failed, secs,
+                secs > 0 ? batch.files / secs : 0.0);
+
+        if (config->cache) {
+                fprintf(ELF_ERR, "cache: %" PRIu64 " hits, %" PRIu64
+                                 " misses\n",
+                        batch.cache_hits, batch.files - batch.cache_hits);
+        }
 }
 
 /*
- * Read ELF program header
- * mode: x64
+ * --serve / --client protocol, native byte order (local socket only)
+ *
+ *   request:  u32 argc, then argc x (u32 len, bytes), argv[0] is the
+ *             client's working directory, argc == 0 ends the session
+ *   response: u32 status, u64 len, then everything the request
+ *             printed; status is what the same command line exits
+ *             with when run on its own, 0 or 255, modes the server
+ *             can not run are refused with 255
+ *
+ * one connection can carry any number of requests, one request any
+ * number of files and --addr2sym addresses
  */
-__cold static Elf64_Phdr *interpret_elf64_program_header(int fd,
-                                                         Elf64_Off elf_start,
-                                                         Elf64_Half e_phnum) {
-        /* alloc once, free at function exits */
-        u_int8_t *buf_each = (u_int8_t *)malloc(sizeof(Elf64_Phdr));
+#define SERVE_MAX_ARGC 65536
+#define SERVE_MAX_ARG (1 << 20)
+#define SERVE_LRU_CAP 256
+
+struct serve {
+        struct map_lru lru;
+        pthread_mutex_t parse_lock; /* getopt_long() keeps global state */
+        uint64_t active;            /* open connections, under parse_lock */
+};
+
+struct serve_conn {
+        struct serve *srv;
+        int fd;
+};
 
-        Elf64_Phdr *program_header_section =
-            (Elf64_Phdr *)malloc(sizeof(Elf64_Phdr) * e_phnum);
+static volatile sig_atomic_t serve_stop;
 
-        for (int i = 0; i < e_phnum; i++) {
-                lseek(fd, elf_start + (sizeof(Elf64_Phdr) * i), SEEK_SET);
+static int __read_full(int fd, void *buf, size_t n) {
+        size_t done = 0;
 
-                int ret = read(fd, buf_each, sizeof(Elf64_Phdr));
-                if (ret < 0) {
-                        perror("read() on interpret_elf64_program_header");
-                } else {
-                        memcpy(&program_header_section[i], buf_each,
-                               sizeof(Elf64_Phdr));
-                        memset(buf_each, 0, sizeof(Elf64_Phdr));
-                }
+        while (done < n) {
+                ssize_t ret = read(fd, (char *)buf + done, n - done);
+                if (ret < 0 && errno == EINTR)
+                        continue;
+                if (ret <= 0)
+                        return -1;
+                done = done + ret;
         }
-        free(buf_each);
 
-        return program_header_section;
+        return 0;
 }
 
-/*
- * Read ELF program header
- * mode: x86
- */
-__cold static Elf32_Phdr *interpret_elf32_program_header(int fd,
-                                                         Elf32_Off elf_start,
-                                                         Elf32_Half e_phnum) {
-        /* alloc once, free at function exits */
-        u_int8_t *buf_each = (u_int8_t *)malloc(sizeof(Elf32_Phdr));
+static int __write_full(int fd, const void *buf, size_t n) {
+        size_t done = 0;
 
-        Elf32_Phdr *program_header_section =
-            (Elf32_Phdr *)malloc(sizeof(Elf32_Phdr) * e_phnum);
+        while (done < n) {
+                ssize_t ret = write(fd, (const char *)buf + done, n - done);
+                if (ret < 0 && errno == EINTR)
+                        continue;
+                if (ret <= 0)
+                        return -1;
+                done = done + ret;
+        }
 
-        for (int i = 0; i < e_phnum; i++) {
-                lseek(fd, elf_start + (sizeof(Elf32_Phdr) * i), SEEK_SET);
+        return 0;
+}
 
-                int ret = read(fd, buf_each, sizeof(Elf32_Phdr));
-                if (ret < 0) {
-                        perror("read() on interpret_elf32_program_header");
-                } else {
-                        memcpy(&program_header_section[i], buf_each,
-                               sizeof(Elf32_Phdr));
-                        memset(buf_each, 0, sizeof(Elf32_Phdr));
-                }
+static void __free_argv(char **argv, uint32_t argc) {
+        for (uint32_t i = 0; argv && i < argc; i++) {
+                free(argv[i]);
         }
-        free(buf_each);
 
-        return program_header_section;
+        free(argv);
 }
 
 /*
- * Read ELF section header
- * mode: x64
+ * NULL at the end of the session or on a malformed request, argv has
+ * a trailing NULL like the one main() gets
  */
-__cold static Elf64_Shdr *
-interpret_elf64_section_header(int fd, Elf64_Off e_shoff, Elf64_Half e_shnum) {
-        u_int8_t *buf_each = (u_int8_t *)malloc(sizeof(Elf64_Shdr));
-        Elf64_Shdr *section_header_section =
-            (Elf64_Shdr *)malloc(sizeof(Elf64_Shdr) * e_shnum);
-
-        for (int i = 0; i < e_shnum; i++) {
-                lseek(fd, e_shoff + (sizeof(Elf64_Shdr) * i), SEEK_SET);
-
-                int ret = read(fd, buf_each, sizeof(Elf64_Shdr));
-                if (ret < 0) {
-                        perror("read() on interpret_elf64_section_header");
-                } else {
-                        memcpy(&section_header_section[i], buf_each,
-                               sizeof(Elf64_Shdr));
-                        memset(buf_each, 0, sizeof(Elf64_Shdr));
-                }
+static char **__serve_read_request(int fd, uint32_t *argc) {
+        if (__read_full(fd, argc, sizeof(uint32_t)) < 0 || *argc == 0 ||
+            *argc > SERVE_MAX_ARGC) {
+                return NULL;
         }
-        free(buf_each);
 
-        return section_header_section;
-}
+        char **argv = (char **)calloc(*argc + 1, sizeof(char *));
 
-/*
- * Read ELF section header
- * mode: x86
- *
- * reserved
- */
-__cold static Elf32_Shdr *
-interpret_elf32_section_header(int fd, Elf32_Off e_shoff, Elf32_Half e_shnum) {
-        u_int8_t *buf_each = (u_int8_t *)malloc(sizeof(Elf32_Shdr));
-        Elf32_Shdr *section_header_section =
-            (Elf32_Shdr *)malloc(sizeof(Elf32_Shdr) * e_shnum);
-
-        for (int i = 0; i < e_shnum; i++) {
-                lseek(fd, e_shoff + (sizeof(Elf32_Shdr) * i), SEEK_SET);
-
-                int ret = read(fd, buf_each, sizeof(Elf32_Shdr));
-                if (ret < 0) {
-                        perror("read() on interpret_elf32_section_header");
-                } else {
-                        memcpy(&section_header_section[i], buf_each,
-                               sizeof(Elf32_Shdr));
-                        memset(buf_each, 0, sizeof(Elf32_Shdr));
+        for (uint32_t i = 0; i < *argc; i++) {
+                uint32_t len;
+
+                if (__read_full(fd, &len, sizeof(len)) < 0 ||
+                    len > SERVE_MAX_ARG) {
+                        __free_argv(argv, *argc);
+                        return NULL;
+                }
+
+                argv[i] = (char *)malloc(len + 1);
+                if (__read_full(fd, argv[i], len) < 0) {
+                        __free_argv(argv, *argc);
+                        return NULL;
                 }
+                argv[i][len] = 0;
         }
-        free(buf_each);
 
-        return section_header_section;
+        return argv;
 }
 
-static int parse_opt(int argc, char *argv[], struct config *config) {
-        int retval = 0;
-        char opt = 0;
-        int index = 0;
+/*
+ * same modes as the CLI, files come out of the LRU already mapped and
+ * indexed, relative paths are taken from the client's directory,
+ * returns -1 when the command line or an input failed
+ */
+static int __serve_request(struct serve *srv, int argc, char **argv) {
+        struct elf_columnar col;
+        struct config config;
+        struct elf_json json;
+        char path[PATH_MAX];
 
-        u_int64_t conv_optarg = 0;
+        memset(&config, 0, sizeof(config));
+        alloc_config_struct(&config);
 
-        while (1) {
-                opt = getopt_long(argc, argv, "", long_options, &index);
+        pthread_mutex_lock(&srv->parse_lock);
+        optind = 0;
+        opterr = 0;
+        int ret = parse_opt(argc, argv, &config);
+        pthread_mutex_unlock(&srv->parse_lock);
 
-                if (opt == -1) {
-                        break;
-                }
+        if (ret < 0) {
+                free_config_struct(&config);
+                return -1;
+        }
 
-                switch (opt) {
-                case '?':
-                        break;
+        /* main runs these around or instead of the per file loop */
+        if (config.hexdump || config.files_from || config.diff ||
+            config.verify || config.dedup || config.simhash_pairs ||
+            config.size_report || config.pid || config.follow) {
+                fprintf(ELF_ERR,
+                        "--hexdump, --files-from, --diff, --verify, --dedup, "
+                        "--simhash-pairs, --size-report, --pid and --follow "
+                        "are not served, run them without --client\n");
+                free_config_struct(&config);
+                return -1;
+        }
 
-                case GETOPT_CUSTOM_FILE:
-                        config->filename = optarg;
-                        break;
+        if (config.format == FORMAT_COLUMNAR && __col_init(&col) == 0) {
+                elf_col = &col;
+        }
 
-                case GETOPT_CUSTOM_HEADER:
-                        config->show_header = 1;
-                        break;
+        for (uint64_t i = 0; i < config.nfiles; i++) {
+                const char *file = config.files[i];
 
-                case GETOPT_CUSTOM_HEADER_STRUCT:
-                        config->show_header_struct = 1;
-                        break;
+                if (file[0] != '/') {
+                        snprintf(path, sizeof(path), "%s/%s", argv[0], file);
+                        file = path;
+                }
 
-                case GETOPT_CUSTOM_PROGRAM_HEADER:
-                        config->show_program_header = 1;
-                        break;
+                struct map_lru_entry *e = map_lru_get(&srv->lru, file);
+                if (e == NULL) {
+                        fprintf(ELF_ERR, "open() %s: %s\n", config.files[i],
+                                strerror(errno));
+                        ret = -1;
+                        continue;
+                }
 
-                case GETOPT_CUSTOM_PROGRAM_HEADER_STRUCT:
-                        config->show_program_header_struct = 1;
-                        break;
+                if (config.nfiles > 1 && config.format == FORMAT_TEXT) {
+                        fprintf(elf_out, "\n%s:\n", config.files[i]);
+                }
 
-                case GETOPT_CUSTOM_SECTION_HEADER:
-                        config->show_section_header = 1;
-                        break;
+                struct elf_view view = { e->data, e->size };
+                enum ELF_arch_type type = __elf_magic_type(e->data, e->size);
+                config.filename = config.files[i];
 
-                case GETOPT_CUSTOM_HEXDUMP:
-                        config->hexdump = 1;
-                        break;
-                case GETOPT_CUSTOM_LOOKUP_SECTION:
-                        strcpy(config->lookup_section_name, optarg);
-                        break;
-                }
-        }
+                struct arena_mark scope = arena_mark(elf_arena);
 
-        return retval;
-}
+                __json_doc_open(&json, &config, NULL, type, e->size);
+                __process_mapped(&config, &view, type, 1, 0, e);
+                __json_doc_close(&json, &config);
+                arena_release(elf_arena, scope);
+                map_lru_put(&srv->lru, e);
+        }
 
-static void alloc_config_struct(struct config *config) {
-        config->lookup_section_name = (char *)malloc(1024);
-        memset(config->lookup_section_name, 0, 1024);
-}
+        if (elf_col) {
+                __col_finish(elf_col, elf_out);
+                elf_col = NULL;
+        }
 
-static void free_config_struct(struct config *config) {
-        free(config->lookup_section_name);
+        free_config_struct(&config);
+        return ret;
 }
 
-__hot static int __get_file_n(int fd) {
-        struct stat statbuf;
-        memset(&statbuf, 0, sizeof(struct stat));
+static void *__serve_conn(void *arg) {
+        struct serve_conn *conn = (struct serve_conn *)arg;
+        struct arena arena;
+        uint32_t argc;
+        char **argv;
 
-        int ret = fstat(fd, &statbuf);
-        if (ret == 0) {
-                // asm volatile("nop");
+        arena_init(&arena);
+        elf_arena = &arena;
 
-                return statbuf.st_size;
-        } else {
-                perror("fstat()");
-                return -1;
-        }
-}
+        while ((argv = __serve_read_request(conn->fd, &argc)) != NULL) {
+                char *buf = NULL;
+                size_t len = 0;
 
-__hot static int _start_hexdump(int fd) {
-        struct file_off_control file_off_control = { .offset = FILE_BUFSIZE,
-                                                     .n = 0 };
-        // memset(&file_off_control, 0, sizeof(struct file_off_control));
+                FILE *stream = open_memstream(&buf, &len);
+                elf_out = stream;
+                elf_err = stream;
 
-        int filesize = __get_file_n(fd);
+                uint32_t status =
+                    __serve_request(conn->srv, argc, argv) < 0 ? 255 : 0;
 
-        char *buf = (char *)malloc(sizeof(char) * FILE_BUFSIZE);
+                fclose(stream);
+                elf_out = NULL;
+                elf_err = NULL;
 
-        VT_TITLE(buf, filesize);
-        for (int i = 0; i < (filesize / FILE_BUFSIZE); i++) {
-                lseek(fd, (file_off_control.offset * file_off_control.n),
-                      SEEK_SET);
-                read(fd, buf, FILE_BUFSIZE);
-                HEXDUMP(buf, FILE_BUFSIZE);
+                uint64_t n = len;
+                int ret = __write_full(conn->fd, &status, sizeof(status)) < 0 ||
+                          __write_full(conn->fd, &n, sizeof(n)) < 0 ||
+                          __write_full(conn->fd, buf, len) < 0;
 
-                file_off_control.n = file_off_control.n + 1;
+                free(buf);
+                __free_argv(argv, argc);
+                if (ret)
+                        break;
         }
 
-        int last_off = file_off_control.offset * file_off_control.n;
-        int n = filesize - last_off;
+        close(conn->fd);
+        elf_arena = NULL;
+        arena_destroy(&arena);
 
-        lseek(fd, SEEK_SET, last_off);
-        memset(buf, 0, n);
-        read(fd, buf, n);
-        HEXDUMP(buf, n);
+        pthread_mutex_lock(&conn->srv->parse_lock);
+        conn->srv->active = conn->srv->active - 1;
+        pthread_mutex_unlock(&conn->srv->parse_lock);
 
-        free(buf);
+        free(conn);
+        return NULL;
 }
 
-__hot static char *_resolve_e_shstrndx(int fd, Elf64_Half e_shstrndx,
-                                       Elf64_Half e_shentsize,
-                                       Elf64_Word sh_name, Elf64_Off e_shoff,
-                                       char *dst) {
-        int shstrtab_location = e_shoff + (e_shstrndx * e_shentsize);
-        lseek(fd, shstrtab_location, SEEK_SET);
+static void __serve_signal(int sig) {
+        (void)sig;
+        serve_stop = 1;
+}
 
-        Elf64_Shdr shstrtab_data = { 0 };
-        char buf[64];
-        char chr = 0;
-        int counter = 0;
+static int __unix_addr(struct sockaddr_un *addr, const char *path) {
+        memset(addr, 0, sizeof(struct sockaddr_un));
+        addr->sun_family = AF_UNIX;
 
-        int ret = read(fd, &buf, 64);
-        if (ret < 0) {
-                perror(
-                    "error: read() Elf64_Shdr on function _resolve_e_shstrndx");
-                goto return_fd_err;
+        if (strlen(path) >= sizeof(addr->sun_path)) {
+                fprintf(ELF_ERR, "socket path is too long: %s\n", path);
+                return -1;
         }
 
-        memcpy(&shstrtab_data, buf, e_shentsize);
+        strcpy(addr->sun_path, path);
+        return 0;
+}
 
-        /* new offset of actual string location */
-        shstrtab_location = shstrtab_data.sh_offset;
-        lseek(fd, shstrtab_location, SEEK_SET);
+/*
+ * --serve PATH, one thread per connection, runs until SIGINT / SIGTERM
+ */
+__cold static int __serve(struct config *config) {
+        struct serve srv;
+        struct sockaddr_un addr;
+        struct sigaction sa;
 
-        /* alloc one linux page memory */
-        char *preallocated_buffer = (char *)malloc(shstrtab_data.sh_size);
+        if (__unix_addr(&addr, config->serve_path) < 0) {
+                return -1;
+        }
 
-        memset(preallocated_buffer, 0, shstrtab_data.sh_size);
-        ret = read(fd, preallocated_buffer, shstrtab_data.sh_size);
+        memset(&sa, 0, sizeof(sa));
+        sa.sa_handler = __serve_signal; /* no SA_RESTART, accept() wakes */
+        sigaction(SIGINT, &sa, NULL);
+        sigaction(SIGTERM, &sa, NULL);
+        signal(SIGPIPE, SIG_IGN);
 
-        if (ret < 0) {
-                perror(
-                    "error: read() .shstrtab on function _resolve_e_shstrndx");
-                goto return_fd_err;
+        int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (fd < 0) {
+                perror("socket()");
+                return -1;
         }
 
-        do {
-                chr = preallocated_buffer[sh_name + counter];
-                counter++;
-        } while (chr != 0);
+        unlink(config->serve_path);
+        if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 ||
+            listen(fd, 128) < 0) {
+                perror("bind()");
+                close(fd);
+                return -1;
+        }
 
-        int far = (sh_name + counter) - sh_name;
-        memset(dst, 0, 4096);
-        memcpy(dst, &preallocated_buffer[sh_name], far);
+        map_lru_init(&srv.lru, SERVE_LRU_CAP);
+        pthread_mutex_init(&srv.parse_lock, NULL);
+        srv.active = 0;
+        fprintf(ELF_ERR, "serving on %s\n", config->serve_path);
 
-        free(preallocated_buffer);
+        while (!serve_stop) {
+                pthread_t thread;
 
-return_fd_err:
-        return 0;
+                int cfd = accept(fd, NULL, NULL);
+                if (cfd < 0) {
+                        if (errno != EINTR)
+                                perror("accept()");
+                        continue;
+                }
+
+                struct serve_conn *conn =
+                    (struct serve_conn *)malloc(sizeof(struct serve_conn));
+                conn->srv = &srv;
+                conn->fd = cfd;
+
+                pthread_mutex_lock(&srv.parse_lock);
+                srv.active = srv.active + 1;
+                pthread_mutex_unlock(&srv.parse_lock);
+
+                if (pthread_create(&thread, NULL, __serve_conn, conn) != 0) {
+                        pthread_mutex_lock(&srv.parse_lock);
+                        srv.active = srv.active - 1;
+                        pthread_mutex_unlock(&srv.parse_lock);
+                        close(cfd);
+                        free(conn);
+                        continue;
+                }
+                pthread_detach(thread);
+        }
+
+        close(fd);
+        unlink(config->serve_path);
+        fprintf(ELF_ERR, "served: %" PRIu64 " hits, %" PRIu64 " misses\n",
+                srv.lru.hits, srv.lru.misses);
+
+        /* a connection still open keeps its entries, exit tears them down */
+        pthread_mutex_lock(&srv.parse_lock);
+        if (srv.active == 0)
+                map_lru_destroy(&srv.lru);
+        pthread_mutex_unlock(&srv.parse_lock);
 
-err_clear_fh:
-        // fflush(fh);
         return 0;
 }
 
-static char *_resolve_e_shstrndx32(int fd, Elf32_Half e_shstrndx,
-                                   Elf32_Half e_shentsize, Elf32_Word sh_name,
-                                   Elf32_Off e_shoff, char *dst) {
-        int shstrtab_location = e_shoff + (e_shstrndx * e_shentsize);
-        lseek(fd, shstrtab_location, SEEK_SET);
+/*
+ * --client PATH, sends this command line to a --serve instance and
+ * prints the answer, argv[0] is swapped for the working directory,
+ * returns the status the server sent, -1 when there was no full answer
+ */
+__cold static int __client(struct config *config, int argc, char **argv) {
+        struct sockaddr_un addr;
+        char cwd[PATH_MAX];
+        uint32_t n = argc;
+        uint32_t status;
+        uint64_t len;
+        char buf[65536];
+
+        if (__unix_addr(&addr, config->client_path) < 0) {
+                return -1;
+        }
 
-        Elf32_Shdr shstrtab_data = { 0 };
-        char buf[sizeof(Elf32_Shdr)];
-        char chr = 0;
-        int counter = 0;
+        if (getcwd(cwd, sizeof(cwd)) == NULL) {
+                perror("getcwd()");
+                return -1;
+        }
 
-        int ret = read(fd, &buf, sizeof(Elf32_Shdr));
-        if (ret < 0) {
-                perror(
-                    "error: read() Elf32_Shdr on function _resolve_e_shstrndx");
-                goto return_fd_err;
+        int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (fd < 0 || connect(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+                perror("connect()");
+                if (fd >= 0)
+                        close(fd);
+                return -1;
         }
 
-        memcpy(&shstrtab_data, buf, e_shentsize);
+        /* one buffered request, the server sees it in one read */
+        char *req = NULL;
+        size_t req_len = 0;
+        FILE *stream = open_memstream(&req, &req_len);
 
-        /* new offset of actual string location */
-        shstrtab_location = shstrtab_data.sh_offset;
-        lseek(fd, shstrtab_location, SEEK_SET);
+        fwrite(&n, sizeof(n), 1, stream);
+        for (int i = 0; i < argc; i++) {
+                const char *arg = i == 0 ? cwd : argv[i];
+                uint32_t arg_len = strlen(arg);
 
-        /* alloc one linux page memory */
-        char *preallocated_buffer = (char *)malloc(shstrtab_data.sh_size);
+                fwrite(&arg_len, sizeof(arg_len), 1, stream);
+                fwrite(arg, 1, arg_len, stream);
+        }
+        n = 0;
+        fwrite(&n, sizeof(n), 1, stream);
+        fclose(stream);
 
-        memset(preallocated_buffer, 0, shstrtab_data.sh_size);
-        ret = read(fd, preallocated_buffer, shstrtab_data.sh_size);
+        int ret = __write_full(fd, req, req_len);
+        free(req);
 
-        if (ret < 0) {
-                perror(
-                    "error: read() .shstrtab on function _resolve_e_shstrndx");
-                goto return_fd_err;
+        if (ret < 0 || __read_full(fd, &status, sizeof(status)) < 0 ||
+            __read_full(fd, &len, sizeof(len)) < 0) {
+                fprintf(ELF_ERR, "no answer from %s\n", config->client_path);
+                close(fd);
+                return -1;
         }
 
-        do {
-                chr = preallocated_buffer[sh_name + counter];
-                counter++;
-        } while (chr != 0);
-
-        int far = (sh_name + counter) - sh_name;
-        memset(dst, 0, 4096);
-        memcpy(dst, &preallocated_buffer[sh_name], far);
+        while (len > 0) {
+                size_t chunk = len < sizeof(buf) ? len : sizeof(buf);
 
-        free(preallocated_buffer);
+                if (__read_full(fd, buf, chunk) < 0) {
+                        fprintf(ELF_ERR, "short answer from %s\n",
+                                config->client_path);
+                        close(fd);
+                        return -1;
+                }
 
-return_fd_err:
-        return 0;
+                fwrite(buf, 1, chunk, stdout);
+                len = len - chunk;
+        }
 
-err_clear_fh:
-        // fflush(fh);
-        return 0;
+        close(fd);
+        return status;
 }
 
 int main(int argc, char **argv) {
+        struct elf_cache cache;
+        struct elf_json json;
         struct config config;
         memset(&config, 0, sizeof(config));
 
+        elf_out = stdout;
         alloc_config_struct(&config);
 
         int ret = parse_opt(argc, argv, &config);
-        __debug_config(&config);
 
-        int fd = __open_file(config.filename);
-        if (fd < 0) {
+        /* the error is out already, nothing runs on a half parsed config */
+        if (ret < 0) {
+                free_config_struct(&config);
                 return -1;
-                // VT_HEXDUMP(ehdr, sizeof(Elf64_Ehdr));
-                // asm volatile("nop");
         }
 
-        int elf_arch_type = read_elf_magic(fd);
+        if (config.serve_path || config.client_path) {
+                ret = config.serve_path ? __serve(&config)
+                                        : __client(&config, argc, argv);
+                free_config_struct(&config);
+                return ret < 0 ? -1 : ret;
+        }
 
-        if (elf_arch_type == ELF64) {
-                Elf64_Ehdr *ehdr = (Elf64_Ehdr *)malloc(sizeof(Elf64_Ehdr));
-                interpret_elf64_hdr(fd, ehdr);
-                __print_elf64_hdr(ehdr, &config);
+        if (config.stats) {
+                elf_stats_init();
+        }
 
-                if (config.show_program_header) {
-                        Elf64_Phdr *phdr_table = interpret_elf64_program_header(
-                            fd, ehdr->e_phoff, ehdr->e_phnum);
+        if (config.files_from && __read_files_from(&config) < 0) {
+                free_config_struct(&config);
+                return -1;
+        }
 
-                        __print_elf64_ph_table(phdr_table, ehdr->e_phnum);
-                        free(phdr_table);
+        if (config.cache_path) {
+                if (elf_cache_open(&cache, config.cache_path) < 0) {
+                        free_config_struct(&config);
+                        return -1;
                 }
+                config.cache = &cache;
+        }
 
-                if (config.show_section_header) {
-                        Elf64_Shdr *shdr_table = interpret_elf64_section_header(
-                            fd, ehdr->e_shoff, ehdr->e_shnum);
-
-                        // VT_HEXDUMP(shdr_table, sizeof(Elf64_Shdr) * 1);
-                        __print_elf64_sh_table(fd, ehdr, shdr_table);
+        if (config.pid) {
+                ret = __process_pid(&config);
+        } else if (config.diff) {
+                ret = __diff(&config);
+        } else if (config.follow) {
+                ret = __follow(&config);
+        } else if (config.nfiles > 1 || config.files_from ||
+                   (config.nfiles == 1 && __is_dir(config.files[0]))) {
+                __process_batch(&config);
+                ret = 0;
+        } else {
+                struct elf_columnar col;
+                struct arena arena;
+                int cache_hit;
 
-                        free(shdr_table);
-                }
+                if (config.format == FORMAT_COLUMNAR && __col_init(&col) == 0)
+                        elf_col = &col;
 
-                free(ehdr);
-        }
+                arena_init(&arena);
+                elf_arena = &arena;
 
-        if (elf_arch_type == ELF32) {
-                Elf32_Ehdr *ehdr = (Elf32_Ehdr *)malloc(sizeof(Elf32_Ehdr));
-                interpret_elf32_hdr(fd, ehdr);
-                __print_elf32_hdr(ehdr, &config);
+                /*
+                 * one JSON document, the set reports go into it as well,
+                 * ndjson records of the set never carry a file
+                 */
+                int keep = __json_set_report(&config) &&
+                           config.format == FORMAT_JSON;
 
-                if (config.show_program_header) {
-                        Elf32_Phdr *phdr_table = interpret_elf32_program_header(
-                            fd, ehdr->e_phoff, ehdr->e_phnum);
+                ret = __process_file(
+                    &config,
+                    config.jobs > 0 ? config.jobs : thread_pool_nproc(), 0,
+                    &cache_hit, keep ? &json : NULL);
 
-                        __print_elf32_ph_table(phdr_table, ehdr->e_phnum);
-                        free(phdr_table);
+                if (elf_col) {
+                        __col_finish(elf_col, elf_out);
+                        elf_col = NULL;
                 }
 
-                if (config.show_section_header) {
-                        Elf32_Shdr *shdr_table = interpret_elf32_section_header(
-                            fd, ehdr->e_shoff, ehdr->e_shnum);
+                elf_arena = NULL;
+                __arena_done(&arena);
+        }
 
-                        __print_elf32_sh_table(fd, ehdr, shdr_table);
+        if (config.cache) {
+                elf_cache_close(config.cache);
+        }
 
-                        free(shdr_table);
-                }
+        if (config.verify && __verify_report(&config) < 0) {
+                ret = -1;
+        }
 
-                free(ehdr);
+        if (__json_set_report(&config) && elf_json == NULL) {
+                __json_set_open(&json, &config);
         }
 
-        if (elf_arch_type == NOT_ELF) {
-                fprintf(stderr, "NOT A ELF FILE!\n");
+        if (config.dedup) {
+                __dedup_report(&config);
         }
 
-        if (elf_arch_type == UNDEFINED_ARCH) {
-                fprintf(stderr, "its confirmed as ELF, but arch is not "
-                                "x86 (legacy) or x86-64\n");
+        if (config.simhash_set) {
+                __simhash_report(&config);
         }
 
-        if (config.hexdump) {
-                _start_hexdump(fd);
+        if (config.size_report && __size_report(&config) < 0) {
+                ret = -1;
         }
 
-        close(fd);
+        if (elf_json) {
+                __json_doc_close(elf_json, &config);
+        }
+
+        if (config.stats) {
+                struct elf_stats_mark mark;
+
+                elf_stats_begin(&mark);
+                fflush(elf_out);
+                elf_stats_end(&mark, STATS_FLUSH);
+                elf_stats_report(ELF_ERR);
+        }
+
+        /* --diff exits like cmp(1) and diff(1), 2 when it went wrong */
+        if (config.diff)
+                ret = ret < 0 ? 2 : ret;
+        else
+                ret = ret < 0 ? -1 : 0;
+
         free_config_struct(&config);
-        // __debug_config(&config);
+        return ret;
 }
@@ -7,8 +7,75 @@
 #ifndef ELF64_HEXDUMP_H
 #define ELF64_HEXDUMP_H
 
+#include "columnar.h"
 #include <elf.h>
+#include <stddef.h>
 #include <stdint.h>
+#include <sys/types.h>
+
+struct ar_archive;
+struct elf_cache;
+struct ehd_file;
+struct ehd_symtab;
+struct ehd_sym_index;
+struct map_lru_entry;
+struct serve;
+struct elf_json;
+struct json_writer;
+struct sockaddr_un;
+struct elf_cache_range;
+struct arena;
+struct proc_map;
+struct proc_maps;
+struct proc_mem;
+struct pid_image;
+struct pid_range;
+struct search_pattern;
+struct search_hits;
+struct search_job;
+struct search_sec;
+struct rule_set;
+struct rule_range;
+struct diff_field;
+struct diff_side;
+struct diff_sec;
+struct diff_totals;
+struct entropy_hist;
+struct entropy_job;
+struct entropy_range;
+struct pretty_table;
+struct strings_job;
+struct strings_span;
+struct str_hits;
+struct str_hit;
+struct hash_range;
+struct hash_job;
+struct manifest;
+struct dedup;
+struct dedup_rank;
+struct dedup_stat;
+struct dedup_entry;
+struct simhash_job;
+struct simhash_score_job;
+struct simhash_set;
+struct size_report;
+struct size_items;
+struct size_seg;
+struct size_region;
+struct size_span;
+struct size_rank;
+struct layout;
+struct layout_region;
+struct layout_hits;
+struct layout_map;
+struct ival;
+struct ival_index;
+struct thread_pool;
+
+/* older glibc elf.h does not know about these yet */
+#ifndef PT_GNU_SFRAME
+#define PT_GNU_SFRAME 0x6474e554
+#endif
 
 #ifdef __clang__
 #ifndef __hot
@@ -28,7 +95,7 @@
 #endif
 
 struct config {
-        char *filename;
+        char *filename; /* file being processed right now */
         uint8_t show_header;
         uint8_t show_header_struct;
         uint8_t hexdump;
@@ -37,47 +104,531 @@ struct config {
         uint8_t show_section_header;
         char *lookup_section_name;
 
+        uint8_t show_symbols;
+        uint8_t show_build_id;
+        int jobs; /* worker threads, 0 means nproc */
+
+        /* every --file, bare argument and --files-from line */
+        char **files;
+        uint64_t nfiles;
+        uint64_t files_cap;
+        uint64_t owned_from; /* how many of them came from files_from */
+        char *files_from;
+
+        char *cache_path;        /* --cache FILE */
+        struct elf_cache *cache; /* NULL when disabled */
+        uint8_t cache_unserved;  /* an option the cache can not answer */
+
+        /* --addr2sym, repeatable */
+        uint64_t *addrs;
+        uint64_t naddrs;
+        uint64_t addrs_cap;
+
+        /* --bytes OFF:LEN */
+        uint8_t show_bytes;
+        uint64_t bytes_off;
+        uint64_t bytes_len;
+
+        char *serve_path;  /* --serve SOCKET */
+        char *client_path; /* --client SOCKET */
+
+        uint8_t format; /* enum elf_format */
+        uint8_t stats;  /* --stats */
+
+        uint8_t populate; /* --populate, MAP_POPULATE */
+        uint8_t hugepage; /* --hugepage, MADV_HUGEPAGE */
+        uint8_t follow;   /* --follow */
+        pid_t pid;        /* --pid, 0 when unset */
+
+        /* --search, repeatable, compiled while parsing */
+        struct search_pattern *patterns;
+        uint64_t npatterns;
+        uint64_t patterns_cap;
+        char *search_in; /* --search-in */
+
+        struct rule_set *rules; /* --rules, NULL when unset */
+        uint8_t diff;           /* --diff, the two inputs */
+
+        uint8_t entropy;        /* --entropy */
+        uint64_t entropy_block; /* --entropy-block, 0 for the default */
+
+        uint8_t strings;      /* --strings */
+        uint8_t strings_enc;  /* --strings-enc, STR_* bits, 0 for ascii */
+        uint8_t skip_debug;   /* --skip-debug */
+        uint32_t strings_min; /* --strings-min, 0 for the default */
+
+        uint8_t hash;             /* --hash */
+        uint8_t hash_algo;        /* enum digest_algo */
+        struct manifest *verify;  /* --verify, NULL when unset */
+        struct dedup *dedup;      /* --dedup, NULL when unset */
+
+        uint8_t simhash;                  /* --simhash */
+        uint64_t simhash_pairs;           /* --simhash-pairs */
+        struct simhash_set *simhash_set;  /* NULL unless ranking pairs */
+
+        struct size_report *size_report; /* --size-report, NULL when unset */
+        const char *size_baseline;        /* --size-baseline */
+
+        uint8_t layout; /* --layout */
+
         /*
          * add more in future
          */
 };
 
-__cold static void __debug_config(struct config *config);
+enum ELF_arch_type {
+        ELF32,
+        ELF64,
+        NOT_ELF,
+        UNDEFINED_ARCH, /* need triage */
+        AR_ARCHIVE      /* static library, members are ELF */
+};
+
+/* how the requested modes walk an input, picks the readahead hints */
+enum elf_access {
+        ACCESS_NORMAL,     /* header tables and what they point to */
+        ACCESS_SEQUENTIAL, /* the whole file, front to back */
+        ACCESS_RANDOM      /* a few small lookups, no readahead */
+};
+
+enum elf_format {
+        FORMAT_TEXT,
+        FORMAT_JSON,  /* one document per input */
+        FORMAT_NDJSON,  /* one record per line */
+        FORMAT_COLUMNAR /* sections / symbols / relocations column blocks */
+};
+
+/* columns of the --format columnar tables */
+enum {
+        COL_SEC_FILE,
+        COL_SEC_MEMBER,
+        COL_SEC_INDEX,
+        COL_SEC_NAME,
+        COL_SEC_TYPE,
+        COL_SEC_FLAGS,
+        COL_SEC_ADDR,
+        COL_SEC_OFFSET,
+        COL_SEC_SIZE,
+        COL_SEC_LINK,
+        COL_SEC_INFO,
+        COL_SEC_ADDRALIGN,
+        COL_SEC_ENTSIZE
+};
+
+enum {
+        COL_SYM_FILE,
+        COL_SYM_MEMBER,
+        COL_SYM_SYMTAB,
+        COL_SYM_INDEX,
+        COL_SYM_NAME,
+        COL_SYM_VALUE,
+        COL_SYM_SIZE,
+        COL_SYM_TYPE,
+        COL_SYM_BIND,
+        COL_SYM_VISIBILITY,
+        COL_SYM_SHNDX
+};
+
+enum {
+        COL_REL_FILE,
+        COL_REL_MEMBER,
+        COL_REL_SECTION,
+        COL_REL_TARGET,
+        COL_REL_INDEX,
+        COL_REL_OFFSET,
+        COL_REL_TYPE,
+        COL_REL_SYM,
+        COL_REL_SYMBOL,
+        COL_REL_ADDEND
+};
+
+struct elf_columnar {
+        struct col_table sections;
+        struct col_table symbols;
+        struct col_table relocs;
+        const char *member; /* archive member being added, or NULL */
+};
+
+/*
+ * bytes of one ELF image, the whole mapped file or one archive member
+ */
+struct elf_view {
+        const uint8_t *data;
+        uint64_t size;
+};
+
+/* value to name, for the sparse ranges of e.g. sh_type */
+struct elf_name {
+        Elf64_Word value;
+        const char *name;
+};
+
 void __print_process_elf_type(unsigned short e_type);
-void __print_machine(int em);
+static const char *__machine_name(Elf64_Half em);
 void __print_elf_version(unsigned int elf_version);
-void __print_elf_section_header_type(Elf64_Word sh_type);
-__cold static void __print_elf64_hdr(Elf64_Ehdr *ehdr, struct config *config);
-__cold static void __print_elf32_hdr(Elf32_Ehdr *ehdr, struct config *config);
-__cold static void __print_ph_table_header();
-__cold static void __print_sh_table_header();
-__cold static void __print_p_type(Elf32_Word p_type);
-__cold static void __print_p_flags(Elf64_Word p_flags);
-__cold static void __print_elf64_ph_table(Elf64_Phdr *data, Elf64_Half e_phnum);
-__cold static void __print_elf32_ph_table(Elf32_Phdr *data, Elf64_Half e_phnum);
-__cold static void __print_elf64_sh_table(int fd, Elf64_Ehdr *ehdr_data,
-                                          Elf64_Shdr *data);
+static const char *__elf_name_find(const struct elf_name *names, size_t n,
+                                   Elf64_Word value);
+static const char *__sh_type_name(Elf64_Word sh_type);
+__cold static void __print_elf_hdr(struct ehd_file *elf,
+                                   struct config *config);
+static const char *__p_type_name(Elf64_Word p_type);
+static const char *__p_type_label(Elf64_Word p_type);
+static const char *__p_flags_name(Elf64_Word p_flags);
+__cold static void __print_ph_table(struct ehd_file *elf);
+__cold static void __print_sh_table(struct ehd_file *elf);
+static const char *__st_type_name(unsigned char st_type);
+static const char *__st_bind_name(unsigned char st_bind);
+static const char *__st_visibility_name(unsigned char st_other);
+__cold static void __print_elf_symtab(struct ehd_symtab *st);
+static void *__arena_ehd_alloc(void *ctx, size_t size);
+static void __arena_ehd_free(void *ctx, void *ptr, size_t size);
+static const struct ehd_allocator *__ehd_allocator(struct ehd_allocator *a);
+static void *__file_alloc(size_t size);
+static void __arena_done(struct arena *a);
 static int __open_file(const char *filename);
+static enum elf_access __access_profile(struct config *config);
+static void __advise_file(int fd, enum elf_access access);
+static void __advise_range(const uint8_t *data, uint64_t size);
+static int __map_file(int fd, struct elf_view *view, struct config *config);
+static void __unmap_file(struct elf_view *view);
+__cold static enum ELF_arch_type __elf_magic_type(const uint8_t *buf,
+                                                  uint64_t size);
 __cold static enum ELF_arch_type read_elf_magic(int fd);
-__cold static void interpret_elf64_hdr(int fd, Elf64_Ehdr *preallocated_hdr);
-__cold static void interpret_elf32_hdr(int fd, Elf32_Ehdr *preallocated_hdr);
-__cold static Elf64_Phdr *
-interpret_elf64_program_header(int fd, Elf64_Off elf_start, Elf64_Half e_phnum);
-__cold static Elf32_Phdr *
-interpret_elf32_program_header(int fd, Elf32_Off elf_start, Elf32_Half e_phnum);
-__cold static Elf64_Shdr *
-interpret_elf64_section_header(int fd, Elf64_Off e_shoff, Elf64_Half e_shnum);
-__cold static Elf32_Shdr *
-interpret_elf32_section_header(int fd, Elf32_Off e_shoff, Elf32_Half e_shnum);
+__cold static void __dump_symtabs(struct ehd_file *elf);
+__cold static void __print_build_id(struct ehd_file *elf);
+__cold static void __dump_section_bytes(struct ehd_file *elf,
+                                        const char *name);
+__cold static void __print_addr2sym(struct config *config,
+                                    struct ehd_sym_index *idx);
+__cold static void __dump_bytes(struct elf_view *src, struct config *config);
+static const char *__arch_type_name(enum ELF_arch_type type);
+static void __json_record_begin(struct elf_json *j, const char *key,
+                                const char *record);
+static void __json_record_end(struct elf_json *j);
+static void __json_list_begin(struct elf_json *j, const char *key);
+static void __json_list_end(struct elf_json *j);
+static void __json_name(struct json_writer *w, const char *key,
+                        const char *name, uint64_t value);
+static void __json_doc_open(struct elf_json *j, struct config *config,
+                            const char *member, enum ELF_arch_type type,
+                            uint64_t size);
+static int __json_set_report(const struct config *config);
+static void __json_set_open(struct elf_json *j, struct config *config);
+static void __json_doc_close(struct elf_json *j, struct config *config);
+__cold static void __json_elf_hdr(struct elf_json *j, struct ehd_file *elf);
+__cold static void __json_ph_table(struct elf_json *j, struct ehd_file *elf);
+__cold static void __json_sh_table(struct elf_json *j, struct ehd_file *elf);
+__cold static void __json_symtabs(struct elf_json *j, struct ehd_file *elf);
+__cold static void __json_build_id(struct elf_json *j, struct ehd_file *elf);
+__cold static void __json_section_bytes(struct elf_json *j,
+                                        struct ehd_file *elf,
+                                        const char *name);
+__cold static void __json_addr2sym(struct elf_json *j, struct config *config,
+                                   struct ehd_sym_index *idx);
+__cold static void __json_bytes(struct elf_json *j, struct elf_view *src,
+                                struct config *config);
+__cold static void __json_hexdump(struct elf_json *j, int fd);
+__cold static void __json_elf(struct elf_json *j, struct ehd_file *elf,
+                              struct config *config,
+                              struct ehd_sym_index *idx);
+static int __col_init(struct elf_columnar *c);
+static void __col_finish(struct elf_columnar *c, FILE *out);
+static void __col_row_end(struct col_table *t);
+__cold static void __col_sections(struct elf_columnar *c,
+                                  struct ehd_file *elf, const char *file);
+__cold static void __col_symtab(struct elf_columnar *c, struct ehd_file *elf,
+                                const char *file, uint64_t section,
+                                const char *table);
+__cold static void __col_reltab(struct elf_columnar *c, struct ehd_file *elf,
+                                const char *file, uint64_t section,
+                                const char *table);
+__cold static void __col_elf(struct elf_columnar *c, struct ehd_file *elf,
+                             struct config *config);
+__cold static void __process_elf(struct ehd_file *elf, struct config *config,
+                                 struct ehd_sym_index *idx);
+__cold static void process_elf_image(struct elf_view *src,
+                                     enum ELF_arch_type type,
+                                     struct config *config);
+__cold static void __print_archive_index(struct ar_archive *ar);
+__cold static void __json_archive_index(struct elf_json *j,
+                                        struct ar_archive *ar,
+                                        struct config *config);
+__cold static void __process_archive(struct elf_view *src,
+                                     struct config *config, int jobs);
 static int parse_opt(int argc, char *argv[], struct config *config);
-__hot static int __get_file_n(int fd);
+static void __add_addr(struct config *config, uint64_t addr);
+static int __parse_bytes(struct config *config, const char *arg);
+static void __add_input(struct config *config, char *path);
+static int __read_files_from(struct config *config);
+static int __cache_serves(int opt);
+static int __cache_usable(struct config *config);
+static void __cache_add_range(struct elf_cache_range **ranges, uint64_t *n,
+                              uint64_t *cap, uint64_t offset, uint64_t size);
+__cold static uint64_t __cache_ranges(struct ehd_file *elf,
+                                      struct elf_cache_range **ranges);
+static void __cache_store(struct config *config, int fd,
+                          struct elf_view *view, enum ELF_arch_type type);
+static int __process_cached(struct config *config, int batch);
+static void __process_mapped(struct config *config, struct elf_view *view,
+                             enum ELF_arch_type type, int jobs, int batch,
+                             struct map_lru_entry *cached);
+static int __process_file(struct config *config, int jobs, int batch,
+                          int *cache_hit, struct elf_json *keep);
+static int __is_dir(const char *path);
+__cold static void __process_batch(struct config *config);
+static int __read_full(int fd, void *buf, size_t n);
+static int __write_full(int fd, const void *buf, size_t n);
+static void __free_argv(char **argv, uint32_t argc);
+static char **__serve_read_request(int fd, uint32_t *argc);
+static int __serve_request(struct serve *srv, int argc, char **argv);
+static void *__serve_conn(void *arg);
+static void __serve_signal(int sig);
+static int __unix_addr(struct sockaddr_un *addr, const char *path);
+__cold static int __serve(struct config *config);
+__cold static int __client(struct config *config, int argc, char **argv);
+__hot static int64_t __get_file_n(int fd);
 __hot static int _start_hexdump(int fd);
-__hot static char *_resolve_e_shstrndx(int fd, Elf64_Half e_shstrndx,
-                                       Elf64_Half e_shentsize,
-                                       Elf64_Word sh_name, Elf64_Off e_shoff,
-                                       char *dst);
-static char *_resolve_e_shstrndx32(int fd, Elf32_Half e_shstrndx,
-                                   Elf32_Half e_shentsize, Elf32_Word sh_name,
-                                   Elf32_Off e_shoff, char *dst);
+static uint64_t __follow_dump(int fd, uint64_t off, uint64_t size);
+__cold static int __follow(struct config *config);
+static int __pid_image_open(struct config *config, pid_t pid,
+                            const struct proc_map *map,
+                            struct pid_image *img);
+static void __pid_image_bias(struct pid_image *img,
+                             const struct proc_maps *maps);
+static struct pid_image *__pid_images(struct config *config, pid_t pid,
+                                      const struct proc_maps *maps,
+                                      uint64_t *n);
+static struct pid_image *__pid_image_find(struct pid_image *images,
+                                          uint64_t n, const char *path);
+static void __pid_images_free(struct pid_image *images, uint64_t n);
+static void __pid_label(struct pid_image *img, uint64_t start, uint64_t end,
+                        char *out, size_t size);
+__cold static void __pid_map_table(const struct proc_maps *maps,
+                                   struct pid_image *images,
+                                   uint64_t nimages);
+__cold static void __pid_dump(struct proc_mem *pm, struct pid_range *r,
+                              uint64_t n);
+__cold static void __pid_section(struct proc_mem *pm,
+                                 struct pid_image *images, uint64_t nimages,
+                                 const char *name);
+__cold static void __pid_hexdump(struct proc_mem *pm,
+                                 const struct proc_maps *maps,
+                                 struct pid_image *images, uint64_t nimages);
+__cold static int __process_pid(struct config *config);
+static uint64_t __diff_field_value(const uint8_t *p,
+                                   const struct diff_field *f);
+static uint64_t __diff_fields(const char *label, const void *a,
+                              const void *b,
+                              const struct diff_field *fields, uint32_t n);
+static void __diff_row(const char *label, uint64_t row, const uint8_t *a,
+                       uint64_t na, const uint8_t *b, uint64_t nb);
+static uint64_t __diff_bytes(const char *label, const uint8_t *a,
+                             uint64_t na, const uint8_t *b, uint64_t nb);
+static int __diff_sec_cmp(const void *a, const void *b);
+static struct diff_sec *__diff_secs(struct ehd_file *elf, uint64_t *n);
+static int64_t *__diff_pair(struct diff_sec *sa, uint64_t na,
+                            struct diff_sec *sb, uint64_t nb,
+                            uint8_t *matched);
+static const char *__diff_sec_label(const char *name, uint64_t index,
+                                    char *buf, size_t size);
+static void __diff_section(struct diff_side *a, uint64_t ia,
+                           struct diff_side *b, uint64_t ib,
+                           struct diff_totals *t);
+static void __diff_elf(struct diff_side *a, struct diff_side *b,
+                       struct diff_totals *t);
+static int __diff_open(struct config *config, struct diff_side *s,
+                       const char *path);
+static void __diff_close(struct diff_side *s);
+__cold static int __diff(struct config *config);
+static int __add_pattern(struct config *config, const char *text);
+static void __search_task(struct thread_pool *tp, int worker, void *arg);
+static void __search_scan(struct config *config, const uint8_t *data,
+                          uint64_t start, uint64_t end, int jobs,
+                          const struct rule_range *ranges,
+                          struct search_hits *out);
+static int __search_range(struct ehd_file *elf, const char *spec,
+                          uint64_t *start, uint64_t *end);
+static int __search_sec_cmp(const void *a, const void *b);
+static struct search_sec *__search_secs(struct ehd_file *elf, uint64_t *n);
+static const char *__search_sec_name(struct ehd_file *elf,
+                                     struct search_sec *secs, uint64_t n,
+                                     uint64_t off);
+static int __search_vaddr(struct ehd_file *elf, uint64_t off,
+                          uint64_t *vaddr);
+static void __search_context(struct elf_view *view, uint64_t off,
+                             uint32_t len, uint64_t *start, uint64_t *end);
+__cold static void __search(struct config *config, struct elf_view *view,
+                            enum ELF_arch_type type, int jobs);
+static struct rule_range *__rules_ranges(struct rule_set *rs,
+                                         struct ehd_file *elf,
+                                         uint64_t size);
+__cold static void __rules(struct config *config, struct elf_view *view,
+                           enum ELF_arch_type type, int jobs);
+static void __strings_task(struct thread_pool *tp, int worker, void *arg);
+static int __strings_debug(const char *name);
+static struct strings_span *__strings_spans(struct ehd_file *elf,
+                                            struct search_sec *secs,
+                                            uint64_t nsecs, uint64_t size,
+                                            uint64_t *n);
+static void __strings_scan(struct config *config, const uint8_t *data,
+                           struct strings_span *spans, uint64_t nspans,
+                           int jobs, struct str_hits *out);
+static const char *__strings_text(const uint8_t *data,
+                                  const struct str_hit *h, char **buf,
+                                  uint64_t *cap, uint64_t *len);
+__cold static void __strings(struct config *config, struct elf_view *view,
+                             enum ELF_arch_type type, int jobs);
+static void __hash_task(struct thread_pool *tp, int worker, void *arg);
+static int __hash_range_cmp(const void *a, const void *b);
+static int __hash_name_cmp(const void *a, const void *b);
+static int __hash_labels(struct hash_range *ranges, uint64_t n,
+                         struct hash_range **by);
+static struct hash_range *__hash_ranges(struct ehd_file *elf, uint64_t size,
+                                        int segments, uint64_t *n);
+static struct hash_job *__hash_jobs(const uint8_t *data,
+                                    struct hash_range **order, uint64_t n,
+                                    int algo, uint64_t *njobs);
+static void __hash_finish(struct hash_job *job, uint64_t njobs, int algo);
+static void __hash_run(const uint8_t *data, struct hash_range **order,
+                       uint64_t n, int algo, int jobs);
+static const char *__hash_check(struct manifest *m, const char *path,
+                                const struct hash_range *r, int algo);
+__cold static void __hash(struct config *config, struct elf_view *view,
+                          enum ELF_arch_type type, int jobs);
+static int __verify_path_cmp(const void *a, const void *b);
+static int __verify_report(struct config *config);
+static void __dedup_file(struct config *config, struct elf_view *view,
+                         enum ELF_arch_type type, int jobs);
+static int __dedup_rank_cmp(const void *a, const void *b);
+static struct dedup_rank *__dedup_rank_stats(const struct dedup_stat *stat,
+                                             uint64_t n, uint64_t *nrank);
+static struct dedup_rank *__dedup_rank_groups(const struct dedup *d,
+                                              uint64_t *nrank);
+static const char *__dedup_first_path(const struct dedup *d,
+                                      const struct dedup_entry *e);
+static void __dedup_text(const struct dedup *d, const struct dedup_rank *g,
+                         uint64_t ng, const struct dedup_rank *s,
+                         uint64_t ns, const struct dedup_rank *l,
+                         uint64_t nl);
+static void __dedup_json(struct elf_json *j, const struct dedup *d,
+                         const struct dedup_rank *g, uint64_t ng,
+                         const struct dedup_rank *s, uint64_t ns,
+                         const struct dedup_rank *l, uint64_t nl);
+static void __dedup_report(struct config *config);
+static void __simhash_task(struct thread_pool *tp, int worker, void *arg);
+static void __simhash_score_task(struct thread_pool *tp, int worker,
+                                 void *arg);
+static void __simhash_pool(void (*fn)(struct thread_pool *, int, void *),
+                           void *jobs_base, size_t job_size, uint64_t n,
+                           int jobs);
+__cold static void __simhash(struct config *config, struct elf_view *view,
+                             enum ELF_arch_type type, int jobs);
+static int __simhash_pair_cmp(const void *a, const void *b);
+static void __simhash_part_cell(struct pretty_table *t, uint32_t v);
+static void __simhash_report(struct config *config);
+static int __size_span_cmp(const void *a, const void *b);
+static int __size_sym_cmp(const void *a, const void *b);
+static uint64_t __size_gap(struct size_seg *segs, const struct size_span *s,
+                           uint64_t ns, uint64_t a, uint64_t b, int vm);
+static uint64_t __size_sweep(struct size_seg *segs, struct size_span *s,
+                             uint64_t ns, struct size_region *regions,
+                             struct size_span *r, uint64_t nr, uint64_t end,
+                             int vm);
+static int __size_symtab(struct ehd_file *elf, struct ehd_symtab *st);
+static void __size_symbols(struct ehd_file *elf, struct size_region *sec,
+                           uint64_t shnum, uint64_t tls,
+                           struct size_items *items);
+static const char *__size_parent(const struct size_seg *segs, int64_t seg);
+static void __size_file(struct config *config, const char *path,
+                        struct ehd_file *elf, uint64_t size, int base);
+__cold static void __size(struct config *config, struct elf_view *view,
+                          enum ELF_arch_type type);
+static int __size_rank_cmp(const void *a, const void *b);
+static uint64_t __size_change(uint64_t now, uint64_t base);
+static struct size_rank *__size_rank(const struct size_report *r,
+                                     uint32_t level, int base, int all,
+                                     uint64_t *nrank);
+static void __size_delta_cell(struct pretty_table *t, uint64_t now,
+                              uint64_t base);
+static void __size_table(const struct size_report *r, uint32_t level,
+                         int base, uint64_t limit);
+static void __size_text(const struct size_report *r, const char *baseline);
+static void __size_json(struct elf_json *j, const struct size_report *r,
+                        const char *baseline);
+static int __size_report(struct config *config);
+static void *__layout_push(void **v, uint64_t *n, uint64_t *cap,
+                           size_t size);
+static struct layout_region *__layout_region(struct layout *l, uint32_t kind,
+                                             uint64_t start, uint64_t size,
+                                             uint64_t index);
+static void __layout_finding(struct layout *l, uint32_t issue, uint64_t a,
+                             uint64_t b, uint64_t bytes, const char *what);
+static int __layout_leaf(const struct layout_region *r);
+static int __layout_load(const struct layout_region *r);
+static void __layout_notes(struct layout *l, struct ehd_file *elf,
+                           uint64_t parent);
+static void __layout_collect(struct layout *l, struct ehd_file *elf);
+static int __layout_load_hit(void *arg, const struct ival *iv);
+static void __layout_overlaps(struct layout *l, const struct ival_index *x,
+                              uint32_t issue);
+static int __layout_first_hit(void *arg, const struct ival *iv);
+static void __layout_sweep(const struct layout *l,
+                           void (*fn)(void *, uint64_t, uint64_t, uint64_t,
+                                      uint64_t, uint64_t),
+                           void *ctx);
+static void __layout_gap(void *arg, uint64_t start, uint64_t end,
+                         uint64_t owner, uint64_t after, uint64_t before);
+static void __layout_check(struct layout *l);
+static void __layout_label(const struct layout_region *r, char *buf,
+                           size_t size);
+static void __layout_map_piece(void *arg, uint64_t start, uint64_t end,
+                               uint64_t owner, uint64_t after,
+                               uint64_t before);
+static char __layout_cell_key(const struct layout *l, uint64_t owner);
+static char __layout_load_key(const struct layout *l, uint64_t load);
+static void __layout_map(struct layout *l);
+static int __layout_gap_cmp(const void *a, const void *b);
+static void __layout_gap_cell(struct pretty_table *t, const struct layout *l,
+                              uint64_t region);
+static void __layout_gaps(struct layout *l);
+static void __layout_region_text(const struct layout *l, uint64_t region);
+static void __layout_findings(const struct layout *l);
+static void __layout_text(struct layout *l);
+static void __json_layout_region(struct json_writer *w, const char *key,
+                                 const struct layout *l, uint64_t region);
+__cold static void __json_layout(struct elf_json *j, const struct layout *l);
+__cold static void __layout(struct config *config, struct elf_view *view,
+                            enum ELF_arch_type type);
+static const char *__entropy_spark(double bits);
+static void __entropy_task(struct thread_pool *tp, int worker, void *arg);
+static struct entropy_range *__entropy_ranges(struct ehd_file *elf,
+                                              uint64_t size, uint64_t *n);
+static int __entropy_run(const uint8_t *data, uint64_t size, uint64_t block,
+                         float *bits, struct entropy_range *ranges,
+                         uint64_t nranges, struct entropy_hist *whole,
+                         int jobs);
+static void __entropy_shares(const struct entropy_hist *h, uint64_t *zero,
+                             uint64_t *text);
+static void __entropy_cell_milli(struct pretty_table *t, uint64_t v,
+                                 int decimals);
+static void __entropy_sparkline(struct pretty_table *t, const float *bits,
+                                uint64_t block, uint64_t offset,
+                                uint64_t size);
+static void __entropy_table(struct entropy_range *ranges, uint64_t n,
+                            int sections, const float *bits,
+                            uint64_t block);
+static int __entropy_range_cmp(const void *a, const void *b);
+static void __entropy_map(const float *bits, uint64_t nblocks,
+                          uint64_t block, struct entropy_range *ranges,
+                          uint64_t nranges);
+static void __json_entropy_hist(struct json_writer *w,
+                                const struct entropy_hist *h);
+__cold static void __json_entropy(struct elf_json *j, const float *bits,
+                                  uint64_t nblocks, uint64_t block,
+                                  struct entropy_range *ranges,
+                                  uint64_t nranges,
+                                  const struct entropy_hist *whole);
+__cold static void __entropy(struct config *config, struct elf_view *view,
+                             enum ELF_arch_type type, int jobs);
 
 #endif /* ELF64_HEXDUMP_H */
\ No newline at end of file
@@ -0,0 +1,477 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+/*
+ * Copyright (C) Fadhil Riyanto <me@fadev.org>
+ */
+
+#include "elf_cache.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#define ELF_CACHE_ALIGN(x) (((x) + 7) & ~7ULL)
+
+static uint32_t __elf_cache_hash(uint64_t dev, uint64_t ino) {
+        uint64_t h = (dev * 0x9e3779b97f4a7c15ULL) ^ ino;
+
+        h = (h ^ (h >> 33)) * 0xff51afd7ed558ccdULL;
+        return (uint32_t)(h ^ (h >> 33));
+}
+
+static void __elf_cache_key_set(struct elf_cache_key *key,
+                                const struct stat *st) {
+        key->dev = st->st_dev;
+        key->ino = st->st_ino;
+        key->size = st->st_size;
+        key->mtime_sec = st->st_mtim.tv_sec;
+        key->mtime_nsec = st->st_mtim.tv_nsec;
+}
+
+/*
+ * a damaged cache is ignored as a whole, every offset is checked once
+ * here so lookups can trust the tables
+ */
+static int __elf_cache_valid(const uint8_t *map, uint64_t size) {
+        const struct elf_cache_hdr *hdr = (const struct elf_cache_hdr *)map;
+
+        if (size < sizeof(*hdr) ||
+            memcmp(hdr->magic, ELF_CACHE_MAGIC, ELF_CACHE_MAGIC_LEN) != 0 ||
+            hdr->version != ELF_CACHE_VERSION || hdr->nslots == 0 ||
+            (hdr->nslots & (hdr->nslots - 1)) != 0 ||
+            hdr->nentries >= hdr->nslots)
+                return 0;
+
+        if (hdr->keys_off > size ||
+            hdr->nentries > (size - hdr->keys_off) /
+                                sizeof(struct elf_cache_key) ||
+            hdr->slots_off > size ||
+            hdr->nslots > (size - hdr->slots_off) / sizeof(uint32_t) ||
+            hdr->ranges_off > size ||
+            hdr->nranges > (size - hdr->ranges_off) /
+                               sizeof(struct elf_cache_range))
+                return 0;
+
+        const struct elf_cache_key *keys =
+            (const struct elf_cache_key *)(map + hdr->keys_off);
+        const struct elf_cache_range *ranges =
+            (const struct elf_cache_range *)(map + hdr->ranges_off);
+        const uint32_t *slots = (const uint32_t *)(map + hdr->slots_off);
+
+        for (uint64_t i = 0; i < hdr->nentries; i++) {
+                if (keys[i].first_range > hdr->nranges ||
+                    keys[i].nranges > hdr->nranges - keys[i].first_range)
+                        return 0;
+        }
+
+        for (uint64_t i = 0; i < hdr->nranges; i++) {
+                if (ranges[i].data_off > size ||
+                    ranges[i].size > size - ranges[i].data_off)
+                        return 0;
+        }
+
+        for (uint32_t i = 0; i < hdr->nslots; i++) {
+                if (slots[i] > hdr->nentries)
+                        return 0;
+        }
+
+        return 1;
+}
+
+/*
+ * a missing or unreadable cache file is not an error, it is created on
+ * elf_cache_close()
+ */
+int elf_cache_open(struct elf_cache *cache, const char *path) {
+        struct stat st;
+
+        memset(cache, 0, sizeof(struct elf_cache));
+        cache->path = strdup(path);
+        pthread_mutex_init(&cache->lock, NULL);
+
+        int fd = open(path, O_RDONLY);
+        if (fd < 0) {
+                if (errno != ENOENT) {
+                        fprintf(stderr, "open() %s: %s\n", path,
+                                strerror(errno));
+                        return -1;
+                }
+                return 0;
+        }
+
+        if (fstat(fd, &st) < 0 || st.st_size == 0) {
+                close(fd);
+                return 0;
+        }
+
+        void *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd);
+
+        if (map == MAP_FAILED) {
+                return 0;
+        }
+
+        if (!__elf_cache_valid((const uint8_t *)map, st.st_size)) {
+                fprintf(stderr, "%s: not a valid cache, rebuilding\n", path);
+                munmap(map, st.st_size);
+                return 0;
+        }
+
+        cache->map = (const uint8_t *)map;
+        cache->map_size = st.st_size;
+        cache->hdr = (const struct elf_cache_hdr *)map;
+        return 0;
+}
+
+static const struct elf_cache_key *
+__elf_cache_find(const struct elf_cache *cache, uint64_t dev, uint64_t ino) {
+        const struct elf_cache_hdr *hdr = cache->hdr;
+
+        if (hdr == NULL) {
+                return NULL;
+        }
+
+        const struct elf_cache_key *keys =
+            (const struct elf_cache_key *)(cache->map + hdr->keys_off);
+        const uint32_t *slots =
+            (const uint32_t *)(cache->map + hdr->slots_off);
+        uint32_t mask = hdr->nslots - 1;
+
+        /* nentries < nslots, there is always an empty slot to stop at */
+        for (uint32_t i = __elf_cache_hash(dev, ino) & mask; slots[i];
+             i = (i + 1) & mask) {
+                const struct elf_cache_key *key = &keys[slots[i] - 1];
+
+                if (key->dev == dev && key->ino == ino)
+                        return key;
+        }
+
+        return NULL;
+}
+
+/*
+ * returns 0 on a hit, -1 on a miss (absent or stale entry)
+ */
+int elf_cache_lookup(struct elf_cache *cache, const struct stat *st,
+                     struct elf_cache_entry *entry) {
+        struct elf_cache_key want;
+
+        memset(entry, 0, sizeof(struct elf_cache_entry));
+        __elf_cache_key_set(&want, st);
+
+        const struct elf_cache_key *key =
+            __elf_cache_find(cache, want.dev, want.ino);
+
+        if (key == NULL || key->size != want.size ||
+            key->mtime_sec != want.mtime_sec ||
+            key->mtime_nsec != want.mtime_nsec) {
+                return -1;
+        }
+
+        entry->type = key->type;
+        if (key->nranges == 0 || key->size == 0) {
+                return 0;
+        }
+
+        const struct elf_cache_range *ranges =
+            (const struct elf_cache_range *)(cache->map +
+                                             cache->hdr->ranges_off) +
+            key->first_range;
+
+        /* untouched pages stay unbacked, only the ranges cost memory */
+        uint8_t *image = (uint8_t *)mmap(
+            NULL, key->size, PROT_READ | PROT_WRITE,
+            MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+        if (image == MAP_FAILED) {
+                return -1;
+        }
+
+        for (uint32_t i = 0; i < key->nranges; i++) {
+                if (ranges[i].offset > key->size ||
+                    ranges[i].size > key->size - ranges[i].offset) {
+                        munmap(image, key->size);
+                        return -1;
+                }
+
+                memcpy(image + ranges[i].offset,
+                       cache->map + ranges[i].data_off, ranges[i].size);
+        }
+
+        mprotect(image, key->size, PROT_READ);
+        entry->data = image;
+        entry->size = key->size;
+        return 0;
+}
+
+void elf_cache_release(struct elf_cache_entry *entry) {
+        if (entry->data) {
+                munmap((void *)entry->data, entry->size);
+        }
+
+        memset(entry, 0, sizeof(struct elf_cache_entry));
+}
+
+/*
+ * ranges outside of the file are dropped, data is the mapped file, the
+ * ranges are copied so the file can be unmapped right after
+ */
+void elf_cache_store(struct elf_cache *cache, const struct stat *st,
+                     uint32_t type, const uint8_t *data,
+                     struct elf_cache_range *ranges, uint64_t nranges) {
+        struct elf_cache_pending p;
+        uint64_t n = 0;
+        uint64_t total = 0;
+
+        memset(&p, 0, sizeof(p));
+        __elf_cache_key_set(&p.key, st);
+        p.key.type = type;
+
+        for (uint64_t i = 0; i < nranges; i++) {
+                if (ranges[i].size == 0 || ranges[i].offset > p.key.size ||
+                    ranges[i].size > p.key.size - ranges[i].offset)
+                        continue;
+
+                ranges[n] = ranges[i];
+                ranges[n].data_off = total;
+                total = ELF_CACHE_ALIGN(total + ranges[i].size);
+                n++;
+        }
+
+        p.key.nranges = n;
+        p.ranges = (struct elf_cache_range *)malloc(
+            (n ? n : 1) * sizeof(struct elf_cache_range));
+        p.data = (uint8_t *)calloc(total ? total : 1, 1);
+
+        for (uint64_t i = 0; i < n; i++) {
+                p.ranges[i] = ranges[i];
+                memcpy(p.data + ranges[i].data_off, data + ranges[i].offset,
+                       ranges[i].size);
+        }
+
+        pthread_mutex_lock(&cache->lock);
+        if (cache->npending == cache->pending_cap) {
+                cache->pending_cap =
+                    cache->pending_cap ? cache->pending_cap * 2 : 64;
+                cache->pending = (struct elf_cache_pending *)realloc(
+                    cache->pending,
+                    cache->pending_cap * sizeof(struct elf_cache_pending));
+        }
+        cache->pending[cache->npending++] = p;
+        pthread_mutex_unlock(&cache->lock);
+}
+
+static int __elf_cache_cmp_pending(const void *a, const void *b) {
+        const struct elf_cache_key *ka =
+            &((const struct elf_cache_pending *)a)->key;
+        const struct elf_cache_key *kb =
+            &((const struct elf_cache_pending *)b)->key;
+
+        if (ka->dev != kb->dev)
+                return ka->dev < kb->dev ? -1 : 1;
+        if (ka->ino != kb->ino)
+                return ka->ino < kb->ino ? -1 : 1;
+        return 0;
+}
+
+/* pending entries are sorted by (dev, ino) before this is called */
+static int __elf_cache_superseded(const struct elf_cache *cache,
+                                  const struct elf_cache_key *key) {
+        struct elf_cache_pending needle;
+
+        needle.key.dev = key->dev;
+        needle.key.ino = key->ino;
+        return bsearch(&needle, cache->pending, cache->npending,
+                       sizeof(struct elf_cache_pending),
+                       __elf_cache_cmp_pending) != NULL;
+}
+
+static void __elf_cache_slot_put(uint32_t *slots, uint32_t nslots,
+                                 const struct elf_cache_key *key,
+                                 uint32_t index) {
+        uint32_t mask = nslots - 1;
+        uint32_t i = __elf_cache_hash(key->dev, key->ino) & mask;
+
+        while (slots[i])
+                i = (i + 1) & mask;
+
+        slots[i] = index + 1;
+}
+
+/*
+ * the new cache is old entries that were not stored again plus this
+ * run's entries, written to a temporary file and renamed over the old
+ * one so concurrent readers never see a partial cache
+ */
+static int __elf_cache_write(struct elf_cache *cache) {
+        const struct elf_cache_key *old_keys = NULL;
+        const struct elf_cache_range *old_ranges = NULL;
+        uint64_t old_n = cache->hdr ? cache->hdr->nentries : 0;
+        struct elf_cache_hdr hdr;
+        char tmp[PATH_MAX];
+        uint64_t nentries = 0, nranges = 0, data_size = 0;
+
+        if (cache->hdr) {
+                old_keys = (const struct elf_cache_key *)(cache->map +
+                                                          cache->hdr->keys_off);
+                old_ranges = (const struct elf_cache_range *)(
+                    cache->map + cache->hdr->ranges_off);
+        }
+
+        qsort(cache->pending, cache->npending,
+              sizeof(struct elf_cache_pending), __elf_cache_cmp_pending);
+
+        /* same inode seen twice in one run (hard links), keep one */
+        uint64_t np = 0;
+        for (uint64_t i = 0; i < cache->npending; i++) {
+                if (np && __elf_cache_cmp_pending(&cache->pending[np - 1],
+                                                  &cache->pending[i]) == 0) {
+                        free(cache->pending[i].ranges);
+                        free(cache->pending[i].data);
+                        continue;
+                }
+                cache->pending[np++] = cache->pending[i];
+        }
+        cache->npending = np;
+
+        struct elf_cache_key *keys = (struct elf_cache_key *)malloc(
+            (old_n + np + 1) * sizeof(struct elf_cache_key));
+        const struct elf_cache_range **src_ranges =
+            (const struct elf_cache_range **)malloc(
+                (old_n + np + 1) * sizeof(struct elf_cache_range *));
+        const uint8_t **src_data =
+            (const uint8_t **)malloc((old_n + np + 1) * sizeof(uint8_t *));
+
+        for (uint64_t i = 0; i < old_n; i++) {
+                if (__elf_cache_superseded(cache, &old_keys[i]))
+                        continue;
+
+                keys[nentries] = old_keys[i];
+                src_ranges[nentries] = old_ranges + old_keys[i].first_range;
+                src_data[nentries] = cache->map;
+                nentries++;
+        }
+
+        for (uint64_t i = 0; i < np; i++) {
+                keys[nentries] = cache->pending[i].key;
+                src_ranges[nentries] = cache->pending[i].ranges;
+                src_data[nentries] = cache->pending[i].data;
+                nentries++;
+        }
+
+        for (uint64_t i = 0; i < nentries; i++) {
+                keys[i].first_range = nranges;
+                nranges = nranges + keys[i].nranges;
+                for (uint32_t j = 0; j < keys[i].nranges; j++)
+                        data_size = ELF_CACHE_ALIGN(data_size +
+                                                    src_ranges[i][j].size);
+        }
+
+        /* load factor <= 0.5 */
+        uint32_t nslots = 16;
+        while (nslots < nentries * 2)
+                nslots = nslots * 2;
+
+        memset(&hdr, 0, sizeof(hdr));
+        memcpy(hdr.magic, ELF_CACHE_MAGIC, ELF_CACHE_MAGIC_LEN);
+        hdr.version = ELF_CACHE_VERSION;
+        hdr.nslots = nslots;
+        hdr.nentries = nentries;
+        hdr.nranges = nranges;
+        hdr.keys_off = sizeof(hdr);
+        hdr.slots_off = hdr.keys_off + nentries * sizeof(struct elf_cache_key);
+        hdr.ranges_off =
+            ELF_CACHE_ALIGN(hdr.slots_off + nslots * sizeof(uint32_t));
+
+        uint64_t data_off =
+            hdr.ranges_off + nranges * sizeof(struct elf_cache_range);
+        uint64_t size = data_off + data_size;
+
+        uint8_t *out = (uint8_t *)calloc(size, 1);
+        uint32_t *slots = (uint32_t *)(out + hdr.slots_off);
+        struct elf_cache_range *ranges =
+            (struct elf_cache_range *)(out + hdr.ranges_off);
+
+        memcpy(out, &hdr, sizeof(hdr));
+        memcpy(out + hdr.keys_off, keys,
+               nentries * sizeof(struct elf_cache_key));
+
+        for (uint64_t i = 0; i < nentries; i++) {
+                __elf_cache_slot_put(slots, nslots, &keys[i], i);
+
+                for (uint32_t j = 0; j < keys[i].nranges; j++) {
+                        const struct elf_cache_range *r = &src_ranges[i][j];
+                        struct elf_cache_range *w =
+                            &ranges[keys[i].first_range + j];
+
+                        w->offset = r->offset;
+                        w->size = r->size;
+                        w->data_off = data_off;
+                        memcpy(out + data_off, src_data[i] + r->data_off,
+                               r->size);
+                        data_off = ELF_CACHE_ALIGN(data_off + r->size);
+                }
+        }
+
+        free(src_data);
+        free(src_ranges);
+        free(keys);
+
+        snprintf(tmp, sizeof(tmp), "%s.XXXXXX", cache->path);
+        int fd = mkstemp(tmp);
+        if (fd < 0) {
+                fprintf(stderr, "mkstemp() %s: %s\n", tmp, strerror(errno));
+                free(out);
+                return -1;
+        }
+
+        uint64_t done = 0;
+        while (done < size) {
+                ssize_t ret = write(fd, out + done, size - done);
+                if (ret < 0) {
+                        if (errno == EINTR)
+                                continue;
+                        break;
+                }
+                done = done + ret;
+        }
+
+        free(out);
+        fchmod(fd, 0644);
+
+        if (close(fd) < 0 || done != size || rename(tmp, cache->path) < 0) {
+                fprintf(stderr, "failed to write cache %s\n", cache->path);
+                unlink(tmp);
+                return -1;
+        }
+
+        return 0;
+}
+
+/*
+ * write the cache back when this run stored anything, then free it
+ */
+int elf_cache_close(struct elf_cache *cache) {
+        int ret = 0;
+
+        if (cache->npending) {
+                ret = __elf_cache_write(cache);
+        }
+
+        for (uint64_t i = 0; i < cache->npending; i++) {
+                free(cache->pending[i].ranges);
+                free(cache->pending[i].data);
+        }
+
+        if (cache->map) {
+                munmap((void *)cache->map, cache->map_size);
+        }
+
+        pthread_mutex_destroy(&cache->lock);
+        free(cache->pending);
+        free(cache->path);
+        memset(cache, 0, sizeof(struct elf_cache));
+        return ret;
+}
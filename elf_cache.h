@@ -0,0 +1,102 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+/*
+ * Copyright (C) Fadhil Riyanto <me@fadev.org>
+ * on-disk metadata cache, one mmapped file for the whole cache, entries
+ * are keyed by (dev, inode) and valid while size and mtime are unchanged
+ *
+ * an entry keeps the file byte ranges the metadata modes read (ELF
+ * header, header tables, .shstrtab, notes), a hit rebuilds a sparse
+ * image of the file from them without opening the file itself
+ */
+
+#ifndef ELF_CACHE_H
+#define ELF_CACHE_H
+
+#include <pthread.h>
+#include <stdint.h>
+#include <sys/stat.h>
+
+#define ELF_CACHE_MAGIC "ELFHDC\0\0"
+#define ELF_CACHE_MAGIC_LEN 8
+#define ELF_CACHE_VERSION 1
+
+/*
+ * file layout, native byte order, every part 8 byte aligned
+ *
+ *   struct elf_cache_hdr
+ *   struct elf_cache_key[nentries]
+ *   uint32_t slots[nslots]        open addressing on (dev, ino),
+ *                                 entry index + 1, 0 is empty
+ *   struct elf_cache_range[...]   ranges of entry i start at
+ *                                 key[i].first_range
+ *   range data
+ */
+struct elf_cache_hdr {
+        char magic[ELF_CACHE_MAGIC_LEN];
+        uint32_t version;
+        uint32_t nslots; /* power of two */
+        uint64_t nentries;
+        uint64_t nranges;
+        uint64_t keys_off;
+        uint64_t slots_off;
+        uint64_t ranges_off;
+};
+
+struct elf_cache_key {
+        uint64_t dev;
+        uint64_t ino;
+        uint64_t size;
+        int64_t mtime_sec;
+        int64_t mtime_nsec;
+        uint32_t type; /* enum ELF_arch_type of the file */
+        uint32_t nranges;
+        uint64_t first_range;
+};
+
+struct elf_cache_range {
+        uint64_t offset;   /* offset in the original file */
+        uint64_t size;
+        uint64_t data_off; /* offset in the cache file */
+};
+
+/* entries stored during this run, written out by elf_cache_close() */
+struct elf_cache_pending {
+        struct elf_cache_key key;
+        struct elf_cache_range *ranges;
+        uint8_t *data;
+};
+
+struct elf_cache {
+        char *path;
+
+        /* what was on disk when the cache was opened */
+        const uint8_t *map;
+        uint64_t map_size;
+        const struct elf_cache_hdr *hdr;
+
+        pthread_mutex_t lock; /* pending list */
+        struct elf_cache_pending *pending;
+        uint64_t npending;
+        uint64_t pending_cap;
+};
+
+/*
+ * a hit, data is a private anonymous mapping of the original file size,
+ * only the cached ranges are filled in
+ */
+struct elf_cache_entry {
+        uint32_t type;
+        const uint8_t *data;
+        uint64_t size;
+};
+
+int elf_cache_open(struct elf_cache *cache, const char *path);
+int elf_cache_lookup(struct elf_cache *cache, const struct stat *st,
+                     struct elf_cache_entry *entry);
+void elf_cache_store(struct elf_cache *cache, const struct stat *st,
+                     uint32_t type, const uint8_t *data,
+                     struct elf_cache_range *ranges, uint64_t nranges);
+void elf_cache_release(struct elf_cache_entry *entry);
+int elf_cache_close(struct elf_cache *cache);
+
+#endif /* ELF_CACHE_H */
@@ -0,0 +1,218 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+/*
+ * Copyright (C) Fadhil Riyanto <me@fadev.org>
+ */
+
+#include "elf_stats.h"
+#include "print_pretty.h"
+#include <linux/perf_event.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+#define STATS_NHW 3
+
+int elf_stats_enabled;
+
+static const char *const stats_phase_names[STATS_NPHASES] = {
+        [STATS_MAGIC] = "magic",
+        [STATS_MAP] = "map",
+        [STATS_HEADER] = "header",
+        [STATS_NAMES] = "names",
+        [STATS_RENDER] = "render",
+        [STATS_FLUSH] = "flush",
+};
+
+static const struct {
+        const char *name;
+        uint64_t config;
+} stats_hw[STATS_NHW] = {
+        { "cycles", PERF_COUNT_HW_CPU_CYCLES },
+        { "instructions", PERF_COUNT_HW_INSTRUCTIONS },
+        { "cache misses", PERF_COUNT_HW_CACHE_MISSES },
+};
+
+/* /proc/self/io, read and write syscalls of every thread */
+struct stats_io {
+        uint64_t rchar;
+        uint64_t wchar;
+        uint64_t syscr;
+        uint64_t syscw;
+};
+
+static struct {
+        /* atomic */
+        uint64_t wall[STATS_NPHASES];
+        uint64_t cpu[STATS_NPHASES];
+        uint64_t calls[STATS_NPHASES];
+        uint64_t lseeks;
+        uint64_t mapped;
+        uint64_t arena_allocs;
+        uint64_t arena_mallocs;
+
+        struct elf_stats_mark start;
+        struct stats_io io;
+        int hw_fd[STATS_NHW];
+} stats;
+
+static uint64_t __stats_clock(clockid_t clock) {
+        struct timespec ts;
+
+        clock_gettime(clock, &ts);
+        return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void __stats_read_io(struct stats_io *io) {
+        char key[32];
+        uint64_t v;
+
+        memset(io, 0, sizeof(*io));
+
+        FILE *f = fopen("/proc/self/io", "r");
+        if (f == NULL)
+                return;
+
+        while (fscanf(f, "%31[^:]: %lu\n", key, &v) == 2) {
+                if (strcmp(key, "rchar") == 0)
+                        io->rchar = v;
+                else if (strcmp(key, "wchar") == 0)
+                        io->wchar = v;
+                else if (strcmp(key, "syscr") == 0)
+                        io->syscr = v;
+                else if (strcmp(key, "syscw") == 0)
+                        io->syscw = v;
+        }
+
+        fclose(f);
+}
+
+/* user space only and inherited, so worker threads count too */
+static int __stats_hw_open(uint64_t config) {
+        struct perf_event_attr attr;
+
+        memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.config = config;
+        attr.inherit = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+
+        return syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+int elf_stats_init(void) {
+        elf_stats_enabled = 1;
+
+        for (int i = 0; i < STATS_NHW; i++) {
+                stats.hw_fd[i] = __stats_hw_open(stats_hw[i].config);
+        }
+
+        __stats_read_io(&stats.io);
+        elf_stats_begin(&stats.start);
+        return 0;
+}
+
+void elf_stats_begin(struct elf_stats_mark *m) {
+        if (!elf_stats_enabled)
+                return;
+
+        m->wall = __stats_clock(CLOCK_MONOTONIC);
+        m->cpu = __stats_clock(CLOCK_THREAD_CPUTIME_ID);
+}
+
+void elf_stats_end(struct elf_stats_mark *m, enum elf_stats_phase phase) {
+        if (!elf_stats_enabled)
+                return;
+
+        uint64_t wall = __stats_clock(CLOCK_MONOTONIC) - m->wall;
+        uint64_t cpu = __stats_clock(CLOCK_THREAD_CPUTIME_ID) - m->cpu;
+
+        __atomic_fetch_add(&stats.wall[phase], wall, __ATOMIC_RELAXED);
+        __atomic_fetch_add(&stats.cpu[phase], cpu, __ATOMIC_RELAXED);
+        __atomic_fetch_add(&stats.calls[phase], 1, __ATOMIC_RELAXED);
+}
+
+void elf_stats_lseek(void) {
+        if (elf_stats_enabled)
+                __atomic_fetch_add(&stats.lseeks, 1, __ATOMIC_RELAXED);
+}
+
+void elf_stats_mapped(uint64_t bytes) {
+        if (elf_stats_enabled)
+                __atomic_fetch_add(&stats.mapped, bytes, __ATOMIC_RELAXED);
+}
+
+void elf_stats_arena(uint64_t nallocs, uint64_t nmallocs) {
+        if (!elf_stats_enabled)
+                return;
+
+        __atomic_fetch_add(&stats.arena_allocs, nallocs, __ATOMIC_RELAXED);
+        __atomic_fetch_add(&stats.arena_mallocs, nmallocs, __ATOMIC_RELAXED);
+}
+
+static const struct pretty_col stats_cols[] = {
+        { "phase", 10, 0 },
+        { "calls", 10, 0 },
+        { "wall us", 14, 0 },
+        { "cpu us", 14, 0 },
+};
+
+void elf_stats_report(FILE *out) {
+        struct pretty_table t;
+        struct stats_io io;
+        struct rusage ru;
+
+        if (!elf_stats_enabled)
+                return;
+
+        uint64_t wall = __stats_clock(CLOCK_MONOTONIC) - stats.start.wall;
+
+        __stats_read_io(&io);
+        getrusage(RUSAGE_SELF, &ru);
+
+        fprintf(out, "stats:\n");
+        pretty_table_init(&t, out, stats_cols, 4);
+        pretty_table_header(&t);
+        for (int i = 0; i < STATS_NPHASES; i++) {
+                pretty_cell_str(&t, stats_phase_names[i]);
+                pretty_cell_u64(&t, stats.calls[i]);
+                pretty_cell_u64(&t, stats.wall[i] / 1000);
+                pretty_cell_u64(&t, stats.cpu[i] / 1000);
+                pretty_row_end(&t);
+        }
+        pretty_table_flush(&t);
+
+        fprintf(out,
+                "total wall %lu us, user %ld us, sys %ld us\n"
+                "read calls %lu, lseek calls %lu, write calls %lu\n"
+                "bytes read %lu, bytes mapped %lu, bytes out %lu\n"
+                "page faults %ld major, %ld minor\n"
+                "peak rss %ld KiB\n"
+                "arena allocations %lu, arena mallocs %lu\n",
+                wall / 1000,
+                ru.ru_utime.tv_sec * 1000000 + ru.ru_utime.tv_usec,
+                ru.ru_stime.tv_sec * 1000000 + ru.ru_stime.tv_usec,
+                io.syscr - stats.io.syscr, stats.lseeks,
+                io.syscw - stats.io.syscw, io.rchar - stats.io.rchar,
+                stats.mapped, io.wchar - stats.io.wchar, ru.ru_majflt,
+                ru.ru_minflt, ru.ru_maxrss, stats.arena_allocs,
+                stats.arena_mallocs);
+
+        for (int i = 0; i < STATS_NHW; i++) {
+                uint64_t v;
+
+                if (stats.hw_fd[i] < 0 ||
+                    read(stats.hw_fd[i], &v, sizeof(v)) != sizeof(v)) {
+                        fprintf(out, "%s n/a (perf_event_open not allowed)\n",
+                                stats_hw[i].name);
+                } else {
+                        fprintf(out, "%s %lu\n", stats_hw[i].name, v);
+                }
+
+                if (stats.hw_fd[i] >= 0)
+                        close(stats.hw_fd[i]);
+        }
+}
@@ -0,0 +1,49 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+/*
+ * Copyright (C) Fadhil Riyanto <me@fadev.org>
+ * --stats, wall and thread CPU time per phase, I/O counters, peak RSS
+ * and, when perf_event_open is allowed, hardware counters of the whole
+ * process. every call is a no-op until elf_stats_init()
+ *
+ * phases may run on many threads at once (batch, archives), their
+ * times are summed over the threads
+ */
+
+#ifndef ELF_STATS_H
+#define ELF_STATS_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+enum elf_stats_phase {
+        STATS_MAGIC,  /* open and read the magic */
+        STATS_MAP,    /* mmap of the input, tables are read through it */
+        STATS_HEADER, /* ehd_open_mem(), header and table bounds */
+        STATS_NAMES,  /* symbol index for --addr2sym */
+        STATS_RENDER, /* printers, JSON and columnar writers, hexdump */
+        STATS_FLUSH,  /* output buffers written out */
+        STATS_NPHASES
+};
+
+struct elf_stats_mark {
+        uint64_t wall;
+        uint64_t cpu;
+};
+
+extern int elf_stats_enabled;
+
+int elf_stats_init(void);
+
+/* time between the two calls goes to phase */
+void elf_stats_begin(struct elf_stats_mark *m);
+void elf_stats_end(struct elf_stats_mark *m, enum elf_stats_phase phase);
+
+void elf_stats_lseek(void);
+void elf_stats_mapped(uint64_t bytes);
+
+/* counters of a per-file arena, added when the arena goes away */
+void elf_stats_arena(uint64_t nallocs, uint64_t nmallocs);
+
+void elf_stats_report(FILE *out);
+
+#endif /* ELF_STATS_H */
@@ -0,0 +1,139 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+/*
+ * Copyright (C) Fadhil Riyanto <me@fadev.org>
+ */
+
+#include "entropy.h"
+#include <math.h>
+#include <pthread.h>
+#include <string.h>
+
+/* a bank counts a quarter of at most this many bytes, fits uint32_t */
+#define ENTROPY_SPAN (1ULL << 32)
+
+/* c * log2(c) for the counts a 4 KiB block can have */
+#define ENTROPY_LUT 4097
+
+static double entropy_lut[ENTROPY_LUT];
+static pthread_once_t entropy_lut_once = PTHREAD_ONCE_INIT;
+
+static void __entropy_lut_init(void) {
+        for (uint32_t c = 1; c < ENTROPY_LUT; c++)
+                entropy_lut[c] = c * log2((double)c);
+}
+
+static inline double __entropy_clog(uint64_t c) {
+        if (c < ENTROPY_LUT)
+                return entropy_lut[c];
+        return c * log2((double)c);
+}
+
+static void __entropy_banks(uint32_t bank[4][256], const uint8_t *d,
+                            uint64_t size) {
+        uint64_t i = 0;
+
+        for (; i + 16 <= size; i += 16) {
+                uint64_t x;
+                uint64_t y;
+
+                memcpy(&x, d + i, 8);
+                memcpy(&y, d + i + 8, 8);
+
+                bank[0][x & 0xff]++;
+                bank[1][(x >> 8) & 0xff]++;
+                bank[2][(x >> 16) & 0xff]++;
+                bank[3][(x >> 24) & 0xff]++;
+                bank[0][(x >> 32) & 0xff]++;
+                bank[1][(x >> 40) & 0xff]++;
+                bank[2][(x >> 48) & 0xff]++;
+                bank[3][x >> 56]++;
+
+                bank[0][y & 0xff]++;
+                bank[1][(y >> 8) & 0xff]++;
+                bank[2][(y >> 16) & 0xff]++;
+                bank[3][(y >> 24) & 0xff]++;
+                bank[0][(y >> 32) & 0xff]++;
+                bank[1][(y >> 40) & 0xff]++;
+                bank[2][(y >> 48) & 0xff]++;
+                bank[3][y >> 56]++;
+        }
+
+        for (; i < size; i++)
+                bank[i & 3][d[i]]++;
+}
+
+void entropy_hist_add(struct entropy_hist *h, const uint8_t *data,
+                      uint64_t size) {
+        uint32_t bank[4][256];
+
+        for (uint64_t off = 0; off < size; off += ENTROPY_SPAN) {
+                uint64_t n =
+                    size - off < ENTROPY_SPAN ? size - off : ENTROPY_SPAN;
+
+                memset(bank, 0, sizeof(bank));
+                __entropy_banks(bank, data + off, n);
+
+                for (uint32_t c = 0; c < 256; c++)
+                        h->count[c] += (uint64_t)bank[0][c] + bank[1][c] +
+                                       bank[2][c] + bank[3][c];
+        }
+
+        h->total += size;
+}
+
+void entropy_hist_merge(struct entropy_hist *dst,
+                        const struct entropy_hist *src) {
+        for (uint32_t c = 0; c < 256; c++)
+                dst->count[c] += src->count[c];
+        dst->total += src->total;
+}
+
+/* H = log2(n) - sum(c * log2(c)) / n */
+static double __entropy_bits(const uint64_t *count, uint64_t total) {
+        double sum = 0;
+
+        if (total == 0)
+                return 0;
+
+        pthread_once(&entropy_lut_once, __entropy_lut_init);
+        for (uint32_t c = 0; c < 256; c++) {
+                if (count[c])
+                        sum += __entropy_clog(count[c]);
+        }
+
+        double bits = log2((double)total) - sum / total;
+        return bits > 0 ? bits : 0;
+}
+
+double entropy_bits(const struct entropy_hist *h) {
+        return __entropy_bits(h->count, h->total);
+}
+
+double entropy_block(const uint8_t *data, uint64_t size,
+                     struct entropy_hist *h) {
+        uint32_t bank[4][256];
+        uint64_t count[256];
+
+        if (size >= ENTROPY_SPAN) {
+                struct entropy_hist big = { { 0 }, 0 };
+
+                entropy_hist_add(&big, data, size);
+                if (h)
+                        entropy_hist_merge(h, &big);
+                return entropy_bits(&big);
+        }
+
+        memset(bank, 0, sizeof(bank));
+        __entropy_banks(bank, data, size);
+
+        for (uint32_t c = 0; c < 256; c++) {
+                count[c] = (uint64_t)bank[0][c] + bank[1][c] + bank[2][c] +
+                           bank[3][c];
+                if (h)
+                        h->count[c] += count[c];
+        }
+
+        if (h)
+                h->total += size;
+        return __entropy_bits(count, size);
+}
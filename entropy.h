@@ -0,0 +1,37 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+/*
+ * Copyright (C) Fadhil Riyanto <me@fadev.org>
+ * --entropy, byte histograms and Shannon entropy
+ *
+ * the histogram kernel counts into four banks in turn, so a run of one
+ * byte value (zero fill, padding) does not wait on the previous store
+ * to the same counter, the banks are summed once at the end
+ */
+
+#ifndef ENTROPY_H
+#define ENTROPY_H
+
+#include <stdint.h>
+
+struct entropy_hist {
+        uint64_t count[256];
+        uint64_t total;
+};
+
+/* byte counts of data[0, size) added to h */
+void entropy_hist_add(struct entropy_hist *h, const uint8_t *data,
+                      uint64_t size);
+void entropy_hist_merge(struct entropy_hist *dst,
+                        const struct entropy_hist *src);
+
+/* bits per byte, 0 (one value) to 8 (uniform) */
+double entropy_bits(const struct entropy_hist *h);
+
+/*
+ * entropy of data[0, size) straight from the banks, for small blocks,
+ * the counts are also added to h unless it is NULL
+ */
+double entropy_block(const uint8_t *data, uint64_t size,
+                     struct entropy_hist *h);
+
+#endif /* ENTROPY_H */
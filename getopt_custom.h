@@ -12,5 +12,38 @@
 #define GETOPT_CUSTOM_PROGRAM_HEADER_STRUCT     0x06 /* [unused right now] dump program header (kernel struct)*/
 #define GETOPT_CUSTOM_SECTION_HEADER            0x07 /* print section header lists */
 #define GETOPT_CUSTOM_LOOKUP_SECTION            0x08 /* looking up on special section */
+#define GETOPT_CUSTOM_SYMBOLS                   0x09 /* print .symtab / .dynsym */
+#define GETOPT_CUSTOM_BUILD_ID                  0x0a /* print NT_GNU_BUILD_ID */
+#define GETOPT_CUSTOM_JOBS                      0x0b /* --jobs n, worker threads */
+#define GETOPT_CUSTOM_FILES_FROM                0x0c /* --files-from x, one input per line */
+#define GETOPT_CUSTOM_CACHE                     0x0d /* --cache x, metadata cache file */
+#define GETOPT_CUSTOM_ADDR2SYM                  0x0e /* --addr2sym addr, symbol covering addr */
+#define GETOPT_CUSTOM_BYTES                     0x0f /* --bytes off:len, hexdump a byte range */
+#define GETOPT_CUSTOM_SERVE                     0x10 /* --serve socket, query daemon */
+#define GETOPT_CUSTOM_CLIENT                    0x11 /* --client socket, ask a --serve daemon */
+#define GETOPT_CUSTOM_FORMAT                    0x12 /* --format text|json|ndjson|columnar */
+#define GETOPT_CUSTOM_STATS                     0x13 /* --stats, timing and counters to stderr */
+#define GETOPT_CUSTOM_POPULATE                  0x14 /* --populate, prefault the whole mapping */
+#define GETOPT_CUSTOM_HUGEPAGE                  0x15 /* --hugepage, ask for huge pages on the mapping */
+#define GETOPT_CUSTOM_FOLLOW                    0x16 /* --follow, hexdump appends as they land */
+#define GETOPT_CUSTOM_PID                       0x17 /* --pid n, maps and memory of a live process */
+#define GETOPT_CUSTOM_SEARCH                    0x18 /* --search pattern, hex with ? nibbles or str:text */
+#define GETOPT_CUSTOM_SEARCH_IN                 0x19 /* --search-in x, section name or seg:N */
+#define GETOPT_CUSTOM_RULES                     0x1a /* --rules x, signature file scanned in one pass */
+#define GETOPT_CUSTOM_DIFF                      0x1b /* --diff A B, section level compare */
+#define GETOPT_CUSTOM_ENTROPY                   0x1c /* --entropy, per block / section / segment */
+#define GETOPT_CUSTOM_ENTROPY_BLOCK             0x1d /* --entropy-block x, bytes per block */
+#define GETOPT_CUSTOM_STRINGS                   0x1e /* --strings, printable runs */
+#define GETOPT_CUSTOM_STRINGS_MIN               0x1f /* --strings-min x, shortest run */
+#define GETOPT_CUSTOM_STRINGS_ENC               0x20 /* --strings-enc x, ascii, utf16le or both */
+#define GETOPT_CUSTOM_SKIP_DEBUG                0x21 /* --skip-debug, leave .debug_* out of --strings */
+#define GETOPT_CUSTOM_HASH                      0x22 /* --hash x, crc32c, xxh64 or sha256 per section / segment */
+#define GETOPT_CUSTOM_VERIFY                    0x23 /* --verify x, check against a --hash manifest */
+#define GETOPT_CUSTOM_DEDUP                     0x24 /* --dedup, identical sections across the inputs */
+#define GETOPT_CUSTOM_SIMHASH                   0x25 /* --simhash, TLSH style digests of code and data */
+#define GETOPT_CUSTOM_SIMHASH_PAIRS             0x26 /* --simhash-pairs x, rank the x closest pairs */
+#define GETOPT_CUSTOM_SIZE_REPORT               0x27 /* --size-report, bytes by segment, section and symbol */
+#define GETOPT_CUSTOM_SIZE_BASELINE             0x28 /* --size-baseline x, report the change against x */
+#define GETOPT_CUSTOM_LAYOUT                    0x29 /* --layout, file layout map, overlaps and gaps */
 
 #endif /* GETOPT_CUSTOM_H */
\ No newline at end of file
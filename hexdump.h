@@ -8,23 +8,33 @@
  */
 
 #include <complex.h>
+#include <inttypes.h>
 #include <stddef.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <string.h>
 
+/* where the macros below write to, override before including */
+#ifndef HEXDUMP_STREAM
+#define HEXDUMP_STREAM stdout
+#endif
+
 #ifndef VT_HEXDUMP_COLOR
 #define VT_HEXDUMP_COLOR(fmt, vt_hexdump_hex)                                  \
         char current_hex = (char)vt_hexdump_hex;                               \
                                                                                \
         if (current_hex == 0x7F) {                                             \
-                printf("\033[1;31m" fmt "\033[0m", vt_hexdump_hex);            \
+                fprintf(HEXDUMP_STREAM, "\033[1;31m" fmt "\033[0m",           \
+                        vt_hexdump_hex);                                       \
         } else if (current_hex == 0xFF) {                                      \
-                printf("\033[1;34m" fmt "\033[0m", vt_hexdump_hex);            \
+                fprintf(HEXDUMP_STREAM, "\033[1;34m" fmt "\033[0m",           \
+                        vt_hexdump_hex);                                       \
         } else if (current_hex == 0x00) {                                      \
-                printf("\033[1;37m" fmt "\033[0m", vt_hexdump_hex);            \
+                fprintf(HEXDUMP_STREAM, "\033[1;37m" fmt "\033[0m",           \
+                        vt_hexdump_hex);                                       \
         } else {                                                               \
-                printf("\033[1;32m" fmt "\033[0m", vt_hexdump_hex);            \
+                fprintf(HEXDUMP_STREAM, "\033[1;32m" fmt "\033[0m",           \
+                        vt_hexdump_hex);                                       \
         }
 
 #endif /* VT_HEXDUMP_COLOR */
@@ -32,28 +42,29 @@
 #define VT_TITLE(PTR, SIZE)                                                    \
         size_t t_ptr_size = SIZE;                                              \
         unsigned char *t_realptr = (unsigned char *)PTR;                       \
-        printf("================= VT_HEXDUMP =================\n");            \
-        printf("file\t\t: %s:%d\n", __FILE__, __LINE__);                       \
-        printf("func\t\t: %s\n", __FUNCTION__);                                \
-        printf("addr\t\t: 0x%016lx\n", t_realptr);                             \
-        printf("dump_size\t: %ld\n\n", t_ptr_size);                            \
+        fprintf(HEXDUMP_STREAM,                                                \
+                "================= VT_HEXDUMP =================\n");     \
+        fprintf(HEXDUMP_STREAM, "file\t\t: %s:%d\n", __FILE__, __LINE__);      \
+        fprintf(HEXDUMP_STREAM, "func\t\t: %s\n", __FUNCTION__);               \
+        fprintf(HEXDUMP_STREAM, "addr\t\t: 0x%016lx\n", t_realptr);            \
+        fprintf(HEXDUMP_STREAM, "dump_size\t: %ld\n\n", t_ptr_size);           \
         for (int x = 0; x < 75; x++) {                                         \
                 if (x >= 40) {                                                 \
-                        printf("16 BYTES WIDE\n");                             \
+                        fprintf(HEXDUMP_STREAM, "16 BYTES WIDE\n");            \
                         break;                                                 \
                 } else {                                                       \
-                        printf(" ");                                           \
+                        fprintf(HEXDUMP_STREAM, " ");                          \
                 }                                                              \
         }                                                                      \
                                                                                \
         for (int x = 0; x < 75; x++) {                                         \
                 if (x >= 21 && x <= 73) {                                      \
-                        printf("_");                                           \
+                        fprintf(HEXDUMP_STREAM, "_");                          \
                 } else {                                                       \
-                        printf(" ");                                           \
+                        fprintf(HEXDUMP_STREAM, " ");                          \
                 }                                                              \
         }                                                                      \
-        printf("\n");
+        fprintf(HEXDUMP_STREAM, "\n");
 
 #ifndef HEXDUMP
 #define HEXDUMP(PTR, SIZE)                                                     \
@@ -67,41 +78,84 @@
         }                                                                      \
                                                                                \
         for (int i = 0; i < n_loop; i++) {                                     \
-                printf("|0x%016lx|", (uintptr_t)(realptr));                    \
+                fprintf(HEXDUMP_STREAM, "|0x%016lx|", (uintptr_t)(realptr));   \
                                                                                \
                 for (int i = 0; i < 16; i++) {                                 \
                         if (i % 4 == 0 && i != 0) {                            \
-                                printf("  ");                                  \
+                                fprintf(HEXDUMP_STREAM, "  ");                 \
                         }                                                      \
                         if (i != 15) {                                         \
                                 if (initial_counter <= ptr_size) {             \
                                         VT_HEXDUMP_COLOR(" %02x", realptr[i]); \
                                 }                                              \
                         } else {                                               \
-                                printf(" %02x ", realptr[i]);                  \
+                                fprintf(HEXDUMP_STREAM, " %02x ", realptr[i]); \
                         }                                                      \
                 }                                                              \
                                                                                \
-                printf(" | ");                                                 \
+                fprintf(HEXDUMP_STREAM, " | ");                                \
                 for (int i = 0; i < 16; i++) {                                 \
                         if (initial_counter <= ptr_size - 1) {                 \
                                 if (realptr[i] >= 32 && realptr[i] <= 126) {   \
-                                        printf("%c", realptr[i]);              \
+                                        fprintf(HEXDUMP_STREAM, "%c",          \
+                                                realptr[i]);                   \
                                 } else {                                       \
-                                        printf(".", realptr[i]);               \
+                                        fprintf(HEXDUMP_STREAM, ".");          \
                                 }                                              \
                         } else {                                               \
-                                printf(".");                                   \
+                                fprintf(HEXDUMP_STREAM, ".");                  \
                         }                                                      \
                         initial_counter = initial_counter + 1;                 \
                 }                                                              \
-                printf(" | ");                                                 \
+                fprintf(HEXDUMP_STREAM, " | ");                                \
                                                                                \
-                printf("\n");                                                  \
+                fprintf(HEXDUMP_STREAM, "\n");                                 \
                 realptr = realptr + 16;                                        \
         }
 #endif
 
+/*
+ * same layout as HEXDUMP, but the left column is ADDR (file offset or
+ * vaddr) instead of the pointer, and it never reads past SIZE
+ */
+#ifndef HEXDUMP_AT
+#define HEXDUMP_AT(PTR, SIZE, ADDR)                                            \
+        do {                                                                   \
+                const unsigned char *at_ptr = (const unsigned char *)(PTR);    \
+                size_t at_size = (SIZE);                                       \
+                uint64_t at_addr = (ADDR);                                     \
+                                                                               \
+                for (size_t at_row = 0; at_row < at_size; at_row += 16) {      \
+                        size_t at_n = at_size - at_row;                        \
+                        if (at_n > 16)                                         \
+                                at_n = 16;                                     \
+                                                                               \
+                        fprintf(HEXDUMP_STREAM, "|0x%016" PRIx64 "|",          \
+                                at_addr + at_row);                             \
+                        for (size_t i = 0; i < 16; i++) {                      \
+                                if (i % 4 == 0 && i != 0) {                    \
+                                        fprintf(HEXDUMP_STREAM, "  ");         \
+                                }                                              \
+                                if (i < at_n) {                                \
+                                        VT_HEXDUMP_COLOR(" %02x",              \
+                                                         at_ptr[at_row + i]);  \
+                                } else {                                       \
+                                        fprintf(HEXDUMP_STREAM, "   ");        \
+                                }                                              \
+                        }                                                      \
+                                                                               \
+                        fprintf(HEXDUMP_STREAM, "  | ");                       \
+                        for (size_t i = 0; i < 16; i++) {                      \
+                                unsigned char c = i < at_n ?                   \
+                                        at_ptr[at_row + i] : '.';              \
+                                fprintf(HEXDUMP_STREAM, "%c",                  \
+                                        (c >= 32 && c <= 126) ? c : '.');      \
+                        }                                                      \
+                        fprintf(HEXDUMP_STREAM, " | \n");                      \
+                }                                                              \
+        } while (0)
+#endif
+
 #ifndef VT_HEXDUMP
 #define VT_HEXDUMP(PTR, SIZE)                                                  \
         VT_TITLE(PTR, SIZE);                                                   \
@@ -113,6 +167,6 @@
         size_t ptr_size = SIZE;                                                \
         unsigned char *simple_hexdump_realptr = (unsigned char *)PTR;          \
         for (int i = 0; i < SIZE; i++) {                                       \
-                printf(" %02x", simple_hexdump_realptr[i]);          \
+                fprintf(HEXDUMP_STREAM, " %02x", simple_hexdump_realptr[i]);   \
         }
 #endif
@@ -0,0 +1,152 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+/*
+ * Copyright (C) Fadhil Riyanto <me@fadev.org>
+ */
+
+#include "interval.h"
+#include <stdlib.h>
+#include <string.h>
+
+/* a subtree this low is scanned in order instead of walked */
+#define IVAL_SCAN_LEVEL 3
+
+int ival_add(struct ival_index *x, uint64_t start, uint64_t end,
+             uint64_t id) {
+        if (end <= start)
+                return 0;
+
+        if (x->n == x->cap) {
+                uint64_t cap = x->cap ? x->cap * 2 : 64;
+                struct ival *v =
+                    (struct ival *)realloc(x->v, cap * sizeof(struct ival));
+                if (v == NULL)
+                        return -1;
+
+                x->v = v;
+                x->cap = cap;
+        }
+
+        x->v[x->n].start = start;
+        x->v[x->n].end = end;
+        x->v[x->n].max = end;
+        x->v[x->n].id = id;
+        x->n++;
+        return 0;
+}
+
+static int __ival_cmp(const void *a, const void *b) {
+        const struct ival *p = (const struct ival *)a;
+        const struct ival *q = (const struct ival *)b;
+
+        if (p->start != q->start)
+                return p->start < q->start ? -1 : 1;
+        if (p->end != q->end)
+                return p->end > q->end ? -1 : 1;
+        return p->id < q->id ? -1 : p->id > q->id;
+}
+
+void ival_build(struct ival_index *x) {
+        struct ival *v = x->v;
+        uint64_t n = x->n;
+        uint64_t last_i = 0;
+        uint64_t last = 0;
+        int k;
+
+        x->root = -1;
+        if (n == 0)
+                return;
+
+        qsort(v, n, sizeof(struct ival), __ival_cmp);
+
+        /* leaves are the even nodes */
+        for (uint64_t i = 0; i < n; i += 2) {
+                last_i = i;
+                last = v[i].max = v[i].end;
+        }
+
+        /*
+         * a node of level k covers 2^(k+1) - 1 slots, the ones past n
+         * are missing, last is the largest end of the rightmost path
+         */
+        for (k = 1; (uint64_t)1 << k <= n; k++) {
+                uint64_t half = (uint64_t)1 << (k - 1);
+                uint64_t step = half << 2;
+
+                for (uint64_t i = (half << 1) - 1; i < n; i += step) {
+                        uint64_t left = v[i - half].max;
+                        uint64_t right = i + half < n ? v[i + half].max : last;
+                        uint64_t e = v[i].end;
+
+                        e = e > left ? e : left;
+                        v[i].max = e > right ? e : right;
+                }
+
+                last_i = (last_i >> k) & 1 ? last_i - half : last_i + half;
+                if (last_i < n && v[last_i].max > last)
+                        last = v[last_i].max;
+        }
+
+        x->root = k - 1;
+}
+
+struct ival_frame {
+        uint64_t node;
+        int level;
+        int left_done;
+};
+
+void ival_query(const struct ival_index *x, uint64_t start, uint64_t end,
+                ival_fn fn, void *ctx) {
+        const struct ival *v = x->v;
+        struct ival_frame stack[66];
+        int top = 0;
+
+        if (x->root < 0 || end <= start)
+                return;
+
+        stack[top].node = ((uint64_t)1 << x->root) - 1;
+        stack[top].level = x->root;
+        stack[top++].left_done = 0;
+
+        while (top) {
+                struct ival_frame f = stack[--top];
+
+                if (f.level <= IVAL_SCAN_LEVEL) {
+                        uint64_t i = f.node >> f.level << f.level;
+                        uint64_t stop = i + ((uint64_t)1 << (f.level + 1)) - 1;
+
+                        if (stop > x->n)
+                                stop = x->n;
+                        for (; i < stop && v[i].start < end; i++) {
+                                if (start < v[i].end && fn(ctx, &v[i]))
+                                        return;
+                        }
+                } else if (!f.left_done) {
+                        uint64_t left = f.node - ((uint64_t)1 << (f.level - 1));
+
+                        stack[top].node = f.node;
+                        stack[top].level = f.level;
+                        stack[top++].left_done = 1;
+
+                        /* a missing left child may still hold nodes */
+                        if (left >= x->n || v[left].max > start) {
+                                stack[top].node = left;
+                                stack[top].level = f.level - 1;
+                                stack[top++].left_done = 0;
+                        }
+                } else if (f.node < x->n && v[f.node].start < end) {
+                        if (start < v[f.node].end && fn(ctx, &v[f.node]))
+                                return;
+
+                        stack[top].node =
+                            f.node + ((uint64_t)1 << (f.level - 1));
+                        stack[top].level = f.level - 1;
+                        stack[top++].left_done = 0;
+                }
+        }
+}
+
+void ival_free(struct ival_index *x) {
+        free(x->v);
+        memset(x, 0, sizeof(struct ival_index));
+}
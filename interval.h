@@ -0,0 +1,47 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+/*
+ * Copyright (C) Fadhil Riyanto <me@fadev.org>
+ * static interval index, half open [start, end) ranges
+ *
+ * the intervals are sorted by start and double as an implicit binary
+ * tree (the cgranges layout): node i sits at the level of its lowest
+ * clear bit and max holds the largest end below it, a query visits
+ * O(log n + hits) nodes and never allocates
+ */
+
+#ifndef INTERVAL_H
+#define INTERVAL_H
+
+#include <stdint.h>
+
+struct ival {
+        uint64_t start;
+        uint64_t end;
+        uint64_t max; /* largest end in the subtree of this node */
+        uint64_t id;
+};
+
+struct ival_index {
+        struct ival *v;
+        uint64_t n;
+        uint64_t cap;
+        int root; /* level of the root, -1 when empty */
+};
+
+/* non zero stops the query */
+typedef int (*ival_fn)(void *ctx, const struct ival *iv);
+
+/* empty intervals are dropped, -1 when out of memory */
+int ival_add(struct ival_index *x, uint64_t start, uint64_t end,
+             uint64_t id);
+
+/* sorts by start, longest first, then builds the tree */
+void ival_build(struct ival_index *x);
+
+/* every interval overlapping [start, end), in index order */
+void ival_query(const struct ival_index *x, uint64_t start, uint64_t end,
+                ival_fn fn, void *ctx);
+
+void ival_free(struct ival_index *x);
+
+#endif /* INTERVAL_H */
@@ -0,0 +1,350 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+/*
+ * Copyright (C) Fadhil Riyanto <me@fadev.org>
+ */
+
+#include "json_writer.h"
+#include <string.h>
+
+static const char __json_hex_digits[] = "0123456789abcdef";
+
+static const char __json_digit_pairs[] = "00010203040506070809"
+                                         "10111213141516171819"
+                                         "20212223242526272829"
+                                         "30313233343536373839"
+                                         "40414243444546474849"
+                                         "50515253545556575859"
+                                         "60616263646566676869"
+                                         "70717273747576777879"
+                                         "80818283848586878889"
+                                         "90919293949596979899";
+
+void json_init(struct json_writer *w, FILE *out) {
+        w->out = out;
+        w->len = 0;
+        w->depth = 0;
+        w->has_items = 0;
+        w->after_key = 0;
+}
+
+void json_flush(struct json_writer *w) {
+        if (w->len > 0) {
+                fwrite(w->buf, 1, w->len, w->out);
+                w->len = 0;
+        }
+}
+
+/* room for n more bytes, n is at most JSON_BUF_SIZE */
+static inline char *__json_reserve(struct json_writer *w, uint32_t n) {
+        if (w->len + n > JSON_BUF_SIZE)
+                json_flush(w);
+
+        return w->buf + w->len;
+}
+
+static inline void __json_putc(struct json_writer *w, char c) {
+        *__json_reserve(w, 1) = c;
+        w->len = w->len + 1;
+}
+
+static void __json_write(struct json_writer *w, const char *s, size_t n) {
+        while (n > 0) {
+                size_t chunk = n < JSON_BUF_SIZE ? n : JSON_BUF_SIZE;
+
+                memcpy(__json_reserve(w, chunk), s, chunk);
+                w->len = w->len + chunk;
+                s = s + chunk;
+                n = n - chunk;
+        }
+}
+
+/* comma between siblings, nothing right after a key */
+static inline void __json_sep(struct json_writer *w) {
+        uint64_t bit = 1ULL << w->depth;
+
+        if (w->after_key) {
+                w->after_key = 0;
+                return;
+        }
+
+        if (w->depth > 0 && (w->has_items & bit))
+                __json_putc(w, ',');
+        w->has_items |= bit;
+}
+
+static void __json_open(struct json_writer *w, char c) {
+        __json_sep(w);
+        __json_putc(w, c);
+
+        if (w->depth + 1 < JSON_MAX_DEPTH)
+                w->depth = w->depth + 1;
+        w->has_items &= ~(1ULL << w->depth);
+}
+
+static void __json_close(struct json_writer *w, char c) {
+        if (w->depth > 0)
+                w->depth = w->depth - 1;
+        __json_putc(w, c);
+}
+
+void json_object_begin(struct json_writer *w) {
+        __json_open(w, '{');
+}
+
+void json_object_end(struct json_writer *w) {
+        __json_close(w, '}');
+}
+
+void json_array_begin(struct json_writer *w) {
+        __json_open(w, '[');
+}
+
+void json_array_end(struct json_writer *w) {
+        __json_close(w, ']');
+}
+
+/* length of the well formed UTF-8 sequence at s, 0 when it is not one */
+static size_t __json_utf8_len(const unsigned char *s, size_t n) {
+        unsigned char lo = 0x80;
+        unsigned char hi = 0xbf;
+        size_t len;
+
+        if (s[0] >= 0xc2 && s[0] <= 0xdf) {
+                len = 2;
+        } else if (s[0] >= 0xe0 && s[0] <= 0xef) {
+                len = 3;
+                lo = s[0] == 0xe0 ? 0xa0 : lo; /* overlong */
+                hi = s[0] == 0xed ? 0x9f : hi; /* surrogates */
+        } else if (s[0] >= 0xf0 && s[0] <= 0xf4) {
+                len = 4;
+                lo = s[0] == 0xf0 ? 0x90 : lo; /* overlong */
+                hi = s[0] == 0xf4 ? 0x8f : hi; /* above U+10FFFF */
+        } else {
+                return 0;
+        }
+
+        if (len > n || s[1] < lo || s[1] > hi)
+                return 0;
+        for (size_t k = 2; k < len; k++) {
+                if ((s[k] & 0xc0) != 0x80)
+                        return 0;
+        }
+
+        return len;
+}
+
+/*
+ * copies runs of plain bytes in one go, '"', '\\' and control
+ * characters are escaped, well formed UTF-8 goes as is, any other byte
+ * of 0x80 and up becomes \u00XX so the output stays valid JSON
+ *
+ * names and keys are mostly ASCII, so the quotes and the string are
+ * first copied in one reserve, checking as it goes, the run loop takes
+ * over from the first byte that is not plain ASCII
+ */
+static void __json_escaped(struct json_writer *w, const char *s, size_t n) {
+        size_t i = 0;
+
+        if (n + 2 <= JSON_BUF_SIZE) {
+                char *p = __json_reserve(w, n + 2);
+
+                *p++ = '"';
+                for (; i < n; i++) {
+                        unsigned char c = (unsigned char)s[i];
+
+                        if (c < 0x20 || c >= 0x80 || c == '"' || c == '\\')
+                                break;
+                        p[i] = c;
+                }
+
+                w->len = w->len + 1 + i;
+                if (i == n) {
+                        p[n] = '"';
+                        w->len = w->len + 1;
+                        return;
+                }
+        } else {
+                __json_putc(w, '"');
+        }
+
+        size_t run = i;
+
+        for (; i < n; i++) {
+                unsigned char c = (unsigned char)s[i];
+
+                if (c >= 0x80) {
+                        size_t len = __json_utf8_len(
+                            (const unsigned char *)s + i, n - i);
+
+                        if (len) {
+                                i = i + len - 1;
+                                continue;
+                        }
+                } else if (c >= 0x20 && c != '"' && c != '\\') {
+                        continue;
+                }
+
+                __json_write(w, s + run, i - run);
+                run = i + 1;
+
+                char *p = __json_reserve(w, 6);
+                p[0] = '\\';
+                if (c == '"' || c == '\\') {
+                        p[1] = c;
+                        w->len = w->len + 2;
+                } else if (c == '\n') {
+                        p[1] = 'n';
+                        w->len = w->len + 2;
+                } else if (c == '\t') {
+                        p[1] = 't';
+                        w->len = w->len + 2;
+                } else {
+                        p[1] = 'u';
+                        p[2] = '0';
+                        p[3] = '0';
+                        p[4] = __json_hex_digits[c >> 4];
+                        p[5] = __json_hex_digits[c & 0xf];
+                        w->len = w->len + 6;
+                }
+        }
+
+        __json_write(w, s + run, n - run);
+        __json_putc(w, '"');
+}
+
+void json_key(struct json_writer *w, const char *key) {
+        __json_sep(w);
+        __json_escaped(w, key, strlen(key));
+        __json_putc(w, ':');
+        w->after_key = 1;
+}
+
+void json_u64(struct json_writer *w, uint64_t v) {
+        char tmp[20];
+        char *end = tmp + sizeof(tmp);
+        char *p = end;
+
+        __json_sep(w);
+
+        while (v >= 100) {
+                uint64_t pair = (v % 100) * 2;
+
+                v = v / 100;
+                p = p - 2;
+                p[0] = __json_digit_pairs[pair];
+                p[1] = __json_digit_pairs[pair + 1];
+        }
+
+        if (v >= 10) {
+                p = p - 2;
+                p[0] = __json_digit_pairs[v * 2];
+                p[1] = __json_digit_pairs[v * 2 + 1];
+        } else {
+                *--p = '0' + v;
+        }
+
+        __json_write(w, p, end - p);
+}
+
+void json_milli(struct json_writer *w, uint64_t milli) {
+        char tmp[4];
+
+        json_u64(w, milli / 1000);
+
+        milli = milli % 1000;
+        tmp[0] = '.';
+        tmp[1] = '0' + milli / 100;
+        tmp[2] = __json_digit_pairs[(milli % 100) * 2];
+        tmp[3] = __json_digit_pairs[(milli % 100) * 2 + 1];
+        __json_write(w, tmp, 4);
+}
+
+void json_hex(struct json_writer *w, uint64_t v) {
+        char tmp[20];
+        char *end = tmp + sizeof(tmp);
+        char *p = end;
+
+        __json_sep(w);
+
+        *--p = '"';
+        do {
+                *--p = __json_hex_digits[v & 0xf];
+                v = v >> 4;
+        } while (v);
+        *--p = 'x';
+        *--p = '0';
+        *--p = '"';
+
+        __json_write(w, p, end - p);
+}
+
+void json_str(struct json_writer *w, const char *s) {
+        json_strn(w, s, strlen(s));
+}
+
+void json_strn(struct json_writer *w, const char *s, size_t n) {
+        __json_sep(w);
+        __json_escaped(w, s, n);
+}
+
+void json_null(struct json_writer *w) {
+        __json_sep(w);
+        __json_write(w, "null", 4);
+}
+
+void json_bool(struct json_writer *w, int v) {
+        __json_sep(w);
+        if (v)
+                __json_write(w, "true", 4);
+        else
+                __json_write(w, "false", 5);
+}
+
+void json_key_u64(struct json_writer *w, const char *key, uint64_t v) {
+        json_key(w, key);
+        json_u64(w, v);
+}
+
+void json_key_hex(struct json_writer *w, const char *key, uint64_t v) {
+        json_key(w, key);
+        json_hex(w, v);
+}
+
+void json_key_str(struct json_writer *w, const char *key, const char *s) {
+        json_key(w, key);
+        json_str(w, s);
+}
+
+void json_hex_begin(struct json_writer *w) {
+        __json_sep(w);
+        __json_putc(w, '"');
+}
+
+void json_hex_bytes(struct json_writer *w, const uint8_t *p, size_t n) {
+        while (n > 0) {
+                size_t chunk = n < JSON_BUF_SIZE / 2 ? n : JSON_BUF_SIZE / 2;
+                char *out = __json_reserve(w, chunk * 2);
+
+                for (size_t i = 0; i < chunk; i++) {
+                        out[i * 2] = __json_hex_digits[p[i] >> 4];
+                        out[i * 2 + 1] = __json_hex_digits[p[i] & 0xf];
+                }
+
+                w->len = w->len + chunk * 2;
+                p = p + chunk;
+                n = n - chunk;
+        }
+}
+
+void json_hex_end(struct json_writer *w) {
+        __json_putc(w, '"');
+}
+
+void json_raw(struct json_writer *w, const char *s, size_t n) {
+        __json_sep(w);
+        __json_write(w, s, n);
+}
+
+void json_newline(struct json_writer *w) {
+        __json_putc(w, '\n');
+}
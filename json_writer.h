@@ -0,0 +1,62 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+/*
+ * Copyright (C) Fadhil Riyanto <me@fadev.org>
+ * streaming JSON writer, values are formatted by hand straight into a
+ * fixed buffer that is written out with fwrite() when full, nothing is
+ * allocated and printf is never called
+ */
+
+#ifndef JSON_WRITER_H
+#define JSON_WRITER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#define JSON_BUF_SIZE (64 * 1024)
+#define JSON_MAX_DEPTH 64
+
+struct json_writer {
+        FILE *out;
+        uint32_t len;
+        uint32_t depth;
+        uint64_t has_items; /* bit n: container at depth n is not empty */
+        int after_key;
+        char buf[JSON_BUF_SIZE];
+};
+
+void json_init(struct json_writer *w, FILE *out);
+void json_flush(struct json_writer *w);
+
+void json_object_begin(struct json_writer *w);
+void json_object_end(struct json_writer *w);
+void json_array_begin(struct json_writer *w);
+void json_array_end(struct json_writer *w);
+void json_key(struct json_writer *w, const char *key);
+
+void json_u64(struct json_writer *w, uint64_t v);
+void json_milli(struct json_writer *w, uint64_t milli); /* 1234 -> 1.234 */
+void json_hex(struct json_writer *w, uint64_t v); /* "0x..." string */
+/* bytes that are not well formed UTF-8 come out as \u00XX */
+void json_str(struct json_writer *w, const char *s);
+void json_strn(struct json_writer *w, const char *s, size_t n);
+void json_null(struct json_writer *w);
+void json_bool(struct json_writer *w, int v);
+
+/* "key": value in one call */
+void json_key_u64(struct json_writer *w, const char *key, uint64_t v);
+void json_key_hex(struct json_writer *w, const char *key, uint64_t v);
+void json_key_str(struct json_writer *w, const char *key, const char *s);
+
+/* "hex" string of raw bytes, can be fed in chunks */
+void json_hex_begin(struct json_writer *w);
+void json_hex_bytes(struct json_writer *w, const uint8_t *p, size_t n);
+void json_hex_end(struct json_writer *w);
+
+/* already rendered value, e.g. a member object built on another thread */
+void json_raw(struct json_writer *w, const char *s, size_t n);
+
+/* record separator for NDJSON, only valid at depth 0 */
+void json_newline(struct json_writer *w);
+
+#endif /* JSON_WRITER_H */
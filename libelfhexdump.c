@@ -0,0 +1,808 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+/*
+ * Copyright (C) Fadhil Riyanto <me@fadev.org>
+ */
+
+#include "libelfhexdump.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+struct ehd_file {
+        const uint8_t *data;
+        uint64_t size;
+        int mapped; /* ehd_open() owns the mapping */
+        struct ehd_allocator alloc;
+
+        int cls;
+        Elf64_Ehdr ehdr; /* widened for ELF32 */
+
+        /* extended numbering resolved */
+        uint64_t shnum;
+        uint32_t shstrndx;
+        uint32_t phnum;
+
+        /* NULL when the table does not fit in the image */
+        const uint8_t *phdrs;
+        const uint8_t *shdrs;
+        const char *shstrtab;
+        uint64_t shstrtab_size;
+};
+
+static void *__ehd_default_alloc(void *ctx, size_t size) {
+        (void)ctx;
+        return malloc(size);
+}
+
+static void __ehd_default_free(void *ctx, void *ptr, size_t size) {
+        (void)ctx;
+        (void)size;
+        free(ptr);
+}
+
+static const struct ehd_allocator ehd_default_allocator = {
+        __ehd_default_alloc,
+        __ehd_default_free,
+        NULL,
+};
+
+static int __ehd_in_image(const struct ehd_file *f, uint64_t offset,
+                          uint64_t size) {
+        return offset <= f->size && size <= f->size - offset;
+}
+
+/*
+ * Read ELF header
+ * mode: x64
+ */
+static void __ehd_elf64_hdr(struct ehd_file *f) {
+        memcpy(&f->ehdr, f->data,
+               f->size < sizeof(Elf64_Ehdr) ? f->size : sizeof(Elf64_Ehdr));
+}
+
+/*
+ * Read ELF header, widened
+ * mode: x86
+ */
+static void __ehd_elf32_hdr(struct ehd_file *f) {
+        Elf32_Ehdr ehdr;
+
+        memset(&ehdr, 0, sizeof(ehdr));
+        memcpy(&ehdr, f->data,
+               f->size < sizeof(Elf32_Ehdr) ? f->size : sizeof(Elf32_Ehdr));
+
+        memcpy(f->ehdr.e_ident, ehdr.e_ident, EI_NIDENT);
+        f->ehdr.e_type = ehdr.e_type;
+        f->ehdr.e_machine = ehdr.e_machine;
+        f->ehdr.e_version = ehdr.e_version;
+        f->ehdr.e_entry = ehdr.e_entry;
+        f->ehdr.e_phoff = ehdr.e_phoff;
+        f->ehdr.e_shoff = ehdr.e_shoff;
+        f->ehdr.e_flags = ehdr.e_flags;
+        f->ehdr.e_ehsize = ehdr.e_ehsize;
+        f->ehdr.e_phentsize = ehdr.e_phentsize;
+        f->ehdr.e_phnum = ehdr.e_phnum;
+        f->ehdr.e_shentsize = ehdr.e_shentsize;
+        f->ehdr.e_shnum = ehdr.e_shnum;
+        f->ehdr.e_shstrndx = ehdr.e_shstrndx;
+}
+
+/*
+ * Read program header entry, widened
+ * mode: x86
+ */
+static void __ehd_elf32_phdr(const uint8_t *p, Elf64_Phdr *out) {
+        Elf32_Phdr phdr;
+
+        memcpy(&phdr, p, sizeof(phdr));
+        out->p_type = phdr.p_type;
+        out->p_flags = phdr.p_flags;
+        out->p_offset = phdr.p_offset;
+        out->p_vaddr = phdr.p_vaddr;
+        out->p_paddr = phdr.p_paddr;
+        out->p_filesz = phdr.p_filesz;
+        out->p_memsz = phdr.p_memsz;
+        out->p_align = phdr.p_align;
+}
+
+/*
+ * Read section header entry, widened
+ * mode: x86
+ */
+static void __ehd_elf32_shdr(const uint8_t *p, Elf64_Shdr *out) {
+        Elf32_Shdr shdr;
+
+        memcpy(&shdr, p, sizeof(shdr));
+        out->sh_name = shdr.sh_name;
+        out->sh_type = shdr.sh_type;
+        out->sh_flags = shdr.sh_flags;
+        out->sh_addr = shdr.sh_addr;
+        out->sh_offset = shdr.sh_offset;
+        out->sh_size = shdr.sh_size;
+        out->sh_link = shdr.sh_link;
+        out->sh_info = shdr.sh_info;
+        out->sh_addralign = shdr.sh_addralign;
+        out->sh_entsize = shdr.sh_entsize;
+}
+
+/*
+ * Read symbol, widened
+ * mode: x86
+ */
+static void __ehd_elf32_sym(const uint8_t *p, Elf64_Sym *out) {
+        Elf32_Sym sym;
+
+        memcpy(&sym, p, sizeof(sym));
+        out->st_name = sym.st_name;
+        out->st_info = sym.st_info;
+        out->st_other = sym.st_other;
+        out->st_shndx = sym.st_shndx;
+        out->st_value = sym.st_value;
+        out->st_size = sym.st_size;
+}
+
+static uint64_t __ehd_phdr_size(const struct ehd_file *f) {
+        return f->cls == ELFCLASS64 ? sizeof(Elf64_Phdr) : sizeof(Elf32_Phdr);
+}
+
+static uint64_t __ehd_shdr_size(const struct ehd_file *f) {
+        return f->cls == ELFCLASS64 ? sizeof(Elf64_Shdr) : sizeof(Elf32_Shdr);
+}
+
+/*
+ * Resolve extended numbering
+ *
+ * objects with >= SHN_LORESERVE sections store 0 in e_shnum and the
+ * real count on shdr[0].sh_size, the same trick is used for e_shstrndx
+ * (SHN_XINDEX -> shdr[0].sh_link) and e_phnum (PN_XNUM -> shdr[0].sh_info)
+ */
+static void __ehd_ext_num(struct ehd_file *f) {
+        const Elf64_Ehdr *ehdr = &f->ehdr;
+        Elf64_Shdr shdr0;
+
+        f->shnum = ehdr->e_shnum;
+        f->shstrndx = ehdr->e_shstrndx;
+        f->phnum = ehdr->e_phnum;
+
+        if (ehdr->e_shoff == 0 ||
+            !__ehd_in_image(f, ehdr->e_shoff, __ehd_shdr_size(f))) {
+                return;
+        }
+
+        if (ehdr->e_shnum != 0 && ehdr->e_shstrndx != SHN_XINDEX &&
+            ehdr->e_phnum != PN_XNUM) {
+                return;
+        }
+
+        if (f->cls == ELFCLASS64)
+                memcpy(&shdr0, f->data + ehdr->e_shoff, sizeof(Elf64_Shdr));
+        else
+                __ehd_elf32_shdr(f->data + ehdr->e_shoff, &shdr0);
+
+        if (ehdr->e_shnum == 0)
+                f->shnum = shdr0.sh_size;
+        if (ehdr->e_shstrndx == SHN_XINDEX)
+                f->shstrndx = shdr0.sh_link;
+        if (ehdr->e_phnum == PN_XNUM)
+                f->phnum = shdr0.sh_info;
+}
+
+/*
+ * locate the header tables and .shstrtab once, every later query is a
+ * bounds check plus a copy
+ */
+static void __ehd_index(struct ehd_file *f) {
+        uint64_t phsize = __ehd_phdr_size(f);
+        uint64_t shsize = __ehd_shdr_size(f);
+        Elf64_Shdr shstr;
+
+        if (f->cls == ELFCLASS64)
+                __ehd_elf64_hdr(f);
+        else
+                __ehd_elf32_hdr(f);
+
+        __ehd_ext_num(f);
+
+        if (f->phnum <= f->size / phsize &&
+            __ehd_in_image(f, f->ehdr.e_phoff, f->phnum * phsize)) {
+                f->phdrs = f->data + f->ehdr.e_phoff;
+        }
+
+        if (f->ehdr.e_shoff != 0 && f->shnum <= f->size / shsize &&
+            __ehd_in_image(f, f->ehdr.e_shoff, f->shnum * shsize)) {
+                f->shdrs = f->data + f->ehdr.e_shoff;
+        }
+
+        if (ehd_section(f, f->shstrndx, &shstr) == EHD_OK &&
+            shstr.sh_type != SHT_NOBITS &&
+            __ehd_in_image(f, shstr.sh_offset, shstr.sh_size)) {
+                f->shstrtab = (const char *)f->data + shstr.sh_offset;
+                f->shstrtab_size = shstr.sh_size;
+        }
+}
+
+int ehd_open_mem(const void *data, uint64_t size,
+                 const struct ehd_allocator *alloc, struct ehd_file **out) {
+        const uint8_t *ident = (const uint8_t *)data;
+
+        *out = NULL;
+        if (alloc == NULL) {
+                alloc = &ehd_default_allocator;
+        }
+
+        if (size < EI_NIDENT || memcmp(ident, ELFMAG, SELFMAG) != 0) {
+                return EHD_ENOTELF;
+        }
+
+        if (ident[EI_CLASS] != ELFCLASS32 && ident[EI_CLASS] != ELFCLASS64) {
+                return EHD_ECLASS;
+        }
+
+        struct ehd_file *f = (struct ehd_file *)alloc->alloc(
+            alloc->ctx, sizeof(struct ehd_file));
+        if (f == NULL) {
+                return EHD_ENOMEM;
+        }
+
+        memset(f, 0, sizeof(struct ehd_file));
+        f->data = ident;
+        f->size = size;
+        f->alloc = *alloc;
+        f->cls = ident[EI_CLASS];
+
+        __ehd_index(f);
+        *out = f;
+        return EHD_OK;
+}
+
+int ehd_open(const char *path, const struct ehd_allocator *alloc,
+             struct ehd_file **out) {
+        struct stat st;
+
+        *out = NULL;
+
+        int fd = open(path, O_RDONLY);
+        if (fd < 0) {
+                return EHD_EIO;
+        }
+
+        if (fstat(fd, &st) < 0) {
+                close(fd);
+                return EHD_EIO;
+        }
+
+        if (st.st_size == 0) {
+                close(fd);
+                return EHD_ENOTELF;
+        }
+
+        void *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        int saved = errno;
+        close(fd);
+
+        if (map == MAP_FAILED) {
+                errno = saved;
+                return EHD_EIO;
+        }
+
+        int ret = ehd_open_mem(map, st.st_size, alloc, out);
+        if (ret != EHD_OK) {
+                munmap(map, st.st_size);
+                return ret;
+        }
+
+        (*out)->mapped = 1;
+        return EHD_OK;
+}
+
+void ehd_close(struct ehd_file *f) {
+        if (f == NULL) {
+                return;
+        }
+
+        if (f->mapped) {
+                munmap((void *)f->data, f->size);
+        }
+
+        struct ehd_allocator alloc = f->alloc;
+        alloc.free(alloc.ctx, f, sizeof(struct ehd_file));
+}
+
+const char *ehd_strerror(int err) {
+        switch (err) {
+        case EHD_OK:
+                return "success";
+        case EHD_EIO:
+                return strerror(errno);
+        case EHD_ENOTELF:
+                return "not an ELF file";
+        case EHD_ECLASS:
+                return "ELF class is neither ELF32 nor ELF64";
+        case EHD_ENOMEM:
+                return "out of memory";
+        case EHD_ERANGE:
+                return "outside of the file";
+        case EHD_ENOENT:
+                return "not found";
+        default:
+                return "unknown error";
+        }
+}
+
+int ehd_class(const struct ehd_file *f) {
+        return f->cls;
+}
+
+const uint8_t *ehd_data(const struct ehd_file *f) {
+        return f->data;
+}
+
+uint64_t ehd_size(const struct ehd_file *f) {
+        return f->size;
+}
+
+const uint8_t *ehd_bytes(const struct ehd_file *f, uint64_t offset,
+                         uint64_t size) {
+        if (!__ehd_in_image(f, offset, size)) {
+                return NULL;
+        }
+
+        return f->data + offset;
+}
+
+const Elf64_Ehdr *ehd_header(const struct ehd_file *f) {
+        return &f->ehdr;
+}
+
+uint64_t ehd_shnum(const struct ehd_file *f) {
+        return f->shnum;
+}
+
+uint32_t ehd_shstrndx(const struct ehd_file *f) {
+        return f->shstrndx;
+}
+
+uint32_t ehd_phnum(const struct ehd_file *f) {
+        return f->phnum;
+}
+
+int ehd_segment(const struct ehd_file *f, uint64_t index, Elf64_Phdr *out) {
+        if (f->phdrs == NULL || index >= f->phnum) {
+                return EHD_ERANGE;
+        }
+
+        if (f->cls == ELFCLASS64)
+                memcpy(out, f->phdrs + index * sizeof(Elf64_Phdr),
+                       sizeof(Elf64_Phdr));
+        else
+                __ehd_elf32_phdr(f->phdrs + index * sizeof(Elf32_Phdr), out);
+
+        return EHD_OK;
+}
+
+int ehd_section(const struct ehd_file *f, uint64_t index, Elf64_Shdr *out) {
+        if (f->shdrs == NULL || index >= f->shnum) {
+                return EHD_ERANGE;
+        }
+
+        if (f->cls == ELFCLASS64)
+                memcpy(out, f->shdrs + index * sizeof(Elf64_Shdr),
+                       sizeof(Elf64_Shdr));
+        else
+                __ehd_elf32_shdr(f->shdrs + index * sizeof(Elf32_Shdr), out);
+
+        return EHD_OK;
+}
+
+/*
+ * a string is only handed out when its NUL is inside the table, an
+ * unusable name is ""
+ */
+static const char *__ehd_string(const char *table, uint64_t size,
+                                uint64_t off) {
+        if (table == NULL || off >= size ||
+            memchr(table + off, 0, size - off) == NULL) {
+                return "";
+        }
+
+        return table + off;
+}
+
+const char *ehd_section_name(const struct ehd_file *f,
+                             const Elf64_Shdr *shdr) {
+        return __ehd_string(f->shstrtab, f->shstrtab_size, shdr->sh_name);
+}
+
+int ehd_section_by_name(const struct ehd_file *f, const char *name,
+                        Elf64_Shdr *out, uint64_t *index) {
+        for (uint64_t i = 0; i < f->shnum; i++) {
+                if (ehd_section(f, i, out) != EHD_OK)
+                        return EHD_ERANGE;
+
+                if (strcmp(ehd_section_name(f, out), name) == 0) {
+                        if (index)
+                                *index = i;
+                        return EHD_OK;
+                }
+        }
+
+        return EHD_ENOENT;
+}
+
+const uint8_t *ehd_section_bytes(const struct ehd_file *f,
+                                 const Elf64_Shdr *shdr) {
+        if (shdr->sh_type == SHT_NOBITS) {
+                return NULL;
+        }
+
+        return ehd_bytes(f, shdr->sh_offset, shdr->sh_size);
+}
+
+/*
+ * the SHT_SYMTAB_SHNDX section that points back (sh_link) to a symtab
+ * carries its extended indexes
+ */
+int ehd_symtab(const struct ehd_file *f, uint64_t section,
+               struct ehd_symtab *out) {
+        uint64_t symsize =
+            f->cls == ELFCLASS64 ? sizeof(Elf64_Sym) : sizeof(Elf32_Sym);
+        Elf64_Shdr shdr, link;
+
+        memset(out, 0, sizeof(struct ehd_symtab));
+        out->file = f;
+        out->section = section;
+
+        if (ehd_section(f, section, &shdr) != EHD_OK) {
+                return EHD_ERANGE;
+        }
+
+        out->syms = ehd_bytes(f, shdr.sh_offset, shdr.sh_size);
+        if (out->syms == NULL) {
+                return EHD_ERANGE;
+        }
+
+        out->nsyms = shdr.sh_size / symsize;
+
+        if (ehd_section(f, shdr.sh_link, &link) == EHD_OK) {
+                out->strtab = (const char *)ehd_section_bytes(f, &link);
+                out->strtab_size = out->strtab ? link.sh_size : 0;
+        }
+
+        for (uint64_t i = 0; i < f->shnum; i++) {
+                Elf64_Shdr x;
+
+                if (ehd_section(f, i, &x) != EHD_OK)
+                        break;
+
+                if (x.sh_type == SHT_SYMTAB_SHNDX && x.sh_link == section &&
+                    x.sh_size >= out->nsyms * sizeof(Elf64_Word)) {
+                        out->xindex = ehd_section_bytes(f, &x);
+                        break;
+                }
+        }
+
+        return EHD_OK;
+}
+
+int ehd_symbol(const struct ehd_symtab *st, uint64_t index, Elf64_Sym *out) {
+        if (index >= st->nsyms) {
+                return EHD_ERANGE;
+        }
+
+        if (st->file->cls == ELFCLASS64)
+                memcpy(out, st->syms + index * sizeof(Elf64_Sym),
+                       sizeof(Elf64_Sym));
+        else
+                __ehd_elf32_sym(st->syms + index * sizeof(Elf32_Sym), out);
+
+        return EHD_OK;
+}
+
+const char *ehd_symbol_name(const struct ehd_symtab *st,
+                            const Elf64_Sym *sym) {
+        return __ehd_string(st->strtab, st->strtab_size, sym->st_name);
+}
+
+int ehd_symbol_xindex(const struct ehd_symtab *st, uint64_t index,
+                      uint32_t *out) {
+        if (st->xindex == NULL || index >= st->nsyms) {
+                return EHD_ENOENT;
+        }
+
+        memcpy(out, st->xindex + index * sizeof(Elf64_Word),
+               sizeof(Elf64_Word));
+        return EHD_OK;
+}
+
+static uint64_t __ehd_rel_size(const struct ehd_file *f, int rela) {
+        if (f->cls == ELFCLASS64)
+                return rela ? sizeof(Elf64_Rela) : sizeof(Elf64_Rel);
+
+        return rela ? sizeof(Elf32_Rela) : sizeof(Elf32_Rel);
+}
+
+int ehd_reltab(const struct ehd_file *f, uint64_t section,
+               struct ehd_reltab *out) {
+        Elf64_Shdr shdr;
+
+        memset(out, 0, sizeof(struct ehd_reltab));
+        out->file = f;
+        out->section = section;
+
+        if (ehd_section(f, section, &shdr) != EHD_OK ||
+            (shdr.sh_type != SHT_REL && shdr.sh_type != SHT_RELA)) {
+                return EHD_ERANGE;
+        }
+
+        out->rels = ehd_bytes(f, shdr.sh_offset, shdr.sh_size);
+        if (out->rels == NULL) {
+                return EHD_ERANGE;
+        }
+
+        out->rela = shdr.sh_type == SHT_RELA;
+        out->nrels = shdr.sh_size / __ehd_rel_size(f, out->rela);
+        out->symtab = shdr.sh_link;
+        out->target = shdr.sh_info;
+
+        return EHD_OK;
+}
+
+int ehd_reloc(const struct ehd_reltab *rt, uint64_t index, Elf64_Rela *out) {
+        const uint8_t *p;
+
+        if (index >= rt->nrels) {
+                return EHD_ERANGE;
+        }
+
+        p = rt->rels + index * __ehd_rel_size(rt->file, rt->rela);
+        out->r_addend = 0;
+
+        if (rt->file->cls == ELFCLASS64) {
+                memcpy(out, p, rt->rela ? sizeof(Elf64_Rela)
+                                        : sizeof(Elf64_Rel));
+        } else {
+                Elf32_Rela rel = { 0 };
+
+                memcpy(&rel, p, rt->rela ? sizeof(Elf32_Rela)
+                                         : sizeof(Elf32_Rel));
+                out->r_offset = rel.r_offset;
+                out->r_info = ELF64_R_INFO(ELF32_R_SYM(rel.r_info),
+                                           ELF32_R_TYPE(rel.r_info));
+                out->r_addend = rel.r_addend;
+        }
+
+        return EHD_OK;
+}
+
+struct ehd_sym_entry {
+        uint64_t value;
+        uint64_t size;
+        uint64_t max_end; /* highest value + size up to this entry */
+        const char *name;
+};
+
+struct ehd_sym_index {
+        struct ehd_allocator alloc;
+        struct ehd_sym_entry *syms; /* sorted by value */
+        uint64_t nsyms;
+        uint64_t cap;
+};
+
+static int __ehd_sym_cmp(const void *a, const void *b) {
+        const struct ehd_sym_entry *sa = (const struct ehd_sym_entry *)a;
+        const struct ehd_sym_entry *sb = (const struct ehd_sym_entry *)b;
+
+        if (sa->value != sb->value)
+                return sa->value < sb->value ? -1 : 1;
+        /* bigger symbol first, so the lookup lands on the inner one */
+        if (sa->size != sb->size)
+                return sa->size > sb->size ? -1 : 1;
+        return 0;
+}
+
+static int __ehd_sym_indexable(const Elf64_Sym *sym) {
+        int type = ELF64_ST_TYPE(sym->st_info);
+
+        return sym->st_shndx != SHN_UNDEF && sym->st_value != 0 &&
+               (type == STT_FUNC || type == STT_OBJECT ||
+                type == STT_NOTYPE || type == STT_GNU_IFUNC ||
+                type == STT_TLS);
+}
+
+/* first SHT_SYMTAB, SHT_DYNSYM when there is none */
+static int __ehd_sym_source(const struct ehd_file *f, struct ehd_symtab *st) {
+        Elf64_Shdr shdr;
+        int64_t dynsym = -1;
+
+        for (uint64_t i = 0; ehd_section(f, i, &shdr) == EHD_OK; i++) {
+                if (shdr.sh_type == SHT_SYMTAB)
+                        return ehd_symtab(f, i, st);
+                if (shdr.sh_type == SHT_DYNSYM && dynsym < 0)
+                        dynsym = i;
+        }
+
+        if (dynsym < 0) {
+                return EHD_ENOENT;
+        }
+
+        return ehd_symtab(f, dynsym, st);
+}
+
+int ehd_sym_index_build(const struct ehd_file *f,
+                        const struct ehd_allocator *alloc,
+                        struct ehd_sym_index **out) {
+        struct ehd_symtab st;
+        Elf64_Sym sym;
+        uint64_t n = 0;
+
+        *out = NULL;
+        if (alloc == NULL) {
+                alloc = &ehd_default_allocator;
+        }
+
+        struct ehd_sym_index *idx = (struct ehd_sym_index *)alloc->alloc(
+            alloc->ctx, sizeof(struct ehd_sym_index));
+        if (idx == NULL) {
+                return EHD_ENOMEM;
+        }
+
+        memset(idx, 0, sizeof(struct ehd_sym_index));
+        idx->alloc = *alloc;
+
+        if (__ehd_sym_source(f, &st) != EHD_OK || st.nsyms == 0) {
+                *out = idx;
+                return EHD_OK;
+        }
+
+        idx->cap = st.nsyms;
+        idx->syms = (struct ehd_sym_entry *)alloc->alloc(
+            alloc->ctx, idx->cap * sizeof(struct ehd_sym_entry));
+        if (idx->syms == NULL) {
+                alloc->free(alloc->ctx, idx, sizeof(struct ehd_sym_index));
+                return EHD_ENOMEM;
+        }
+
+        for (uint64_t i = 0; ehd_symbol(&st, i, &sym) == EHD_OK; i++) {
+                if (!__ehd_sym_indexable(&sym))
+                        continue;
+
+                idx->syms[n].value = sym.st_value;
+                idx->syms[n].size = sym.st_size;
+                idx->syms[n].name = ehd_symbol_name(&st, &sym);
+                n++;
+        }
+
+        qsort(idx->syms, n, sizeof(struct ehd_sym_entry), __ehd_sym_cmp);
+
+        uint64_t max_end = 0;
+        for (uint64_t i = 0; i < n; i++) {
+                uint64_t end = idx->syms[i].value + idx->syms[i].size;
+
+                if (end > max_end)
+                        max_end = end;
+                idx->syms[i].max_end = max_end;
+        }
+
+        idx->nsyms = n;
+        *out = idx;
+        return EHD_OK;
+}
+
+/*
+ * the symbol that covers addr, a sized symbol covers
+ * [value, value + size), an unsized one only its own address
+ */
+int ehd_addr2sym(const struct ehd_sym_index *idx, uint64_t addr,
+                 const char **name, uint64_t *offset) {
+        uint64_t lo = 0;
+        uint64_t hi = idx->nsyms;
+
+        /* first entry with value > addr */
+        while (lo < hi) {
+                uint64_t mid = lo + (hi - lo) / 2;
+
+                if (idx->syms[mid].value <= addr)
+                        lo = mid + 1;
+                else
+                        hi = mid;
+        }
+
+        /*
+         * walk back over the entries at or below addr, nearest first,
+         * nothing before an entry whose max_end <= addr can cover it
+         */
+        for (uint64_t i = lo; i > 0; i--) {
+                const struct ehd_sym_entry *e = &idx->syms[i - 1];
+
+                if (addr - e->value < e->size ||
+                    (e->size == 0 && addr == e->value)) {
+                        *name = e->name;
+                        *offset = addr - e->value;
+                        return EHD_OK;
+                }
+
+                if (e->max_end <= addr && e->value != addr)
+                        break;
+        }
+
+        return EHD_ENOENT;
+}
+
+void ehd_sym_index_free(struct ehd_sym_index *idx) {
+        if (idx == NULL) {
+                return;
+        }
+
+        struct ehd_allocator alloc = idx->alloc;
+
+        if (idx->syms) {
+                alloc.free(alloc.ctx, idx->syms,
+                           idx->cap * sizeof(struct ehd_sym_entry));
+        }
+        alloc.free(alloc.ctx, idx, sizeof(struct ehd_sym_index));
+}
+
+/*
+ * walk one note area (SHT_NOTE section or PT_NOTE segment) for
+ * NT_GNU_BUILD_ID
+ */
+static int __ehd_note_build_id(const struct ehd_file *f, uint64_t offset,
+                               uint64_t size, const uint8_t **id,
+                               uint32_t *id_size) {
+        const uint8_t *notes = ehd_bytes(f, offset, size);
+        uint64_t pos = 0;
+
+        if (notes == NULL) {
+                return EHD_ERANGE;
+        }
+
+        while (pos + sizeof(Elf64_Nhdr) <= size) {
+                Elf64_Nhdr nhdr;
+                memcpy(&nhdr, notes + pos, sizeof(Elf64_Nhdr));
+
+                uint64_t name_off = pos + sizeof(Elf64_Nhdr);
+                uint64_t desc_off = name_off + ((nhdr.n_namesz + 3) & ~3ULL);
+
+                if (desc_off > size || nhdr.n_descsz > size - desc_off) {
+                        break;
+                }
+
+                if (nhdr.n_type == NT_GNU_BUILD_ID && nhdr.n_namesz == 4 &&
+                    memcmp(notes + name_off, "GNU", 4) == 0) {
+                        *id = notes + desc_off;
+                        *id_size = nhdr.n_descsz;
+                        return EHD_OK;
+                }
+
+                pos = desc_off + ((nhdr.n_descsz + 3) & ~3ULL);
+        }
+
+        return EHD_ENOENT;
+}
+
+int ehd_build_id(const struct ehd_file *f, const uint8_t **id,
+                 uint32_t *size) {
+        Elf64_Shdr shdr;
+        Elf64_Phdr phdr;
+
+        for (uint64_t i = 0; ehd_section(f, i, &shdr) == EHD_OK; i++) {
+                if (shdr.sh_type == SHT_NOTE &&
+                    __ehd_note_build_id(f, shdr.sh_offset, shdr.sh_size, id,
+                                        size) == EHD_OK)
+                        return EHD_OK;
+        }
+
+        /* stripped section headers, fall back to PT_NOTE */
+        for (uint64_t i = 0; ehd_segment(f, i, &phdr) == EHD_OK; i++) {
+                if (phdr.p_type == PT_NOTE &&
+                    __ehd_note_build_id(f, phdr.p_offset, phdr.p_filesz, id,
+                                        size) == EHD_OK)
+                        return EHD_OK;
+        }
+
+        return EHD_ENOENT;
+}
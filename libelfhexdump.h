@@ -0,0 +1,137 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+/*
+ * Copyright (C) Fadhil Riyanto <me@fadev.org>
+ * libelfhexdump, ELF32/ELF64 reader used by the elf64 CLI
+ *
+ * every table is read in place from the mapped image and handed out
+ * widened to the ELF64 types, queries never allocate and never print,
+ * the only allocation is the ehd_file handle, made with the caller's
+ * allocator (malloc when NULL)
+ *
+ * strings and byte ranges point into the image, they stay valid until
+ * ehd_close()
+ */
+
+#ifndef LIBELFHEXDUMP_H
+#define LIBELFHEXDUMP_H
+
+#include <elf.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* return codes, errno is kept on EHD_EIO */
+#define EHD_OK 0
+#define EHD_EIO -1      /* open(), fstat() or mmap() failed */
+#define EHD_ENOTELF -2  /* no ELF magic */
+#define EHD_ECLASS -3   /* ELF, but neither ELFCLASS32 nor ELFCLASS64 */
+#define EHD_ENOMEM -4   /* allocator returned NULL */
+#define EHD_ERANGE -5   /* index or table outside of the image */
+#define EHD_ENOENT -6   /* no such section / note */
+
+struct ehd_allocator {
+        void *(*alloc)(void *ctx, size_t size);
+        void (*free)(void *ctx, void *ptr, size_t size);
+        void *ctx;
+};
+
+struct ehd_file;
+
+/*
+ * one SHT_SYMTAB / SHT_DYNSYM, filled by ehd_symtab(), lives on the
+ * caller's stack
+ */
+struct ehd_symtab {
+        const struct ehd_file *file;
+        uint64_t section; /* section index of the table */
+        uint64_t nsyms;
+        const uint8_t *syms;
+        const char *strtab;
+        uint64_t strtab_size;
+        const uint8_t *xindex; /* SHT_SYMTAB_SHNDX entries or NULL */
+};
+
+/* open and map a file, or wrap an image the caller keeps alive */
+int ehd_open(const char *path, const struct ehd_allocator *alloc,
+             struct ehd_file **out);
+int ehd_open_mem(const void *data, uint64_t size,
+                 const struct ehd_allocator *alloc, struct ehd_file **out);
+void ehd_close(struct ehd_file *f);
+const char *ehd_strerror(int err);
+
+/* image */
+int ehd_class(const struct ehd_file *f); /* ELFCLASS32 / ELFCLASS64 */
+const uint8_t *ehd_data(const struct ehd_file *f);
+uint64_t ehd_size(const struct ehd_file *f);
+const uint8_t *ehd_bytes(const struct ehd_file *f, uint64_t offset,
+                         uint64_t size);
+
+/* ELF header, counts have extended numbering resolved */
+const Elf64_Ehdr *ehd_header(const struct ehd_file *f);
+uint64_t ehd_shnum(const struct ehd_file *f);
+uint32_t ehd_shstrndx(const struct ehd_file *f);
+uint32_t ehd_phnum(const struct ehd_file *f);
+
+/* segments */
+int ehd_segment(const struct ehd_file *f, uint64_t index, Elf64_Phdr *out);
+
+/* sections */
+int ehd_section(const struct ehd_file *f, uint64_t index, Elf64_Shdr *out);
+const char *ehd_section_name(const struct ehd_file *f, const Elf64_Shdr *shdr);
+int ehd_section_by_name(const struct ehd_file *f, const char *name,
+                        Elf64_Shdr *out, uint64_t *index);
+const uint8_t *ehd_section_bytes(const struct ehd_file *f,
+                                 const Elf64_Shdr *shdr);
+
+/* symbols */
+int ehd_symtab(const struct ehd_file *f, uint64_t section,
+               struct ehd_symtab *out);
+int ehd_symbol(const struct ehd_symtab *st, uint64_t index, Elf64_Sym *out);
+const char *ehd_symbol_name(const struct ehd_symtab *st,
+                            const Elf64_Sym *sym);
+int ehd_symbol_xindex(const struct ehd_symtab *st, uint64_t index,
+                      uint32_t *out);
+
+/*
+ * one SHT_REL / SHT_RELA, filled by ehd_reltab(), entries come out as
+ * Elf64_Rela with r_info in the ELF64 layout, r_addend is 0 for SHT_REL
+ */
+struct ehd_reltab {
+        const struct ehd_file *file;
+        uint64_t section; /* section index of the table */
+        uint64_t nrels;
+        const uint8_t *rels;
+        int rela;        /* SHT_RELA */
+        uint64_t symtab; /* sh_link, symbol table the entries refer to */
+        uint64_t target; /* sh_info, section being relocated */
+};
+
+int ehd_reltab(const struct ehd_file *f, uint64_t section,
+               struct ehd_reltab *out);
+int ehd_reloc(const struct ehd_reltab *rt, uint64_t index, Elf64_Rela *out);
+
+/*
+ * address to symbol, the index is built once (.symtab, or .dynsym when
+ * stripped) with the caller's allocator, lookups are a binary search
+ */
+struct ehd_sym_index;
+
+int ehd_sym_index_build(const struct ehd_file *f,
+                        const struct ehd_allocator *alloc,
+                        struct ehd_sym_index **out);
+int ehd_addr2sym(const struct ehd_sym_index *idx, uint64_t addr,
+                 const char **name, uint64_t *offset);
+void ehd_sym_index_free(struct ehd_sym_index *idx);
+
+/* NT_GNU_BUILD_ID, SHT_NOTE sections first, then PT_NOTE segments */
+int ehd_build_id(const struct ehd_file *f, const uint8_t **id,
+                 uint32_t *size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* LIBELFHEXDUMP_H */
@@ -0,0 +1,178 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+/*
+ * Copyright (C) Fadhil Riyanto <me@fadev.org>
+ */
+
+#include "manifest.h"
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+static uint64_t __manifest_hash(const char *path, const char *range) {
+        uint64_t h = 0xcbf29ce484222325ULL; /* FNV-1a */
+
+        for (; *path; path++)
+                h = (h ^ (uint8_t)*path) * 0x100000001b3ULL;
+        h = (h ^ 0xff) * 0x100000001b3ULL;
+        for (; *range; range++)
+                h = (h ^ (uint8_t)*range) * 0x100000001b3ULL;
+        return h;
+}
+
+static int __manifest_hex(const char *s, uint8_t *out, uint32_t *len) {
+        uint32_t n = 0;
+
+        for (; s[0] && s[1]; s += 2) {
+                unsigned int v;
+
+                if (n == DIGEST_MAX || sscanf(s, "%2x", &v) != 1)
+                        return -1;
+                out[n++] = v;
+        }
+
+        *len = n;
+        return *s || n == 0 ? -1 : 0;
+}
+
+static int __manifest_add(struct manifest *m, const char *algo,
+                          const char *digest, const char *range,
+                          const char *path) {
+        struct manifest_entry e = { 0 };
+
+        e.algo = digest_parse(algo);
+        if (e.algo < 0 || __manifest_hex(digest, e.digest, &e.len) < 0)
+                return -1;
+
+        if (m->n == m->cap) {
+                uint64_t cap = m->cap ? m->cap * 2 : 64;
+                struct manifest_entry *p = (struct manifest_entry *)realloc(
+                    m->entries, cap * sizeof(struct manifest_entry));
+                if (p == NULL)
+                        return -1;
+
+                m->entries = p;
+                m->cap = cap;
+        }
+
+        e.path = strdup(path);
+        e.range = strdup(range);
+        m->entries[m->n++] = e;
+        return 0;
+}
+
+static int __manifest_index(struct manifest *m) {
+        m->nslots = 16;
+        while (m->nslots < m->n * 2)
+                m->nslots *= 2;
+
+        m->slots = (uint32_t *)calloc(m->nslots, sizeof(uint32_t));
+        if (m->slots == NULL)
+                return -1;
+
+        for (uint64_t i = 0; i < m->n; i++) {
+                struct manifest_entry *e = &m->entries[i];
+                uint64_t s = __manifest_hash(e->path, e->range);
+
+                /* a repeated entry keeps the first digest */
+                if (manifest_find(m, e->path, e->range))
+                        continue;
+
+                for (s &= m->nslots - 1; m->slots[s];
+                     s = (s + 1) & (m->nslots - 1))
+                        ;
+                m->slots[s] = i + 1;
+        }
+
+        return 0;
+}
+
+int manifest_load(struct manifest *m, const char *path, FILE *err) {
+        char *line = NULL;
+        size_t cap = 0;
+        uint32_t lineno = 0;
+        int ret = 0;
+
+        memset(m, 0, sizeof(struct manifest));
+
+        FILE *f = fopen(path, "r");
+        if (f == NULL) {
+                fprintf(err, "%s: cannot open: %s\n", path, strerror(errno));
+                return -1;
+        }
+
+        while (ret == 0 && getline(&line, &cap, f) > 0) {
+                char *save = NULL;
+                const char *sep = " \t\r\n";
+
+                lineno++;
+                char *algo = strtok_r(line, sep, &save);
+                if (algo == NULL || algo[0] == '#')
+                        continue;
+
+                char *digest = strchr(algo, ':');
+                char *range = strtok_r(NULL, sep, &save);
+                char *file = strtok_r(NULL, "\r\n", &save);
+
+                while (file && (*file == ' ' || *file == '\t'))
+                        file++;
+
+                if (digest == NULL || range == NULL || file == NULL ||
+                    *file == 0) {
+                        fprintf(err, "%s:%u: want ALGO:DIGEST RANGE PATH\n",
+                                path, lineno);
+                        ret = -1;
+                        break;
+                }
+
+                *digest++ = 0;
+                if (__manifest_add(m, algo, digest, range, file) < 0) {
+                        fprintf(err, "%s:%u: bad digest %s:%s\n", path,
+                                lineno, algo, digest);
+                        ret = -1;
+                }
+        }
+
+        /* a directory opens fine and reads nothing, that is no manifest */
+        if (ret == 0 && ferror(f)) {
+                fprintf(err, "%s: cannot read: %s\n", path, strerror(errno));
+                ret = -1;
+        } else if (ret == 0 && m->n == 0) {
+                fprintf(err, "%s: no digests, nothing to verify\n", path);
+                ret = -1;
+        }
+
+        free(line);
+        fclose(f);
+
+        if (ret == 0)
+                ret = __manifest_index(m);
+
+        if (ret < 0)
+                manifest_free(m);
+        return ret;
+}
+
+void manifest_free(struct manifest *m) {
+        for (uint64_t i = 0; i < m->n; i++) {
+                free(m->entries[i].path);
+                free(m->entries[i].range);
+        }
+
+        free(m->entries);
+        free(m->slots);
+        memset(m, 0, sizeof(struct manifest));
+}
+
+struct manifest_entry *manifest_find(const struct manifest *m,
+                                     const char *path, const char *range) {
+        uint64_t s = __manifest_hash(path, range) & (m->nslots - 1);
+
+        for (; m->slots[s]; s = (s + 1) & (m->nslots - 1)) {
+                struct manifest_entry *e = &m->entries[m->slots[s] - 1];
+
+                if (strcmp(e->path, path) == 0 && strcmp(e->range, range) == 0)
+                        return e;
+        }
+
+        return NULL;
+}
@@ -0,0 +1,53 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+/*
+ * Copyright (C) Fadhil Riyanto <me@fadev.org>
+ * --verify FILE, digests written by --hash, one range a line:
+ *
+ *   # algo:digest              range           path
+ *   sha256:9f86d0...           section:.text   /usr/bin/ls
+ *   sha256:2c26b4...           segment:2       /usr/bin/ls
+ *
+ * the path is the rest of the line, entries are looked up by path and
+ * range in an open addressed table, lookups are safe from any thread
+ */
+
+#ifndef MANIFEST_H
+#define MANIFEST_H
+
+#include "digest.h"
+#include <stdio.h>
+
+struct manifest_entry {
+        char *path;
+        char *range; /* "section:.text", "segment:2", "file" */
+        uint8_t digest[DIGEST_MAX];
+        uint32_t len;
+        int algo;
+        int seen; /* atomic, set once a run hashed this range */
+};
+
+struct manifest {
+        struct manifest_entry *entries;
+        uint64_t n;
+        uint64_t cap;
+        uint32_t *slots; /* entry index + 1, 0 is empty */
+        uint64_t nslots; /* power of two */
+        int inputs;      /* every path is an input of the run */
+
+        /* atomic, what a run found */
+        uint64_t checked;
+        uint64_t failed;
+        uint64_t added; /* hashed, but not in the manifest */
+};
+
+/*
+ * 0, or -1 with the reason on err: path can not be read, a line is
+ * malformed, or there is not a single digest in it
+ */
+int manifest_load(struct manifest *m, const char *path, FILE *err);
+void manifest_free(struct manifest *m);
+
+struct manifest_entry *manifest_find(const struct manifest *m,
+                                     const char *path, const char *range);
+
+#endif /* MANIFEST_H */
@@ -0,0 +1,245 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+/*
+ * Copyright (C) Fadhil Riyanto <me@fadev.org>
+ */
+
+#include "map_lru.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+static uint64_t __map_lru_hash(const char *path) {
+        uint64_t h = 0xcbf29ce484222325ULL;
+
+        for (; *path; path++) {
+                h = (h ^ (uint8_t)*path) * 0x100000001b3ULL;
+        }
+
+        return h;
+}
+
+static int __map_lru_same_file(const struct stat *a, const struct stat *b) {
+        return a->st_dev == b->st_dev && a->st_ino == b->st_ino &&
+               a->st_size == b->st_size &&
+               a->st_mtim.tv_sec == b->st_mtim.tv_sec &&
+               a->st_mtim.tv_nsec == b->st_mtim.tv_nsec;
+}
+
+int map_lru_init(struct map_lru *lru, uint64_t cap) {
+        memset(lru, 0, sizeof(struct map_lru));
+        pthread_mutex_init(&lru->lock, NULL);
+
+        lru->cap = cap ? cap : 1;
+        lru->nbuckets = 16;
+        while (lru->nbuckets < lru->cap * 2)
+                lru->nbuckets = lru->nbuckets * 2;
+
+        lru->buckets = (struct map_lru_entry **)calloc(
+            lru->nbuckets, sizeof(struct map_lru_entry *));
+        return lru->buckets ? 0 : -1;
+}
+
+static void __map_lru_free(struct map_lru_entry *e) {
+        ehd_sym_index_free(e->symidx);
+        ehd_close(e->elf);
+        if (e->data)
+                munmap((void *)e->data, e->size);
+
+        pthread_mutex_destroy(&e->symidx_lock);
+        free(e->path);
+        free(e);
+}
+
+/* opened outside of the lru lock, a cold file does not stall hits */
+static struct map_lru_entry *__map_lru_load(const char *path) {
+        struct map_lru_entry *e =
+            (struct map_lru_entry *)calloc(1, sizeof(struct map_lru_entry));
+
+        int fd = open(path, O_RDONLY);
+        if (fd < 0 || fstat(fd, &e->st) < 0 || S_ISDIR(e->st.st_mode)) {
+                int saved = S_ISDIR(e->st.st_mode) ? EISDIR : errno;
+
+                if (fd >= 0)
+                        close(fd);
+                free(e);
+                errno = saved;
+                return NULL;
+        }
+
+        e->path = strdup(path);
+        e->size = e->st.st_size;
+        pthread_mutex_init(&e->symidx_lock, NULL);
+
+        if (e->size > 0) {
+                void *map = mmap(NULL, e->size, PROT_READ, MAP_PRIVATE, fd, 0);
+                if (map == MAP_FAILED) {
+                        int saved = errno;
+
+                        close(fd);
+                        e->size = 0;
+                        __map_lru_free(e);
+                        errno = saved;
+                        return NULL;
+                }
+                e->data = (const uint8_t *)map;
+        }
+
+        close(fd);
+
+        if (e->data)
+                ehd_open_mem(e->data, e->size, NULL, &e->elf);
+
+        return e;
+}
+
+static void __map_lru_unlink(struct map_lru *lru, struct map_lru_entry *e) {
+        if (e->prev)
+                e->prev->next = e->next;
+        else
+                lru->head = e->next;
+
+        if (e->next)
+                e->next->prev = e->prev;
+        else
+                lru->tail = e->prev;
+
+        e->prev = NULL;
+        e->next = NULL;
+}
+
+static void __map_lru_push_front(struct map_lru *lru,
+                                 struct map_lru_entry *e) {
+        e->prev = NULL;
+        e->next = lru->head;
+        if (lru->head)
+                lru->head->prev = e;
+        lru->head = e;
+        if (lru->tail == NULL)
+                lru->tail = e;
+}
+
+/* caller holds lru->lock, the entry is freed once its last user is done */
+static void __map_lru_evict(struct map_lru *lru, struct map_lru_entry *e) {
+        uint64_t b = __map_lru_hash(e->path) & (lru->nbuckets - 1);
+        struct map_lru_entry **pp = &lru->buckets[b];
+
+        while (*pp && *pp != e)
+                pp = &(*pp)->hnext;
+        if (*pp)
+                *pp = e->hnext;
+
+        __map_lru_unlink(lru, e);
+        lru->n = lru->n - 1;
+        e->evicted = 1;
+
+        if (e->refs == 0)
+                __map_lru_free(e);
+}
+
+static struct map_lru_entry *__map_lru_find(struct map_lru *lru,
+                                            const char *path, uint64_t b) {
+        for (struct map_lru_entry *e = lru->buckets[b]; e; e = e->hnext) {
+                if (strcmp(e->path, path) == 0)
+                        return e;
+        }
+
+        return NULL;
+}
+
+/*
+ * returns a referenced entry, release it with map_lru_put(), NULL with
+ * errno set when the file can not be opened
+ */
+struct map_lru_entry *map_lru_get(struct map_lru *lru, const char *path) {
+        uint64_t b = __map_lru_hash(path) & (lru->nbuckets - 1);
+        struct stat st;
+
+        if (stat(path, &st) < 0) {
+                return NULL;
+        }
+
+        pthread_mutex_lock(&lru->lock);
+        struct map_lru_entry *e = __map_lru_find(lru, path, b);
+
+        if (e && __map_lru_same_file(&e->st, &st)) {
+                __map_lru_unlink(lru, e);
+                __map_lru_push_front(lru, e);
+                e->refs = e->refs + 1;
+                lru->hits = lru->hits + 1;
+                pthread_mutex_unlock(&lru->lock);
+                return e;
+        }
+
+        /* changed on disk */
+        if (e)
+                __map_lru_evict(lru, e);
+
+        lru->misses = lru->misses + 1;
+        pthread_mutex_unlock(&lru->lock);
+
+        struct map_lru_entry *fresh = __map_lru_load(path);
+        if (fresh == NULL) {
+                return NULL;
+        }
+
+        pthread_mutex_lock(&lru->lock);
+
+        /* someone else loaded it meanwhile, keep theirs */
+        e = __map_lru_find(lru, path, b);
+        if (e && __map_lru_same_file(&e->st, &fresh->st)) {
+                __map_lru_free(fresh);
+                __map_lru_unlink(lru, e);
+                __map_lru_push_front(lru, e);
+                e->refs = e->refs + 1;
+                pthread_mutex_unlock(&lru->lock);
+                return e;
+        }
+
+        if (e)
+                __map_lru_evict(lru, e);
+
+        while (lru->n >= lru->cap && lru->tail)
+                __map_lru_evict(lru, lru->tail);
+
+        fresh->hnext = lru->buckets[b];
+        lru->buckets[b] = fresh;
+        __map_lru_push_front(lru, fresh);
+        lru->n = lru->n + 1;
+        fresh->refs = 1;
+
+        pthread_mutex_unlock(&lru->lock);
+        return fresh;
+}
+
+void map_lru_put(struct map_lru *lru, struct map_lru_entry *entry) {
+        pthread_mutex_lock(&lru->lock);
+        entry->refs = entry->refs - 1;
+        if (entry->refs == 0 && entry->evicted)
+                __map_lru_free(entry);
+        pthread_mutex_unlock(&lru->lock);
+}
+
+/* NULL when the entry is not an ELF file */
+struct ehd_sym_index *map_lru_symidx(struct map_lru_entry *entry) {
+        if (entry->elf == NULL) {
+                return NULL;
+        }
+
+        pthread_mutex_lock(&entry->symidx_lock);
+        if (entry->symidx == NULL)
+                ehd_sym_index_build(entry->elf, NULL, &entry->symidx);
+        pthread_mutex_unlock(&entry->symidx_lock);
+
+        return entry->symidx;
+}
+
+void map_lru_destroy(struct map_lru *lru) {
+        while (lru->tail)
+                __map_lru_evict(lru, lru->tail);
+
+        free(lru->buckets);
+        pthread_mutex_destroy(&lru->lock);
+}
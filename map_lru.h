@@ -0,0 +1,55 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+/*
+ * Copyright (C) Fadhil Riyanto <me@fadev.org>
+ * LRU of mapped and indexed files for --serve, an entry is reused while
+ * the file keeps its (dev, inode, size, mtime)
+ */
+
+#ifndef MAP_LRU_H
+#define MAP_LRU_H
+
+#include "libelfhexdump.h"
+#include <pthread.h>
+#include <stdint.h>
+#include <sys/stat.h>
+
+struct map_lru_entry {
+        char *path;
+        struct stat st;
+
+        const uint8_t *data; /* NULL for an empty file */
+        uint64_t size;
+        struct ehd_file *elf; /* NULL when not ELF32/ELF64 */
+
+        /* built on the first --addr2sym */
+        pthread_mutex_t symidx_lock;
+        struct ehd_sym_index *symidx;
+
+        uint64_t refs;
+        int evicted;
+
+        struct map_lru_entry *prev; /* LRU list, head is most recent */
+        struct map_lru_entry *next;
+        struct map_lru_entry *hnext; /* hash chain */
+};
+
+struct map_lru {
+        pthread_mutex_t lock;
+        struct map_lru_entry **buckets;
+        uint64_t nbuckets; /* power of two */
+        struct map_lru_entry *head;
+        struct map_lru_entry *tail;
+        uint64_t n;
+        uint64_t cap;
+
+        uint64_t hits;
+        uint64_t misses;
+};
+
+int map_lru_init(struct map_lru *lru, uint64_t cap);
+struct map_lru_entry *map_lru_get(struct map_lru *lru, const char *path);
+void map_lru_put(struct map_lru *lru, struct map_lru_entry *entry);
+struct ehd_sym_index *map_lru_symidx(struct map_lru_entry *entry);
+void map_lru_destroy(struct map_lru *lru);
+
+#endif /* MAP_LRU_H */
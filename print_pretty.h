@@ -1,89 +1,196 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+/*
+ * Copyright (C) Fadhil Riyanto <me@fadev.org>
+ * table renderer, every cell is formatted once straight into a row
+ * buffer and padded with memset, the buffer goes out with one fwrite()
+ * when full or when the table is flushed
+ *
+ *   struct pretty_table t;
+ *
+ *   pretty_table_init(&t, out, cols, ncols);
+ *   pretty_table_fit(&t, 1, strlen(name));      (optional, auto-fit)
+ *   pretty_table_header(&t);
+ *   pretty_cell_u64(&t, 1);
+ *   pretty_cell_str(&t, name);
+ *   pretty_row_end(&t);
+ *   pretty_table_flush(&t);
+ */
+
 #ifndef PRINT_PRETTY_H
 #define PRINT_PRETTY_H
 
+#include <stdint.h>
 #include <stdio.h>
-#ifndef PRINT_PRETTY_FILL_PAD
-#define PRINT_PRETTY_FILL_PAD(pad_space, len)                                  \
-        do {                                                                   \
-                if (((long)pad_space - (long)len) < 0) {                       \
-                        /* warn, text overflow */                              \
-                } else {                                                       \
-                        for (int i = 0; i < pad_space - len; i++) {            \
-                                printf(" ");                                   \
-                        }                                                      \
-                }                                                              \
-        } while (0)
-#endif /* PRINT_PRETTY_FILL_PAD */
-
-#ifdef USE_PRETTY_PRINT_PAD_COUNT
-int __init_print_pad_count = 0;
-
-#ifndef PRINT_PRETTYF_PAD_COUNT
-#define PRINT_PRETTYF_PAD_COUNT(f, chr, len, pad_space)                        \
-        do {                                                                   \
-                printf(f, chr);                                                \
-                PRINT_PRETTY_FILL_PAD(pad_space, len);                         \
-                __init_print_pad_count = __init_print_pad_count + pad_space;   \
-        } while (0)
-#endif /* PRINT_PRETTYF_PAD_COUNT */
-
-#ifndef PRINT_PRETTY_PAD_COUNT
-#define PRINT_PRETTY_PAD_COUNT(chr, len, pad_space)                            \
-        do {                                                                   \
-                printf("%s", chr);                                             \
-                PRINT_PRETTY_FILL_PAD(pad_space, len);                         \
-                __init_print_pad_count = __init_print_pad_count + pad_space;   \
-        } while (0)
-#endif /* PRINT_PRETTY_PAD_COUNT */
-
-#define PRETTY_PRINT_PAD_COUNT_RESET()                                         \
-        do {                                                                   \
-                __init_print_pad_count = 0;                                    \
-        } while (0)
-
-#endif /* USE_PRETTY_PRINT_PAD_COUNT */
-
-#ifndef PRINT_PRETTY
-#define PRINT_PRETTY(chr, len, pad_space)                                      \
-        do {                                                                   \
-                printf("%s", chr);                                             \
-                PRINT_PRETTY_FILL_PAD(pad_space, len);                         \
-        } while (0)
-#endif /* PRINT_PRETTY */
-
-#ifndef PRINT_PRETTYF
-#define PRINT_PRETTYF(f, chr, len, pad_space)                                  \
-        do {                                                                   \
-                printf(f, chr);                                                \
-                PRINT_PRETTY_FILL_PAD(pad_space, len);                         \
-        } while (0)
-#endif /* PRINT_PRETTYF */
-
-#ifndef PRINT_PRETTYF_NUM
-#define PRINT_PRETTYF_NUM(f, chr, pad_space)                                   \
-        do {                                                                   \
-                printf(f, chr);                                                \
-                                                                               \
-                /* Predict usage of char space */                              \
-                char buf[64];                                                  \
-                snprintf(buf, 64, f, chr);                                     \
-                PRINT_PRETTY_FILL_PAD(pad_space, strlen(buf));                 \
-        } while (0)
-#endif /* PRINT_PRETTYF_NUM */
-
-#ifndef PRINT_PRETTYF_NO_OVERFLOW
-#define PRINT_PRETTYF_NO_OVERFLOW(f, chr, pad_space)                           \
-        do {                                                                   \
-                if (((long)pad_space - (long)strlen(chr)) < 0) {               \
-                        for (int i = 0; i < pad_space - 2; i++) {              \
-                                printf("%c", chr[i]);                          \
-                        }                                                      \
-                                                                               \
-                        printf("  ");                                          \
-                } else {                                                       \
-                        PRINT_PRETTYF_NUM(f, chr, pad_space);                  \
-                }                                                              \
-        } while (0)
-#endif /* PRINT_PRETTYF_NO_OVERFLOW */
-
-#endif /* PRINT_PRETTY_H*/
\ No newline at end of file
+#include <string.h>
+
+#define PRETTY_BUF_SIZE (16 * 1024)
+#define PRETTY_MAX_COLUMNS 16
+
+/* room left after the text when a column is widened to fit it */
+#define PRETTY_GAP 2
+#define PRETTY_MAX_WIDTH (PRETTY_BUF_SIZE / 4)
+
+/* column flags */
+#define PRETTY_TRUNCATE 0x1 /* cut to width - PRETTY_GAP, never overflow */
+#define PRETTY_NOPAD 0x2    /* last column, row cells are not padded */
+
+struct pretty_col {
+        const char *title;
+        uint16_t width; /* cell width, gap included */
+        uint8_t flags;
+};
+
+struct pretty_table {
+        FILE *out;
+        const struct pretty_col *cols;
+        uint16_t ncols;
+        uint16_t cell; /* next cell of the current row */
+        uint16_t width[PRETTY_MAX_COLUMNS];
+        uint32_t len;
+        char buf[PRETTY_BUF_SIZE];
+};
+
+static inline void pretty_table_init(struct pretty_table *t, FILE *out,
+                                     const struct pretty_col *cols,
+                                     uint16_t ncols) {
+        t->out = out;
+        t->cols = cols;
+        t->ncols = ncols < PRETTY_MAX_COLUMNS ? ncols : PRETTY_MAX_COLUMNS;
+        t->cell = 0;
+        t->len = 0;
+
+        for (uint16_t i = 0; i < t->ncols; i++) {
+                t->width[i] = cols[i].width;
+        }
+}
+
+/* widen a column so len bytes of text still leave the gap, never shrinks */
+static inline void pretty_table_fit(struct pretty_table *t, uint16_t col,
+                                    size_t len) {
+        if (len + PRETTY_GAP > PRETTY_MAX_WIDTH)
+                len = PRETTY_MAX_WIDTH - PRETTY_GAP;
+
+        if (col < t->ncols && len + PRETTY_GAP > t->width[col])
+                t->width[col] = len + PRETTY_GAP;
+}
+
+static inline void pretty_table_flush(struct pretty_table *t) {
+        if (t->len > 0) {
+                fwrite(t->buf, 1, t->len, t->out);
+                t->len = 0;
+        }
+}
+
+/* room for n more bytes, NULL when n alone is more than the buffer */
+static inline char *__pretty_reserve(struct pretty_table *t, size_t n) {
+        if (t->len + n > PRETTY_BUF_SIZE)
+                pretty_table_flush(t);
+
+        return n > PRETTY_BUF_SIZE ? NULL : t->buf + t->len;
+}
+
+static inline void __pretty_fill(struct pretty_table *t, char c, size_t n) {
+        while (n > 0) {
+                size_t chunk = n < PRETTY_BUF_SIZE ? n : PRETTY_BUF_SIZE;
+
+                memset(__pretty_reserve(t, chunk), c, chunk);
+                t->len = t->len + chunk;
+                n = n - chunk;
+        }
+}
+
+/* len bytes of s padded with spaces up to width, width >= len */
+static inline void __pretty_put(struct pretty_table *t, const char *s,
+                                size_t len, size_t width) {
+        char *p = __pretty_reserve(t, width);
+
+        if (p == NULL) {
+                fwrite(s, 1, len, t->out);
+                return;
+        }
+
+        memcpy(p, s, len);
+        memset(p + len, ' ', width - len);
+        t->len = t->len + width;
+}
+
+/*
+ * text that does not fit runs into the next cell unpadded, like the
+ * old PRINT_PRETTY macros did, unless the column truncates
+ */
+static inline void pretty_cell(struct pretty_table *t, const char *s,
+                               size_t len) {
+        uint16_t col = t->cell < t->ncols ? t->cell : t->ncols - 1;
+        size_t width = t->width[col];
+        uint8_t flags = t->cols[col].flags;
+
+        t->cell = t->cell + 1;
+
+        if ((flags & PRETTY_TRUNCATE) && len >= width && width > PRETTY_GAP)
+                len = width - PRETTY_GAP;
+        if ((flags & PRETTY_NOPAD) || len >= width)
+                width = len;
+
+        __pretty_put(t, s, len, width);
+}
+
+static inline void pretty_cell_str(struct pretty_table *t, const char *s) {
+        pretty_cell(t, s, strlen(s));
+}
+
+static inline void pretty_cell_u64(struct pretty_table *t, uint64_t v) {
+        char tmp[20];
+        char *p = tmp + sizeof(tmp);
+
+        do {
+                *--p = '0' + v % 10;
+                v = v / 10;
+        } while (v);
+
+        pretty_cell(t, p, tmp + sizeof(tmp) - p);
+}
+
+/* "0x" and at least digits hex digits, zero filled */
+static inline void pretty_cell_hex(struct pretty_table *t, uint64_t v,
+                                   int digits) {
+        static const char hex[] = "0123456789abcdef";
+        char tmp[18];
+        char *p = tmp + sizeof(tmp);
+
+        do {
+                *--p = hex[v & 0xf];
+                v = v >> 4;
+                digits = digits - 1;
+        } while (v || digits > 0);
+
+        *--p = 'x';
+        *--p = '0';
+
+        pretty_cell(t, p, tmp + sizeof(tmp) - p);
+}
+
+static inline void pretty_row_end(struct pretty_table *t) {
+        *__pretty_reserve(t, 1) = '\n';
+        t->len = t->len + 1;
+        t->cell = 0;
+}
+
+/* titles padded to the column widths, then a line of dashes as wide */
+static inline void pretty_table_header(struct pretty_table *t) {
+        size_t total = 0;
+
+        for (uint16_t i = 0; i < t->ncols; i++) {
+                const char *title = t->cols[i].title;
+                size_t len = strlen(title);
+
+                __pretty_put(t, title, len,
+                             len < t->width[i] ? t->width[i] : len);
+                total = total + t->width[i];
+        }
+
+        pretty_row_end(t);
+        __pretty_fill(t, '-', total);
+        pretty_row_end(t);
+}
+
+#endif /* PRINT_PRETTY_H */
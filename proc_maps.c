@@ -0,0 +1,156 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+/*
+ * Copyright (C) Fadhil Riyanto <me@fadev.org>
+ */
+
+#define _GNU_SOURCE /* process_vm_readv() */
+#include "proc_maps.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+static struct proc_map *__proc_maps_add(struct proc_maps *m) {
+        if (m->n == m->cap) {
+                uint64_t cap = m->cap ? m->cap * 2 : 64;
+                struct proc_map *maps = (struct proc_map *)realloc(
+                    m->maps, cap * sizeof(struct proc_map));
+                if (maps == NULL)
+                        return NULL;
+
+                m->maps = maps;
+                m->cap = cap;
+        }
+
+        return &m->maps[m->n++];
+}
+
+/* start-end perms offset dev inode [path] */
+int proc_maps_read(pid_t pid, struct proc_maps *m) {
+        char path[64];
+        char *line = NULL;
+        size_t cap = 0;
+
+        memset(m, 0, sizeof(struct proc_maps));
+        snprintf(path, sizeof(path), "/proc/%d/maps", (int)pid);
+
+        FILE *f = fopen(path, "r");
+        if (f == NULL)
+                return -1;
+
+        while (getline(&line, &cap, f) > 0) {
+                struct proc_map map;
+                int name = 0;
+
+                memset(&map, 0, sizeof(map));
+                if (sscanf(line,
+                           "%" SCNx64 "-%" SCNx64 " %4s %" SCNx64
+                           " %*x:%*x %" SCNu64 " %n",
+                           &map.start, &map.end, map.perms, &map.offset,
+                           &map.inode, &name) < 5)
+                        continue;
+
+                line[strcspn(line, "\n")] = 0;
+                if (name > 0 && line[name])
+                        map.path = strdup(line + name);
+
+                struct proc_map *slot = __proc_maps_add(m);
+                if (slot == NULL) {
+                        free(map.path);
+                        break;
+                }
+                *slot = map;
+        }
+
+        free(line);
+        fclose(f);
+        return 0;
+}
+
+void proc_maps_free(struct proc_maps *m) {
+        for (uint64_t i = 0; i < m->n; i++) {
+                free(m->maps[i].path);
+        }
+
+        free(m->maps);
+        memset(m, 0, sizeof(struct proc_maps));
+}
+
+void proc_mem_init(struct proc_mem *pm, pid_t pid) {
+        memset(pm, 0, sizeof(struct proc_mem));
+        pm->pid = pid;
+        pm->mem_fd = -1;
+}
+
+void proc_mem_close(struct proc_mem *pm) {
+        if (pm->mem_fd >= 0)
+                close(pm->mem_fd);
+
+        pm->mem_fd = -1;
+}
+
+static ssize_t __proc_mem_pread(struct proc_mem *pm,
+                                const struct iovec *remote, int n,
+                                uint8_t *buf) {
+        ssize_t total = 0;
+
+        if (pm->mem_fd < 0) {
+                char path[64];
+
+                snprintf(path, sizeof(path), "/proc/%d/mem", (int)pm->pid);
+                pm->mem_fd = open(path, O_RDONLY | O_CLOEXEC);
+                if (pm->mem_fd < 0)
+                        return -1;
+        }
+
+        for (int i = 0; i < n; i++) {
+                size_t done = 0;
+
+                while (done < remote[i].iov_len) {
+                        ssize_t ret = pread(
+                            pm->mem_fd, buf + total, remote[i].iov_len - done,
+                            (off_t)(uintptr_t)remote[i].iov_base + done);
+                        pm->mem_reads = pm->mem_reads + 1;
+                        if (ret <= 0)
+                                return total;
+
+                        done = done + ret;
+                        total = total + ret;
+                }
+        }
+
+        return total;
+}
+
+ssize_t proc_mem_readv(struct proc_mem *pm, const struct iovec *remote,
+                       int n, void *buf) {
+        size_t total = 0;
+
+        for (int i = 0; i < n; i++) {
+                total = total + remote[i].iov_len;
+        }
+
+        if (!pm->use_mem) {
+                struct iovec local = { buf, total };
+                ssize_t ret = process_vm_readv(pm->pid, &local, 1, remote, n,
+                                               0);
+
+                pm->readv_calls = pm->readv_calls + 1;
+                if (ret >= 0)
+                        return ret;
+
+                /* nothing readable at the first remote address */
+                if (errno == EFAULT || errno == EIO)
+                        return 0;
+
+                if (errno != ENOSYS && errno != EPERM)
+                        return -1;
+
+                pm->use_mem = 1;
+        }
+
+        return __proc_mem_pread(pm, remote, n, (uint8_t *)buf);
+}
@@ -0,0 +1,58 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+/*
+ * Copyright (C) Fadhil Riyanto <me@fadev.org>
+ * --pid, /proc/PID/maps and reads of another process's memory
+ *
+ * reads go through process_vm_readv, many ranges per call. when the
+ * syscall is missing or refused they fall back to pread on
+ * /proc/PID/mem, which is allowed under the same ptrace rules
+ */
+
+#ifndef PROC_MAPS_H
+#define PROC_MAPS_H
+
+#include <stdint.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+
+#define PROC_MEM_MAX_IOV 64
+
+struct proc_map {
+        uint64_t start;
+        uint64_t end;
+        uint64_t offset; /* file offset of start */
+        uint64_t inode;  /* 0 for anonymous memory */
+        char perms[5];   /* "r-xp" */
+        char *path;      /* NULL when the line has none */
+};
+
+struct proc_maps {
+        struct proc_map *maps; /* sorted by address, as the kernel lists */
+        uint64_t n;
+        uint64_t cap;
+};
+
+struct proc_mem {
+        pid_t pid;
+        int mem_fd; /* /proc/PID/mem, -1 until the first fallback */
+        int use_mem;
+
+        uint64_t readv_calls;
+        uint64_t mem_reads;
+};
+
+int proc_maps_read(pid_t pid, struct proc_maps *m);
+void proc_maps_free(struct proc_maps *m);
+
+void proc_mem_init(struct proc_mem *pm, pid_t pid);
+void proc_mem_close(struct proc_mem *pm);
+
+/*
+ * reads the n remote ranges back to back into buf, stops at the first
+ * byte that can not be read, returns how many bytes were read or -1
+ * when the process can not be read at all
+ */
+ssize_t proc_mem_readv(struct proc_mem *pm, const struct iovec *remote,
+                       int n, void *buf);
+
+#endif /* PROC_MAPS_H */
@@ -0,0 +1,203 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+/*
+ * Copyright (C) Fadhil Riyanto <me@fadev.org>
+ */
+
+#include "rules.h"
+#include <stdlib.h>
+#include <string.h>
+
+struct rules_ctx {
+        const struct rule_set *rs;
+        const struct rule_range *ranges;
+        const uint8_t *data;
+        uint64_t size;
+        uint64_t start;
+        uint64_t end;
+        struct search_hits *hits;
+};
+
+static struct rule *__rules_add(struct rule_set *rs) {
+        if (rs->n == rs->cap) {
+                uint32_t cap = rs->cap ? rs->cap * 2 : 64;
+                struct rule *rules = (struct rule *)realloc(
+                    rs->rules, cap * sizeof(struct rule));
+                if (rules == NULL)
+                        return NULL;
+
+                rs->rules = rules;
+                rs->cap = cap;
+        }
+
+        memset(&rs->rules[rs->n], 0, sizeof(struct rule));
+        return &rs->rules[rs->n++];
+}
+
+/* longest run of fully fixed bytes, 0 when there is none */
+static uint32_t __rules_key(struct rule *r) {
+        const struct search_pattern *p = &r->pattern;
+        uint32_t run = 0;
+
+        for (uint32_t i = 0; i < p->len; i++) {
+                run = p->mask[i] == 0xff ? run + 1 : 0;
+
+                if (run > r->key_len) {
+                        r->key_len = run;
+                        r->key_off = i + 1 - run;
+                }
+        }
+
+        return r->key_len;
+}
+
+static int __rules_space(char c) {
+        return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+/*
+ * NAME PATTERN [@SECTION] in line, cut in place: the pattern runs to
+ * the end of the line or to a last field starting with '@'
+ */
+static int __rules_split(char *line, char **name, char **text,
+                         char **section) {
+        char *p = line;
+        char *end;
+
+        *section = NULL;
+        while (__rules_space(*p))
+                p++;
+        *name = p;
+        while (*p && !__rules_space(*p))
+                p++;
+        if (*p)
+                *p++ = 0;
+        while (__rules_space(*p))
+                p++;
+        *text = p;
+
+        end = p + strlen(p);
+        while (end > p && __rules_space(end[-1]))
+                *--end = 0;
+
+        char *last = end;
+        while (last > p && !__rules_space(last[-1]))
+                last--;
+        if (last > p && *last == '@') {
+                *section = last + 1;
+                end = last;
+                while (end > p && __rules_space(end[-1]))
+                        *--end = 0;
+        }
+
+        return **text && (*section == NULL || **section) ? 0 : -1;
+}
+
+int rules_load(struct rule_set *rs, const char *path, FILE *err) {
+        char *line = NULL;
+        size_t cap = 0;
+        uint32_t lineno = 0;
+        int ret = 0;
+
+        memset(rs, 0, sizeof(struct rule_set));
+        if (ac_init(&rs->ac) < 0)
+                return -1;
+
+        FILE *f = fopen(path, "r");
+        if (f == NULL) {
+                fprintf(err, "%s: cannot open\n", path);
+                ac_free(&rs->ac);
+                return -1;
+        }
+
+        while (ret == 0 && getline(&line, &cap, f) > 0) {
+                char *name, *text, *section;
+
+                lineno++;
+                int bad = __rules_split(line, &name, &text, &section);
+                if (name[0] == 0 || name[0] == '#')
+                        continue;
+
+                struct rule *r = bad ? NULL : __rules_add(rs);
+                if (r == NULL) {
+                        fprintf(err, "%s:%u: want NAME PATTERN [@SECTION]\n",
+                                path, lineno);
+                        ret = -1;
+                        break;
+                }
+
+                r->name = strdup(name);
+                r->text = strdup(text);
+                r->section = section ? strdup(section) : NULL;
+
+                if (search_compile(r->text, &r->pattern) < 0) {
+                        fprintf(err, "%s:%u: bad pattern %s\n", path, lineno,
+                                text);
+                        ret = -1;
+                } else if (__rules_key(r) == 0) {
+                        fprintf(err, "%s:%u: %s has no fully fixed byte\n",
+                                path, lineno, name);
+                        ret = -1;
+                } else if (ac_add(&rs->ac, r->pattern.value + r->key_off,
+                                  r->key_len, rs->n - 1) < 0) {
+                        ret = -1;
+                }
+
+                if (r->pattern.len > rs->max_len)
+                        rs->max_len = r->pattern.len;
+        }
+
+        free(line);
+        fclose(f);
+
+        if (ret == 0)
+                ret = ac_compile(&rs->ac);
+
+        if (ret < 0)
+                rules_free(rs);
+        return ret;
+}
+
+void rules_free(struct rule_set *rs) {
+        for (uint32_t i = 0; i < rs->n; i++) {
+                free(rs->rules[i].name);
+                free(rs->rules[i].text);
+                free(rs->rules[i].section);
+        }
+
+        free(rs->rules);
+        ac_free(&rs->ac);
+        memset(rs, 0, sizeof(struct rule_set));
+}
+
+/* key of rule id ends at key_end, the rule starts key_off + key_len before */
+static void __rules_hit(void *arg, uint32_t id, uint64_t key_end) {
+        struct rules_ctx *ctx = (struct rules_ctx *)arg;
+        const struct rule *r = &ctx->rs->rules[id];
+        uint64_t back = r->key_off + r->key_len;
+
+        if (key_end < back)
+                return;
+
+        uint64_t at = key_end - back;
+        if (at < ctx->start || at >= ctx->end ||
+            r->pattern.len > ctx->size - at)
+                return;
+
+        if (ctx->ranges && (at < ctx->ranges[id].start ||
+                            at + r->pattern.len > ctx->ranges[id].end))
+                return;
+
+        if (r->pattern.exact || search_match(&r->pattern, ctx->data + at))
+                search_hits_add(ctx->hits, at, id);
+}
+
+void rules_scan(const struct rule_set *rs, const struct rule_range *ranges,
+                const uint8_t *data, uint64_t size, uint64_t start,
+                uint64_t end, struct search_hits *hits) {
+        struct rules_ctx ctx = { rs, ranges, data, size, start, end, hits };
+
+        /* a rule starting before end may finish up to max_len later */
+        uint64_t stop = end + rs->max_len < size ? end + rs->max_len : size;
+
+        ac_scan(&rs->ac, data, start, stop, __rules_hit, &ctx);
+}
@@ -0,0 +1,61 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+/*
+ * Copyright (C) Fadhil Riyanto <me@fadev.org>
+ * --rules FILE, byte signatures scanned in one pass, one rule a line:
+ *
+ *   # name       pattern (as --search)    [@section]
+ *   upx_magic    str:UPX!
+ *   elf_in_data  7f 45 4c 46              @.rodata
+ *   xor_eax      31 c0 ?? c3              @.text
+ *
+ * the pattern is the rest of the line, spaces included, up to a last
+ * field starting with '@'
+ *
+ * the longest run of fully fixed bytes of every rule is a key of one
+ * Aho-Corasick automaton, a key hit is checked against the whole
+ * pattern (wildcards included) and the rule's section range
+ */
+
+#ifndef RULES_H
+#define RULES_H
+
+#include "aho_corasick.h"
+#include "search.h"
+#include <stdio.h>
+
+struct rule {
+        char *name;
+        char *section; /* NULL matches anywhere */
+        char *text;    /* pattern as written, pattern.text points here */
+        struct search_pattern pattern;
+        uint32_t key_off; /* automaton key, pattern bytes [off, off+len) */
+        uint32_t key_len;
+};
+
+struct rule_set {
+        struct rule *rules;
+        uint32_t n;
+        uint32_t cap;
+        uint32_t max_len; /* longest pattern */
+        struct ac ac;
+};
+
+/* file range a rule may match in, end 0 when its section is missing */
+struct rule_range {
+        uint64_t start;
+        uint64_t end;
+};
+
+/* 0, or -1 with the reason on err */
+int rules_load(struct rule_set *rs, const char *path, FILE *err);
+void rules_free(struct rule_set *rs);
+
+/*
+ * rules matching at a start offset in [start, end) of data[0, size),
+ * inside ranges[rule], appended to hits (pattern is the rule index)
+ */
+void rules_scan(const struct rule_set *rs, const struct rule_range *ranges,
+                const uint8_t *data, uint64_t size, uint64_t start,
+                uint64_t end, struct search_hits *hits);
+
+#endif /* RULES_H */
@@ -0,0 +1,207 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+/*
+ * Copyright (C) Fadhil Riyanto <me@fadev.org>
+ */
+
+#include "search.h"
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+static int __search_nibble(char c) {
+        if (c >= '0' && c <= '9')
+                return c - '0';
+        if (c >= 'a' && c <= 'f')
+                return c - 'a' + 10;
+        if (c >= 'A' && c <= 'F')
+                return c - 'A' + 10;
+        return -1;
+}
+
+static int __search_compile_hex(const char *s, struct search_pattern *p) {
+        uint32_t nibbles = 0;
+
+        for (; *s; s++) {
+                uint8_t value = 0;
+                uint8_t mask = 0;
+
+                if (*s == ' ' || *s == '\t')
+                        continue;
+
+                if (*s != '?') {
+                        int v = __search_nibble(*s);
+                        if (v < 0)
+                                return -1;
+
+                        value = v;
+                        mask = 0xf;
+                }
+
+                if (nibbles / 2 >= SEARCH_MAX_PATTERN)
+                        return -1;
+
+                uint32_t i = nibbles / 2;
+                if (nibbles % 2 == 0) {
+                        p->value[i] = value << 4;
+                        p->mask[i] = mask << 4;
+                } else {
+                        p->value[i] |= value;
+                        p->mask[i] |= mask;
+                }
+                nibbles++;
+        }
+
+        if (nibbles == 0 || nibbles % 2)
+                return -1;
+
+        p->len = nibbles / 2;
+        return 0;
+}
+
+int search_compile(const char *text, struct search_pattern *p) {
+        memset(p, 0, sizeof(struct search_pattern));
+        p->text = text;
+
+        if (strncmp(text, "str:", 4) == 0) {
+                size_t len = strlen(text + 4);
+
+                if (len == 0 || len > SEARCH_MAX_PATTERN)
+                        return -1;
+
+                memcpy(p->value, text + 4, len);
+                memset(p->mask, 0xff, len);
+                p->len = len;
+        } else {
+                if (strncmp(text, "hex:", 4) == 0)
+                        text = text + 4;
+
+                if (__search_compile_hex(text, p) < 0)
+                        return -1;
+        }
+
+        p->exact = 1;
+        for (uint32_t i = 0; i < p->len; i++) {
+                if (p->mask[i] != 0xff) {
+                        p->exact = 0;
+                        continue;
+                }
+
+                if (!p->anchored)
+                        p->first = i;
+                p->last = i;
+                p->anchored = 1;
+        }
+
+        return 0;
+}
+
+void search_hits_add(struct search_hits *hits, uint64_t offset, uint32_t id) {
+        if (hits->n == hits->cap) {
+                uint64_t cap = hits->cap ? hits->cap * 2 : 64;
+                struct search_hit *h = (struct search_hit *)realloc(
+                    hits->hits, cap * sizeof(struct search_hit));
+                if (h == NULL)
+                        return;
+
+                hits->hits = h;
+                hits->cap = cap;
+        }
+
+        hits->hits[hits->n].offset = offset;
+        hits->hits[hits->n].pattern = id;
+        hits->n++;
+}
+
+static inline int __search_match(const struct search_pattern *p,
+                                 const uint8_t *d) {
+        if (p->exact)
+                return memcmp(d, p->value, p->len) == 0;
+
+        for (uint32_t i = 0; i < p->len; i++) {
+                if ((d[i] & p->mask[i]) != p->value[i])
+                        return 0;
+        }
+
+        return 1;
+}
+
+int search_match(const struct search_pattern *p, const uint8_t *d) {
+        return __search_match(p, d);
+}
+
+void search_scan(const struct search_pattern *p, uint32_t id,
+                 const uint8_t *data, uint64_t size, uint64_t start,
+                 uint64_t end, struct search_hits *hits) {
+        if (p->len == 0 || size < p->len)
+                return;
+
+        /* last position a whole match still fits */
+        if (end > size - p->len + 1)
+                end = size - p->len + 1;
+
+        uint64_t s = start;
+
+        if (p->anchored) {
+                const uint8_t *a = data + p->first;
+                const uint8_t *b = data + p->last;
+                uint8_t va = p->value[p->first];
+                uint8_t vb = p->value[p->last];
+
+#ifdef __SSE2__
+                __m128i xa = _mm_set1_epi8((char)va);
+                __m128i xb = _mm_set1_epi8((char)vb);
+
+                for (; s + 16 <= end; s += 16) {
+                        __m128i ca = _mm_cmpeq_epi8(
+                            _mm_loadu_si128((const __m128i *)(a + s)), xa);
+                        __m128i cb = _mm_cmpeq_epi8(
+                            _mm_loadu_si128((const __m128i *)(b + s)), xb);
+                        uint32_t bits =
+                            _mm_movemask_epi8(_mm_and_si128(ca, cb));
+
+                        while (bits) {
+                                uint64_t at = s + __builtin_ctz(bits);
+
+                                if (__search_match(p, data + at))
+                                        search_hits_add(hits, at, id);
+                                bits = bits & (bits - 1);
+                        }
+                }
+#endif
+
+                for (; s < end; s++) {
+                        if (a[s] == va && b[s] == vb &&
+                            __search_match(p, data + s))
+                                search_hits_add(hits, s, id);
+                }
+                return;
+        }
+
+        for (; s < end; s++) {
+                if (__search_match(p, data + s))
+                        search_hits_add(hits, s, id);
+        }
+}
+
+static int __search_hit_cmp(const void *a, const void *b) {
+        const struct search_hit *x = (const struct search_hit *)a;
+        const struct search_hit *y = (const struct search_hit *)b;
+
+        if (x->offset != y->offset)
+                return x->offset < y->offset ? -1 : 1;
+        return x->pattern < y->pattern ? -1 : x->pattern > y->pattern;
+}
+
+void search_hits_sort(struct search_hits *hits) {
+        if (hits->n > 1)
+                qsort(hits->hits, hits->n, sizeof(struct search_hit),
+                      __search_hit_cmp);
+}
+
+void search_hits_free(struct search_hits *hits) {
+        free(hits->hits);
+        memset(hits, 0, sizeof(struct search_hits));
+}
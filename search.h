@@ -0,0 +1,66 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+/*
+ * Copyright (C) Fadhil Riyanto <me@fadev.org>
+ * --search, byte patterns with wildcard nibbles
+ *
+ *   "488b??24"  "48 8b ?? 2?"   hex, '?' is any nibble, spaces ignored
+ *   "hex:7f454c46"              same, explicit
+ *   "str:GLIBC_2."              the bytes of an ASCII string
+ *
+ * candidates come from comparing 16 positions at once against the
+ * first and the last fully fixed byte of the pattern (SSE2), only
+ * those are checked byte by byte
+ */
+
+#ifndef SEARCH_H
+#define SEARCH_H
+
+#include <stdint.h>
+
+#define SEARCH_MAX_PATTERN 256
+
+struct search_pattern {
+        const char *text; /* as given on the command line */
+        uint8_t value[SEARCH_MAX_PATTERN];
+        uint8_t mask[SEARCH_MAX_PATTERN]; /* 0xff fixed, 0 any */
+        uint32_t len;
+
+        /* anchors, first and last byte with mask 0xff */
+        uint32_t first;
+        uint32_t last;
+        int anchored; /* 0 when no byte is fully fixed */
+        int exact;    /* no wildcard at all */
+};
+
+struct search_hit {
+        uint64_t offset;
+        uint32_t pattern;
+};
+
+struct search_hits {
+        struct search_hit *hits;
+        uint64_t n;
+        uint64_t cap;
+};
+
+/* 0, or -1 when text is not a valid pattern */
+int search_compile(const char *text, struct search_pattern *p);
+
+/*
+ * matches starting in [start, end) of data[0, size), a match may run
+ * past end but never past size, offsets are relative to data
+ */
+void search_scan(const struct search_pattern *p, uint32_t id,
+                 const uint8_t *data, uint64_t size, uint64_t start,
+                 uint64_t end, struct search_hits *hits);
+
+/* p against d[0, p->len) */
+int search_match(const struct search_pattern *p, const uint8_t *d);
+
+void search_hits_add(struct search_hits *hits, uint64_t offset, uint32_t id);
+
+/* by offset, then by pattern */
+void search_hits_sort(struct search_hits *hits);
+void search_hits_free(struct search_hits *hits);
+
+#endif /* SEARCH_H */
@@ -0,0 +1,375 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+/*
+ * Copyright (C) Fadhil Riyanto <me@fadev.org>
+ */
+
+#include "simhash.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* neighbours a band member is paired with, bounds the pairs of a run */
+#define SIMHASH_WINDOW 32
+#define SIMHASH_MAX_FILES (1 << 27) /* file ids fit a band key */
+
+/* salts of the checksum and of the six triplets */
+enum { SALT_SUM, SALT_2, SALT_3, SALT_5, SALT_7, SALT_11, SALT_13, NSALTS };
+static const uint8_t salts[NSALTS] = { 0, 2, 3, 5, 7, 11, 13 };
+
+static uint8_t pearson[256];
+/* the first two Pearson steps of a salt, folded into one load */
+static uint8_t pearson1[NSALTS][256];
+static uint8_t body_diff[256][256]; /* distance of 4 coded buckets */
+static pthread_once_t simhash_once = PTHREAD_ONCE_INIT;
+
+static void __simhash_setup(void) {
+        uint32_t x = 0x2545f491;
+
+        for (int i = 0; i < 256; i++)
+                pearson[i] = i;
+
+        /* Fisher-Yates with a fixed xorshift, the table never changes */
+        for (int i = 255; i > 0; i--) {
+                x ^= x << 13;
+                x ^= x >> 17;
+                x ^= x << 5;
+
+                int j = x % (i + 1);
+                uint8_t t = pearson[i];
+
+                pearson[i] = pearson[j];
+                pearson[j] = t;
+        }
+
+        for (int s = 0; s < NSALTS; s++) {
+                for (int i = 0; i < 256; i++)
+                        pearson1[s][i] = pearson[pearson[salts[s]] ^ i];
+        }
+
+        for (int a = 0; a < 256; a++) {
+                for (int b = 0; b < 256; b++) {
+                        uint32_t d = 0;
+
+                        for (int k = 0; k < 8; k += 2) {
+                                int x1 = (a >> k) & 3;
+                                int x2 = (b >> k) & 3;
+                                int v = x1 > x2 ? x1 - x2 : x2 - x1;
+
+                                /* opposite quartiles weigh double */
+                                d += v == 3 ? 6 : v;
+                        }
+                        body_diff[a][b] = d;
+                }
+        }
+}
+
+static inline uint8_t __pearson(int salt, uint8_t i, uint8_t j, uint8_t k) {
+        uint8_t h = pearson1[salt][i];
+
+        h = pearson[h ^ j];
+        return pearson[h ^ k];
+}
+
+/* a log of the length, finer for small inputs */
+static uint8_t __simhash_lvalue(uint64_t len) {
+        double l;
+
+        if (len <= 656)
+                l = log((double)len) / log(1.5);
+        else if (len <= 3199)
+                l = log((double)len) / log(1.3) - 8.72777;
+        else
+                l = log((double)len) / log(1.1) - 62.5472;
+
+        return (uint8_t)((uint64_t)l & 0xff);
+}
+
+static int __u32_cmp(const void *a, const void *b) {
+        uint32_t x = *(const uint32_t *)a;
+        uint32_t y = *(const uint32_t *)b;
+
+        return x < y ? -1 : x > y;
+}
+
+int simhash_compute(const uint8_t *data, uint64_t size, struct simhash *h) {
+        uint32_t bucket[256] = { 0 };
+        uint32_t sorted[SIMHASH_BUCKETS];
+        uint8_t checksum = 0;
+
+        pthread_once(&simhash_once, __simhash_setup);
+        memset(h, 0, sizeof(struct simhash));
+
+        if (size < SIMHASH_MIN)
+                return -1;
+
+        /* w0 is the newest byte of the window, w4 the oldest */
+        uint8_t w1 = data[3], w2 = data[2], w3 = data[1], w4 = data[0];
+        for (uint64_t i = 4; i < size; i++) {
+                uint8_t w0 = data[i];
+
+                /* summed, not chained, so no byte waits on the last */
+                checksum += __pearson(SALT_SUM, w0, w1, w2);
+                bucket[__pearson(SALT_2, w0, w1, w2)]++;
+                bucket[__pearson(SALT_3, w0, w1, w3)]++;
+                bucket[__pearson(SALT_5, w0, w2, w3)]++;
+                bucket[__pearson(SALT_7, w0, w2, w4)]++;
+                bucket[__pearson(SALT_11, w0, w1, w4)]++;
+                bucket[__pearson(SALT_13, w0, w3, w4)]++;
+
+                w4 = w3;
+                w3 = w2;
+                w2 = w1;
+                w1 = w0;
+        }
+
+        memcpy(sorted, bucket, sizeof(sorted));
+        qsort(sorted, SIMHASH_BUCKETS, sizeof(uint32_t), __u32_cmp);
+
+        uint32_t q1 = sorted[SIMHASH_BUCKETS / 4 - 1];
+        uint32_t q2 = sorted[SIMHASH_BUCKETS / 2 - 1];
+        uint32_t q3 = sorted[SIMHASH_BUCKETS * 3 / 4 - 1];
+
+        if (q3 == 0)
+                return -1;
+
+        for (int b = 0; b < SIMHASH_BUCKETS; b++) {
+                uint8_t code = bucket[b] <= q1   ? 0
+                               : bucket[b] <= q2 ? 1
+                               : bucket[b] <= q3 ? 2
+                                                 : 3;
+
+                h->body[b / 4] |= code << (2 * (b % 4));
+        }
+
+        h->checksum = checksum;
+        h->lvalue = __simhash_lvalue(size);
+        h->q1ratio = (uint8_t)((uint64_t)q1 * 100 / q3) % 16;
+        h->q2ratio = (uint8_t)((uint64_t)q2 * 100 / q3) % 16;
+        return 0;
+}
+
+static inline uint32_t __mod_diff(uint32_t x, uint32_t y, uint32_t range) {
+        uint32_t d = x > y ? x - y : y - x;
+
+        return d < range - d ? d : range - d;
+}
+
+uint32_t simhash_distance(const struct simhash *a, const struct simhash *b) {
+        uint32_t d = 0;
+        uint32_t v;
+
+        pthread_once(&simhash_once, __simhash_setup);
+
+        v = __mod_diff(a->lvalue, b->lvalue, 256);
+        d += v <= 1 ? v : v * 12;
+
+        v = __mod_diff(a->q1ratio, b->q1ratio, 16);
+        d += v <= 1 ? v : (v - 1) * 12;
+
+        v = __mod_diff(a->q2ratio, b->q2ratio, 16);
+        d += v <= 1 ? v : (v - 1) * 12;
+
+        if (a->checksum != b->checksum)
+                d++;
+
+        for (int i = 0; i < SIMHASH_BODY; i++)
+                d += body_diff[a->body[i]][b->body[i]];
+
+        return d;
+}
+
+void simhash_hex(const struct simhash *h, char *out) {
+        static const char digits[] = "0123456789abcdef";
+        const uint8_t head[3] = { h->checksum, h->lvalue,
+                                  (uint8_t)(h->q1ratio << 4 | h->q2ratio) };
+
+        for (int i = 0; i < 3; i++) {
+                *out++ = digits[head[i] >> 4];
+                *out++ = digits[head[i] & 0xf];
+        }
+
+        for (int i = SIMHASH_BODY - 1; i >= 0; i--) {
+                *out++ = digits[h->body[i] >> 4];
+                *out++ = digits[h->body[i] & 0xf];
+        }
+        *out = 0;
+}
+
+int simhash_set_init(struct simhash_set *s) {
+        memset(s, 0, sizeof(struct simhash_set));
+        return pthread_mutex_init(&s->lock, NULL) == 0 ? 0 : -1;
+}
+
+void simhash_set_free(struct simhash_set *s) {
+        for (uint64_t i = 0; i < s->n; i++)
+                free(s->files[i].path);
+
+        free(s->files);
+        pthread_mutex_destroy(&s->lock);
+        memset(s, 0, sizeof(struct simhash_set));
+}
+
+int simhash_set_add(struct simhash_set *s, const char *path,
+                    const struct simhash *h, uint8_t present) {
+        int ret = 0;
+
+        if (present == 0)
+                return 0;
+
+        pthread_mutex_lock(&s->lock);
+        if (s->n == s->cap) {
+                uint64_t cap = s->cap ? s->cap * 2 : 256;
+                struct simhash_file *f = (struct simhash_file *)realloc(
+                    s->files, cap * sizeof(struct simhash_file));
+
+                if (f == NULL) {
+                        ret = -1;
+                        goto out;
+                }
+                s->files = f;
+                s->cap = cap;
+        }
+
+        struct simhash_file *f = &s->files[s->n];
+
+        f->path = strdup(path);
+        if (f->path == NULL) {
+                ret = -1;
+                goto out;
+        }
+
+        memcpy(f->h, h, sizeof(f->h));
+        f->present = present;
+        s->n++;
+
+out:
+        pthread_mutex_unlock(&s->lock);
+        return ret;
+}
+
+/* section, band and band bytes in the high half, file id in the low */
+static int __u64_cmp(const void *a, const void *b) {
+        uint64_t x = *(const uint64_t *)a;
+        uint64_t y = *(const uint64_t *)b;
+
+        return x < y ? -1 : x > y;
+}
+
+int simhash_candidates(const struct simhash_set *s,
+                       struct simhash_pair **pairs, uint64_t *n) {
+        const uint32_t width = SIMHASH_BODY / SIMHASH_BANDS;
+        uint64_t nkeys = 0;
+        uint64_t npairs = 0;
+        uint64_t cap = 0;
+        uint64_t *keys;
+        uint64_t *ab = NULL;
+
+        *pairs = NULL;
+        *n = 0;
+        if (s->n > SIMHASH_MAX_FILES)
+                return -1;
+
+        keys = (uint64_t *)malloc((s->n * SIMHASH_SECS * SIMHASH_BANDS + 1) *
+                                  sizeof(uint64_t));
+        if (keys == NULL)
+                return -1;
+
+        /* 2 bits section, 4 bits band, 16 bits band bytes, 27 bits file */
+        for (uint64_t f = 0; f < s->n; f++) {
+                for (uint64_t sec = 0; sec < SIMHASH_SECS; sec++) {
+                        if (!(s->files[f].present & (1 << sec)))
+                                continue;
+
+                        const uint8_t *body = s->files[f].h[sec].body;
+
+                        for (uint64_t band = 0; band < SIMHASH_BANDS; band++) {
+                                uint64_t v = body[band * width] |
+                                             body[band * width + 1] << 8;
+
+                                keys[nkeys++] = sec << 47 | band << 43 |
+                                                v << 27 | f;
+                        }
+                }
+        }
+
+        qsort(keys, nkeys, sizeof(uint64_t), __u64_cmp);
+
+        const uint64_t mask = ~(uint64_t)0 << 27;
+        for (uint64_t i = 0, j; i < nkeys; i = j) {
+                for (j = i + 1; j < nkeys && (keys[j] & mask) ==
+                                                 (keys[i] & mask);
+                     j++)
+                        ;
+
+                for (uint64_t x = i; x < j; x++) {
+                        for (uint64_t y = x + 1;
+                             y < j && y <= x + SIMHASH_WINDOW; y++) {
+                                if (npairs == cap) {
+                                        cap = cap ? cap * 2 : 4096;
+                                        uint64_t *p = (uint64_t *)realloc(
+                                            ab, cap * sizeof(uint64_t));
+                                        if (p == NULL) {
+                                                free(ab);
+                                                free(keys);
+                                                return -1;
+                                        }
+                                        ab = p;
+                                }
+
+                                ab[npairs++] =
+                                    (keys[x] & ~mask) << 32 | (keys[y] & ~mask);
+                        }
+                }
+        }
+        free(keys);
+
+        qsort(ab, npairs, sizeof(uint64_t), __u64_cmp);
+
+        struct simhash_pair *out = (struct simhash_pair *)calloc(
+            npairs + 1, sizeof(struct simhash_pair));
+        if (out == NULL) {
+                free(ab);
+                return -1;
+        }
+
+        for (uint64_t i = 0; i < npairs; i++) {
+                if (i > 0 && ab[i] == ab[i - 1])
+                        continue;
+
+                out[*n].a = ab[i] >> 32;
+                out[*n].b = (uint32_t)ab[i];
+                (*n)++;
+        }
+
+        free(ab);
+        *pairs = out;
+        return 0;
+}
+
+int simhash_score(const struct simhash_set *s, struct simhash_pair *p) {
+        const struct simhash_file *a = &s->files[p->a];
+        const struct simhash_file *b = &s->files[p->b];
+        uint32_t sum = 0;
+        uint32_t count = 0;
+
+        for (int sec = 0; sec < SIMHASH_SECS; sec++) {
+                int in_a = a->present & (1 << sec);
+                int in_b = b->present & (1 << sec);
+
+                if (in_a && in_b)
+                        p->part[sec] = simhash_distance(&a->h[sec], &b->h[sec]);
+                else if (in_a || in_b)
+                        p->part[sec] = SIMHASH_FAR;
+                else
+                        continue;
+
+                sum += p->part[sec];
+                count++;
+        }
+
+        if (count == 0)
+                return -1;
+
+        p->distance = (sum + count / 2) / count;
+        return 0;
+}
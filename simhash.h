@@ -0,0 +1,87 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+/*
+ * Copyright (C) Fadhil Riyanto <me@fadev.org>
+ * --simhash, locality sensitive digests in the style of TLSH
+ *
+ * a 5 byte window rolls over the input, six byte triplets of every
+ * window are Pearson hashed into 128 buckets, each bucket is then
+ * coded in 2 bits by the quartile of its count, so a small patch moves
+ * a few buckets and the distance of two digests stays small
+ *
+ * the Pearson table is our own permutation, digests are not
+ * interchangeable with the TLSH library
+ *
+ * near pairs of a large set are found by banding: a body is cut into
+ * SIMHASH_BANDS pieces and only inputs sharing a piece are compared
+ */
+
+#ifndef SIMHASH_H
+#define SIMHASH_H
+
+#include <pthread.h>
+#include <stdint.h>
+
+#define SIMHASH_BUCKETS 128
+#define SIMHASH_BODY (SIMHASH_BUCKETS / 4)
+#define SIMHASH_HEX (2 * (3 + SIMHASH_BODY) + 1)
+#define SIMHASH_MIN 256   /* shorter inputs get no digest */
+#define SIMHASH_BANDS 16  /* 2 byte pieces of the body */
+#define SIMHASH_SECS 3    /* .text, .rodata, .data */
+#define SIMHASH_FAR 400   /* distance of a section only one side has */
+
+struct simhash {
+        uint8_t checksum;
+        uint8_t lvalue; /* log of the length */
+        uint8_t q1ratio;
+        uint8_t q2ratio;
+        uint8_t body[SIMHASH_BODY];
+};
+
+/* 0, or -1 when data is too short or too uniform for a digest */
+int simhash_compute(const uint8_t *data, uint64_t size, struct simhash *h);
+
+/* 0 for the same digest, grows with the difference */
+uint32_t simhash_distance(const struct simhash *a, const struct simhash *b);
+
+/* SIMHASH_HEX bytes, NUL included */
+void simhash_hex(const struct simhash *h, char *out);
+
+/* the digests of a batch, one per input */
+struct simhash_file {
+        char *path;
+        struct simhash h[SIMHASH_SECS];
+        uint8_t present; /* bit per section */
+};
+
+struct simhash_set {
+        pthread_mutex_t lock;
+        struct simhash_file *files;
+        uint64_t n;
+        uint64_t cap;
+};
+
+struct simhash_pair {
+        uint32_t a;
+        uint32_t b;
+        uint32_t distance; /* mean of part[] over the sections either has */
+        uint32_t part[SIMHASH_SECS];
+};
+
+int simhash_set_init(struct simhash_set *s);
+void simhash_set_free(struct simhash_set *s);
+
+/* safe from any thread, inputs with no digest at all are dropped */
+int simhash_set_add(struct simhash_set *s, const char *path,
+                    const struct simhash *h, uint8_t present);
+
+/*
+ * pairs sharing a band of any section, each once with a < b, a band
+ * shared by many inputs pairs each only with its next neighbours
+ */
+int simhash_candidates(const struct simhash_set *s,
+                       struct simhash_pair **pairs, uint64_t *n);
+
+/* distance and part[] of p, -1 when the two have no section at all */
+int simhash_score(const struct simhash_set *s, struct simhash_pair *p);
+
+#endif /* SIMHASH_H */
@@ -0,0 +1,192 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+/*
+ * Copyright (C) Fadhil Riyanto <me@fadev.org>
+ */
+
+#include "size_report.h"
+#include <stdlib.h>
+#include <string.h>
+
+static uint64_t __size_fnv(uint64_t h, const char *s) {
+        for (; *s; s++)
+                h = (h ^ (uint8_t)*s) * 0x100000001b3ULL;
+        return h;
+}
+
+static uint64_t __size_key(uint32_t level, const char *name,
+                           const char *parent) {
+        uint64_t h = 0xcbf29ce484222325ULL ^ level;
+
+        h = __size_fnv(h, name);
+        h = (h ^ 0xff) * 0x100000001b3ULL;
+        return __size_fnv(h, parent);
+}
+
+static int __size_grow(struct size_report *r) {
+        uint64_t nslots = r->nslots ? r->nslots * 2 : 1024;
+        uint32_t *slots = (uint32_t *)calloc(nslots, sizeof(uint32_t));
+
+        if (slots == NULL)
+                return -1;
+
+        for (uint64_t k = 0; k < r->n; k++) {
+                const struct size_row *row = &r->rows[k];
+                uint64_t i = __size_key(row->level, r->pool + row->name,
+                                        r->pool + row->parent) &
+                             (nslots - 1);
+
+                while (slots[i])
+                        i = (i + 1) & (nslots - 1);
+                slots[i] = k + 1;
+        }
+
+        free(r->slots);
+        r->slots = slots;
+        r->nslots = nslots;
+        return 0;
+}
+
+/* offset of a copy of str in the pool, UINT64_MAX when out of memory */
+static uint64_t __size_str(struct size_report *r, const char *str) {
+        uint64_t len = strlen(str) + 1;
+
+        if (r->len + len > r->pool_cap) {
+                uint64_t cap = r->pool_cap ? r->pool_cap * 2 : 4096;
+
+                while (cap < r->len + len)
+                        cap *= 2;
+
+                char *pool = (char *)realloc(r->pool, cap);
+                if (pool == NULL)
+                        return UINT64_MAX;
+                r->pool = pool;
+                r->pool_cap = cap;
+        }
+
+        memcpy(r->pool + r->len, str, len);
+        r->len += len;
+        return r->len - len;
+}
+
+static struct size_row *__size_find(struct size_report *r,
+                                    const struct size_item *it) {
+        if (r->n * 2 >= r->nslots && __size_grow(r) < 0)
+                return NULL;
+
+        uint64_t i = __size_key(it->level, it->name, it->parent) &
+                     (r->nslots - 1);
+        for (; r->slots[i]; i = (i + 1) & (r->nslots - 1)) {
+                struct size_row *row = &r->rows[r->slots[i] - 1];
+
+                if (row->level == it->level &&
+                    strcmp(r->pool + row->name, it->name) == 0 &&
+                    strcmp(r->pool + row->parent, it->parent) == 0)
+                        return row;
+        }
+
+        if (r->n == r->cap) {
+                uint64_t cap = r->cap ? r->cap * 2 : 1024;
+                struct size_row *p = (struct size_row *)realloc(
+                    r->rows, cap * sizeof(struct size_row));
+
+                if (p == NULL)
+                        return NULL;
+                r->rows = p;
+                r->cap = cap;
+        }
+
+        uint64_t name = __size_str(r, it->name);
+        uint64_t parent = __size_str(r, it->parent);
+        if (name == UINT64_MAX || parent == UINT64_MAX)
+                return NULL;
+
+        struct size_row *row = &r->rows[r->n];
+        memset(row, 0, sizeof(struct size_row));
+        row->name = name;
+        row->parent = parent;
+        row->level = it->level;
+        r->slots[i] = ++r->n;
+        return row;
+}
+
+int size_report_init(struct size_report *r) {
+        memset(r, 0, sizeof(struct size_report));
+        pthread_mutex_init(&r->lock, NULL);
+        return __size_grow(r);
+}
+
+void size_report_free(struct size_report *r) {
+        free(r->rows);
+        free(r->slots);
+        free(r->pool);
+        pthread_mutex_destroy(&r->lock);
+        memset(r, 0, sizeof(struct size_report));
+}
+
+int size_report_add(struct size_report *r, const struct size_items *s,
+                    uint64_t file, uint64_t vm, int base) {
+        int ret = 0;
+
+        pthread_mutex_lock(&r->lock);
+
+        if (base) {
+                r->base_files++;
+                r->base_file += file;
+                r->base_vm += vm;
+        } else {
+                r->files++;
+                r->file += file;
+                r->vm += vm;
+        }
+
+        for (uint64_t i = 0; i < s->n; i++) {
+                struct size_row *row = __size_find(r, &s->items[i]);
+
+                if (row == NULL) {
+                        ret = -1;
+                        break;
+                }
+
+                if (base) {
+                        row->base_file += s->items[i].file;
+                        row->base_vm += s->items[i].vm;
+                } else {
+                        row->file += s->items[i].file;
+                        row->vm += s->items[i].vm;
+                }
+        }
+
+        pthread_mutex_unlock(&r->lock);
+        return ret;
+}
+
+void size_items_add(struct size_items *s, uint32_t level, const char *name,
+                    const char *parent, uint64_t file, uint64_t vm) {
+        if (file == 0 && vm == 0)
+                return;
+
+        if (s->n == s->cap) {
+                uint64_t cap = s->cap ? s->cap * 2 : 256;
+                struct size_item *items = (struct size_item *)realloc(
+                    s->items, cap * sizeof(struct size_item));
+                if (items == NULL) {
+                        s->failed = 1;
+                        return;
+                }
+
+                s->items = items;
+                s->cap = cap;
+        }
+
+        s->items[s->n].name = name;
+        s->items[s->n].parent = parent;
+        s->items[s->n].file = file;
+        s->items[s->n].vm = vm;
+        s->items[s->n].level = level;
+        s->n++;
+}
+
+void size_items_free(struct size_items *s) {
+        free(s->items);
+        memset(s, 0, sizeof(struct size_items));
+}
@@ -0,0 +1,91 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+/*
+ * Copyright (C) Fadhil Riyanto <me@fadev.org>
+ * --size-report, file and VM bytes by segment, section and symbol
+ *
+ * one row per (level, name, parent), the bytes of every input are
+ * added to the same rows, so a batch reports the whole set; a
+ * --size-baseline input adds to the base side of the rows and the
+ * report turns into a delta
+ */
+
+#ifndef SIZE_REPORT_H
+#define SIZE_REPORT_H
+
+#include <pthread.h>
+#include <stdint.h>
+
+enum size_level {
+        SIZE_SEGMENT,
+        SIZE_SECTION,
+        SIZE_SYMBOL,
+};
+
+struct size_row {
+        uint64_t name;   /* offset in the pool */
+        uint64_t parent; /* offset in the pool, "" for segments */
+        uint64_t file;
+        uint64_t vm;
+        uint64_t base_file;
+        uint64_t base_vm;
+        uint32_t level;
+};
+
+struct size_report {
+        pthread_mutex_t lock;
+
+        struct size_row *rows;
+        uint64_t n;
+        uint64_t cap;
+        uint32_t *slots; /* row index + 1, 0 is empty */
+        uint64_t nslots; /* power of two */
+
+        char *pool;
+        uint64_t len;
+        uint64_t pool_cap;
+
+        uint64_t files;
+        uint64_t file;
+        uint64_t vm;
+        uint64_t base_files;
+        uint64_t base_file;
+        uint64_t base_vm;
+};
+
+/* one attribution of an input, the same key may come many times */
+struct size_item {
+        const char *name;
+        const char *parent;
+        uint64_t file;
+        uint64_t vm;
+        uint32_t level;
+};
+
+struct size_items {
+        struct size_item *items;
+        uint64_t n;
+        uint64_t cap;
+        int failed; /* an item was lost to malloc */
+};
+
+int size_report_init(struct size_report *r);
+void size_report_free(struct size_report *r);
+
+/*
+ * the items of one input of file / vm bytes in total, safe from any
+ * thread, base adds to the baseline side
+ */
+int size_report_add(struct size_report *r, const struct size_items *s,
+                    uint64_t file, uint64_t vm, int base);
+
+/* empty items are dropped */
+void size_items_add(struct size_items *s, uint32_t level, const char *name,
+                    const char *parent, uint64_t file, uint64_t vm);
+void size_items_free(struct size_items *s);
+
+static inline const char *size_report_str(const struct size_report *r,
+                                          uint64_t off) {
+        return r->pool + off;
+}
+
+#endif /* SIZE_REPORT_H */
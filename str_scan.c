@@ -0,0 +1,243 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+/*
+ * Copyright (C) Fadhil Riyanto <me@fadev.org>
+ */
+
+#include "str_scan.h"
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+struct str_run {
+        uint64_t start; /* in units */
+        int in;
+        int owned; /* 0 for the run that was already going at start */
+};
+
+static inline int __str_printable(uint8_t c) {
+        return (c >= 0x20 && c <= 0x7e) || c == '\t';
+}
+
+static void __str_add(struct str_hits *hits, uint64_t offset, uint64_t len,
+                      int enc) {
+        if (hits->n == hits->cap) {
+                uint64_t cap = hits->cap ? hits->cap * 2 : 256;
+                struct str_hit *h = (struct str_hit *)realloc(
+                    hits->hits, cap * sizeof(struct str_hit));
+                if (h == NULL)
+                        return;
+
+                hits->hits = h;
+                hits->cap = cap;
+        }
+
+        hits->hits[hits->n].offset = offset;
+        hits->hits[hits->n].len = len > UINT32_MAX ? UINT32_MAX : len;
+        hits->hits[hits->n].enc = enc;
+        hits->n++;
+}
+
+#ifdef __SSE2__
+static inline __m128i __str_class(__m128i x) {
+        /* signed compare, 0x80..0xff are negative and drop out */
+        __m128i lo = _mm_cmpgt_epi8(x, _mm_set1_epi8(0x1f));
+        __m128i hi = _mm_cmplt_epi8(x, _mm_set1_epi8(0x7f));
+        __m128i tab = _mm_cmpeq_epi8(x, _mm_set1_epi8('\t'));
+
+        return _mm_or_si128(_mm_and_si128(lo, hi), tab);
+}
+#endif
+
+/* bit i: d[i] printable */
+static inline uint64_t __str_mask_ascii(const uint8_t *d) {
+#ifdef __SSE2__
+        uint64_t m = 0;
+
+        for (int k = 0; k < 4; k++) {
+                __m128i x = _mm_loadu_si128((const __m128i *)(d + 16 * k));
+
+                m |= (uint64_t)(uint16_t)_mm_movemask_epi8(__str_class(x))
+                     << (16 * k);
+        }
+        return m;
+#else
+        uint64_t m = 0;
+
+        for (int i = 0; i < 64; i++) {
+                if (__str_printable(d[i]))
+                        m |= (uint64_t)1 << i;
+        }
+        return m;
+#endif
+}
+
+/* bit i: d[2i] printable and d[2i+1] zero, 128 bytes in */
+static inline uint64_t __str_mask_utf16(const uint8_t *d) {
+#ifdef __SSE2__
+        const __m128i low = _mm_set1_epi16(0x00ff);
+        const __m128i zero = _mm_setzero_si128();
+        uint64_t m = 0;
+
+        for (int k = 0; k < 4; k++) {
+                __m128i a = _mm_loadu_si128((const __m128i *)(d + 32 * k));
+                __m128i b =
+                    _mm_loadu_si128((const __m128i *)(d + 32 * k + 16));
+                __m128i even = _mm_packus_epi16(_mm_and_si128(a, low),
+                                                _mm_and_si128(b, low));
+                __m128i odd = _mm_packus_epi16(_mm_srli_epi16(a, 8),
+                                               _mm_srli_epi16(b, 8));
+                __m128i ok = _mm_and_si128(__str_class(even),
+                                           _mm_cmpeq_epi8(odd, zero));
+
+                m |= (uint64_t)(uint16_t)_mm_movemask_epi8(ok) << (16 * k);
+        }
+        return m;
+#else
+        uint64_t m = 0;
+
+        for (int i = 0; i < 64; i++) {
+                if (__str_printable(d[2 * i]) && d[2 * i + 1] == 0)
+                        m |= (uint64_t)1 << i;
+        }
+        return m;
+#endif
+}
+
+static inline int __str_unit(const uint8_t *data, uint64_t off, int enc) {
+        if (enc == STR_ASCII)
+                return __str_printable(data[off]);
+        return __str_printable(data[off]) && data[off + 1] == 0;
+}
+
+static inline void __str_end(struct str_run *r, uint64_t unit, uint64_t base,
+                             uint32_t width, uint32_t min, int enc,
+                             struct str_hits *hits) {
+        if (r->owned && unit - r->start >= min)
+                __str_add(hits, base + r->start * width,
+                          (unit - r->start) * width, enc);
+        r->in = 0;
+        r->owned = 1;
+}
+
+/*
+ * units of width bytes from base, runs starting in [0, n) are ours,
+ * the one still open at n is followed as far as limit
+ */
+static void __str_runs(const uint8_t *data, uint64_t base, uint64_t n,
+                       uint64_t limit, uint32_t width, uint32_t min,
+                       int enc, struct str_hits *hits) {
+        struct str_run r = { 0, 0, 1 };
+        uint64_t nmax = (limit - base) / width;
+        uint64_t u = 0;
+
+        /* a run going on across base was found by the scan before it */
+        if (n && base >= width && __str_unit(data, base - width, enc) &&
+            __str_unit(data, base, enc))
+                r.owned = 0;
+
+        for (; u + 64 <= nmax; u += 64) {
+                const uint8_t *d = data + base + u * width;
+                uint32_t pos = 0;
+
+                if (u >= n && (!r.in || !r.owned))
+                        return;
+
+                uint64_t m = width == 1 ? __str_mask_ascii(d)
+                                        : __str_mask_utf16(d);
+                if (m == ~(uint64_t)0) {
+                        if (!r.in) {
+                                r.in = 1;
+                                r.start = u;
+                        }
+                        continue;
+                }
+
+                while (pos < 64) {
+                        uint64_t rest =
+                            (r.in ? ~m : m) & (~(uint64_t)0 << pos);
+
+                        if (rest == 0)
+                                break;
+
+                        pos = __builtin_ctzll(rest);
+                        if (r.in) {
+                                __str_end(&r, u + pos, base, width, min, enc,
+                                          hits);
+                        } else if (u + pos >= n) {
+                                return;
+                        } else {
+                                r.in = 1;
+                                r.start = u + pos;
+                        }
+                }
+        }
+
+        for (; u < nmax; u++) {
+                int p = __str_unit(data, base + u * width, enc);
+
+                if (u >= n && (!r.in || !r.owned))
+                        return;
+
+                if (p && !r.in) {
+                        r.in = 1;
+                        r.start = u;
+                } else if (!p && r.in) {
+                        __str_end(&r, u, base, width, min, enc, hits);
+                }
+        }
+
+        if (r.in)
+                __str_end(&r, nmax, base, width, min, enc, hits);
+}
+
+void str_scan(const uint8_t *data, uint64_t start, uint64_t end,
+              uint64_t limit, uint32_t min, int enc, struct str_hits *hits) {
+        if (end > limit)
+                end = limit;
+        if (start >= end)
+                return;
+
+        if (enc & STR_ASCII)
+                __str_runs(data, start, end - start, limit, 1, min,
+                           STR_ASCII, hits);
+
+        if (!(enc & STR_UTF16LE))
+                return;
+
+        /* both alignments, a unit counts where its first byte is */
+        for (uint64_t phase = 0; phase < 2; phase++) {
+                uint64_t base = start + ((start & 1) != phase);
+                uint64_t n = 0;
+
+                if (base < end)
+                        n = (end - base + 1) / 2;
+                if (base + n * 2 > limit)
+                        n = (limit - base) / 2;
+                __str_runs(data, base, n, limit, 2, min, STR_UTF16LE, hits);
+        }
+
+        str_hits_sort(hits);
+}
+
+static int __str_hit_cmp(const void *a, const void *b) {
+        const struct str_hit *x = (const struct str_hit *)a;
+        const struct str_hit *y = (const struct str_hit *)b;
+
+        if (x->offset != y->offset)
+                return x->offset < y->offset ? -1 : 1;
+        return x->enc < y->enc ? -1 : x->enc > y->enc;
+}
+
+void str_hits_sort(struct str_hits *hits) {
+        if (hits->n > 1)
+                qsort(hits->hits, hits->n, sizeof(struct str_hit),
+                      __str_hit_cmp);
+}
+
+void str_hits_free(struct str_hits *hits) {
+        free(hits->hits);
+        memset(hits, 0, sizeof(struct str_hits));
+}
@@ -0,0 +1,47 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+/*
+ * Copyright (C) Fadhil Riyanto <me@fadev.org>
+ * --strings, runs of printable characters
+ *
+ * printable is 0x20..0x7e and tab, as strings(1) has it, a UTF-16LE
+ * character is a printable byte followed by 0x00, both alignments are
+ * looked at
+ *
+ * 64 bytes are classified at once into a bit mask (SSE2), a run is
+ * then only a matter of finding the next 0 or 1 bit with ctz, so long
+ * stretches of text or of binary cost one compare per 16 bytes
+ */
+
+#ifndef STR_SCAN_H
+#define STR_SCAN_H
+
+#include <stdint.h>
+
+#define STR_ASCII 0x1
+#define STR_UTF16LE 0x2
+
+struct str_hit {
+        uint64_t offset;
+        uint32_t len; /* bytes, twice the characters for UTF-16LE */
+        uint8_t enc;  /* STR_ASCII or STR_UTF16LE */
+};
+
+struct str_hits {
+        struct str_hit *hits;
+        uint64_t n;
+        uint64_t cap;
+};
+
+/*
+ * runs of at least min characters starting in [start, end) of data,
+ * a run may go on past end up to limit, a run that was already going
+ * at start belongs to whoever scanned the bytes before it
+ */
+void str_scan(const uint8_t *data, uint64_t start, uint64_t end,
+              uint64_t limit, uint32_t min, int enc, struct str_hits *hits);
+
+/* by offset */
+void str_hits_sort(struct str_hits *hits);
+void str_hits_free(struct str_hits *hits);
+
+#endif /* STR_SCAN_H */
@@ -0,0 +1,240 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+/*
+ * Copyright (C) Fadhil Riyanto <me@fadev.org>
+ */
+
+#include "thread_pool.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+struct thread_pool_worker_arg {
+        struct thread_pool *tp;
+        int worker;
+};
+
+int thread_pool_nproc(void) {
+        long n = sysconf(_SC_NPROCESSORS_ONLN);
+
+        return n > 0 ? (int)n : 1;
+}
+
+static void __deque_push(struct thread_pool_deque *dq,
+                         struct thread_pool_task task) {
+        pthread_mutex_lock(&dq->lock);
+
+        if (dq->tail - dq->head == dq->cap) {
+                uint64_t cap = dq->cap ? dq->cap * 2 : 64;
+                struct thread_pool_task *tasks = (struct thread_pool_task *)
+                    malloc(cap * sizeof(struct thread_pool_task));
+
+                for (uint64_t i = dq->head; i < dq->tail; i++) {
+                        tasks[i & (cap - 1)] = dq->tasks[i & (dq->cap - 1)];
+                }
+
+                free(dq->tasks);
+                dq->tasks = tasks;
+                dq->cap = cap;
+        }
+
+        dq->tasks[dq->tail & (dq->cap - 1)] = task;
+        dq->tail = dq->tail + 1;
+
+        pthread_mutex_unlock(&dq->lock);
+}
+
+/*
+ * owner takes the oldest task (submit order is kept as much as
+ * possible), a thief takes the newest one from the other end
+ */
+static int __deque_pop(struct thread_pool_deque *dq,
+                       struct thread_pool_task *task, int steal) {
+        int ret = 0;
+
+        pthread_mutex_lock(&dq->lock);
+        if (dq->head != dq->tail) {
+                if (steal) {
+                        dq->tail = dq->tail - 1;
+                        *task = dq->tasks[dq->tail & (dq->cap - 1)];
+                } else {
+                        *task = dq->tasks[dq->head & (dq->cap - 1)];
+                        dq->head = dq->head + 1;
+                }
+                ret = 1;
+        }
+        pthread_mutex_unlock(&dq->lock);
+
+        return ret;
+}
+
+static int __thread_pool_grab(struct thread_pool *tp, int worker,
+                              struct thread_pool_task *task) {
+        if (__deque_pop(&tp->deques[worker], task, 0))
+                return 1;
+
+        for (int i = 1; i < tp->nthreads; i++) {
+                int victim = (worker + i) % tp->nthreads;
+
+                if (__deque_pop(&tp->deques[victim], task, 1))
+                        return 1;
+        }
+
+        return 0;
+}
+
+static void *__thread_pool_worker(void *data) {
+        struct thread_pool_worker_arg *arg =
+            (struct thread_pool_worker_arg *)data;
+        struct thread_pool *tp = arg->tp;
+        int worker = arg->worker;
+        struct thread_pool_task task;
+
+        free(arg);
+
+        while (1) {
+                if (__thread_pool_grab(tp, worker, &task)) {
+                        task.fn(tp, worker, task.arg);
+
+                        if (__atomic_sub_fetch(&tp->pending, 1,
+                                               __ATOMIC_ACQ_REL) == 0) {
+                                pthread_mutex_lock(&tp->idle_lock);
+                                pthread_cond_broadcast(&tp->done_cond);
+                                pthread_mutex_unlock(&tp->idle_lock);
+                        }
+                        continue;
+                }
+
+                pthread_mutex_lock(&tp->idle_lock);
+                if (tp->stop) {
+                        pthread_mutex_unlock(&tp->idle_lock);
+                        break;
+                }
+
+                /*
+                 * pending counts queued and running tasks, only sleep
+                 * when nothing is queued anywhere
+                 */
+                int queued = 0;
+                for (int i = 0; i < tp->nthreads && !queued; i++) {
+                        struct thread_pool_deque *dq = &tp->deques[i];
+
+                        pthread_mutex_lock(&dq->lock);
+                        queued = dq->head != dq->tail;
+                        pthread_mutex_unlock(&dq->lock);
+                }
+
+                if (!queued)
+                        pthread_cond_wait(&tp->idle_cond, &tp->idle_lock);
+                pthread_mutex_unlock(&tp->idle_lock);
+        }
+
+        return NULL;
+}
+
+/* wakes the first started workers for good and joins them */
+static void __thread_pool_stop(struct thread_pool *tp, int started) {
+        pthread_mutex_lock(&tp->idle_lock);
+        tp->stop = 1;
+        pthread_cond_broadcast(&tp->idle_cond);
+        pthread_mutex_unlock(&tp->idle_lock);
+
+        for (int i = 0; i < started; i++) {
+                pthread_join(tp->threads[i], NULL);
+        }
+}
+
+static void __thread_pool_free(struct thread_pool *tp) {
+        for (int i = 0; i < tp->nthreads; i++) {
+                pthread_mutex_destroy(&tp->deques[i].lock);
+                free(tp->deques[i].tasks);
+        }
+
+        pthread_cond_destroy(&tp->done_cond);
+        pthread_cond_destroy(&tp->idle_cond);
+        pthread_mutex_destroy(&tp->idle_lock);
+        free(tp->deques);
+        free(tp->threads);
+        tp->deques = NULL;
+        tp->threads = NULL;
+        tp->nthreads = 0;
+}
+
+int thread_pool_init(struct thread_pool *tp, int nthreads) {
+        if (nthreads < 1)
+                nthreads = 1;
+
+        tp->threads = (pthread_t *)malloc(sizeof(pthread_t) * nthreads);
+        tp->deques = (struct thread_pool_deque *)calloc(
+            nthreads, sizeof(struct thread_pool_deque));
+        tp->nthreads = nthreads;
+        tp->pending = 0;
+        tp->next_rr = 0;
+        tp->stop = 0;
+
+        pthread_mutex_init(&tp->idle_lock, NULL);
+        pthread_cond_init(&tp->idle_cond, NULL);
+        pthread_cond_init(&tp->done_cond, NULL);
+
+        for (int i = 0; i < nthreads; i++) {
+                pthread_mutex_init(&tp->deques[i].lock, NULL);
+        }
+
+        for (int i = 0; i < nthreads; i++) {
+                struct thread_pool_worker_arg *arg =
+                    (struct thread_pool_worker_arg *)malloc(
+                        sizeof(struct thread_pool_worker_arg));
+                arg->tp = tp;
+                arg->worker = i;
+
+                /*
+                 * running workers read nthreads without a lock, so it
+                 * never shrinks, a short pool is taken down instead
+                 */
+                if (pthread_create(&tp->threads[i], NULL, __thread_pool_worker,
+                                   arg) != 0) {
+                        perror("pthread_create()");
+                        free(arg);
+                        __thread_pool_stop(tp, i);
+                        __thread_pool_free(tp);
+                        return -1;
+                }
+        }
+
+        return 0;
+}
+
+/*
+ * worker < 0 spreads tasks round robin (submits from outside the pool),
+ * a task that spawns more work passes its own worker index so the new
+ * tasks stay local until somebody steals them
+ */
+void thread_pool_submit(struct thread_pool *tp, int worker, thread_pool_fn fn,
+                        void *arg) {
+        struct thread_pool_task task = { .fn = fn, .arg = arg };
+
+        if (worker < 0 || worker >= tp->nthreads) {
+                worker = __atomic_fetch_add(&tp->next_rr, 1, __ATOMIC_RELAXED) %
+                         tp->nthreads;
+        }
+
+        __atomic_add_fetch(&tp->pending, 1, __ATOMIC_ACQ_REL);
+        __deque_push(&tp->deques[worker], task);
+
+        pthread_mutex_lock(&tp->idle_lock);
+        pthread_cond_broadcast(&tp->idle_cond);
+        pthread_mutex_unlock(&tp->idle_lock);
+}
+
+/* wait until every submitted task, and what they spawned, is finished */
+void thread_pool_wait(struct thread_pool *tp) {
+        pthread_mutex_lock(&tp->idle_lock);
+        while (__atomic_load_n(&tp->pending, __ATOMIC_ACQUIRE) != 0) {
+                pthread_cond_wait(&tp->done_cond, &tp->idle_lock);
+        }
+        pthread_mutex_unlock(&tp->idle_lock);
+}
+
+void thread_pool_destroy(struct thread_pool *tp) {
+        __thread_pool_stop(tp, tp->nthreads);
+        __thread_pool_free(tp);
+}
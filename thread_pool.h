@@ -0,0 +1,53 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+/*
+ * Copyright (C) Fadhil Riyanto <me@fadev.org>
+ * work-stealing thread pool, every worker owns a deque, idle workers
+ * steal from the others
+ */
+
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <pthread.h>
+#include <stdint.h>
+
+struct thread_pool;
+
+/* worker is the index of the thread running the task, 0..nthreads-1 */
+typedef void (*thread_pool_fn)(struct thread_pool *tp, int worker, void *arg);
+
+struct thread_pool_task {
+        thread_pool_fn fn;
+        void *arg;
+};
+
+struct thread_pool_deque {
+        struct thread_pool_task *tasks;
+        uint64_t head; /* owner pops here */
+        uint64_t tail; /* submit pushes here, thieves steal here */
+        uint64_t cap;  /* power of two */
+        pthread_mutex_t lock;
+};
+
+struct thread_pool {
+        pthread_t *threads;
+        struct thread_pool_deque *deques;
+        int nthreads;
+
+        uint64_t pending; /* submitted and not finished, atomic */
+        uint64_t next_rr; /* round robin cursor for outside submits */
+        int stop;
+
+        pthread_mutex_t idle_lock;
+        pthread_cond_t idle_cond; /* new work, or stop */
+        pthread_cond_t done_cond; /* pending dropped to 0 */
+};
+
+int thread_pool_nproc(void);
+int thread_pool_init(struct thread_pool *tp, int nthreads);
+void thread_pool_submit(struct thread_pool *tp, int worker, thread_pool_fn fn,
+                        void *arg);
+void thread_pool_wait(struct thread_pool *tp);
+void thread_pool_destroy(struct thread_pool *tp);
+
+#endif /* THREAD_POOL_H */